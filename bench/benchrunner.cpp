@@ -0,0 +1,103 @@
+#include "benchrunner.h"
+
+#include <QDateTime>
+#include <QElapsedTimer>
+#include <QJsonArray>
+#include <QSysInfo>
+#include <QTextStream>
+#include <QVector>
+#include <algorithm>
+
+BenchRunner::BenchRunner(int iterations, const QString& filter)
+    : iterations(qMax(1, iterations))
+    , filter(filter)
+{
+}
+
+bool BenchRunner::isSelected(const QString& name) const
+{
+    return filter.isEmpty() || name.contains(filter);
+}
+
+void BenchRunner::run(const QString& name, int scale, qint64 bytes, std::function<void()> body, std::function<void()> setup)
+{
+    if(!isSelected(name))
+    {
+        return;
+    }
+
+    // Progress goes to stderr so stdout stays valid JSON
+    QTextStream err(stderr);
+    err << name << " x" << scale << "...";
+    err.flush();
+
+    QVector<qint64> times;
+    QElapsedTimer timer;
+    for(int i = -1; i < iterations; ++i)
+    {
+        if(setup)
+        {
+            setup();
+        }
+        timer.start();
+        body();
+        const qint64 nsec = timer.nsecsElapsed();
+        if(i >= 0)
+        {
+            times.append(nsec);
+        }
+    }
+    std::sort(times.begin(), times.end());
+
+    BenchResult result;
+    result.name = name;
+    result.scale = scale;
+    result.iterations = iterations;
+    result.min_nsec = times.first();
+    result.median_nsec = times[times.size() / 2];
+    qint64 total_nsec = 0;
+    foreach(qint64 nsec, times)
+    {
+        total_nsec += nsec;
+    }
+    result.mean_nsec = total_nsec / times.size();
+    result.bytes = bytes;
+    results.append(result);
+
+    err << " " << QString::number(result.median_nsec / 1000000.0, 'f', 3) << " ms\n";
+}
+
+const QList<BenchResult>& BenchRunner::getResults() const
+{
+    return results;
+}
+
+QJsonObject BenchRunner::toJson() const
+{
+    QJsonArray json_results;
+    foreach(const BenchResult& result, results)
+    {
+        QJsonObject json_result;
+        json_result["name"] = result.name;
+        json_result["scale"] = result.scale;
+        json_result["iterations"] = result.iterations;
+        json_result["min_nsec"] = result.min_nsec;
+        json_result["median_nsec"] = result.median_nsec;
+        json_result["mean_nsec"] = result.mean_nsec;
+        if(result.bytes > 0)
+        {
+            json_result["bytes"] = result.bytes;
+            json_result["mb_per_sec"] = result.median_nsec ? result.bytes * 1000.0 / result.median_nsec : 0.0;
+        }
+        json_results.append(json_result);
+    }
+
+    QJsonObject root;
+    root["suite"] = "edgba_bench";
+    root["timestamp"] = QDateTime::currentDateTimeUtc().toString(Qt::ISODate);
+    root["qt_version"] = QString(qVersion());
+    root["cpu"] = QSysInfo::currentCpuArchitecture();
+    root["os"] = QSysInfo::prettyProductName();
+    root["results"] = json_results;
+    return root;
+}
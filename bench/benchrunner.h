@@ -0,0 +1,39 @@
+#ifndef BENCHRUNNER_H
+#define BENCHRUNNER_H
+
+#include <QJsonObject>
+#include <QList>
+#include <QString>
+#include <functional>
+
+struct BenchResult
+{
+    QString name;
+    int scale;              // multiple of the sample project
+    int iterations;
+    qint64 min_nsec;
+    qint64 median_nsec;
+    qint64 mean_nsec;
+    qint64 bytes;           // data processed per iteration, 0 if not meaningful
+};
+
+// Times each benchmark body a fixed number of iterations after one warm up run.
+// Setup runs before every iteration and is not timed
+class BenchRunner
+{
+private:
+    int iterations;
+    QString filter;
+    QList<BenchResult> results;
+
+public:
+    BenchRunner(int iterations, const QString& filter);
+
+    bool isSelected(const QString& name) const;
+    void run(const QString& name, int scale, qint64 bytes, std::function<void()> body, std::function<void()> setup = nullptr);
+
+    const QList<BenchResult>& getResults() const;
+    QJsonObject toJson() const;
+};
+
+#endif // BENCHRUNNER_H
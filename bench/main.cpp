@@ -0,0 +1,336 @@
+#include "benchrunner.h"
+#include "syntheticproject.h"
+
+#include <filecache.h>
+#include <msglog.h>
+#include <gba/game.h>
+#include <gba/tileops.h>
+#include <gba/mapthumbnails.h>
+#include <gba/colorconv.h>
+#include <compiler/cgen.h>
+
+#include <QCoreApplication>
+#include <QCommandLineParser>
+#include <QFile>
+#include <QFileInfo>
+#include <QJsonDocument>
+#include <QTextStream>
+
+#define BENCH_EXIT_OK      0
+#define BENCH_EXIT_FAILED  1
+#define BENCH_EXIT_USAGE   2
+
+#ifndef EDGBA_BENCH_PROJECT
+#define EDGBA_BENCH_PROJECT "games/jrpg/rpg.edgba"
+#endif
+
+static qint64 generatedBytes(const Game& game)
+{
+    qint64 bytes = 0;
+    const QString generated_path = game.getAbsoluteGeneratedPath();
+    foreach(const QList<Asset*>& assets, game.asset_table)
+    {
+        foreach(Asset* asset, assets)
+        {
+            bytes += QFileInfo(generated_path + asset->getPath() + asset->getName() + ".c").size();
+        }
+    }
+    return bytes;
+}
+
+static void benchGame(BenchRunner& runner, SyntheticProject& project)
+{
+    const int scale = project.getScale();
+    Game game;
+    game.load(project.getProjectFile());
+    const qint64 bytes = generatedBytes(game);
+
+    runner.run("game_load_cold", scale, bytes, [&]()
+    {
+        game.load(project.getProjectFile());
+    }, []()
+    {
+        FileCache::get().clear();
+    });
+    runner.run("game_load_cached", scale, bytes, [&]()
+    {
+        game.load(project.getProjectFile());
+    });
+
+    // Save skips unchanged files, cold compares against the files on disk, cached against the file cache
+    runner.run("game_save_cold", scale, bytes, [&]()
+    {
+        game.save();
+    }, []()
+    {
+        FileCache::get().clear();
+    });
+    runner.run("game_save_cached", scale, bytes, [&]()
+    {
+        game.save();
+    });
+
+    QList<Map*> maps = game.getAssets<Map>();
+    runner.run("map_render", scale, 0, [&]()
+    {
+        QImage image;
+        foreach(Map* map, maps)
+        {
+            map->render(image);
+        }
+    });
+
+    // Generated on the pool without the disk cache
+    MapThumbnailCache thumbnails;
+    thumbnails.setCacheDir(QString());
+    runner.run("map_thumbnails", scale, 0, [&]()
+    {
+        thumbnails.clear();
+        foreach(Map* map, maps)
+        {
+            thumbnails.getThumbnail(map, 0);
+        }
+        thumbnails.waitForDone();
+        QCoreApplication::processEvents();
+    });
+
+    // Swaps the first two tiles, every run changes every map
+    const QVector<int> swap_remap = QVector<int>() << 1 << 0;
+    runner.run("map_tile_remap", scale, 0, [&]()
+    {
+        TileOps::apply(maps, TileOp::remapTiles(swap_remap));
+    });
+
+    QList<Tileset*> tilesets = game.getAssets<Tileset>();
+    runner.run("tileset_render_tile", scale, 0, [&]()
+    {
+        QImage tile(GBA_TILE_SIZE, GBA_TILE_SIZE, QImage::Format_Indexed8);
+        foreach(Tileset* tileset, tilesets)
+        {
+            QVector<QRgb> color_table = tileset->getPalette();
+            color_table.resize(GBA_PALETTE_COUNT);
+            tile.setColorTable(color_table);
+
+            const int tile_count = (tileset->getWidth() / GBA_TILE_SIZE) * (tileset->getHeight() / GBA_TILE_SIZE);
+            for(int tile_index = 0; tile_index < tile_count; ++tile_index)
+            {
+                tileset->renderTile(tile, tile_index, tile_index & 1, tile_index & 2, GBA_TILE_SIZE, GBA_TILE_SIZE);
+            }
+        }
+    });
+
+    runner.run("tileset_sync_palettes", scale, 0, [&]()
+    {
+        Tileset::syncPalettes(tilesets, game.getTilesetPalette());
+    });
+}
+
+// Every kernel the CPU runs must match GBA2RGBA and RGBA2GBA exactly, the timings mean nothing otherwise
+static bool checkColorConvKernels()
+{
+    QVector<unsigned short> gba_colors(0x10000);
+    QVector<QRgb> rgba_colors(0x10000);
+    for(int i = 0; i < gba_colors.size(); ++i)
+    {
+        gba_colors[i] = i;
+        // Every 8 bit value in each channel with the alpha going through 0
+        rgba_colors[i] = (QRgb(i & 0xff) << 24) | (QRgb(i & 0xff) << 16) | (QRgb(i >> 8) << 8) | QRgb((i * 7) & 0xff);
+    }
+
+    const ColorConvKernel default_kernel = getColorConvKernel();
+    const ColorConvKernel kernels[] = {ColorConvKernel::SCALAR, ColorConvKernel::SSE2, ColorConvKernel::AVX2};
+    bool success = true;
+    for(ColorConvKernel kernel : kernels)
+    {
+        if(!setColorConvKernel(kernel))
+        {
+            continue;
+        }
+
+        QVector<QRgb> out_rgba(gba_colors.size());
+        QVector<unsigned short> out_gba(rgba_colors.size());
+        QVector<unsigned short> round_trip(gba_colors.size());
+        convertGBAToRGBA(gba_colors.constData(), out_rgba.data(), gba_colors.size());
+        convertRGBAToGBA(rgba_colors.constData(), out_gba.data(), rgba_colors.size());
+        convertRGBAToGBA(out_rgba.constData(), round_trip.data(), out_rgba.size());
+        for(int i = 0; i < gba_colors.size(); ++i)
+        {
+            const bool rgba_ok = out_rgba[i] == GBA2RGBA(gba_colors[i]);
+            const bool gba_ok = out_gba[i] == RGBA2GBA(rgba_colors[i]);
+            // The 16th bit is not a color, everything else comes back
+            const bool round_trip_ok = round_trip[i] == (gba_colors[i] & 0x7fff);
+            if(!rgba_ok || !gba_ok || !round_trip_ok)
+            {
+                QTextStream(stderr) << "Color conversion " << getColorConvKernelName(kernel) << " differs at " << i << "\n";
+                success = false;
+                break;
+            }
+        }
+    }
+    setColorConvKernel(default_kernel);
+    return success;
+}
+
+static void benchColors(BenchRunner& runner, int scale, const QImage& image)
+{
+    const QImage argb = image.convertToFormat(QImage::Format_ARGB32);
+    const int count = argb.width() * argb.height();
+    const QRgb* rgba_colors = reinterpret_cast<const QRgb*>(argb.constBits());
+    QVector<unsigned short> gba_colors(count);
+    QVector<QRgb> out_rgba(count);
+
+    const ColorConvKernel default_kernel = getColorConvKernel();
+    const ColorConvKernel kernels[] = {ColorConvKernel::SCALAR, ColorConvKernel::SSE2, ColorConvKernel::AVX2};
+    for(ColorConvKernel kernel : kernels)
+    {
+        if(!setColorConvKernel(kernel))
+        {
+            continue;
+        }
+        const QString kernel_name = getColorConvKernelName(kernel);
+        runner.run("color_rgba_to_gba_" + kernel_name, scale, qint64(count) * sizeof(QRgb), [&]()
+        {
+            convertRGBAToGBA(rgba_colors, gba_colors.data(), count);
+        });
+        runner.run("color_gba_to_rgba_" + kernel_name, scale, qint64(count) * sizeof(unsigned short), [&]()
+        {
+            convertGBAToRGBA(gba_colors.constData(), out_rgba.data(), count);
+        });
+    }
+    setColorConvKernel(default_kernel);
+}
+
+static void benchImage(BenchRunner& runner, SyntheticProject& project, const QString& sample_project_file)
+{
+    const int scale = project.getScale();
+    const QString image_file = project.createLargeImage(sample_project_file);
+    if(image_file.isEmpty())
+    {
+        QTextStream(stderr) << "Failed to create the large image\n";
+        return;
+    }
+
+    QImage image;
+    const qint64 file_bytes = QFileInfo(image_file).size();
+    runner.run("png_decode", scale, file_bytes, [&]()
+    {
+        image.load(image_file);
+    });
+
+    benchColors(runner, scale, image);
+
+    TiledImage tiled_image;
+    runner.run("tiled_image_load_from_image", scale, qint64(image.width()) * image.height(), [&]()
+    {
+        tiled_image.loadFromImage(image);
+    });
+
+    const QVector<unsigned char>& pixels = tiled_image.getPixels();
+    const int width = tiled_image.getWidth();
+    const int height = tiled_image.getHeight();
+    QVector<unsigned char> gba_pixels;
+    runner.run("translate_to_gba_image", scale, pixels.size(), [&]()
+    {
+        gba_pixels = translateToGBAImage(pixels, GBA_TILE_SIZE, GBA_TILE_SIZE, width, height);
+    });
+    runner.run("translate_from_gba_image", scale, pixels.size(), [&]()
+    {
+        translateFromGBAImage(gba_pixels, GBA_TILE_SIZE, GBA_TILE_SIZE, width, height);
+    });
+
+    QString text;
+    runner.run("cgen_array_write", scale, gba_pixels.size(), [&]()
+    {
+        text.clear();
+        QTextStream out(&text);
+        CGen::ArrayWriter writer(out);
+        writer.writeAllValues(CGen::Type::CONST_UNSIGNED_CHAR, "bench_pixels", gba_pixels);
+    });
+    runner.run("cgen_array_read", scale, text.size(), [&]()
+    {
+        QTextStream in(&text);
+        CGen::ArrayReader reader(in);
+        QString id;
+        QVector<unsigned char> values;
+        reader.readAllValues(CGen::Type::CONST_UNSIGNED_CHAR, id, values);
+    });
+}
+
+int main(int argc, char** argv)
+{
+    QCoreApplication app(argc, argv);
+    QTextStream err(stderr);
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("EdGBA core benchmarks. Writes the results as JSON");
+    parser.addHelpOption();
+
+    QCommandLineOption project_option("project", "Sample project to scale.", "project", EDGBA_BENCH_PROJECT);
+    QCommandLineOption scales_option("scales", "Comma separated multiples of the sample project.", "scales", "1,10,100");
+    QCommandLineOption iterations_option("iterations", "Timed runs of each benchmark.", "N", "5");
+    QCommandLineOption filter_option("filter", "Only run benchmarks whose name contains the text.", "text");
+    QCommandLineOption output_option("output", "Write the JSON to a file instead of stdout.", "file");
+    parser.addOption(project_option);
+    parser.addOption(scales_option);
+    parser.addOption(iterations_option);
+    parser.addOption(filter_option);
+    parser.addOption(output_option);
+    parser.process(app);
+
+    const QString sample_project_file = QFileInfo(parser.value(project_option)).absoluteFilePath();
+    if(!QFileInfo(sample_project_file).isFile())
+    {
+        err << "Project file does not exist " << sample_project_file << "\n";
+        return BENCH_EXIT_USAGE;
+    }
+
+    QList<int> scales;
+    foreach(const QString& scale_text, parser.value(scales_option).split(',', QString::SkipEmptyParts))
+    {
+        bool scale_ok = false;
+        const int scale = scale_text.trimmed().toInt(&scale_ok);
+        if(!scale_ok || scale < 1)
+        {
+            err << "Invalid --scales " << parser.value(scales_option) << "\n";
+            return BENCH_EXIT_USAGE;
+        }
+        scales << scale;
+    }
+
+    if(!checkColorConvKernels())
+    {
+        return BENCH_EXIT_FAILED;
+    }
+
+    // Nobody listens to the log, do not let it queue up
+    MsgLog::get().setFlushInterval(0);
+
+    BenchRunner runner(parser.value(iterations_option).toInt(), parser.value(filter_option));
+    foreach(int scale, scales)
+    {
+        SyntheticProject project;
+        if(!project.create(sample_project_file, scale))
+        {
+            err << "Failed to create the x" << scale << " project in " << project.getPath() << "\n";
+            return BENCH_EXIT_FAILED;
+        }
+        benchGame(runner, project);
+        benchImage(runner, project, sample_project_file);
+    }
+
+    const QByteArray json = QJsonDocument(runner.toJson()).toJson(QJsonDocument::Indented);
+    if(parser.isSet(output_option))
+    {
+        QFile file(parser.value(output_option));
+        if(!file.open(QIODevice::WriteOnly | QIODevice::Truncate) || file.write(json) != json.size())
+        {
+            err << "Failed to write " << parser.value(output_option) << "\n";
+            return BENCH_EXIT_FAILED;
+        }
+    }
+    else
+    {
+        QTextStream(stdout) << json;
+    }
+    return BENCH_EXIT_OK;
+}
@@ -0,0 +1,152 @@
+#include "syntheticproject.h"
+
+#include <gba/gba.h>
+
+#include <QDir>
+#include <QDirIterator>
+#include <QFile>
+#include <QFileInfo>
+#include <QRegularExpression>
+#include <QStringList>
+#include <QTextStream>
+#include <math.h>
+#include <string.h>
+
+static bool copyDir(const QString& from_dir, const QString& to_dir)
+{
+    QDirIterator it(from_dir, QDir::Files, QDirIterator::Subdirectories);
+    while(it.hasNext())
+    {
+        const QString from_file = it.next();
+        const QString to_file = to_dir + "/" + QDir(from_dir).relativeFilePath(from_file);
+        QDir().mkpath(QFileInfo(to_file).absolutePath());
+        if(!QFile::copy(from_file, to_file))
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+static bool readText(const QString& file_path, QString& out_text)
+{
+    QFile file(file_path);
+    if(!file.open(QIODevice::ReadOnly))
+    {
+        return false;
+    }
+    out_text = QString::fromUtf8(file.readAll());
+    return true;
+}
+
+static bool writeText(const QString& file_path, const QString& text)
+{
+    QFile file(file_path);
+    if(!file.open(QIODevice::WriteOnly | QIODevice::Truncate))
+    {
+        return false;
+    }
+    return file.write(text.toUtf8()) >= 0;
+}
+
+SyntheticProject::SyntheticProject()
+    : scale(1)
+{
+}
+
+bool SyntheticProject::create(const QString& sample_project_file, int scale)
+{
+    this->scale = scale;
+    const QFileInfo sample_info(sample_project_file);
+    if(!dir.isValid() || !copyDir(sample_info.absolutePath(), dir.path()))
+    {
+        return false;
+    }
+    project_file = dir.path() + "/" + sample_info.fileName();
+
+    // Every asset declares and references its data through identifiers starting with its name,
+    // so renaming that prefix makes an independent copy. References to other assets are kept
+    QStringList asset_dirs;
+    asset_dirs << GBA_MAPS_PATH << GBA_TILESETS_PATH << GBA_SPRITESHEETS_PATH << GBA_SPRITEANIMS_PATH;
+    foreach(const QString& asset_dir, asset_dirs)
+    {
+        const QString path = dir.path() + "/" GBA_GENERATED_PATH + asset_dir;
+        foreach(const QFileInfo& info, QDir(path).entryInfoList(QStringList() << "*.c", QDir::Files))
+        {
+            QString text;
+            if(!readText(info.absoluteFilePath(), text))
+            {
+                return false;
+            }
+
+            const QString name = info.completeBaseName();
+            const QRegularExpression name_regex("\\b" + QRegularExpression::escape(name));
+            for(int copy = 1; copy < scale; ++copy)
+            {
+                const QString copy_name = name + "_S" + QString::number(copy);
+                QString copy_text = text;
+                copy_text.replace(name_regex, copy_name);
+                if(!writeText(path + copy_name + ".c", copy_text))
+                {
+                    return false;
+                }
+            }
+        }
+    }
+    return true;
+}
+
+QString SyntheticProject::getProjectFile() const
+{
+    return project_file;
+}
+
+QString SyntheticProject::getPath() const
+{
+    return dir.path();
+}
+
+int SyntheticProject::getScale() const
+{
+    return scale;
+}
+
+QString SyntheticProject::createLargeImage(const QString& sample_project_file)
+{
+    const QString images_path = QFileInfo(sample_project_file).absolutePath() + "/" GBA_IMAGES_PATH;
+    QImage sample;
+    foreach(const QFileInfo& info, QDir(images_path).entryInfoList(QStringList() << "*.png", QDir::Files))
+    {
+        QImage image(info.absoluteFilePath());
+        if(image.width() * image.height() > sample.width() * sample.height())
+        {
+            sample = image;
+        }
+    }
+    if(sample.isNull())
+    {
+        return QString();
+    }
+
+    // Copied by scanline, the benchmark only needs QtCore and QImage
+    sample = sample.convertToFormat(QImage::Format_ARGB32);
+    const int side = int(ceil(sqrt(double(scale))));
+    const int row_bytes = sample.width() * 4;
+    QImage large(sample.width() * side, sample.height() * side, QImage::Format_ARGB32);
+    for(int y = 0; y < large.height(); ++y)
+    {
+        const uchar* from = sample.constScanLine(y % sample.height());
+        uchar* to = large.scanLine(y);
+        for(int x = 0; x < side; ++x)
+        {
+            memcpy(to + x * row_bytes, from, size_t(row_bytes));
+        }
+    }
+
+    const QString image_file = dir.path() + "/large_x" + QString::number(scale) + ".png";
+    if(!large.save(image_file))
+    {
+        return QString();
+    }
+    return image_file;
+}
@@ -0,0 +1,29 @@
+#ifndef SYNTHETICPROJECT_H
+#define SYNTHETICPROJECT_H
+
+#include <QImage>
+#include <QString>
+#include <QTemporaryDir>
+
+// Copy of a sample project in a temporary directory with every map, tileset, spritesheet and animation
+// duplicated scale times under new names. The shared palettes and the code are kept as they are
+class SyntheticProject
+{
+private:
+    QTemporaryDir dir;
+    QString project_file;
+    int scale;
+
+public:
+    SyntheticProject();
+
+    bool create(const QString& sample_project_file, int scale);
+    QString getProjectFile() const;
+    QString getPath() const;
+    int getScale() const;
+
+    // The largest image of the sample tiled in a grid to about scale times its area, written as png
+    QString createLargeImage(const QString& sample_project_file);
+};
+
+#endif // SYNTHETICPROJECT_H
@@ -0,0 +1,31 @@
+# Headless benchmarks of the core model and compiler. Prints JSON results, see edgba_bench --help
+CONFIG += qt console release
+CONFIG -= app_bundle
+
+QT += core gui
+
+TARGET = edgba_bench
+TEMPLATE = app
+
+# The sample project scaled by the benchmarks
+DEFINES += EDGBA_BENCH_PROJECT=\\\"$$PWD/games/jrpg/rpg.edgba\\\"
+
+SOURCES = bench/main.cpp \
+bench/benchrunner.cpp \
+bench/syntheticproject.cpp
+
+HEADERS = \
+bench/benchrunner.h \
+bench/syntheticproject.h
+
+INCLUDEPATH += bench
+
+# Time the hot paths with their trace zones, as in a debug editor
+DEFINES += EDGBA_TRACE=1
+
+# gba/ and compiler/ model code, does not depend on widgets
+include(edgba_core.pri)
+
+linux-g++ | linux-g++-64 | linux-g++-32{
+	QMAKE_CXXFLAGS += -Wno-deprecated-copy -Wno-class-memaccess
+}
@@ -0,0 +1,71 @@
+# EdGBA core: the game model, asset export and ROM compiler without any widgets.
+# Shared by the editor, the command line build and the benchmarks.
+QT += core gui
+
+INCLUDEPATH += $$PWD/source
+
+# Scoped timing zones, see source/trace.h. Release editor builds leave them out
+CONFIG(debug, debug|release): DEFINES += EDGBA_TRACE=1
+
+SOURCES += \
+$$PWD/source/common.cpp \
+$$PWD/source/filecache.cpp \
+$$PWD/source/msglog.cpp \
+$$PWD/source/trace.cpp \
+$$PWD/source/config.cpp \
+$$PWD/source/gba/game.cpp \
+$$PWD/source/gba/map.cpp \
+$$PWD/source/gba/tiledimage.cpp \
+$$PWD/source/gba/sourcefile.cpp \
+$$PWD/source/gba/spritesheet.cpp \
+$$PWD/source/gba/tileset.cpp \
+$$PWD/source/gba/spriteanim.cpp \
+$$PWD/source/gba/palette.cpp \
+$$PWD/source/gba/colorconv.cpp \
+$$PWD/source/gba/asset.cpp \
+$$PWD/source/gba/assetgraph.cpp \
+$$PWD/source/gba/editjournal.cpp \
+$$PWD/source/gba/tileops.cpp \
+$$PWD/source/gba/mapthumbnails.cpp \
+$$PWD/source/gba/batchimporter.cpp \
+$$PWD/source/compiler/cgen.cpp \
+$$PWD/source/compiler/clexer.cpp \
+$$PWD/source/compiler/buildtrace.cpp \
+$$PWD/source/compiler/buildfilegen.cpp \
+$$PWD/source/compiler/elfanalyzer.cpp \
+$$PWD/source/compiler/romcompiler.cpp \
+$$PWD/source/compiler/romautobuilder.cpp \
+$$PWD/source/compiler/symbolindex.cpp
+
+HEADERS += \
+$$PWD/source/rle.h \
+$$PWD/source/defines.h \
+$$PWD/source/common.h \
+$$PWD/source/filecache.h \
+$$PWD/source/msglog.h \
+$$PWD/source/trace.h \
+$$PWD/source/config.h \
+$$PWD/source/gba/game.h \
+$$PWD/source/gba/map.h \
+$$PWD/source/gba/tiledimage.h \
+$$PWD/source/gba/sourcefile.h \
+$$PWD/source/gba/spritesheet.h \
+$$PWD/source/gba/tileset.h \
+$$PWD/source/gba/spriteanim.h \
+$$PWD/source/gba/palette.h \
+$$PWD/source/gba/colorconv.h \
+$$PWD/source/gba/asset.h \
+$$PWD/source/gba/assetgraph.h \
+$$PWD/source/gba/editjournal.h \
+$$PWD/source/gba/tileops.h \
+$$PWD/source/gba/mapthumbnails.h \
+$$PWD/source/gba/batchimporter.h \
+$$PWD/source/compiler/cgen.h \
+$$PWD/source/compiler/cschema.h \
+$$PWD/source/compiler/clexer.h \
+$$PWD/source/compiler/buildtrace.h \
+$$PWD/source/compiler/buildfilegen.h \
+$$PWD/source/compiler/elfanalyzer.h \
+$$PWD/source/compiler/romcompiler.h \
+$$PWD/source/compiler/romautobuilder.h \
+$$PWD/source/compiler/symbolindex.h
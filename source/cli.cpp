@@ -0,0 +1,135 @@
+#include "cli.h"
+#include "defines.h"
+#include "msglog.h"
+
+#include <gba/game.h>
+#include <gba/batchimporter.h>
+#include <compiler/romcompiler.h>
+
+#include <QCoreApplication>
+#include <QCommandLineParser>
+#include <QFileInfo>
+#include <QTextStream>
+#include <QThread>
+
+bool CommandLine::isHeadless(int argc, char** argv)
+{
+    for(int i = 1; i < argc; ++i)
+    {
+        const QString arg = argv[i];
+        if(arg == "--build" || arg.startsWith("--build=") || arg == "--help" || arg == "-h")
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+int CommandLine::run(int argc, char** argv)
+{
+    QCoreApplication app(argc, argv);
+    QCoreApplication::setApplicationName(EDGBA_APP_NAME);
+    QCoreApplication::setOrganizationName(EDGBA_ORG_NAME);
+
+    QTextStream err(stderr);
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription(EDGBA_TITLE " headless asset export and ROM build");
+    parser.addHelpOption();
+
+    QCommandLineOption build_option("build", "Export the assets and build the ROM of the project file.", "project");
+    QCommandLineOption jobs_option("jobs", "Number of files to compile in parallel.", "N", QString::number(QThread::idealThreadCount()));
+    QCommandLineOption export_option("export-only", "Only export the assets, do not build the ROM.");
+    QCommandLineOption import_tileset_option("import-tileset", "Import an image as a tileset before the build. Can be repeated.", "image");
+    QCommandLineOption import_spritesheet_option("import-spritesheet", "Import an image as a spritesheet before the build. Can be repeated.", "image");
+    parser.addOption(build_option);
+    parser.addOption(jobs_option);
+    parser.addOption(export_option);
+    parser.addOption(import_tileset_option);
+    parser.addOption(import_spritesheet_option);
+
+    if(!parser.parse(app.arguments()))
+    {
+        err << parser.errorText() << "\n" << parser.helpText();
+        return CLI_EXIT_USAGE;
+    }
+
+    if(parser.isSet("help"))
+    {
+        QTextStream(stdout) << parser.helpText();
+        return CLI_EXIT_OK;
+    }
+
+    if(!parser.isSet(build_option))
+    {
+        err << "Missing --build <project>\n" << parser.helpText();
+        return CLI_EXIT_USAGE;
+    }
+
+    bool jobs_ok = false;
+    const int jobs = parser.value(jobs_option).toInt(&jobs_ok);
+    if(!jobs_ok || jobs < 1)
+    {
+        err << "Invalid --jobs " << parser.value(jobs_option) << "\n";
+        return CLI_EXIT_USAGE;
+    }
+
+    const QString project_file = QFileInfo(parser.value(build_option)).absoluteFilePath();
+    if(!QFileInfo(project_file).isFile())
+    {
+        err << "Project file does not exist " << project_file << "\n";
+        return CLI_EXIT_USAGE;
+    }
+
+    // Stream the message log to stdout. There is no event loop during the build, so flush on every message
+    CommandLine output;
+    QObject::connect(&MsgLog::get(), SIGNAL(textPosted(QString)), &output, SLOT(on_text(QString)));
+    MsgLog::get().setFlushInterval(0);
+
+    Game game;
+    if(!game.load(project_file))
+    {
+        msgError("Game") << "Failed to load " << project_file << "\n";
+        return CLI_EXIT_USAGE;
+    }
+    msgLog("Game") << "Loaded Game " << game.getAbsoluteProjectFile() << "\n";
+
+    // Imported assets are saved to the project along with the export
+    BatchImporter importer;
+    foreach(const QString& image_file, parser.values(import_tileset_option))
+    {
+        importer.addFile(QFileInfo(image_file).absoluteFilePath(), BatchImportType::TILESET);
+    }
+    foreach(const QString& image_file, parser.values(import_spritesheet_option))
+    {
+        importer.addFile(QFileInfo(image_file).absoluteFilePath(), BatchImportType::SPRITESHEET);
+    }
+    if(importer.getItems().size())
+    {
+        importer.decode();
+        QList<Asset*> added, updated;
+        importer.apply(&game, added, updated);
+        game.save();
+    }
+
+    if(parser.isSet(export_option))
+    {
+        game.save();
+        msgLog("Game") << "Exported assets to " << game.getAbsoluteGeneratedPath() << "\n";
+        return CLI_EXIT_OK;
+    }
+
+    RomCompiler rom_compiler;
+    if(!rom_compiler.buildNow(&game, jobs))
+    {
+        return CLI_EXIT_BUILD_FAILED;
+    }
+    return CLI_EXIT_OK;
+}
+
+void CommandLine::on_text(QString text)
+{
+    QTextStream out(stdout);
+    out << text;
+    out.flush();
+}
@@ -0,0 +1,26 @@
+#ifndef CLI_H
+#define CLI_H
+
+#include <QObject>
+#include <QString>
+
+// Process exit codes of the command line
+#define CLI_EXIT_OK           0
+#define CLI_EXIT_BUILD_FAILED 1
+#define CLI_EXIT_USAGE        2
+
+// Headless build without any widgets. Usage edgba --build <project.edgba> [--jobs N] [--export-only]
+// [--import-tileset <image>]... [--import-spritesheet <image>]...
+class CommandLine : public QObject
+{
+    Q_OBJECT
+public:
+    // True if the arguments request a headless run instead of the editor
+    static bool isHeadless(int argc, char** argv);
+    static int run(int argc, char** argv);
+
+public slots:
+    void on_text(QString text);
+};
+
+#endif // CLI_H
@@ -1,8 +1,10 @@
 #include "common.h"
 #include "msglog.h"
 #include "config.h"
+#include "filecache.h"
+#include <QFile>
 #include <QFileInfo>
-#include <QApplication>
+#include <QCoreApplication>
 #include <QProcessEnvironment>
 
 QString Common::absoluteFile(const QString& in_file)
@@ -33,7 +35,7 @@ QString Common::absolutePath(const QString& in_path)
 // Get the full path to the exe
 QString Common::getExePath(const QString& file_or_path_suffix)
 {
-    return absolutePath(QApplication::applicationDirPath()) + file_or_path_suffix;
+    return absolutePath(QCoreApplication::applicationDirPath()) + file_or_path_suffix;
 }
 
 QString Common::getSystemVariable(const QString& variable, const QString& default_value)
@@ -79,3 +81,8 @@ bool Common::dirExists(const QString& path)
     }
     return false;
 }
+
+bool Common::writeFileIfChanged(const QString& path, const QByteArray& data)
+{
+    return FileCache::get().write(path, data);
+}
@@ -2,6 +2,7 @@
 #define COMMON_H
 
 #include <QString>
+#include <QByteArray>
 
 namespace Common
 {
@@ -17,6 +18,9 @@ namespace Common
 
     bool fileExists(const QString& path);
     bool dirExists(const QString& path);
+
+    // Only writes when the contents differ, so unchanged files keep their timestamp for incremental builds
+    bool writeFileIfChanged(const QString& path, const QByteArray& data);
 }
 
 #endif // COMMON_H
@@ -0,0 +1,287 @@
+#include "buildfilegen.h"
+#include "romcompiler.h"
+#include <common.h>
+
+#include <QDir>
+#include <QFileInfo>
+#include <QRegularExpression>
+
+#define NINJA_FILE "build.ninja"
+#define MAKE_FILE  "Makefile"
+#define BUILD_FILE_HEADER "Generated by EdGBA from the build settings. Changes are overwritten on export"
+
+// Stand-ins for the per step variables. Replaced by the build tool's own variables after quoting
+#define PLACEHOLDER_SOURCE  "@@SOURCE@@"
+#define PLACEHOLDER_OBJECT  "@@OBJECT@@"
+#define PLACEHOLDER_OBJECTS "@@OBJECTS@@"
+
+typedef QString (*EscapeFunc)(const QString&);
+
+static QString shellQuote(const QString& arg)
+{
+    static const QRegularExpression unsafe("[^A-Za-z0-9_@%+=:,./-]");
+    if(arg.size() && !arg.contains(unsafe))
+    {
+        return arg;
+    }
+#ifdef _WIN32
+    return "\"" + arg + "\"";
+#else
+    QString quoted = arg;
+    quoted.replace("'", "'\\''");
+    return "'" + quoted + "'";
+#endif
+}
+
+static QString ninjaEscapeCommand(const QString& text)
+{
+    QString escaped = text;
+    return escaped.replace("$", "$$");
+}
+
+static QString ninjaEscapePath(const QString& path)
+{
+    QString escaped = ninjaEscapeCommand(path);
+    escaped.replace(" ", "$ ");
+    escaped.replace(":", "$:");
+    return escaped;
+}
+
+static QString makeEscapeCommand(const QString& text)
+{
+    QString escaped = text;
+    return escaped.replace("$", "$$");
+}
+
+static QString makeEscapePath(const QString& path)
+{
+    QString escaped = makeEscapeCommand(path);
+    escaped.replace(" ", "\\ ");
+    escaped.replace("#", "\\#");
+    return escaped;
+}
+
+// Args with %{TEMP} pointing at the build dir, so objects and the elf are kept between builds
+static RomCompileArgs getBuildArgs(const RomCompileArgs& args)
+{
+    RomCompileArgs build_args = args;
+    build_args.variables["%{TEMP}"] = BuildFileGenerator::getBuildDir(args);
+    return build_args;
+}
+
+// Expands a step into a single shell command line
+static QString buildCommand(const RomCompileArgs& args, const QString& step, EscapeFunc escape, const QString& source, const QString& object, const QString& objects)
+{
+    RomCompileArgs step_args = args;
+    step_args.variables["%{SOURCE}"] = PLACEHOLDER_SOURCE;
+    step_args.variables["%{OBJECT}"] = PLACEHOLDER_OBJECT;
+    step_args.variables["%{OBJECTS}"] = PLACEHOLDER_OBJECTS;
+
+    QString program;
+    QStringList program_args;
+    step_args.buildProgramCommand(step, program, program_args);
+
+    const QString program_path = args.findProgram(program);
+    QString command = escape(shellQuote(program_path.size() ? program_path : program));
+    foreach(const QString& arg, program_args)
+    {
+        command += " " + escape(shellQuote(arg));
+    }
+
+    command.replace(PLACEHOLDER_SOURCE, source);
+    command.replace(PLACEHOLDER_OBJECT, object);
+    command.replace(PLACEHOLDER_OBJECTS, objects);
+    return command;
+}
+
+static void getObjects(const RomCompileArgs& args, QStringList& out_sources, QStringList& out_objects, QStringList& out_rules)
+{
+    // Mirrors RomCompilerWorker, assembly first
+    foreach(const QString& sourcefile, args.sourcefiles)
+    {
+        QString objectfile;
+        if(QFileInfo(sourcefile).suffix() == "S" && args.getObjectFile(sourcefile, objectfile))
+        {
+            out_sources << sourcefile;
+            out_objects << objectfile;
+            out_rules << "as";
+        }
+    }
+    foreach(const QString& sourcefile, args.sourcefiles)
+    {
+        QString objectfile;
+        if(QFileInfo(sourcefile).suffix() == "c" && args.getObjectFile(sourcefile, objectfile))
+        {
+            out_sources << sourcefile;
+            out_objects << objectfile;
+            out_rules << "cc";
+        }
+    }
+}
+
+QString BuildFileGenerator::getBuildDir(const RomCompileArgs& args)
+{
+    return args.expandVariable("%{BUILD}");
+}
+
+QString BuildFileGenerator::getElfFile(const RomCompileArgs& args)
+{
+    return getBuildArgs(args).expandVariable("%{TEMP}%{GAME}.elf");
+}
+
+QString BuildFileGenerator::getNinjaFile(const RomCompileArgs& args)
+{
+    return getBuildDir(args) + NINJA_FILE;
+}
+
+QString BuildFileGenerator::generateNinja(const RomCompileArgs& in_args)
+{
+    const RomCompileArgs args = getBuildArgs(in_args);
+    const EscapeFunc escape = ninjaEscapeCommand;
+
+    QString out;
+    out += "# " BUILD_FILE_HEADER "\n";
+    out += "ninja_required_version = 1.3\n";
+    out += "builddir = " + ninjaEscapePath(getBuildDir(args)) + "\n\n";
+
+    if(args.custom_step.size())
+    {
+        out += "rule custom\n";
+        out += "  command = " + buildCommand(args, args.custom_step, escape, "", "", "") + "\n";
+        out += "  description = Custom build\n";
+        out += "  pool = console\n\n";
+        out += "build custom: custom\n";
+        out += "default custom\n";
+        return out;
+    }
+
+#ifdef _WIN32
+    // ninja does not run commands through a shell on windows
+    const QString shell = "cmd /c ";
+#else
+    const QString shell = "";
+#endif
+
+    out += "rule cc\n";
+    out += "  command = " + buildCommand(args, args.compile_step, escape, "$in", "$out", "") + " -MMD -MF $out.d\n";
+    out += "  depfile = $out.d\n";
+    out += "  deps = gcc\n";
+    out += "  description = Compiling $in\n\n";
+
+    out += "rule as\n";
+    out += "  command = " + buildCommand(args, args.assemble_step, escape, "$in", "$out", "") + "\n";
+    out += "  description = Assembling $in\n\n";
+
+    out += "rule link\n";
+    out += "  command = " + buildCommand(args, args.link_step, escape, "", "", "$in") + "\n";
+    out += "  description = Linking $out\n\n";
+
+    out += "rule rom\n";
+    out += "  command = " + shell + buildCommand(args, args.objcopy_step, escape, "", "", "")
+         + " && " + buildCommand(args, args.fix_step, escape, "", "", "") + "\n";
+    out += "  description = Creating $out\n\n";
+
+    QStringList sources, objects, rules;
+    getObjects(args, sources, objects, rules);
+
+    QStringList object_paths;
+    for(int i = 0; i < sources.size(); ++i)
+    {
+        out += "build " + ninjaEscapePath(objects[i]) + ": " + rules[i] + " " + ninjaEscapePath(sources[i]) + "\n";
+        object_paths << ninjaEscapePath(objects[i]);
+    }
+
+    const QString elf_file = ninjaEscapePath(getElfFile(args));
+    const QString rom_file = ninjaEscapePath(args.expandVariable("%{ROM}"));
+    out += "\n";
+    out += "build " + elf_file + ": link " + object_paths.join(" ") + "\n";
+    out += "build " + rom_file + ": rom " + elf_file + "\n";
+    out += "default " + rom_file + "\n";
+    return out;
+}
+
+QString BuildFileGenerator::generateMakefile(const RomCompileArgs& in_args)
+{
+    const RomCompileArgs args = getBuildArgs(in_args);
+    const EscapeFunc escape = makeEscapeCommand;
+
+    QString out;
+    out += "# " BUILD_FILE_HEADER "\n\n";
+
+    if(args.custom_step.size())
+    {
+        out += ".PHONY: all\n";
+        out += "all:\n";
+        out += "\t" + buildCommand(args, args.custom_step, escape, "", "", "") + "\n";
+        return out;
+    }
+
+    QStringList sources, objects, rules;
+    getObjects(args, sources, objects, rules);
+
+    QStringList object_paths;
+    foreach(const QString& object, objects)
+    {
+        object_paths << makeEscapePath(object);
+    }
+
+    const QString build_dir = makeEscapePath(QDir::cleanPath(getBuildDir(args)));
+    const QString elf_file = makeEscapePath(getElfFile(args));
+    const QString rom_file = makeEscapePath(args.expandVariable("%{ROM}"));
+
+    out += "OBJECTS = " + object_paths.join(" ") + "\n";
+    out += "DEPS = $(OBJECTS:.o=.d)\n\n";
+
+    out += ".PHONY: all clean\n";
+    out += "all: " + rom_file + "\n\n";
+
+    out += rom_file + ": " + elf_file + "\n";
+    out += "\t" + buildCommand(args, args.objcopy_step, escape, "", "", "") + "\n";
+    out += "\t" + buildCommand(args, args.fix_step, escape, "", "", "") + "\n\n";
+
+    out += elf_file + ": $(OBJECTS)\n";
+    out += "\t" + buildCommand(args, args.link_step, escape, "", "", "$^") + "\n\n";
+
+    for(int i = 0; i < sources.size(); ++i)
+    {
+        const QString& step = rules[i] == "cc" ? args.compile_step : args.assemble_step;
+        const QString depfile = rules[i] == "cc" ? " -MMD -MP -MF $(@:.o=.d)" : "";
+        out += object_paths[i] + ": " + makeEscapePath(sources[i]) + " | " + build_dir + "\n";
+        out += "\t" + buildCommand(args, step, escape, "$<", "$@", "") + depfile + "\n\n";
+    }
+
+    out += build_dir + ":\n";
+    out += "\tmkdir -p $@\n\n";
+
+    out += "clean:\n";
+    out += "\trm -f $(OBJECTS) $(DEPS) " + elf_file + " " + rom_file + "\n\n";
+
+    out += "-include $(DEPS)\n";
+    return out;
+}
+
+bool BuildFileGenerator::exportBuildFiles(const RomCompileArgs& args, QStringList& out_files, QString& out_error)
+{
+    const QString build_dir = getBuildDir(args);
+    if(!QDir().mkpath(build_dir))
+    {
+        out_error = "Could not create " + build_dir;
+        return false;
+    }
+
+    const QString ninja_file = build_dir + NINJA_FILE;
+    const QString make_file = build_dir + MAKE_FILE;
+    if(!Common::writeFileIfChanged(ninja_file, generateNinja(args).toUtf8()))
+    {
+        out_error = "Could not write " + ninja_file;
+        return false;
+    }
+    if(!Common::writeFileIfChanged(make_file, generateMakefile(args).toUtf8()))
+    {
+        out_error = "Could not write " + make_file;
+        return false;
+    }
+
+    out_files << ninja_file << make_file;
+    return true;
+}
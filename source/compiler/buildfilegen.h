@@ -0,0 +1,25 @@
+#ifndef BUILDFILEGEN_H
+#define BUILDFILEGEN_H
+
+#include <QString>
+#include <QStringList>
+
+struct RomCompileArgs;
+
+// Generates a build.ninja or GNU Makefile from the build steps, for building outside of the editor.
+// Objects and the elf are placed in %{BUILD}. Compiled sources track their included headers through gcc depfiles
+class BuildFileGenerator
+{
+public:
+    static QString generateNinja(const RomCompileArgs& args);
+    static QString generateMakefile(const RomCompileArgs& args);
+
+    // Writes %{BUILD}build.ninja and %{BUILD}Makefile
+    static bool exportBuildFiles(const RomCompileArgs& args, QStringList& out_files, QString& out_error);
+
+    static QString getBuildDir(const RomCompileArgs& args);
+    static QString getElfFile(const RomCompileArgs& args);
+    static QString getNinjaFile(const RomCompileArgs& args);
+};
+
+#endif // BUILDFILEGEN_H
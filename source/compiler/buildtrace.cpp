@@ -0,0 +1,135 @@
+#include "buildtrace.h"
+
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QMap>
+#include <QJsonArray>
+#include <QJsonObject>
+#include <QJsonDocument>
+#include <QStringList>
+#include <algorithm>
+
+static QString formatMsec(qint64 usec)
+{
+    return QString("%1 ms").arg(usec / 1000.0, 9, 'f', 1);
+}
+
+void BuildTrace::start()
+{
+    events.clear();
+    timer.start();
+}
+
+qint64 BuildTrace::elapsedUsec() const
+{
+    if(!timer.isValid())
+    {
+        return 0;
+    }
+    return timer.nsecsElapsed() / 1000;
+}
+
+void BuildTrace::addEvent(const QString& name, const QString& category, qint64 start_usec, int exit_code, qint64 output_bytes, const QString& cache_status, int lane)
+{
+    BuildTraceEvent event;
+    event.name = name;
+    event.category = category;
+    event.start_usec = start_usec;
+    event.duration_usec = elapsedUsec() - start_usec;
+    event.exit_code = exit_code;
+    event.output_bytes = output_bytes;
+    event.cache_status = cache_status;
+    event.lane = lane;
+    events.append(event);
+}
+
+void BuildTrace::addEvent(const BuildTraceEvent& event)
+{
+    events.append(event);
+}
+
+const QList<BuildTraceEvent>& BuildTrace::getEvents() const
+{
+    return events;
+}
+
+bool BuildTrace::writeChromeTrace(const QString& file_path) const
+{
+    QJsonArray trace_events;
+    foreach(const BuildTraceEvent& event, events)
+    {
+        QJsonObject args;
+        args["exit_code"] = event.exit_code;
+        args["output_bytes"] = event.output_bytes;
+        args["cache"] = event.cache_status;
+
+        QJsonObject trace_event;
+        trace_event["name"] = event.name;
+        trace_event["cat"] = event.category;
+        trace_event["ph"] = "X";
+        trace_event["ts"] = event.start_usec;
+        trace_event["dur"] = event.duration_usec;
+        trace_event["pid"] = 1;
+        trace_event["tid"] = event.lane + 1;
+        trace_event["args"] = args;
+        trace_events.append(trace_event);
+    }
+
+    QJsonObject root;
+    root["traceEvents"] = trace_events;
+    root["displayTimeUnit"] = "ms";
+
+    QDir().mkpath(QFileInfo(file_path).absolutePath());
+    QFile file(file_path);
+    if(!file.open(QIODevice::WriteOnly | QIODevice::Truncate))
+    {
+        return false;
+    }
+    file.write(QJsonDocument(root).toJson(QJsonDocument::Compact));
+    file.close();
+    return true;
+}
+
+QString BuildTrace::summary(int max_steps) const
+{
+    QString text;
+    qint64 total_usec = 0;
+    QStringList categories;
+    QMap<QString, qint64> category_usec;
+    QMap<QString, int> category_count;
+
+    foreach(const BuildTraceEvent& event, events)
+    {
+        total_usec = qMax(total_usec, event.start_usec + event.duration_usec);
+        if(!categories.contains(event.category))
+        {
+            categories << event.category;
+        }
+        category_usec[event.category] += event.duration_usec;
+        category_count[event.category] += 1;
+    }
+
+    text += "Build timing " + formatMsec(total_usec).trimmed() + "\n";
+    foreach(const QString& category, categories)
+    {
+        text += formatMsec(category_usec[category]) + "  " + category.leftJustified(9) + QString::number(category_count[category]) + " step(s)\n";
+    }
+
+    QList<BuildTraceEvent> slowest = events;
+    std::sort(slowest.begin(), slowest.end(), [](const BuildTraceEvent& a, const BuildTraceEvent& b)
+    {
+        return a.duration_usec > b.duration_usec;
+    });
+
+    text += "Slowest steps\n";
+    for(int i = 0; i < slowest.size() && i < max_steps; ++i)
+    {
+        const BuildTraceEvent& event = slowest[i];
+        text += formatMsec(event.duration_usec) + "  " + event.category.leftJustified(9) + event.name
+              + "  exit:" + QString::number(event.exit_code)
+              + " output:" + QString::number(event.output_bytes) + "B"
+              + " cache:" + event.cache_status + "\n";
+    }
+    return text;
+}
@@ -0,0 +1,40 @@
+#ifndef BUILDTRACE_H
+#define BUILDTRACE_H
+
+#include <QList>
+#include <QString>
+#include <QElapsedTimer>
+
+// A single timed step of a ROM build
+struct BuildTraceEvent
+{
+    QString name;           // file or step name
+    QString category;       // export, assemble, compile, link, objcopy, fix, custom
+    qint64 start_usec;      // relative to the start of the build
+    qint64 duration_usec;
+    int exit_code;
+    qint64 output_bytes;    // captured stdout + stderr of the tool
+    QString cache_status;   // hit, miss or uncached
+    int lane;               // parallel job slot, written as the trace thread id
+};
+
+// Records the wall time of each build step. Written out as Chrome trace-event JSON (chrome://tracing, Perfetto)
+class BuildTrace
+{
+private:
+    QElapsedTimer timer;
+    QList<BuildTraceEvent> events;
+
+public:
+    void start();
+    qint64 elapsedUsec() const;
+
+    void addEvent(const QString& name, const QString& category, qint64 start_usec, int exit_code, qint64 output_bytes, const QString& cache_status, int lane = 0);
+    void addEvent(const BuildTraceEvent& event);
+    const QList<BuildTraceEvent>& getEvents() const;
+
+    bool writeChromeTrace(const QString& file_path) const;
+    QString summary(int max_steps = 10) const;
+};
+
+#endif // BUILDTRACE_H
@@ -1,4 +1,5 @@
 #include "cgen.h"
+#include <trace.h>
 #include <QStringList>
 
 static QString TYPE_TO_STR[] = {
@@ -234,6 +235,7 @@ bool CGen::writeStructDef(QTextStream& out, const QString& type, const QList<QPa
 
 bool CGen::writeStruct(QTextStream& out, QString type, QString id, const QList<QString>& field_data)
 {
+    TRACE_SCOPE("cgen", "CGen::writeStruct");
     out << type << " " << id << " ={" << endl;
     foreach(QString value, field_data)
     {
@@ -245,6 +247,7 @@ bool CGen::writeStruct(QTextStream& out, QString type, QString id, const QList<Q
 
 bool CGen::readStruct(QTextStream& in, QString type, QString& id, QList<QString>& field_data)
 {
+    TRACE_SCOPE("cgen", "CGen::readStruct");
     qint64 pos = in.pos();
     QTextStream::Status status = in.status();
 
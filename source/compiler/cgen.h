@@ -2,6 +2,7 @@
 #define CGEN_H
 
 #include <iostream>
+#include <trace.h>
 #include <QMap>
 #include <QString>
 #include <QVector>
@@ -82,6 +83,7 @@ namespace CGen
         template <typename ElementType>
         bool writeAllValues(Type type, const QString& id, QVector<ElementType>& values)
         {
+            TRACE_SCOPE("cgen", "CGen::ArrayWriter::writeAllValues");
             begin(type, id);
             for(int i =0; i < values.size(); ++i)
             {
@@ -94,6 +96,7 @@ namespace CGen
         template <typename ElementType>
         bool writeAllValues(QString type, const QString& id, QVector<ElementType>& values)
         {
+            TRACE_SCOPE("cgen", "CGen::ArrayWriter::writeAllValues");
             begin(type, id);
             for(int i =0; i < values.size(); ++i)
             {
@@ -119,6 +122,7 @@ namespace CGen
         template <typename ElementType>
         bool readAllValues(Type type, QString& id, QVector<ElementType>& values)
         {
+            TRACE_SCOPE("cgen", "CGen::ArrayReader::readAllValues");
             if(!begin(type, id))
             {
                 return false;
@@ -0,0 +1,317 @@
+#include "clexer.h"
+#include <QString>
+#include <string.h>
+
+#define KEYWORD_TABLE_SIZE 128
+#define KEYWORD_MIN_LENGTH 2
+#define KEYWORD_MAX_LENGTH 8
+
+static const char* keywords[] =
+{
+    "auto", "break", "case", "char", "const", "continue", "default", "do", "double", "else", "enum",
+    "extern", "float", "for", "goto", "if", "inline", "int", "long", "register", "return", "short",
+    "signed", "sizeof", "static", "struct", "switch", "typedef", "union", "unsigned", "void", "volatile", "while"
+};
+
+// Collision free for the keywords above. Only the keyword in the slot has to be compared
+static inline int keywordHash(int length, ushort first, ushort second, ushort last)
+{
+    return (length + first * 9 + second + last * 13) & (KEYWORD_TABLE_SIZE - 1);
+}
+
+struct KeywordTable
+{
+    const char* slots[KEYWORD_TABLE_SIZE];
+
+    KeywordTable()
+    {
+        memset(slots, 0, sizeof(slots));
+        for(size_t i = 0; i < sizeof(keywords) / sizeof(keywords[0]); ++i)
+        {
+            const char* keyword = keywords[i];
+            const int length = int(strlen(keyword));
+            const int hash = keywordHash(length, uchar(keyword[0]), uchar(keyword[1]), uchar(keyword[length - 1]));
+            Q_ASSERT(slots[hash] == nullptr);
+            slots[hash] = keyword;
+        }
+    }
+};
+
+static inline bool isIdentifierStart(ushort c)
+{
+    return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || c == '_' || (c >= 0x80 && QChar(c).isLetter());
+}
+
+static inline bool isIdentifierChar(ushort c)
+{
+    return isIdentifierStart(c) || (c >= '0' && c <= '9');
+}
+
+static inline bool isDigit(ushort c)
+{
+    return c >= '0' && c <= '9';
+}
+
+static inline bool isSpace(ushort c)
+{
+    return c == ' ' || c == '\t' || c == '\r' || c == '\f' || c == '\v';
+}
+
+// Returns the index after the closing */ or -1 when the comment continues on the next line
+static int scanCommentEnd(const QChar* text, int length, int i)
+{
+    for(; i + 1 < length; ++i)
+    {
+        if(text[i].unicode() == '*' && text[i + 1].unicode() == '/')
+        {
+            return i + 2;
+        }
+    }
+    return -1;
+}
+
+// Returns the index after the closing quote or -1 when the line ends first
+static int scanQuoted(const QChar* text, int length, int i, ushort quote)
+{
+    for(; i < length; ++i)
+    {
+        const ushort c = text[i].unicode();
+        if(c == '\\')
+        {
+            ++i;
+        }
+        else if(c == quote)
+        {
+            return i + 1;
+        }
+    }
+    return -1;
+}
+
+static int scanNumber(const QChar* text, int length, int i)
+{
+    const bool hex = i + 1 < length && text[i].unicode() == '0' && (text[i + 1].unicode() == 'x' || text[i + 1].unicode() == 'X');
+    for(++i; i < length; ++i)
+    {
+        const ushort c = text[i].unicode();
+        if(isIdentifierChar(c) || c == '.')
+        {
+            continue;
+        }
+        // exponent sign, 1e-3 or 0x1p+4
+        const ushort prev = text[i - 1].unicode();
+        const bool exponent = hex ? (prev == 'p' || prev == 'P') : (prev == 'e' || prev == 'E');
+        if((c == '+' || c == '-') && exponent)
+        {
+            continue;
+        }
+        break;
+    }
+    return i;
+}
+
+static inline void addToken(QVector<CToken>& out_tokens, int start, int length, CTokenType type)
+{
+    CToken token;
+    token.start = start;
+    token.length = length;
+    token.type = type;
+    out_tokens.append(token);
+}
+
+bool CLexer::isKeyword(const QChar* text, int length)
+{
+    static const KeywordTable table;
+    if(length < KEYWORD_MIN_LENGTH || length > KEYWORD_MAX_LENGTH)
+    {
+        return false;
+    }
+
+    const ushort first = text[0].unicode();
+    const ushort last = text[length - 1].unicode();
+    if(first < 'a' || first > 'z' || last < 'a' || last > 'z')
+    {
+        return false;
+    }
+
+    const char* keyword = table.slots[keywordHash(length, first, text[1].unicode(), last)];
+    if(keyword == nullptr)
+    {
+        return false;
+    }
+    for(int i = 0; i < length; ++i)
+    {
+        if(uchar(keyword[i]) != text[i].unicode())
+        {
+            return false;
+        }
+    }
+    return keyword[length] == '\0';
+}
+
+QStringList CLexer::getKeywords()
+{
+    QStringList list;
+    for(size_t i = 0; i < sizeof(keywords) / sizeof(keywords[0]); ++i)
+    {
+        list << keywords[i];
+    }
+    return list;
+}
+
+int CLexer::tokenize(const QChar* text, int length, int state, QVector<CToken>& out_tokens)
+{
+    if(state < 0)
+    {
+        state = CLEX_STATE_NORMAL;
+    }
+    int mode = state & CLEX_STATE_MODE_MASK;
+    bool directive = (state & CLEX_STATE_DIRECTIVE) != 0;
+    bool include = false;
+    bool line_start = !directive;
+    int i = 0;
+
+    // Finish the construct left open by the previous line
+    if(mode == CLEX_STATE_COMMENT)
+    {
+        const int end = scanCommentEnd(text, length, 0);
+        addToken(out_tokens, 0, end < 0 ? length : end, CTOKEN_COMMENT);
+        i = end < 0 ? length : end;
+        if(end >= 0)
+        {
+            mode = CLEX_STATE_NORMAL;
+        }
+    }
+    else if(mode == CLEX_STATE_STRING)
+    {
+        const int end = scanQuoted(text, length, 0, '"');
+        addToken(out_tokens, 0, end < 0 ? length : end, CTOKEN_STRING);
+        i = end < 0 ? length : end;
+        if(end >= 0 || length == 0 || text[length - 1].unicode() != '\\')
+        {
+            mode = CLEX_STATE_NORMAL;
+        }
+    }
+
+    while(i < length)
+    {
+        const ushort c = text[i].unicode();
+        if(isSpace(c))
+        {
+            ++i;
+            continue;
+        }
+
+        const ushort next = i + 1 < length ? text[i + 1].unicode() : 0;
+        const int start = i;
+
+        if(c == '/' && next == '/')
+        {
+            addToken(out_tokens, start, length - start, CTOKEN_COMMENT);
+            i = length;
+        }
+        else if(c == '/' && next == '*')
+        {
+            const int end = scanCommentEnd(text, length, i + 2);
+            i = end < 0 ? length : end;
+            addToken(out_tokens, start, i - start, CTOKEN_COMMENT);
+            if(end < 0)
+            {
+                mode = CLEX_STATE_COMMENT;
+            }
+        }
+        else if(c == '"' || c == '\'')
+        {
+            const int end = scanQuoted(text, length, i + 1, c);
+            i = end < 0 ? length : end;
+            addToken(out_tokens, start, i - start, include ? CTOKEN_INCLUDE_PATH : CTOKEN_STRING);
+            if(end < 0 && c == '"' && text[length - 1].unicode() == '\\')
+            {
+                mode = CLEX_STATE_STRING;
+            }
+        }
+        else if(c == '#' && line_start)
+        {
+            ++i;
+            while(i < length && isSpace(text[i].unicode()))
+            {
+                ++i;
+            }
+            const int name_start = i;
+            while(i < length && isIdentifierChar(text[i].unicode()))
+            {
+                ++i;
+            }
+            addToken(out_tokens, start, i - start, CTOKEN_DIRECTIVE);
+            directive = true;
+            include = i - name_start == 7 && QString::fromRawData(text + name_start, 7) == QLatin1String("include");
+        }
+        else if(c == '<' && include)
+        {
+            int end = i + 1;
+            while(end < length && text[end].unicode() != '>')
+            {
+                ++end;
+            }
+            i = end < length ? end + 1 : length;
+            addToken(out_tokens, start, i - start, CTOKEN_INCLUDE_PATH);
+        }
+        else if(isDigit(c) || (c == '.' && isDigit(next)))
+        {
+            i = scanNumber(text, length, i);
+            addToken(out_tokens, start, i - start, CTOKEN_NUMBER);
+        }
+        else if(isIdentifierStart(c))
+        {
+            ++i;
+            while(i < length && isIdentifierChar(text[i].unicode()))
+            {
+                ++i;
+            }
+
+            CTokenType type = CTOKEN_IDENTIFIER;
+            if(isKeyword(text + start, i - start))
+            {
+                type = CTOKEN_KEYWORD;
+            }
+            else
+            {
+                int lookahead = i;
+                while(lookahead < length && isSpace(text[lookahead].unicode()))
+                {
+                    ++lookahead;
+                }
+                if(lookahead < length && text[lookahead].unicode() == '(')
+                {
+                    type = CTOKEN_FUNCTION;
+                }
+            }
+            addToken(out_tokens, start, i - start, type);
+        }
+        else
+        {
+            ++i;
+            if(c == '{' || c == '}' || c == '[' || c == ']')
+            {
+                addToken(out_tokens, start, 1, CTOKEN_BRACE);
+            }
+            else if(c == '(' || c == ')')
+            {
+                addToken(out_tokens, start, 1, CTOKEN_PAREN);
+            }
+            else
+            {
+                addToken(out_tokens, start, 1, CTOKEN_PUNCTUATION);
+            }
+        }
+        line_start = false;
+    }
+
+    // A directive continues with a trailing backslash or an open comment
+    const bool continued = length > 0 && text[length - 1].unicode() == '\\';
+    if(directive && (continued || mode == CLEX_STATE_COMMENT))
+    {
+        mode |= CLEX_STATE_DIRECTIVE;
+    }
+    return mode;
+}
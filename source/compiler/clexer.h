@@ -0,0 +1,49 @@
+#ifndef CLEXER_H
+#define CLEXER_H
+
+#include <QChar>
+#include <QStringList>
+#include <QVector>
+
+// Lexer state carried from one line to the next. Stored in the QSyntaxHighlighter block state
+#define CLEX_STATE_NORMAL    0
+#define CLEX_STATE_COMMENT   1      // inside a /* */ comment
+#define CLEX_STATE_STRING    2      // string literal continued with a trailing backslash
+#define CLEX_STATE_MODE_MASK 3
+#define CLEX_STATE_DIRECTIVE 4      // preprocessor line continued with a trailing backslash
+
+enum CTokenType
+{
+    CTOKEN_COMMENT,
+    CTOKEN_STRING,          // string and char literals
+    CTOKEN_NUMBER,
+    CTOKEN_KEYWORD,
+    CTOKEN_DIRECTIVE,       // #define, #include ...
+    CTOKEN_INCLUDE_PATH,    // <file.h> or "file.h" after #include
+    CTOKEN_IDENTIFIER,
+    CTOKEN_FUNCTION,        // identifier followed by (
+    CTOKEN_BRACE,           // { } [ ]
+    CTOKEN_PAREN,           // ( )
+    CTOKEN_PUNCTUATION      // any other single character
+};
+
+struct CToken
+{
+    int start;
+    int length;
+    CTokenType type;
+};
+
+// Single pass C tokenizer working one line at a time, so it can be resumed at any line from the previous line's state
+class CLexer
+{
+public:
+    // Appends the tokens of a line to out_tokens and returns the state for the next line. Whitespace is skipped
+    static int tokenize(const QChar* text, int length, int state, QVector<CToken>& out_tokens);
+
+    // Perfect hash lookup of the C keywords
+    static bool isKeyword(const QChar* text, int length);
+    static QStringList getKeywords();
+};
+
+#endif // CLEXER_H
@@ -0,0 +1,179 @@
+#ifndef CSCHEMA_H
+#define CSCHEMA_H
+
+#include "cgen.h"
+
+#include <QDataStream>
+#include <QList>
+#include <QPair>
+#include <QString>
+
+// One field of a generated C struct. Integer fields go through get_int/set_int,
+// identifier fields (array and struct pointers) through get_id/set_id
+template<typename Owner>
+struct CSchemaField
+{
+    CGen::Type type;
+    const char* name;
+    int bits;                                   // bitfield width, 0 if not a bitfield
+    const char* struct_type;                    // pointed to type of a CONST_STRUCT field
+    bool (*enabled)(const Owner&);              // nullptr if the field is always present
+    int (*get_int)(const Owner&);
+    void (*set_int)(Owner&, int);
+    QString (*get_id)(const Owner&);
+    void (*set_id)(Owner&, const QString&);     // nullptr to skip on read, the data is loaded with the arrays
+};
+
+// Adapters from getters, setters and members to the field function pointers
+namespace CSchemaAccess
+{
+    template<typename Owner, typename Value, Value (Owner::*Getter)() const>
+    int getInt(const Owner& owner) { return int((owner.*Getter)()); }
+
+    template<typename Owner, typename Value, void (Owner::*Setter)(Value)>
+    void setInt(Owner& owner, int value) { (owner.*Setter)(Value(value)); }
+
+    template<typename Owner, typename Value, Value Owner::*Member>
+    int getMember(const Owner& owner) { return int(owner.*Member); }
+
+    template<typename Owner, typename Value, Value Owner::*Member>
+    void setMember(Owner& owner, int value) { owner.*Member = Value(value); }
+
+    template<typename Owner, QString (Owner::*Getter)() const>
+    QString getId(const Owner& owner) { return (owner.*Getter)(); }
+}
+
+#define CSCHEMA_GETTER(Owner, Value, getter) (&CSchemaAccess::getInt<Owner, Value, &Owner::getter>)
+#define CSCHEMA_SETTER(Owner, Value, setter) (&CSchemaAccess::setInt<Owner, Value, &Owner::setter>)
+#define CSCHEMA_MEMBER_GETTER(Owner, Value, member) (&CSchemaAccess::getMember<Owner, Value, &Owner::member>)
+#define CSCHEMA_MEMBER_SETTER(Owner, Value, member) (&CSchemaAccess::setMember<Owner, Value, &Owner::member>)
+#define CSCHEMA_ID_GETTER(Owner, getter) (&CSchemaAccess::getId<Owner, &Owner::getter>)
+
+// Field table of an asset struct. The struct definition, the initializer and the parser all
+// walk the same table, so their field order can not drift apart
+template<typename Owner>
+class CSchema
+{
+private:
+    const CSchemaField<Owner>* fields;
+    int field_count;
+
+public:
+    template<int Count>
+    explicit CSchema(const CSchemaField<Owner> (&fields)[Count])
+        : fields(fields)
+        , field_count(Count)
+    {
+    }
+
+    static CSchemaField<Owner> intField(CGen::Type type, const char* name, int (*get_int)(const Owner&), void (*set_int)(Owner&, int) = nullptr, int bits = 0)
+    {
+        CSchemaField<Owner> field = { type, name, bits, nullptr, nullptr, get_int, set_int, nullptr, nullptr };
+        return field;
+    }
+
+    static CSchemaField<Owner> idField(CGen::Type type, const char* name, QString (*get_id)(const Owner&), void (*set_id)(Owner&, const QString&) = nullptr,
+                                       const char* struct_type = nullptr, bool (*enabled)(const Owner&) = nullptr)
+    {
+        CSchemaField<Owner> field = { type, name, 0, struct_type, enabled, nullptr, nullptr, get_id, set_id };
+        return field;
+    }
+
+    // prefix is prepended to every field name, for structs flattened into their parent
+    void getStructFields(const Owner& owner, QList<QPair<CGen::Type, QString>>& out_fields, const QString& prefix = QString()) const
+    {
+        for(int i = 0; i < field_count; ++i)
+        {
+            const CSchemaField<Owner>& field = fields[i];
+            if(field.enabled && !field.enabled(owner))
+                continue;
+
+            QString id = prefix + field.name;
+            if(field.struct_type)
+                id = QString(field.struct_type) + "* " + id;
+            if(field.bits)
+                id += " : " + QString::number(field.bits);
+            out_fields.push_back(qMakePair(field.type, id));
+        }
+    }
+
+    void writeStructData(const Owner& owner, QList<QString>& out_field_data) const
+    {
+        for(int i = 0; i < field_count; ++i)
+        {
+            const CSchemaField<Owner>& field = fields[i];
+            if(field.enabled && !field.enabled(owner))
+                continue;
+
+            out_field_data.append(field.get_int ? QString::number(field.get_int(owner)) : field.get_id(owner));
+        }
+    }
+
+    // Consumes this struct's values from the front. Returns false if they ran out
+    bool readStructData(Owner& owner, QList<QString>& in_field_data) const
+    {
+        for(int i = 0; i < field_count; ++i)
+        {
+            const CSchemaField<Owner>& field = fields[i];
+            if(field.enabled && !field.enabled(owner))
+                continue;
+            if(in_field_data.isEmpty())
+                return false;
+
+            const QString value = in_field_data.takeFirst();
+            if(field.set_int)
+                field.set_int(owner, value.toInt());
+            else if(field.set_id)
+                field.set_id(owner, value);
+        }
+        return true;
+    }
+
+    // Integers as qint32 without going through text. Identifiers are derived from the asset name
+    // and only stored when they can be read back
+    void writeBinary(const Owner& owner, QDataStream& out) const
+    {
+        for(int i = 0; i < field_count; ++i)
+        {
+            const CSchemaField<Owner>& field = fields[i];
+            if(field.enabled && !field.enabled(owner))
+                continue;
+
+            if(field.get_int)
+                out << qint32(field.get_int(owner));
+            else if(field.set_id)
+                out << field.get_id(owner);
+        }
+    }
+
+    bool readBinary(Owner& owner, QDataStream& in) const
+    {
+        for(int i = 0; i < field_count; ++i)
+        {
+            const CSchemaField<Owner>& field = fields[i];
+            if(field.enabled && !field.enabled(owner))
+                continue;
+
+            if(field.get_int)
+            {
+                qint32 value;
+                in >> value;
+                if(in.status() != QDataStream::Ok)
+                    return false;
+                if(field.set_int)
+                    field.set_int(owner, value);
+            }
+            else if(field.set_id)
+            {
+                QString value;
+                in >> value;
+                if(in.status() != QDataStream::Ok)
+                    return false;
+                field.set_id(owner, value);
+            }
+        }
+        return true;
+    }
+};
+
+#endif // CSCHEMA_H
@@ -0,0 +1,380 @@
+#include "elfanalyzer.h"
+#include <gba/gba.h>
+
+#include <QFile>
+#include <QtEndian>
+#include <algorithm>
+#include <cstring>
+
+// ELF32 constants, see the System V ABI
+#define ELF_HEADER_SIZE     52
+#define ELF_SECTION_SIZE    40
+#define ELF_SYMBOL_SIZE     16
+#define ELF_CLASS_32        1
+#define ELF_DATA_LSB        1
+#define ELF_SHT_SYMTAB      2
+#define ELF_SHT_NOBITS      8
+#define ELF_SHF_ALLOC       0x2
+#define ELF_STT_OBJECT      1
+#define ELF_STT_FUNC        2
+#define ELF_SHN_UNDEF       0
+#define ELF_SHN_LORESERVE   0xFF00
+
+#define REGION_ROM   "ROM"
+#define REGION_IWRAM "IWRAM"
+#define REGION_EWRAM "EWRAM"
+#define REGION_OTHER "Other"
+
+static inline quint16 read16(const QByteArray& data, quint32 offset)
+{
+    return qFromLittleEndian<quint16>(reinterpret_cast<const uchar*>(data.constData()) + offset);
+}
+
+static inline quint32 read32(const QByteArray& data, quint32 offset)
+{
+    return qFromLittleEndian<quint32>(reinterpret_cast<const uchar*>(data.constData()) + offset);
+}
+
+static inline bool inBounds(const QByteArray& data, quint32 offset, quint32 size)
+{
+    return quint64(offset) + size <= quint64(data.size());
+}
+
+// -------------------------- Reader ----------------------------------------
+
+bool ElfReader::load(const QString& file_path)
+{
+    QFile file(file_path);
+    if(!file.open(QIODevice::ReadOnly))
+    {
+        return fail("Could not open " + file_path);
+    }
+    return parse(file.readAll());
+}
+
+bool ElfReader::parse(const QByteArray& elf_data)
+{
+    data = elf_data;
+    error.clear();
+    sections.clear();
+    symbols.clear();
+
+    if(!inBounds(data, 0, ELF_HEADER_SIZE) || !data.startsWith("\x7F" "ELF"))
+    {
+        return fail("Not an ELF file");
+    }
+    if(data[4] != ELF_CLASS_32 || data[5] != ELF_DATA_LSB)
+    {
+        return fail("Only little endian ELF32 files are supported");
+    }
+
+    const quint32 section_offset = read32(data, 0x20);
+    const quint16 section_entry_size = read16(data, 0x2E);
+    const quint16 section_count = read16(data, 0x30);
+    const quint16 section_names_index = read16(data, 0x32);
+
+    if(section_entry_size < ELF_SECTION_SIZE || !inBounds(data, section_offset, quint32(section_entry_size) * section_count))
+    {
+        return fail("Invalid section header table");
+    }
+
+    QList<quint32> name_offsets;
+    for(int i = 0; i < section_count; ++i)
+    {
+        const quint32 header = section_offset + quint32(i) * section_entry_size;
+        name_offsets.append(read32(data, header + 0));
+
+        ElfSection section;
+        section.type = read32(data, header + 4);
+        section.flags = read32(data, header + 8);
+        section.address = read32(data, header + 12);
+        section.offset = read32(data, header + 16);
+        section.size = read32(data, header + 20);
+        section.link = read32(data, header + 24);
+        section.entry_size = read32(data, header + 36);
+        sections.append(section);
+    }
+
+    if(const ElfSection* names = getSection(section_names_index))
+    {
+        const ElfSection section_names = *names;
+        for(int i = 0; i < sections.size(); ++i)
+        {
+            sections[i].name = readString(section_names, name_offsets[i]);
+        }
+    }
+
+    foreach(const ElfSection& section, sections)
+    {
+        if(section.type == ELF_SHT_SYMTAB)
+        {
+            return readSymbols(section);
+        }
+    }
+    return fail("No symbol table. Was the ELF stripped?");
+}
+
+bool ElfReader::readSymbols(const ElfSection& symtab)
+{
+    const ElfSection* strtab = getSection(symtab.link);
+    const quint32 entry_size = symtab.entry_size ? symtab.entry_size : ELF_SYMBOL_SIZE;
+    if(strtab == nullptr || entry_size < ELF_SYMBOL_SIZE || !inBounds(data, symtab.offset, symtab.size))
+    {
+        return fail("Invalid symbol table");
+    }
+
+    const quint32 symbol_count = symtab.size / entry_size;
+    for(quint32 i = 0; i < symbol_count; ++i)
+    {
+        const quint32 entry = symtab.offset + i * entry_size;
+        ElfSymbol symbol;
+        symbol.name = readString(*strtab, read32(data, entry + 0));
+        symbol.value = read32(data, entry + 4);
+        symbol.size = read32(data, entry + 8);
+        symbol.type = quint8(data[entry + 12]) & 0xF;
+        symbol.section_index = read16(data, entry + 14);
+        symbols.append(symbol);
+    }
+    return true;
+}
+
+QString ElfReader::readString(const ElfSection& strtab, quint32 offset) const
+{
+    if(offset >= strtab.size || !inBounds(data, strtab.offset, strtab.size))
+    {
+        return QString();
+    }
+    const char* start = data.constData() + strtab.offset + offset;
+    const char* end = static_cast<const char*>(memchr(start, '\0', strtab.size - offset));
+    const int length = end ? int(end - start) : int(strtab.size - offset);
+    return QString::fromLatin1(start, length);
+}
+
+bool ElfReader::fail(const QString& message)
+{
+    error = message;
+    return false;
+}
+
+const QString& ElfReader::getError() const
+{
+    return error;
+}
+
+const QList<ElfSection>& ElfReader::getSections() const
+{
+    return sections;
+}
+
+const QList<ElfSymbol>& ElfReader::getSymbols() const
+{
+    return symbols;
+}
+
+const ElfSection* ElfReader::getSection(int section_index) const
+{
+    if(section_index < 0 || section_index >= sections.size())
+    {
+        return nullptr;
+    }
+    return &sections[section_index];
+}
+
+// -------------------------- Report ----------------------------------------
+
+bool RomSizeReport::isEmpty() const
+{
+    return regions.isEmpty();
+}
+
+static QString formatBytes(qint64 size)
+{
+    return QString("%1").arg(size, 9);
+}
+
+QString RomSizeReport::summary() const
+{
+    QString text = "Memory usage\n";
+    foreach(const RomRegionUsage& region, regions)
+    {
+        const double percent = region.capacity ? 100.0 * region.used / region.capacity : 0.0;
+        text += region.name.leftJustified(6) + formatBytes(region.used) + " / " + formatBytes(region.capacity).trimmed()
+              + QString(" bytes (%1%)\n").arg(percent, 0, 'f', 1);
+    }
+
+    text += "Sections\n";
+    foreach(const RomSizeEntry& section, sections)
+    {
+        text += formatBytes(section.size) + "  " + section.region.leftJustified(6) + section.name + "\n";
+    }
+
+    text += "Assets\n";
+    foreach(const RomSizeEntry& asset, assets)
+    {
+        text += formatBytes(asset.size) + "  " + asset.region.leftJustified(6) + asset.name + " (" + asset.type + ")\n";
+    }
+    return text;
+}
+
+// -------------------------- Analyzer ----------------------------------------
+
+QString ElfAnalyzer::getRegionName(quint32 address)
+{
+    // ROM is mirrored over the three wait state regions
+    if(address >= GBA_ROM_ADDRESS && address < GBA_ROM_ADDRESS + 3 * GBA_ROM_SIZE)
+        return REGION_ROM;
+    if(address >= GBA_IWRAM_ADDRESS && address < GBA_IWRAM_ADDRESS + GBA_IWRAM_SIZE)
+        return REGION_IWRAM;
+    if(address >= GBA_EWRAM_ADDRESS && address < GBA_EWRAM_ADDRESS + GBA_EWRAM_SIZE)
+        return REGION_EWRAM;
+    return REGION_OTHER;
+}
+
+QString ElfAnalyzer::getAssetName(const QString& symbol_name, const QMap<QString, QString>& asset_types)
+{
+    if(asset_types.contains(symbol_name))
+    {
+        return symbol_name;
+    }
+
+    static const char* suffixes[] = { GBA_PIXELS_SUFFIX, GBA_TILES_SUFFIX, GBA_COLORS_SUFFIX, GBA_PALETTE_SUFFIX, "_frames" };
+    for(const char* suffix : suffixes)
+    {
+        if(!symbol_name.endsWith(suffix))
+        {
+            continue;
+        }
+
+        QString base = symbol_name.left(symbol_name.size() - int(qstrlen(suffix)));
+        if(asset_types.contains(base))
+        {
+            return base;
+        }
+
+        // Map backgrounds are named <map>_bg<index>_tiles
+        if(base.size() > 4 && base.at(base.size() - 4) == '_' && base.midRef(base.size() - 3, 2) == "bg")
+        {
+            base.chop(4);
+            if(asset_types.contains(base))
+            {
+                return base;
+            }
+        }
+    }
+    return QString();
+}
+
+bool ElfAnalyzer::analyze(const QString& elf_file, const QMap<QString, QString>& asset_types, RomSizeReport& out_report, QString& out_error)
+{
+    out_report = RomSizeReport();
+
+    ElfReader reader;
+    if(!reader.load(elf_file))
+    {
+        out_error = reader.getError();
+        return false;
+    }
+
+    QMap<QString, qint64> region_used;
+
+    // Section budget. Initialized data placed in RAM is also stored in ROM to be copied at boot
+    foreach(const ElfSection& section, reader.getSections())
+    {
+        if(!(section.flags & ELF_SHF_ALLOC) || section.size == 0)
+        {
+            continue;
+        }
+
+        RomSizeEntry entry;
+        entry.name = section.name;
+        entry.region = getRegionName(section.address);
+        entry.address = section.address;
+        entry.size = section.size;
+        out_report.sections.append(entry);
+
+        region_used[entry.region] += section.size;
+        if(entry.region != REGION_ROM && section.type != ELF_SHT_NOBITS)
+        {
+            region_used[REGION_ROM] += section.size;
+        }
+    }
+
+    // Asset budget, one entry per asset and region
+    QMap<QString, int> asset_entries;
+    foreach(const ElfSymbol& symbol, reader.getSymbols())
+    {
+        if(symbol.size == 0 || symbol.type != ELF_STT_OBJECT)
+        {
+            continue;
+        }
+        if(symbol.section_index == ELF_SHN_UNDEF || symbol.section_index >= ELF_SHN_LORESERVE)
+        {
+            continue;
+        }
+
+        const QString asset_name = getAssetName(symbol.name, asset_types);
+        if(asset_name.isEmpty())
+        {
+            continue;
+        }
+
+        const QString region = getRegionName(symbol.value);
+        const QString key = asset_name + "|" + region;
+        if(!asset_entries.contains(key))
+        {
+            RomSizeEntry entry;
+            entry.name = asset_name;
+            entry.type = asset_types.value(asset_name);
+            entry.region = region;
+            entry.address = symbol.value;
+            entry.size = 0;
+            asset_entries[key] = out_report.assets.size();
+            out_report.assets.append(entry);
+        }
+
+        RomSizeEntry& entry = out_report.assets[asset_entries[key]];
+        entry.address = qMin(entry.address, symbol.value);
+        entry.size += symbol.size;
+        entry.symbols.append(symbol.name);
+    }
+
+    std::sort(out_report.assets.begin(), out_report.assets.end(), [](const RomSizeEntry& a, const RomSizeEntry& b)
+    {
+        return a.size > b.size;
+    });
+
+    struct Region { const char* name; quint32 address; qint64 capacity; };
+    static const Region regions[] = {
+        { REGION_ROM,   GBA_ROM_ADDRESS,   GBA_ROM_SIZE },
+        { REGION_IWRAM, GBA_IWRAM_ADDRESS, GBA_IWRAM_SIZE },
+        { REGION_EWRAM, GBA_EWRAM_ADDRESS, GBA_EWRAM_SIZE },
+    };
+    for(const Region& region : regions)
+    {
+        RomRegionUsage usage;
+        usage.name = region.name;
+        usage.address = region.address;
+        usage.used = region_used.value(region.name);
+        usage.capacity = region.capacity;
+        out_report.regions.append(usage);
+
+        if(usage.used > usage.capacity)
+        {
+            out_report.warnings.append(QString("%1 overflow, %2 of %3 bytes used").arg(usage.name).arg(usage.used).arg(usage.capacity));
+        }
+        else if(usage.name != REGION_ROM && usage.used * 100 >= usage.capacity * ELF_RAM_WARN_PERCENT)
+        {
+            out_report.warnings.append(QString("%1 is nearly full, %2 of %3 bytes used").arg(usage.name).arg(usage.used).arg(usage.capacity));
+        }
+    }
+
+    foreach(const RomSizeEntry& asset, out_report.assets)
+    {
+        if(asset.region != REGION_ROM && asset.size >= ELF_LARGE_ASSET_SIZE)
+        {
+            out_report.warnings.append(QString("%1 places %2 bytes in %3 (%4). Is the data declared const?")
+                                       .arg(asset.name).arg(asset.size).arg(asset.region).arg(asset.symbols.join(", ")));
+        }
+    }
+    return true;
+}
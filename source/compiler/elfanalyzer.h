@@ -0,0 +1,106 @@
+#ifndef ELFANALYZER_H
+#define ELFANALYZER_H
+
+#include <QByteArray>
+#include <QList>
+#include <QMap>
+#include <QMetaType>
+#include <QString>
+#include <QStringList>
+
+// Warn when a RAM region is filled above this percentage
+#define ELF_RAM_WARN_PERCENT 90
+// Warn when an asset with at least this many bytes is placed outside of ROM
+#define ELF_LARGE_ASSET_SIZE 1024
+
+struct ElfSection
+{
+    QString name;
+    quint32 type;
+    quint32 flags;
+    quint32 address;
+    quint32 offset;
+    quint32 size;
+    quint32 link;
+    quint32 entry_size;
+};
+
+struct ElfSymbol
+{
+    QString name;
+    quint32 value;
+    quint32 size;
+    quint8 type;
+    quint16 section_index;
+};
+
+// Minimal little endian ELF32 reader. Only reads the section headers and the symbol table
+class ElfReader
+{
+private:
+    QByteArray data;
+    QString error;
+    QList<ElfSection> sections;
+    QList<ElfSymbol> symbols;
+
+public:
+    bool load(const QString& file_path);
+    bool parse(const QByteArray& elf_data);
+
+    const QString& getError() const;
+    const QList<ElfSection>& getSections() const;
+    const QList<ElfSymbol>& getSymbols() const;
+
+    // Section for a header index, ie ElfSymbol::section_index. Null when out of range
+    const ElfSection* getSection(int section_index) const;
+
+private:
+    bool fail(const QString& message);
+    bool readSymbols(const ElfSection& symtab);
+    QString readString(const ElfSection& strtab, quint32 offset) const;
+};
+
+// Bytes of a section or asset that reside in a single memory region
+struct RomSizeEntry
+{
+    QString name;
+    QString type;
+    QString region;
+    quint32 address;
+    qint64 size;
+    QStringList symbols;
+};
+
+struct RomRegionUsage
+{
+    QString name;
+    quint32 address;
+    qint64 used;
+    qint64 capacity;
+};
+
+struct RomSizeReport
+{
+    QList<RomSizeEntry> sections;
+    QList<RomSizeEntry> assets;
+    QList<RomRegionUsage> regions;
+    QStringList warnings;
+
+    bool isEmpty() const;
+    QString summary() const;
+};
+
+Q_DECLARE_METATYPE(RomSizeReport);
+
+class ElfAnalyzer
+{
+public:
+    // asset_types maps asset names to their type names and is used to attribute symbols to assets
+    static bool analyze(const QString& elf_file, const QMap<QString, QString>& asset_types, RomSizeReport& out_report, QString& out_error);
+
+    static QString getRegionName(quint32 address);
+    // Matches a symbol to an asset using the generated id suffixes, ie <map>_bg0_tiles, <tileset>_pixels
+    static QString getAssetName(const QString& symbol_name, const QMap<QString, QString>& asset_types);
+};
+
+#endif // ELFANALYZER_H
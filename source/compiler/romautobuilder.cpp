@@ -0,0 +1,196 @@
+#include "romautobuilder.h"
+#include <msglog.h>
+#include <gba/game.h>
+
+#include <QFileInfo>
+
+RomAutoBuilder::RomAutoBuilder(QObject* parent) :
+    QObject(parent),
+    game(nullptr),
+    rom_compiler(nullptr),
+    enabled(false),
+    request_serial(0),
+    building_serial(0),
+    building_revision(0),
+    built_serial(0),
+    built_revision(0),
+    built(false),
+    restart(false),
+    restart_export(false),
+    launch(false)
+{
+    debounce_timer.setSingleShot(true);
+    debounce_timer.setInterval(AUTO_BUILD_DEBOUNCE_MSEC);
+    connect(&debounce_timer, SIGNAL(timeout()), this, SLOT(on_debounce()));
+}
+
+RomAutoBuilder::~RomAutoBuilder()
+{
+    cancel();
+    delete rom_compiler;
+}
+
+void RomAutoBuilder::setGame(Game* game)
+{
+    cancel();
+    this->game = game;
+    built = false;
+    ++request_serial;
+    rom_file = "";
+}
+
+void RomAutoBuilder::setEnabled(bool enabled)
+{
+    this->enabled = enabled;
+    if(!enabled)
+    {
+        debounce_timer.stop();
+    }
+}
+
+bool RomAutoBuilder::isEnabled() const
+{
+    return enabled;
+}
+
+bool RomAutoBuilder::isBuilding() const
+{
+    return rom_compiler != nullptr;
+}
+
+bool RomAutoBuilder::isFresh() const
+{
+    if(!built || isBuilding() || debounce_timer.isActive() || hasUnsavedEdits())
+    {
+        return false;
+    }
+    return built_serial == request_serial && built_revision == game->getRevision() && QFileInfo::exists(rom_file);
+}
+
+void RomAutoBuilder::requestBuild()
+{
+    if(!enabled || game == nullptr || !game->isValid())
+    {
+        return;
+    }
+
+    ++request_serial;
+    debounce_timer.start();
+}
+
+void RomAutoBuilder::run()
+{
+    if(game == nullptr)
+    {
+        return;
+    }
+
+    if(isFresh())
+    {
+        msgLog("ROM") << "ROM is up to date\n";
+        emit launchReady(rom_file);
+        return;
+    }
+
+    launch = true;
+    debounce_timer.stop();
+
+    // The running build already covers everything, launch when it is done
+    if(isBuilding() && !restart && building_serial == request_serial && building_revision == game->getRevision() && !hasUnsavedEdits())
+    {
+        return;
+    }
+
+    ++request_serial;
+    startBuild(true);
+}
+
+void RomAutoBuilder::cancel()
+{
+    debounce_timer.stop();
+    restart = false;
+    restart_export = false;
+    launch = false;
+    if(rom_compiler)
+    {
+        rom_compiler->cancel();
+    }
+}
+
+void RomAutoBuilder::on_debounce()
+{
+    // Unsaved edits are picked up by the next save
+    if(hasUnsavedEdits() || isFresh())
+    {
+        return;
+    }
+    startBuild(false);
+}
+
+void RomAutoBuilder::on_buildFinished(bool success, QString rom_file)
+{
+    rom_compiler->deleteLater();
+    rom_compiler = nullptr;
+
+    if(restart)
+    {
+        const bool export_assets = restart_export;
+        restart = false;
+        restart_export = false;
+        startBuild(export_assets);
+        return;
+    }
+
+    if(success)
+    {
+        built = true;
+        built_serial = building_serial;
+        built_revision = building_revision;
+        this->rom_file = rom_file;
+    }
+
+    if(launch)
+    {
+        launch = false;
+        if(success)
+            emit launchReady(rom_file);
+        else
+            emit launchFailed();
+    }
+}
+
+bool RomAutoBuilder::hasUnsavedEdits() const
+{
+    if(game->isDirty())
+    {
+        return true;
+    }
+    foreach(SourceFile* source_file, game->source_files)
+    {
+        if(source_file->isDirty())
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+void RomAutoBuilder::startBuild(bool export_assets)
+{
+    // Supersede the running build. It is restarted once the cancelled one has finished
+    if(rom_compiler)
+    {
+        restart = true;
+        restart_export = restart_export || export_assets;
+        rom_compiler->cancel();
+        return;
+    }
+
+    building_serial = request_serial;
+    building_revision = game->getRevision();
+
+    rom_compiler = new RomCompiler();
+    connect(rom_compiler, SIGNAL(finished(bool,QString)), this, SLOT(on_buildFinished(bool,QString)));
+    connect(rom_compiler, SIGNAL(analyzed(RomSizeReport)), this, SIGNAL(analyzed(RomSizeReport)));
+    rom_compiler->build(game, export_assets, true);
+}
@@ -0,0 +1,69 @@
+#ifndef ROMAUTOBUILDER_H
+#define ROMAUTOBUILDER_H
+
+#include "romcompiler.h"
+
+#include <QObject>
+#include <QTimer>
+
+class Game;
+
+// Wait this long after the last save before building, so a burst of saves only builds once
+#define AUTO_BUILD_DEBOUNCE_MSEC 500
+
+// Rebuilds the ROM in the background after the game is saved, so Run can launch it right away.
+// Builds are incremental and a build that is superseded by a newer save is cancelled and restarted
+class RomAutoBuilder : public QObject
+{
+    Q_OBJECT
+private:
+    Game* game;
+    RomCompiler* rom_compiler;  // null when no build is running
+    QTimer debounce_timer;
+    bool enabled;
+
+    // Each save requests a build. The ROM is fresh once the latest request was built with no edits since
+    quint64 request_serial;
+    quint64 building_serial;
+    quint64 building_revision;
+    quint64 built_serial;
+    quint64 built_revision;
+    bool built;
+    QString rom_file;
+
+    bool restart;         // the running build was cancelled for a newer one
+    bool restart_export;
+    bool launch;          // Run was pressed while building
+
+public:
+    explicit RomAutoBuilder(QObject* parent = nullptr);
+    ~RomAutoBuilder();
+
+    void setGame(Game* game);
+    void setEnabled(bool enabled);
+    bool isEnabled() const;
+    bool isBuilding() const;
+    // True if the last built ROM matches the saved game and there are no unsaved edits
+    bool isFresh() const;
+
+    // The game was saved. Builds once no more saves arrive for AUTO_BUILD_DEBOUNCE_MSEC
+    void requestBuild();
+    // Launches the ROM if it is fresh. Otherwise exports and builds it first, or waits for the running build
+    void run();
+    void cancel();
+
+signals:
+    void launchReady(QString rom_file);
+    void launchFailed();
+    void analyzed(RomSizeReport report);
+
+private slots:
+    void on_debounce();
+    void on_buildFinished(bool success, QString rom_file);
+
+private:
+    bool hasUnsavedEdits() const;
+    void startBuild(bool export_assets);
+};
+
+#endif // ROMAUTOBUILDER_H
@@ -1,17 +1,21 @@
 #include "romcompiler.h"
+#include "buildfilegen.h"
 #include <common.h>
 #include <msglog.h>
 #include <defines.h>
 #include <config.h>
+#include <trace.h>
 #include <gba/game.h>
 
 #include <initializer_list>
 #include <QDebug>
+#include <QDateTime>
 #include <QDir>
 #include <QFileInfo>
 #include <QProcess>
 #include <QTextStream>
-#include <QApplication>
+#include <QCoreApplication>
+#include <QStandardPaths>
 
 #define COMPILE_CATEGORY "ROM"
 
@@ -37,6 +41,9 @@ const char* default_libs      = "-lm";
 const char* default_includes  = "-I%{GENERATED} -I%{CODE}";
 const char* default_arch      = "-mcpu=arm7tdmi";
 const char* default_rom       = "%{PROJECT}%{GAME}.gba";
+const char* default_trace     = "%{BUILD}%{GAME}.trace.json";
+// Opt in, ninja builds only run once a ninja executable is configured
+const char* default_ninja     = "";
 
 // Steps
 const char* default_compile_step = "%{CC} %{ARCH} %{INCLUDES} %{CFLAGS} -c %{SOURCE} -o %{OBJECT}";
@@ -61,6 +68,8 @@ QString getDefaultValue(QString key)
         build_defaults[BUILD_INCLUDES] = default_includes;
         build_defaults[BUILD_ARCH] = default_arch;
         build_defaults[BUILD_ROM] = default_rom;
+        build_defaults[BUILD_TRACE] = default_trace;
+        build_defaults[BUILD_NINJA] = default_ninja;
 
         build_defaults[BUILD_STEP_COMPILE] = default_compile_step;
         build_defaults[BUILD_STEP_ASSEMBLE] = default_assemble_step;
@@ -88,6 +97,8 @@ void RomCompiler::resetDefaults()
     Config::remove(BUILD_INCLUDES);
     Config::remove(BUILD_ARCH);
     Config::remove(BUILD_ROM);
+    Config::remove(BUILD_TRACE);
+    Config::remove(BUILD_NINJA);
 
     Config::remove(BUILD_STEP_COMPILE);
     Config::remove(BUILD_STEP_ASSEMBLE);
@@ -121,20 +132,70 @@ void RomCompiler::saveConfig()
     Config::save();
 }
 
+// Inputs do not change once they are checked (objects and the elf are only checked after they were built),
+// so each file is only looked up once per build
+qint64 RomCompilerWorker::getInputTime(const QString& input)
+{
+    QHash<QString, qint64>::const_iterator it = input_times.constFind(input);
+    if(it != input_times.constEnd())
+    {
+        return it.value();
+    }
+
+    const QFileInfo input_info(input);
+    const qint64 time = input_info.exists() ? input_info.lastModified().toMSecsSinceEpoch() : -1;
+    input_times.insert(input, time);
+    return time;
+}
+
+// True if the output exists and is newer than every input
+bool RomCompilerWorker::isUpToDate(const QString& output, const QStringList& inputs)
+{
+    const QFileInfo output_info(output);
+    if(!output_info.exists())
+    {
+        return false;
+    }
+
+    const qint64 output_time = output_info.lastModified().toMSecsSinceEpoch();
+    foreach(const QString& input, inputs)
+    {
+        const qint64 input_time = getInputTime(input);
+        if(input_time < 0 || input_time > output_time)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
 void RomCompilerWorker::run(RomCompileArgs args)
 {
+    TRACE_SCOPE("build", "RomCompilerWorker::run");
     this->args = args;
+    objectfiles.clear();
+    input_times.clear();
 
-    QString rom_file = expandVariable("%{ROM}");
-    QDir(expandVariable("%{TEMP}")).mkpath(".");
+    QString rom_file = args.expandVariable("%{ROM}");
+    QDir(args.expandVariable("%{TEMP}")).mkpath(".");
 
     if(args.custom_step.size())
     {
         emit log(COMPILE_CATEGORY, "Custom build...\n");
-        if(!customBuild())
-            emit finished(false, rom_file);
+        finish(customBuild(), rom_file);
+        return;
+    }
 
-        emit finished(true, rom_file);
+    const QString ninja_program = findNinja();
+    if(ninja_program.size())
+    {
+        emit log(COMPILE_CATEGORY, "Building with " + ninja_program + "...\n");
+        const bool success = ninjaBuild(ninja_program);
+        if(success)
+        {
+            analyze(BuildFileGenerator::getElfFile(args));
+        }
+        finish(success, rom_file);
         return;
     }
 
@@ -142,7 +203,7 @@ void RomCompilerWorker::run(RomCompileArgs args)
 
     if(!assemble(args.sourcefiles))
     {
-        emit finished(false, rom_file);
+        finish(false, rom_file);
         return;
     }
 
@@ -150,15 +211,35 @@ void RomCompilerWorker::run(RomCompileArgs args)
 
     if(!compile(args.sourcefiles))
     {
-        emit finished(false, rom_file);
+        finish(false, rom_file);
         return;
     }
 
-    emit log(COMPILE_CATEGORY, "Linking objects...\n");
+    const QString elf_file = args.expandVariable("%{TEMP}%{GAME}.elf");
+    if(args.incremental && isUpToDate(elf_file, objectfiles))
+    {
+        emit log(COMPILE_CATEGORY, "Objects unchanged, skipped linking\n");
+        args.trace.addEvent("Link", "link", args.trace.elapsedUsec(), 0, 0, "hit");
+    }
+    else
+    {
+        emit log(COMPILE_CATEGORY, "Linking objects...\n");
+
+        if(!link())
+        {
+            finish(false, rom_file);
+            return;
+        }
+    }
 
-    if(!link())
+    analyze(elf_file);
+
+    if(args.incremental && isUpToDate(rom_file, QStringList(elf_file)))
     {
-        emit finished(false, rom_file);
+        emit log(COMPILE_CATEGORY, "ROM is up to date\n");
+        args.trace.addEvent("Objcopy", "objcopy", args.trace.elapsedUsec(), 0, 0, "hit");
+        args.trace.addEvent("Fix", "fix", args.trace.elapsedUsec(), 0, 0, "hit");
+        finish(true, rom_file);
         return;
     }
 
@@ -166,7 +247,7 @@ void RomCompilerWorker::run(RomCompileArgs args)
 
     if(!objcopy())
     {
-        emit finished(false, rom_file);
+        finish(false, rom_file);
         return;
     }
 
@@ -174,193 +255,478 @@ void RomCompilerWorker::run(RomCompileArgs args)
 
     if(!fixup())
     {
-        emit finished(false, rom_file);
+        finish(false, rom_file);
         return;
     }
 
-    emit finished(true, rom_file);
+    finish(true, rom_file);
+}
+
+void RomCompilerWorker::finish(bool success, const QString& rom_file)
+{
+    if(isCancelled())
+    {
+        emit warning(COMPILE_CATEGORY, "Build cancelled");
+        success = false;
+    }
+
+    emit log(COMPILE_CATEGORY, args.trace.summary());
+
+    if(args.trace_file.size())
+    {
+        QString trace_file = args.expandVariable(args.trace_file);
+        if(args.trace.writeChromeTrace(trace_file))
+            emit log(COMPILE_CATEGORY, "Wrote build trace " + trace_file);
+        else
+            emit warning(COMPILE_CATEGORY, "Failed to write build trace " + trace_file);
+    }
+
+    emit finished(success, rom_file);
 }
 
 RomCompilerWorker::~RomCompilerWorker()
 {
-    QDir(expandVariable("%{TEMP}")).removeRecursively();
+    // Incremental builds keep their objects for the next build
+    if(!args.incremental)
+    {
+        QDir(args.expandVariable("%{TEMP}")).removeRecursively();
+    }
 }
 
-int RomCompilerWorker::runtool(QString program, const QStringList& program_args)
+void RomCompilerWorker::cancel()
 {
-    QString programPath = program;
-    QFileInfo file_info(programPath);
-#ifdef _WIN32
-    if(!file_info.exists() && file_info.suffix() != "exe")
+    cancelled.storeRelease(1);
+}
+
+bool RomCompilerWorker::isCancelled() const
+{
+    return cancelled.loadAcquire() != 0;
+}
+
+int RomCompilerWorker::runtool(const QString& trace_name, const QString& trace_category, QString program, const QStringList& program_args)
+{
+    QList<RomCompileJob> jobs;
+    jobs.append(makeJob(trace_name, trace_category, program, program_args));
+
+    RomCompileJob& job = jobs.first();
+    if(!startTool(job))
     {
-        if(programPath[programPath.size()-1] != '.')
-            programPath += '.';
-        programPath += "exe";
-        file_info = QFileInfo(programPath);
+        return -1;
     }
-#endif
+    while(job.process->state() != QProcess::NotRunning && !job.process->waitForFinished(50))
+    {
+        if(isCancelled())
+        {
+            job.process->kill();
+            job.process->waitForFinished(-1);
+        }
+    }
+    return finishTool(job);
+}
 
-    if(!file_info.exists())
+bool RomCompilerWorker::runtools(QList<RomCompileJob>& jobs)
+{
+    const int max_jobs = qMax(1, args.jobs);
+    QVector<bool> lanes(max_jobs, false);
+    QList<RomCompileJob> running;
+    bool success = true;
+
+    while(jobs.size() || running.size())
     {
-        programPath = QApplication::applicationDirPath() + "/" + program;
-        file_info = QFileInfo(programPath);
-        programPath = file_info.absoluteFilePath();
+        // Fill the free lanes. Stop scheduling after the first failure but let running jobs finish
+        while(success && jobs.size() && running.size() < max_jobs)
+        {
+            RomCompileJob job = jobs.takeFirst();
+            job.lane = lanes.indexOf(false);
+            if(!startTool(job))
+            {
+                success = false;
+                break;
+            }
+            lanes[job.lane] = true;
+            running.append(job);
+        }
+
+        if(!success || isCancelled())
+        {
+            success = false;
+            jobs.clear();
+            foreach(const RomCompileJob& job, running)
+            {
+                if(job.process->state() != QProcess::NotRunning)
+                {
+                    job.process->kill();
+                }
+            }
+        }
+
+        for(int i = 0; i < running.size();)
+        {
+            RomCompileJob& job = running[i];
+            if(job.process->state() != QProcess::NotRunning && !job.process->waitForFinished(10))
+            {
+                ++i;
+                continue;
+            }
+
+            if(finishTool(job) != 0)
+            {
+                success = false;
+            }
+            lanes[job.lane] = false;
+            running.removeAt(i);
+        }
     }
+    return success;
+}
 
-    const QString programName = file_info.completeBaseName();
-    if(!file_info.exists())
+RomCompileJob RomCompilerWorker::makeJob(const QString& trace_name, const QString& trace_category, const QString& program, const QStringList& program_args) const
+{
+    RomCompileJob job;
+    job.trace_name = trace_name;
+    job.trace_category = trace_category;
+    job.program = program;
+    job.program_args = program_args;
+    job.process = nullptr;
+    job.start_usec = 0;
+    job.lane = 0;
+    job.cache_status = "uncached";
+    return job;
+}
+
+bool RomCompilerWorker::startTool(RomCompileJob& job)
+{
+    job.start_usec = args.trace.elapsedUsec();
+    if(isCancelled())
     {
-        emit error(COMPILE_CATEGORY, "Toolchain failed to find " + programName);
-        emit error(COMPILE_CATEGORY, "Can not find program (" + program + ")");
-        emit finished(false, expandVariable("%{ROM}"));
-        return -1;
+        return false;
+    }
+
+    const QString program_path = args.findProgram(job.program);
+    job.program_name = QFileInfo(program_path.size() ? program_path : job.program).completeBaseName();
+    if(program_path.isEmpty())
+    {
+        emit error(COMPILE_CATEGORY, "Toolchain failed to find " + job.program_name);
+        emit error(COMPILE_CATEGORY, "Can not find program (" + job.program + ")");
+        args.trace.addEvent(job.trace_name, job.trace_category, job.start_usec, -1, 0, job.cache_status, job.lane);
+        return false;
     }
 
 #if LOG_VERBOSE
-    QString cmd = program;
-    foreach(const QString& arg, program_args)
+    QString cmd = job.program;
+    foreach(const QString& arg, job.program_args)
     {
         cmd += " " + arg;
     }
     emit log(COMPILE_CATEGORY, cmd);
 #endif
 
-    QProcess* process = new QProcess(this);
-    process->start(program, program_args);
+    job.process = new QProcess(this);
+    job.process->start(job.program, job.program_args);
+    return true;
+}
 
-    process->waitForFinished();
+int RomCompilerWorker::finishTool(RomCompileJob& job)
+{
+    QProcess* process = job.process;
 
-    QString programOutput = QString(process->readAllStandardOutput());
+    QByteArray programOutputBytes = process->readAllStandardOutput();
+    QString programOutput = QString(programOutputBytes);
     if(programOutput.size())
     {
-        emit log(programName, programOutput);
+        emit log(job.program_name, programOutput);
     }
 
-    QString programError = QString(process->readAllStandardError());
+    QByteArray programErrorBytes = process->readAllStandardError();
+    QString programError = QString(programErrorBytes);
     if(programError.size())
     {
-        emit error(programName, programError);
+        emit error(job.program_name, programError);
     }
 
     int exit_code = process->exitCode();
+    if(process->error() == QProcess::FailedToStart)
+    {
+        emit error(COMPILE_CATEGORY, "Failed to start " + job.program);
+        exit_code = -1;
+    }
+    else if(process->exitStatus() == QProcess::CrashExit)
+    {
+        // Killed on cancel or crashed, the exit code is not meaningful
+        exit_code = -1;
+    }
     process->closeReadChannel(QProcess::StandardOutput);
     process->closeReadChannel(QProcess::StandardError);
     process->close();
 
     delete process;
+    job.process = nullptr;
+
+    args.trace.addEvent(job.trace_name, job.trace_category, job.start_usec, exit_code, programOutputBytes.size() + programErrorBytes.size(), job.cache_status, job.lane);
     return exit_code;
 }
 
 bool RomCompilerWorker::compile(const QStringList& sourcefiles)
 {
+    TRACE_SCOPE("build", "RomCompilerWorker::compile");
+    QList<RomCompileJob> jobs;
     foreach(QString sourcefile, sourcefiles)
     {
         if(QFileInfo(sourcefile).suffix() != "c")
             continue;
 
         QString objectfile;
-        if(!getObjectFile(sourcefile, objectfile)) continue;
+        if(!args.getObjectFile(sourcefile, objectfile)) continue;
+
+        if(!args.variables.contains("%{OBJECTS}"))
+            args.variables["%{OBJECTS}"] = objectfile;
+        else
+            args.variables["%{OBJECTS}"] += " " + objectfile;
+        objectfiles << objectfile;
+
+        if(args.incremental && isUpToDate(objectfile, QStringList(sourcefile) + args.headerfiles))
+        {
+            args.trace.addEvent(QFileInfo(sourcefile).fileName(), "compile", args.trace.elapsedUsec(), 0, 0, "hit");
+            continue;
+        }
 
         args.variables["%{SOURCE}"] = sourcefile;
         args.variables["%{OBJECT}"] = objectfile;
 
         QString program;
         QStringList program_args;
-        buildProgramCommand(args.compile_step, program, program_args);
+        args.buildProgramCommand(args.compile_step, program, program_args);
 
         args.variables.remove("%{SOURCE}");
         args.variables.remove("%{OBJECT}");
 
-        if(runtool(program, program_args) != 0)
-        {
-            return false;
-        }
-
-        if(!args.variables.contains("%{OBJECTS}"))
-            args.variables["%{OBJECTS}"] = objectfile;
-        else
-            args.variables["%{OBJECTS}"] += " " + objectfile;
-
+        RomCompileJob job = makeJob(QFileInfo(sourcefile).fileName(), "compile", program, program_args);
+        if(args.incremental)
+            job.cache_status = "miss";
+        jobs.append(job);
     }
-    return true;
+    return runtools(jobs);
 }
 
 bool RomCompilerWorker::assemble(const QStringList& sourcefiles)
 {
+    TRACE_SCOPE("build", "RomCompilerWorker::assemble");
+    QList<RomCompileJob> jobs;
     foreach(QString sourcefile, sourcefiles)
     {
         if(QFileInfo(sourcefile).suffix() != "S")
             continue;
 
         QString objectfile;
-        if(!getObjectFile(sourcefile, objectfile)) continue;
+        if(!args.getObjectFile(sourcefile, objectfile)) continue;
+
+        if(!args.variables.contains("%{OBJECTS}"))
+            args.variables["%{OBJECTS}"] = objectfile;
+        else
+            args.variables["%{OBJECTS}"] += " " + objectfile;
+        objectfiles << objectfile;
+
+        if(args.incremental && isUpToDate(objectfile, QStringList(sourcefile) + args.headerfiles))
+        {
+            args.trace.addEvent(QFileInfo(sourcefile).fileName(), "assemble", args.trace.elapsedUsec(), 0, 0, "hit");
+            continue;
+        }
 
         args.variables["%{SOURCE}"] = sourcefile;
         args.variables["%{OBJECT}"] = objectfile;
 
         QString program;
         QStringList program_args;
-        buildProgramCommand(args.assemble_step, program, program_args);
+        args.buildProgramCommand(args.assemble_step, program, program_args);
 
         args.variables.remove("%{SOURCE}");
         args.variables.remove("%{OBJECT}");
 
-        if(runtool(program, program_args) != 0)
-        {
-            return false;
-        }
-
-        if(!args.variables.contains("%{OBJECTS}"))
-            args.variables["%{OBJECTS}"] = objectfile;
-        else
-            args.variables["%{OBJECTS}"] += " " + objectfile;
-
+        RomCompileJob job = makeJob(QFileInfo(sourcefile).fileName(), "assemble", program, program_args);
+        if(args.incremental)
+            job.cache_status = "miss";
+        jobs.append(job);
     }
-    return true;
+    return runtools(jobs);
 }
 
 bool RomCompilerWorker::link()
 {
+    TRACE_SCOPE("build", "RomCompilerWorker::link");
     QString program;
     QStringList program_args;
 
-    buildProgramCommand(args.link_step, program, program_args);
-    if(runtool(program, program_args) != 0)
+    args.buildProgramCommand(args.link_step, program, program_args);
+    if(runtool("Link", "link", program, program_args) != 0)
     {
         return false;
     }
     return true;
 }
 
+void RomCompilerWorker::analyze(const QString& elf_file)
+{
+    TRACE_SCOPE("build", "RomCompilerWorker::analyze");
+    const qint64 start_usec = args.trace.elapsedUsec();
+
+    RomSizeReport report;
+    QString analyze_error;
+    if(!ElfAnalyzer::analyze(elf_file, args.asset_types, report, analyze_error))
+    {
+        // The link step is configurable, the elf may not exist
+        emit warning(COMPILE_CATEGORY, "Skipped size analysis of " + elf_file + ". " + analyze_error);
+        args.trace.addEvent("Size analysis", "analyze", start_usec, -1, 0, "uncached");
+        return;
+    }
+
+    emit log(COMPILE_CATEGORY, report.summary());
+    foreach(const QString& message, report.warnings)
+    {
+        emit warning(COMPILE_CATEGORY, message);
+    }
+    emit analyzed(report);
+
+    args.trace.addEvent("Size analysis", "analyze", start_usec, 0, 0, "uncached");
+}
+
 bool RomCompilerWorker::objcopy()
 {
+    TRACE_SCOPE("build", "RomCompilerWorker::objcopy");
     QString program;
     QStringList program_args;
 
-    buildProgramCommand(args.objcopy_step, program, program_args);
-    return runtool(program, program_args) == 0;
+    args.buildProgramCommand(args.objcopy_step, program, program_args);
+    return runtool("Objcopy", "objcopy", program, program_args) == 0;
 }
 
 
 bool RomCompilerWorker::fixup()
 {
+    TRACE_SCOPE("build", "RomCompilerWorker::fixup");
     QString program;
     QStringList program_args;
 
-    buildProgramCommand(args.fix_step, program, program_args);
-    return runtool(program, program_args) == 0;
+    args.buildProgramCommand(args.fix_step, program, program_args);
+    return runtool("Fix", "fix", program, program_args) == 0;
 }
 
 bool RomCompilerWorker::customBuild()
 {
+    TRACE_SCOPE("build", "RomCompilerWorker::customBuild");
     QString program;
     QStringList program_args;
 
-    buildProgramCommand(args.custom_step, program, program_args);
-    return runtool(program, program_args) == 0;
+    args.buildProgramCommand(args.custom_step, program, program_args);
+    return runtool("Custom", "custom", program, program_args) == 0;
 }
 
-bool RomCompilerWorker::getObjectFile(const QString& source_file, QString& out_object_file) const
+QString RomCompilerWorker::findNinja() const
+{
+    if(args.ninja.isEmpty())
+    {
+        return QString();
+    }
+
+    const QString program = args.expandVariable(args.ninja);
+    QString program_path = args.findProgram(program);
+    if(program_path.isEmpty())
+    {
+        program_path = QStandardPaths::findExecutable(program);
+    }
+    return program_path;
+}
+
+bool RomCompilerWorker::ninjaBuild(const QString& ninja_program)
+{
+    TRACE_SCOPE("build", "RomCompilerWorker::ninjaBuild");
+    QStringList build_files;
+    QString export_error;
+    if(!BuildFileGenerator::exportBuildFiles(args, build_files, export_error))
+    {
+        emit error(COMPILE_CATEGORY, export_error);
+        return false;
+    }
+
+    // ninja appends each finished edge to its log, read back the new entries for the trace
+    const QString build_dir = BuildFileGenerator::getBuildDir(args);
+    const QString log_file = build_dir + ".ninja_log";
+    const qint64 log_offset = QFileInfo(log_file).size();
+    const qint64 start_usec = args.trace.elapsedUsec();
+
+    // A full build must not reuse what ninja considers up to date from the last one
+    if(!args.incremental)
+    {
+        QStringList clean_args;
+        clean_args << "-C" << build_dir << "-t" << "clean";
+        if(runtool("ninja", "ninja", ninja_program, clean_args) != 0)
+        {
+            return false;
+        }
+    }
+
+    QStringList ninja_args;
+    ninja_args << "-C" << build_dir << "-j" << QString::number(qMax(1, args.jobs));
+    const bool success = runtool("ninja", "ninja", ninja_program, ninja_args) == 0;
+
+    traceNinjaLog(log_file, log_offset, start_usec);
+    return success;
+}
+
+void RomCompilerWorker::traceNinjaLog(const QString& log_file, qint64 log_offset, qint64 start_usec)
+{
+    QFile file(log_file);
+    if(!file.open(QIODevice::ReadOnly | QIODevice::Text) || !file.seek(log_offset))
+    {
+        return;
+    }
+
+    // Entries are "start_ms end_ms mtime output hash", relative to the start of ninja
+    QList<qint64> lane_ends;
+    while(!file.atEnd())
+    {
+        const QStringList fields = QString(file.readLine()).trimmed().split('\t');
+        if(fields.size() < 4 || fields[0].startsWith('#'))
+        {
+            continue;
+        }
+
+        BuildTraceEvent event;
+        event.name = QFileInfo(fields[3]).fileName();
+        event.start_usec = start_usec + fields[0].toLongLong() * 1000;
+        event.duration_usec = (fields[1].toLongLong() - fields[0].toLongLong()) * 1000;
+        event.exit_code = 0;
+        event.output_bytes = 0;
+        event.cache_status = "miss";
+
+        const QString suffix = QFileInfo(fields[3]).suffix();
+        if(suffix == "o")
+            event.category = "compile";
+        else if(suffix == "elf")
+            event.category = "link";
+        else
+            event.category = "rom";
+
+        // Lane 0 is the ninja step itself. Reuse the first lane that is free at the start of this edge
+        event.lane = 0;
+        for(int lane = 0; lane < lane_ends.size() && event.lane == 0; ++lane)
+        {
+            if(lane_ends[lane] <= event.start_usec)
+            {
+                event.lane = lane + 1;
+            }
+        }
+        if(event.lane == 0)
+        {
+            lane_ends.append(0);
+            event.lane = lane_ends.size();
+        }
+        lane_ends[event.lane - 1] = event.start_usec + event.duration_usec;
+
+        args.trace.addEvent(event);
+    }
+}
+
+bool RomCompileArgs::getObjectFile(const QString& source_file, QString& out_object_file) const
 {
     QFileInfo info(source_file);
     if(info.suffix() != "c" && info.suffix() != "s")
@@ -372,16 +738,16 @@ bool RomCompilerWorker::getObjectFile(const QString& source_file, QString& out_o
     return true;
 }
 
-QString RomCompilerWorker::expandVariable(QString variable) const
+QString RomCompileArgs::expandVariable(QString variable) const
 {
     bool replaced;
     do
     {
         replaced = false;
-        foreach(const QString& key, args.variables.keys())
+        foreach(const QString& key, variables.keys())
         {
             QString prev_arg = variable;
-            variable = variable.replace(key, args.variables[key]);
+            variable = variable.replace(key, variables[key]);
 
             if(prev_arg != variable)
             {
@@ -395,7 +761,7 @@ QString RomCompilerWorker::expandVariable(QString variable) const
     return variable;
 }
 
-void RomCompilerWorker::buildProgramCommand(const QString& command, QString& out_program, QStringList& out_args)
+void RomCompileArgs::buildProgramCommand(const QString& command, QString& out_program, QStringList& out_args) const
 {
     QStringList temp_args = command.split(" ");
     foreach(QString arg, temp_args)
@@ -418,50 +784,150 @@ void RomCompilerWorker::buildProgramCommand(const QString& command, QString& out
     out_args.removeAll(" ");
 }
 
+QString RomCompileArgs::findProgram(const QString& program) const
+{
+    QString programPath = program;
+    QFileInfo file_info(programPath);
+#ifdef _WIN32
+    if(!file_info.exists() && file_info.suffix() != "exe")
+    {
+        if(programPath[programPath.size()-1] != '.')
+            programPath += '.';
+        programPath += "exe";
+        file_info = QFileInfo(programPath);
+    }
+#endif
+
+    if(!file_info.exists())
+    {
+        programPath = QCoreApplication::applicationDirPath() + "/" + program;
+        file_info = QFileInfo(programPath);
+    }
+
+    if(!file_info.exists())
+    {
+        return QString();
+    }
+    return file_info.absoluteFilePath();
+}
+
 // -------------------------- Worker ----------------------------------------
 
+RomCompiler::RomCompiler(QObject* parent) :
+    QObject(parent),
+    worker(nullptr),
+    build_success(false)
+{
+}
+
 RomCompiler::~RomCompiler()
 {
     thread.quit();
     thread.wait();
 }
 
-void RomCompiler::build(Game* game)
+void RomCompiler::build(Game* game, bool export_assets, bool incremental)
 {
     static bool register_type = true;
     if(register_type)
     {
         // Allow to pass RomCompileArgs through QObject::connect
         qRegisterMetaType<RomCompileArgs>("RomCompileArgs");
+        qRegisterMetaType<RomSizeReport>("RomSizeReport");
         register_type = false;
     }
 
-    RomCompilerWorker* worker = new RomCompilerWorker();
+    worker = new RomCompilerWorker();
     worker->moveToThread(&thread);
     connect(this, SIGNAL(started(RomCompileArgs)), worker, SLOT(run(RomCompileArgs)));
     connect(&thread, SIGNAL(finished()), worker, SLOT(deleteLater()));
+    connectWorker(worker);
+
+    thread.start();
 
+    RomCompileArgs args;
+    prepare(game, args, export_assets, incremental);
+
+    emit started(args);
+}
+
+bool RomCompiler::buildNow(Game* game, int jobs)
+{
+    build_success = false;
+
+    RomCompileArgs args;
+    prepare(game, args);
+    args.jobs = jobs;
+
+    // Worker signals are delivered directly as it lives on this thread
+    RomCompilerWorker worker;
+    connectWorker(&worker);
+    this->worker = &worker;
+    worker.run(args);
+    this->worker = nullptr;
+
+    return build_success;
+}
+
+void RomCompiler::cancel()
+{
+    if(worker)
+    {
+        worker->cancel();
+    }
+}
+
+void RomCompiler::connectWorker(RomCompilerWorker* worker)
+{
     connect(worker, SIGNAL(log(QString,QString)), this, SLOT(on_workerLog(QString,QString)));
     connect(worker, SIGNAL(warning(QString,QString)), this, SLOT(on_workerWarning(QString,QString)));
     connect(worker, SIGNAL(error(QString,QString)), this, SLOT(on_workerError(QString,QString)));
     connect(worker, SIGNAL(finished(bool,QString)), this, SLOT(on_workerFinished(bool,QString)));
+    connect(worker, SIGNAL(analyzed(RomSizeReport)), this, SIGNAL(analyzed(RomSizeReport)));
+}
 
-    thread.start();
+void RomCompiler::prepare(Game* game, RomCompileArgs& args, bool export_assets, bool incremental)
+{
+    args.trace.start();
+
+    // Export assets before handing off to the worker so the export time is part of the trace
+    if(export_assets)
+    {
+        const qint64 export_start_usec = args.trace.elapsedUsec();
+        game->save();
+        args.trace.addEvent("Export assets", "export", export_start_usec, 0, 0, "uncached");
+    }
 
-    RomCompileArgs args;
     setup(game, args);
 
-    emit started(args);
+    if(incremental)
+    {
+        args.incremental = true;
+        args.variables["%{TEMP}"] = "%{BUILD}";
+    }
 }
 
 void RomCompiler::setup(Game* game, RomCompileArgs& args)
 {
-    args.variables["%{TEMP}"] = QApplication::applicationDirPath() + "/temp/";
+    args.variables["%{TEMP}"] = QCoreApplication::applicationDirPath() + "/temp/";
     args.variables["%{PROJECT}"] = game->getAbsoluteProjectPath();
+    args.variables["%{BUILD}"] = "%{PROJECT}build/";
     args.variables["%{GAME}"] = game->getName();
     args.variables["%{CODE}"] = game->getAbsoluteCodePath();
     args.variables["%{GENERATED}"] = game->getAbsoluteGeneratedPath();
     args.sourcefiles = game->getSourceFiles();
+    args.headerfiles = game->getHeaderFiles();
+    args.headerfiles << game->getAbsoluteGeneratedPath() + GBA_ASSETS_HEADER;
+    args.headerfiles.removeDuplicates();
+    args.incremental = false;
+
+    foreach(const QString& type, game->asset_table.keys())
+    {
+        foreach(Asset* asset, game->asset_table[type])
+        {
+            args.asset_types[asset->getName()] = type;
+        }
+    }
 
 #ifdef _WIN32
     args.variables["%{OS}"]      = "win32";
@@ -489,6 +955,9 @@ void RomCompiler::setup(Game* game, RomCompileArgs& args)
     args.objcopy_step  = getConfig(BUILD_STEP_OBJCOPY);
     args.fix_step      = getConfig(BUILD_STEP_FIX);
     args.custom_step   = getConfig(BUILD_CUSTOM);
+    args.trace_file    = getConfig(BUILD_TRACE);
+    args.ninja         = getConfig(BUILD_NINJA);
+    args.jobs          = QThread::idealThreadCount();
 }
 
 void RomCompiler::on_workerLog(QString category, QString log)
@@ -508,6 +977,7 @@ void RomCompiler::on_workerError(QString category, QString log)
 
 void RomCompiler::on_workerFinished(bool success, QString rom_file)
 {
+    build_success = success;
     if(success)
     {
         msgLog(COMPILE_CATEGORY) << "Created rom file...\n";
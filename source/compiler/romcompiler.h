@@ -4,6 +4,12 @@
 #include <QDebug>
 #include <QString>
 #include <QThread>
+#include <QProcess>
+#include <QAtomicInt>
+#include <QHash>
+
+#include "buildtrace.h"
+#include "elfanalyzer.h"
 
 #define BUILD_CC       "BUILD_CC"
 #define BUILD_AS       "BUILD_AS"
@@ -22,13 +28,19 @@
 #define BUILD_STEP_OBJCOPY  "BUILD_STEP_OBJCOPY"
 #define BUILD_STEP_FIX      "BUILD_STEP_FIX"
 #define BUILD_CUSTOM      "BUILD_CUSTOM"
+#define BUILD_TRACE       "BUILD_TRACE"
+#define BUILD_NINJA       "BUILD_NINJA"
 
 // TODO: create options to manually link against existing libs
 struct RomCompileArgs
 {
+    RomCompileArgs() : jobs(1), incremental(false) {}
+
     // Variables
     QMap<QString, QString> variables;
     QStringList sourcefiles;   // %{SOURCES}, also provides %{SOURCE} and %{OBJECT} for link and compile
+    QStringList headerfiles;   // every source is assumed to depend on every header for incremental builds
+    QMap<QString, QString> asset_types; // asset name to type name. Used to attribute linked symbols to assets
 
     QString compile_step;
     QString assemble_step;
@@ -36,22 +48,64 @@ struct RomCompileArgs
     QString objcopy_step;
     QString fix_step;
     QString custom_step;
+
+    // Number of compile and assemble steps to run at once
+    int jobs;
+
+    // Keep objects in %{BUILD} and skip steps whose outputs are newer than their inputs
+    bool incremental;
+
+    // Chrome trace-event output. Disabled when empty
+    QString trace_file;
+    BuildTrace trace;
+
+    // Ninja executable. When found the build runs through a generated build.ninja. Empty by default, which disables it
+    QString ninja;
+
+    QString expandVariable(QString variable) const;
+    void buildProgramCommand(const QString& command, QString& out_program, QStringList& out_args) const;
+    bool getObjectFile(const QString& source_file, QString& out_object_file) const;
+    // Absolute path of a tool, relative tool paths are searched next to the exe. Empty if not found
+    QString findProgram(const QString& program) const;
 };
 
 Q_DECLARE_METATYPE(RomCompileArgs);
 
+// A single tool invocation of the build
+struct RomCompileJob
+{
+    QString trace_name;
+    QString trace_category;
+    QString program;
+    QStringList program_args;
+    QString cache_status;  // trace status, "miss" for a stale object of an incremental build
+
+    QString program_name;
+    QProcess* process;
+    qint64 start_usec;
+    int lane;
+};
+
 class RomCompilerWorker : public QObject
 {
     Q_OBJECT
 private:
 
     RomCompileArgs args;
+    QStringList objectfiles;
+    QAtomicInt cancelled;
+    QHash<QString, qint64> input_times;  // modified msec of the build inputs, -1 if missing
 
 public:
     ~RomCompilerWorker();
 
+    // Thread safe. Kills the running tools and fails the build
+    void cancel();
+    bool isCancelled() const;
+
 signals:
     void finished(bool success, QString rom_file);
+    void analyzed(RomSizeReport report);
     void log(QString category, QString log);
     void warning(QString category, QString log);
     void error(QString category, QString log);
@@ -65,16 +119,24 @@ private:
     bool compile(const QStringList& sourcefiles);
     bool assemble(const QStringList& sourcefiles);
     bool link();
+    void analyze(const QString& elf_file);
     bool objcopy();
     bool fixup();
 
     bool customBuild();
-
-    int runtool(QString program, const QStringList& args);
-
-    bool getObjectFile(const QString& source_file, QString& out_object_file) const;
-    QString expandVariable(QString variable) const;
-    void buildProgramCommand(const QString& command, QString& out_program, QStringList& out_args);
+    bool ninjaBuild(const QString& ninja_program);
+    QString findNinja() const;
+    void traceNinjaLog(const QString& log_file, qint64 log_offset, qint64 start_usec);
+
+    void finish(bool success, const QString& rom_file);
+    qint64 getInputTime(const QString& input);
+    bool isUpToDate(const QString& output, const QStringList& inputs);
+    int runtool(const QString& trace_name, const QString& trace_category, QString program, const QStringList& args);
+    // Runs the jobs with up to args.jobs tools at once
+    bool runtools(QList<RomCompileJob>& jobs);
+    RomCompileJob makeJob(const QString& trace_name, const QString& trace_category, const QString& program, const QStringList& program_args) const;
+    bool startTool(RomCompileJob& job);
+    int finishTool(RomCompileJob& job);
 };
 
 class Game;
@@ -84,8 +146,11 @@ class RomCompiler : public QObject
 private:
     friend class RomCompilerWorker;
     QThread thread;
+    RomCompilerWorker* worker;
+    bool build_success;
 
 public:
+    explicit RomCompiler(QObject* parent = nullptr);
     ~RomCompiler();
 
     static void resetDefaults();
@@ -93,13 +158,23 @@ public:
     static void setConfig(QString key, QString value);
     static void saveConfig();
 
-    void build(Game* game);
+    // export_assets saves the game first. Incremental builds reuse the objects in %{BUILD}
+    void build(Game* game, bool export_assets = true, bool incremental = false);
+    // Builds on the calling thread, blocking until the ROM is done. Used by the command line
+    bool buildNow(Game* game, int jobs);
+    // Cancels the running build, finished is still emitted
+    void cancel();
+
+    // Optionally exports the assets then fills the args from the game and build config
+    static void prepare(Game* game, RomCompileArgs& args, bool export_assets = true, bool incremental = false);
+    static void setup(Game* game, RomCompileArgs& args);
 
 private:
-    void setup(Game* game, RomCompileArgs& args);
+    void connectWorker(RomCompilerWorker* worker);
 
 signals:
     void started(RomCompileArgs args);
+    void analyzed(RomSizeReport report);
     void finished(bool success, QString rom_file);
 
 private slots:
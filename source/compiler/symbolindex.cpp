@@ -0,0 +1,529 @@
+#include "symbolindex.h"
+#include "clexer.h"
+#include <gba/game.h>
+#include <filecache.h>
+
+#include <QDataStream>
+#include <QDateTime>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QSaveFile>
+#include <QStringRef>
+
+#define SYMBOL_INDEX_MAGIC 0x45445359 // EDSY
+
+struct ScanToken
+{
+    int offset;         // in the file text
+    int length;
+    int line;
+    int column;
+    CTokenType type;
+    bool directive;     // part of a preprocessor line
+};
+
+static bool isIndexedFile(const QString& file_path)
+{
+    const QString suffix = QFileInfo(file_path).suffix();
+    return suffix == "c" || suffix == "h";
+}
+
+static bool isHeaderFile(const QString& file_path)
+{
+    return QFileInfo(file_path).suffix() == "h";
+}
+
+// Tokenizes the whole file, dropping comments
+static void tokenizeFile(const QString& text, QVector<ScanToken>& out_tokens)
+{
+    QVector<CToken> line_tokens;
+    int state = CLEX_STATE_NORMAL;
+    int line = 0;
+    int line_start = 0;
+    while(line_start <= text.size())
+    {
+        int line_end = text.indexOf('\n', line_start);
+        if(line_end < 0)
+        {
+            line_end = text.size();
+        }
+
+        bool directive = (state & CLEX_STATE_DIRECTIVE) != 0;
+        line_tokens.clear();
+        state = CLexer::tokenize(text.constData() + line_start, line_end - line_start, state, line_tokens);
+        foreach(const CToken& token, line_tokens)
+        {
+            if(token.type == CTOKEN_DIRECTIVE)
+            {
+                directive = true;
+            }
+            if(token.type == CTOKEN_COMMENT)
+            {
+                continue;
+            }
+            ScanToken scan_token;
+            scan_token.offset = line_start + token.start;
+            scan_token.length = token.length;
+            scan_token.line = line;
+            scan_token.column = token.start;
+            scan_token.type = token.type;
+            scan_token.directive = directive;
+            out_tokens.append(scan_token);
+        }
+
+        line_start = line_end + 1;
+        ++line;
+    }
+}
+
+static inline QStringRef tokenText(const QString& text, const ScanToken& token)
+{
+    return QStringRef(&text, token.offset, token.length);
+}
+
+static inline bool isChar(const QString& text, const ScanToken& token, CTokenType type, char c)
+{
+    return token.type == type && text[token.offset] == QLatin1Char(c);
+}
+
+// Index of the first token after the ) matching the ( at open, or -1
+static int skipParens(const QString& text, const QVector<ScanToken>& tokens, int open)
+{
+    int depth = 0;
+    for(int i = open; i < tokens.size(); ++i)
+    {
+        if(tokens[i].directive || tokens[i].type != CTOKEN_PAREN)
+        {
+            continue;
+        }
+        depth += text[tokens[i].offset] == QLatin1Char('(') ? 1 : -1;
+        if(depth == 0)
+        {
+            return i + 1;
+        }
+    }
+    return -1;
+}
+
+static void addSymbol(QList<CSymbol>& out_symbols, const QString& text, const QString& file_path, const ScanToken& token, CSymbolKind kind)
+{
+    CSymbol symbol;
+    symbol.name = tokenText(text, token).toString();
+    symbol.kind = kind;
+    symbol.file_path = file_path;
+    symbol.line = token.line;
+    symbol.column = token.column;
+    out_symbols.append(symbol);
+}
+
+const CSymbol* SymbolTable::find(const QString& name) const
+{
+    QHash<QString, CSymbol>::const_iterator it = definitions.constFind(name);
+    return it != definitions.constEnd() ? &it.value() : nullptr;
+}
+
+// Not a parser. Only file scope declarations are recognized, which covers what go to definition needs
+void SymbolIndex::scanSymbols(const QString& text, const QString& file_path, QList<CSymbol>& out_symbols)
+{
+    QVector<ScanToken> tokens;
+    tokenizeFile(text, tokens);
+
+    const bool is_header = isHeaderFile(file_path);
+    const bool is_assets_header = QFileInfo(file_path).fileName() == GBA_ASSETS_HEADER;
+
+    int brace_depth = 0;
+    int paren_depth = 0;
+    bool in_typedef = false;
+    bool typedef_locked = false;    // found the name of a function pointer typedef
+    int typedef_name = -1;
+    bool in_extern = false;
+    int extern_name = -1;
+
+    for(int i = 0; i < tokens.size(); ++i)
+    {
+        const ScanToken& token = tokens[i];
+        if(token.directive)
+        {
+            if(token.type == CTOKEN_DIRECTIVE && tokenText(text, token).mid(1).trimmed() == QLatin1String("define")
+                && i + 1 < tokens.size() && tokens[i + 1].line == token.line
+                && (tokens[i + 1].type == CTOKEN_IDENTIFIER || tokens[i + 1].type == CTOKEN_FUNCTION))
+            {
+                addSymbol(out_symbols, text, file_path, tokens[i + 1], CSYMBOL_MACRO);
+            }
+            continue;
+        }
+
+        switch(token.type)
+        {
+        case CTOKEN_BRACE:
+            if(isChar(text, token, CTOKEN_BRACE, '{'))
+            {
+                ++brace_depth;
+            }
+            else if(isChar(text, token, CTOKEN_BRACE, '}'))
+            {
+                brace_depth = qMax(0, brace_depth - 1);
+            }
+            break;
+
+        case CTOKEN_PAREN:
+            paren_depth = isChar(text, token, CTOKEN_PAREN, '(') ? paren_depth + 1 : qMax(0, paren_depth - 1);
+            break;
+
+        case CTOKEN_KEYWORD:
+        {
+            const QStringRef keyword = tokenText(text, token);
+            if(brace_depth == 0 && keyword == QLatin1String("typedef"))
+            {
+                in_typedef = true;
+                typedef_locked = false;
+                typedef_name = -1;
+            }
+            else if(brace_depth == 0 && keyword == QLatin1String("extern"))
+            {
+                in_extern = true;
+                extern_name = -1;
+            }
+            else if((keyword == QLatin1String("struct") || keyword == QLatin1String("union") || keyword == QLatin1String("enum"))
+                && i + 2 < tokens.size() && tokens[i + 1].type == CTOKEN_IDENTIFIER && isChar(text, tokens[i + 2], CTOKEN_BRACE, '{'))
+            {
+                addSymbol(out_symbols, text, file_path, tokens[i + 1], CSYMBOL_STRUCT);
+            }
+            break;
+        }
+
+        case CTOKEN_IDENTIFIER:
+            if(brace_depth == 0 && in_typedef && !typedef_locked)
+            {
+                if(paren_depth == 0)
+                {
+                    typedef_name = i;
+                }
+                else if(i >= 2 && isChar(text, tokens[i - 1], CTOKEN_PUNCTUATION, '*') && isChar(text, tokens[i - 2], CTOKEN_PAREN, '('))
+                {
+                    // typedef void (*name)(int);
+                    typedef_name = i;
+                    typedef_locked = true;
+                }
+            }
+            if(brace_depth == 0 && paren_depth == 0 && in_extern)
+            {
+                extern_name = i;
+            }
+            break;
+
+        case CTOKEN_FUNCTION:
+            if(brace_depth == 0 && paren_depth == 0)
+            {
+                if(in_typedef)
+                {
+                    if(!typedef_locked)
+                    {
+                        typedef_name = i;
+                    }
+                }
+                else
+                {
+                    // A definition, or a prototype in a header
+                    const int after = skipParens(text, tokens, i + 1);
+                    if(after >= 0 && after < tokens.size()
+                        && (isChar(text, tokens[after], CTOKEN_BRACE, '{') || (is_header && isChar(text, tokens[after], CTOKEN_PUNCTUATION, ';'))))
+                    {
+                        addSymbol(out_symbols, text, file_path, token, CSYMBOL_FUNCTION);
+                    }
+                }
+            }
+            break;
+
+        case CTOKEN_PUNCTUATION:
+            if(brace_depth == 0 && paren_depth == 0 && isChar(text, token, CTOKEN_PUNCTUATION, ';'))
+            {
+                if(in_typedef && typedef_name >= 0)
+                {
+                    addSymbol(out_symbols, text, file_path, tokens[typedef_name], CSYMBOL_TYPEDEF);
+                }
+                if(in_extern && extern_name >= 0 && is_assets_header)
+                {
+                    addSymbol(out_symbols, text, file_path, tokens[extern_name], CSYMBOL_ASSET);
+                }
+                in_typedef = false;
+                in_extern = false;
+            }
+            break;
+
+        default:
+            break;
+        }
+    }
+}
+
+bool SymbolIndex::load(const QString& index_file)
+{
+    clear();
+
+    QFile file(index_file);
+    if(!file.open(QIODevice::ReadOnly))
+    {
+        return false;
+    }
+
+    QDataStream in(&file);
+    in.setVersion(QDataStream::Qt_5_0);
+
+    quint32 magic = 0;
+    qint32 version = 0;
+    in >> magic >> version;
+    if(magic != SYMBOL_INDEX_MAGIC || version != SYMBOL_INDEX_VERSION)
+    {
+        return false;
+    }
+
+    qint32 file_count = 0;
+    in >> file_count;
+    for(qint32 i = 0; i < file_count && in.status() == QDataStream::Ok; ++i)
+    {
+        QString file_path;
+        SymbolFileEntry entry;
+        qint32 symbol_count = 0;
+        in >> file_path >> entry.modified_msec >> entry.size >> symbol_count;
+        for(qint32 j = 0; j < symbol_count && in.status() == QDataStream::Ok; ++j)
+        {
+            CSymbol symbol;
+            qint32 kind, line, column;
+            in >> symbol.name >> kind >> line >> column;
+            symbol.kind = CSymbolKind(kind);
+            symbol.file_path = file_path;
+            symbol.line = line;
+            symbol.column = column;
+            entry.symbols.append(symbol);
+        }
+        files.insert(file_path, entry);
+    }
+
+    if(in.status() != QDataStream::Ok)
+    {
+        clear();
+        return false;
+    }
+    return true;
+}
+
+bool SymbolIndex::save(const QString& index_file) const
+{
+    QDir().mkpath(QFileInfo(index_file).absolutePath());
+
+    QSaveFile file(index_file);
+    if(!file.open(QIODevice::WriteOnly))
+    {
+        return false;
+    }
+
+    QDataStream out(&file);
+    out.setVersion(QDataStream::Qt_5_0);
+    out << quint32(SYMBOL_INDEX_MAGIC) << qint32(SYMBOL_INDEX_VERSION) << qint32(files.size());
+    for(QHash<QString, SymbolFileEntry>::const_iterator it = files.constBegin(); it != files.constEnd(); ++it)
+    {
+        const SymbolFileEntry& entry = it.value();
+        out << it.key() << entry.modified_msec << entry.size << qint32(entry.symbols.size());
+        foreach(const CSymbol& symbol, entry.symbols)
+        {
+            out << symbol.name << qint32(symbol.kind) << qint32(symbol.line) << qint32(symbol.column);
+        }
+    }
+    return file.commit();
+}
+
+void SymbolIndex::clear()
+{
+    files.clear();
+}
+
+bool SymbolIndex::updateFile(const QString& file_path)
+{
+    QFileInfo info(file_path);
+    if(!info.isFile())
+    {
+        return removeFile(file_path);
+    }
+
+    const qint64 modified_msec = info.lastModified().toMSecsSinceEpoch();
+    QHash<QString, SymbolFileEntry>::const_iterator it = files.constFind(file_path);
+    if(it != files.constEnd() && it->modified_msec == modified_msec && it->size == info.size())
+    {
+        return false;
+    }
+
+    QByteArray data;
+    if(!FileCache::get().read(file_path, data))
+    {
+        return removeFile(file_path);
+    }
+
+    SymbolFileEntry entry;
+    entry.modified_msec = modified_msec;
+    entry.size = info.size();
+    scanSymbols(QString::fromUtf8(data), file_path, entry.symbols);
+    files.insert(file_path, entry);
+    return true;
+}
+
+bool SymbolIndex::removeFile(const QString& file_path)
+{
+    return files.remove(file_path) > 0;
+}
+
+bool SymbolIndex::updateFiles(const QStringList& file_paths)
+{
+    bool changed = false;
+    QSet<QString> listed;
+    foreach(const QString& file_path, file_paths)
+    {
+        listed.insert(file_path);
+        changed |= updateFile(file_path);
+    }
+
+    foreach(const QString& file_path, files.keys())
+    {
+        if(!listed.contains(file_path))
+        {
+            files.remove(file_path);
+            changed = true;
+        }
+    }
+    return changed;
+}
+
+SymbolTable SymbolIndex::buildTable() const
+{
+    SymbolTable table;
+
+    // Sorted so the same index always resolves a name to the same file
+    QStringList file_paths = files.keys();
+    file_paths.sort();
+    foreach(const QString& file_path, file_paths)
+    {
+        foreach(const CSymbol& symbol, files[file_path].symbols)
+        {
+            QHash<QString, CSymbol>::iterator it = table.definitions.find(symbol.name);
+            if(it == table.definitions.end())
+            {
+                table.definitions.insert(symbol.name, symbol);
+                table.names << symbol.name;
+            }
+            else if(isHeaderFile(it->file_path) && !isHeaderFile(symbol.file_path))
+            {
+                *it = symbol;
+            }
+
+            if(symbol.kind == CSYMBOL_STRUCT || symbol.kind == CSYMBOL_TYPEDEF)
+            {
+                table.type_names.insert(symbol.name);
+            }
+        }
+    }
+    table.names.sort();
+    return table;
+}
+
+// ---------------------------- Symbol Indexer --------------------------------//
+
+void SymbolIndexWorker::reindex(QString new_index_file, QStringList file_paths)
+{
+    if(index_file != new_index_file)
+    {
+        index_file = new_index_file;
+        index.load(index_file);
+    }
+
+    if(index.updateFiles(file_paths))
+    {
+        index.save(index_file);
+    }
+    emit indexed(index.buildTable());
+}
+
+void SymbolIndexWorker::updateFile(QString file_path)
+{
+    if(index_file.isEmpty())
+    {
+        return;
+    }
+
+    if(index.updateFile(file_path))
+    {
+        index.save(index_file);
+        emit indexed(index.buildTable());
+    }
+}
+
+SymbolIndexer::SymbolIndexer(QObject* parent)
+    : QObject(parent)
+    , index_worker(nullptr)
+{
+    static bool register_type = true;
+    if(register_type)
+    {
+        qRegisterMetaType<SymbolTable>("SymbolTable");
+        register_type = false;
+    }
+
+    index_worker = new SymbolIndexWorker();
+    index_worker->moveToThread(&index_thread);
+    connect(this, SIGNAL(reindexRequested(QString,QStringList)), index_worker, SLOT(reindex(QString,QStringList)));
+    connect(this, SIGNAL(updateRequested(QString)), index_worker, SLOT(updateFile(QString)));
+    connect(index_worker, SIGNAL(indexed(SymbolTable)), this, SLOT(on_indexed(SymbolTable)));
+    connect(&index_thread, SIGNAL(finished()), index_worker, SLOT(deleteLater()));
+    index_thread.start(QThread::LowPriority);
+}
+
+SymbolIndexer::~SymbolIndexer()
+{
+    index_thread.quit();
+    index_thread.wait();
+}
+
+void SymbolIndexer::reindex(Game* game)
+{
+    if(game == nullptr || !game->isValid())
+    {
+        return;
+    }
+
+    QStringList file_paths;
+    foreach(const QString& file_path, game->getSourceFiles() + game->getHeaderFiles())
+    {
+        if(isIndexedFile(file_path))
+        {
+            file_paths << file_path;
+        }
+    }
+
+    // Written on save, so it may not have been listed yet
+    const QString assets_header = QFileInfo(game->getAbsoluteGeneratedPath() + GBA_ASSETS_HEADER).absoluteFilePath();
+    if(!file_paths.contains(assets_header))
+    {
+        file_paths << assets_header;
+    }
+
+    emit reindexRequested(game->getAbsoluteProjectPath() + SYMBOL_INDEX_FILE, file_paths);
+}
+
+void SymbolIndexer::updateFile(const QString& file_path)
+{
+    if(isIndexedFile(file_path))
+    {
+        emit updateRequested(QFileInfo(file_path).absoluteFilePath());
+    }
+}
+
+const SymbolTable& SymbolIndexer::getTable() const
+{
+    return table;
+}
+
+void SymbolIndexer::on_indexed(SymbolTable new_table)
+{
+    table = new_table;
+    emit updated();
+}
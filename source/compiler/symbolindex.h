@@ -0,0 +1,124 @@
+#ifndef SYMBOLINDEX_H
+#define SYMBOLINDEX_H
+
+#include <QHash>
+#include <QList>
+#include <QMetaType>
+#include <QObject>
+#include <QSet>
+#include <QString>
+#include <QStringList>
+#include <QThread>
+
+class Game;
+
+// Saved per project, relative to the project path
+#define SYMBOL_INDEX_FILE    "build/symbols.idx"
+#define SYMBOL_INDEX_VERSION 1
+
+enum CSymbolKind
+{
+    CSYMBOL_FUNCTION,
+    CSYMBOL_STRUCT,     // struct, union and enum tags
+    CSYMBOL_TYPEDEF,
+    CSYMBOL_MACRO,
+    CSYMBOL_ASSET       // asset ids declared in the generated assets.h
+};
+
+struct CSymbol
+{
+    QString name;
+    CSymbolKind kind;
+    QString file_path;
+    int line;           // 0 based
+    int column;
+};
+
+// Symbols of one file and the file state they were scanned from
+struct SymbolFileEntry
+{
+    qint64 modified_msec;
+    qint64 size;
+    QList<CSymbol> symbols;
+};
+
+// Lookup tables built from a SymbolIndex, handed from the indexer thread to the editor
+class SymbolTable
+{
+public:
+    QHash<QString, CSymbol> definitions;    // one per name, source files win over headers
+    QSet<QString> type_names;               // struct tags and typedefs
+    QStringList names;                      // sorted, for completion
+
+    const CSymbol* find(const QString& name) const;
+};
+Q_DECLARE_METATYPE(SymbolTable)
+
+// Functions, types, macros and asset ids of a set of C files.
+// A file is only rescanned when its size or modified time changed since it was indexed
+class SymbolIndex
+{
+private:
+    QHash<QString, SymbolFileEntry> files;
+
+public:
+    static void scanSymbols(const QString& text, const QString& file_path, QList<CSymbol>& out_symbols);
+
+    bool load(const QString& index_file);
+    bool save(const QString& index_file) const;
+    void clear();
+
+    // Each returns true if the index changed
+    bool updateFile(const QString& file_path);
+    bool removeFile(const QString& file_path);
+    // Updates the listed files and drops any other
+    bool updateFiles(const QStringList& file_paths);
+
+    SymbolTable buildTable() const;
+};
+
+class SymbolIndexWorker : public QObject
+{
+    Q_OBJECT
+private:
+    SymbolIndex index;
+    QString index_file;
+
+public slots:
+    void reindex(QString index_file, QStringList file_paths);
+    void updateFile(QString file_path);
+
+signals:
+    void indexed(SymbolTable table);
+};
+
+// Keeps the symbol index of the game's code up to date on a background thread
+class SymbolIndexer : public QObject
+{
+    Q_OBJECT
+private:
+    QThread index_thread;
+    SymbolIndexWorker* index_worker;
+    SymbolTable table;
+
+public:
+    explicit SymbolIndexer(QObject* parent = nullptr);
+    ~SymbolIndexer();
+
+    // Indexes the source and header files of the game. Unchanged files are taken from the saved index
+    void reindex(Game* game);
+    // A file changed on disk
+    void updateFile(const QString& file_path);
+
+    const SymbolTable& getTable() const;
+
+signals:
+    void reindexRequested(QString index_file, QStringList file_paths);
+    void updateRequested(QString file_path);
+    void updated();
+
+private slots:
+    void on_indexed(SymbolTable table);
+};
+
+#endif // SYMBOLINDEX_H
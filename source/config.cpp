@@ -1,7 +1,7 @@
 #include "config.h"
 
 #include <QSettings>
-#include <QApplication>
+#include <QCoreApplication>
 
 
 QMap<QString, QString> Config::data;
@@ -9,7 +9,7 @@ bool Config::is_loaded = false;
 
 void Config::save()
 {
-    QSettings settings(QApplication::applicationDirPath() + "/edgba.ini", QSettings::IniFormat);
+    QSettings settings(QCoreApplication::applicationDirPath() + "/edgba.ini", QSettings::IniFormat);
     settings.clear();
     settings.beginGroup("User");
     QMap<QString, QString>::const_iterator i = data.constBegin();
@@ -26,7 +26,7 @@ void Config::load()
     is_loaded = true;
     data.clear();
 
-    QSettings settings(QApplication::applicationDirPath() + "/edgba.ini", QSettings::IniFormat);
+    QSettings settings(QCoreApplication::applicationDirPath() + "/edgba.ini", QSettings::IniFormat);
     settings.beginGroup("User");
     QStringList keys = settings.childKeys();
     foreach (QString key, keys)
@@ -13,6 +13,7 @@
 #define CONFIG_KEY_RECENT_PROJECT "recent_project"
 #define CONFIG_KEY_DEVKITPRO_PATH "devkitpro_path"
 #define CONFIG_KEY_DARK_MODE "dark_mode"
+#define CONFIG_KEY_AUTO_BUILD "auto_build"
 
 // path relative to the edgba editor exe. Copied from external dir
 #define EDITOR_DEVKITPRO_PATH "devkitPro"
@@ -22,4 +23,10 @@
 
 #define LOG_VERBOSE true
 
+// Scoped timing zones for the editor hot paths, see trace.h. 0 compiles them out.
+// Enabled by edgba_core.pri for debug builds and by edgba_bench.pro
+#ifndef EDGBA_TRACE
+#define EDGBA_TRACE 0
+#endif
+
 #endif // DEFINES_H
@@ -5,6 +5,8 @@
 
 EditContext::EditContext()
 {
+    qRegisterMetaType<AssetChange>("AssetChange");
+    QObject::connect(this, SIGNAL(assetChanged(AssetChange)), &map_thumbnails, SLOT(on_assetChanged(AssetChange)));
     game = nullptr;
     reset();
 }
@@ -14,8 +16,12 @@ EditContext::~EditContext()
 
 void EditContext::reset()
 {
+    map_thumbnails.clear();
+    undo_steps.clear();
+    redo_steps.clear();
     if(game == nullptr)
     {
+        asset_graph.clear();
         tileset = nullptr;
         spriteanim = nullptr;
         spritesheet = nullptr;
@@ -23,12 +29,11 @@ void EditContext::reset()
         return;
     }
 
+    // Part of resetting the editors, not an edit to notify or journal
     const int bg_index = 0;
     QList<Tileset*> tilesets = game->getAssets<Tileset>();
-    if(tilesets.size())
-        setTileset(bg_index, tilesets[0]);
-    else
-        setTileset(bg_index, nullptr);
+    if(map)
+        map->setTileset(bg_index, tilesets.size() ? tilesets[0] : nullptr);
 
     QList<Map*> maps = game->getAssets<Map>();
     if(maps.size())
@@ -47,6 +52,8 @@ void EditContext::reset()
         setSpriteAnim(spriteanims[0]);
     else
         setSpriteAnim(nullptr);
+
+    asset_graph.rebuild(game);
 }
 
 Game* EditContext::getGame()
@@ -64,17 +71,113 @@ void EditContext::setGame(Game* new_game)
     reset();
 }
 
+const AssetGraph& EditContext::getAssetGraph() const
+{
+    return asset_graph;
+}
+
+EditJournal& EditContext::getJournal()
+{
+    return journal;
+}
+
+MapThumbnailCache& EditContext::getMapThumbnails()
+{
+    return map_thumbnails;
+}
+
+void EditContext::journalChange(const AssetChange& change)
+{
+    switch(change.type)
+    {
+    case AssetChangeType::TILES:
+        // Whole map changes, like an undo, are stored as the entire map
+        if(!change.rect.isEmpty())
+        {
+            journal.appendTiles(dynamic_cast<Map*>(change.asset), change.rect);
+            break;
+        }
+        journal.appendAsset(change.asset);
+        break;
+    case AssetChangeType::REMOVED:
+        journal.appendRemove(change.asset);
+        break;
+    case AssetChangeType::RENAMED:
+        journal.appendRename(change.asset, change.old_name);
+        break;
+    case AssetChangeType::FIELDS:
+        journal.appendFields(change.asset);
+        break;
+    default:
+        journal.appendAsset(change.asset);
+        break;
+    }
+}
+
+void EditContext::notifyChanged(Asset* asset, AssetChangeType type, const QRect& rect)
+{
+    if(asset == nullptr)
+    {
+        return;
+    }
+
+    // Dependents are rebuilt from the edited asset on replay, only it is journaled
+    journalChange(AssetChange(type, asset, rect));
+    foreach(const AssetChange& change, asset_graph.propagate(AssetChange(type, asset, rect)))
+    {
+        emit assetChanged(change);
+    }
+}
+
+void EditContext::renameAsset(Asset* asset, const QString& name)
+{
+    if(asset == nullptr || asset->getName() == name)
+    {
+        return;
+    }
+
+    AssetChange change(AssetChangeType::RENAMED, asset);
+    change.old_name = asset->getName();
+    asset->setName(name);
+    journalChange(change);
+
+    // Dependents store the name of what they reference, update only those
+    foreach(Asset* dependent, asset_graph.getDependents(asset))
+    {
+        if(Map* dependent_map = dynamic_cast<Map*>(dependent))
+        {
+            dependent_map->syncBackgrounds();
+        }
+        else if(TiledImage* dependent_image = dynamic_cast<TiledImage*>(dependent))
+        {
+            dependent_image->setSharedPalette(name);
+        }
+    }
+
+    foreach(const AssetChange& propagated, asset_graph.propagate(change))
+    {
+        emit assetChanged(propagated);
+    }
+}
+
 bool EditContext::newMap(QString name)
 {
     Map* new_map = game->addAsset<Map>();
     if(new_map)
+    {
         new_map->setName(name);
+        asset_graph.updateAsset(new_map, game);
+        notifyChanged(new_map, AssetChangeType::ADDED);
+    }
     setMap(new_map);
     return getMap() != nullptr;
 }
 
 bool EditContext::removeMap()
 {
+    notifyChanged(map, AssetChangeType::REMOVED);
+    forgetMap(map);
+    asset_graph.removeAsset(map);
     game->removeAsset<Map>(map);
 
     Map* map = nullptr;
@@ -127,9 +230,14 @@ bool EditContext::loadTilesetFromImage(Tileset* tileset, QString image_filename)
         {
             QFileInfo fileInfo(image_filename);
             tileset->setName(fileInfo.baseName());
+            notifyChanged(tileset, AssetChangeType::ADDED);
         }
 
+        // Shared palettes may have been reassigned, refresh their edges before notifying
         game->rebuildPalettes();
+        asset_graph.rebuild(game);
+        notifyChanged(tileset, AssetChangeType::PIXELS);
+        notifyChanged(game->getTilesetPalette(), AssetChangeType::PALETTE);
         return true;
     }
     return false;
@@ -142,28 +250,131 @@ Tileset* EditContext::newTileset(QString name)
 
     Tileset* tileset = game->addAsset<Tileset>();
     if(tileset)
+    {
         tileset->setName(name);
+        asset_graph.updateAsset(tileset, game);
+        notifyChanged(tileset, AssetChangeType::ADDED);
+    }
 
     return tileset;
 }
 
 void EditContext::removeTileset(Tileset *tileset)
 {
+    if(tileset == nullptr)
+        return;
+
+    notifyChanged(tileset, AssetChangeType::REMOVED);
     if(map)
+    {
         map->removeTileset(tileset);
+        asset_graph.updateAsset(map, game);
+    }
+    asset_graph.removeAsset(tileset);
     if(game)
         game->removeAsset<Tileset>(tileset);
 }
 
 void EditContext::replaceTileset(Tileset *tileset, Tileset *new_tileset)
 {
-    foreach(Map* map, game->getAssets<Map>())
+    // Only the maps referencing the tileset need to change
+    foreach(Asset* dependent, asset_graph.getDependents(tileset))
     {
-        map->replaceTileset(tileset, new_tileset);
+        if(Map* dependent_map = dynamic_cast<Map*>(dependent))
+        {
+            dependent_map->replaceTileset(tileset, new_tileset);
+            dependent_map->syncBackgrounds();
+            asset_graph.updateAsset(dependent_map, game);
+            notifyChanged(dependent_map, AssetChangeType::PROPERTIES);
+        }
     }
     removeTileset(tileset);
 }
 
+int EditContext::importBatch(BatchImporter& importer)
+{
+    if(game == nullptr)
+    {
+        return 0;
+    }
+
+    QList<Asset*> added, updated;
+    importer.apply(game, added, updated);
+    if(added.isEmpty() && updated.isEmpty())
+    {
+        return 0;
+    }
+
+    foreach(Asset* asset, added)
+    {
+        notifyChanged(asset, AssetChangeType::ADDED);
+    }
+
+    // Shared palettes may have been reassigned, refresh their edges before notifying
+    asset_graph.rebuild(game);
+    foreach(Asset* asset, added + updated)
+    {
+        notifyChanged(asset, AssetChangeType::PIXELS);
+    }
+    notifyChanged(game->getTilesetPalette(), AssetChangeType::PALETTE);
+    notifyChanged(game->getSpritePalette(), AssetChangeType::PALETTE);
+    return added.size() + updated.size();
+}
+
+int EditContext::applyTileOps(const QList<TileOp>& ops)
+{
+    if(game == nullptr || ops.isEmpty())
+    {
+        return 0;
+    }
+
+    // Ops on one tileset only reach the maps that depend on it
+    QList<Map*> maps;
+    bool all_maps = false;
+    foreach(const TileOp& op, ops)
+    {
+        all_maps |= op.tileset == nullptr;
+    }
+    if(all_maps)
+    {
+        maps = game->getAssets<Map>();
+    }
+    else
+    {
+        foreach(const TileOp& op, ops)
+        {
+            foreach(Asset* dependent, asset_graph.getDependents(op.tileset))
+            {
+                Map* dependent_map = dynamic_cast<Map*>(dependent);
+                if(dependent_map && !maps.contains(dependent_map))
+                {
+                    maps.append(dependent_map);
+                }
+            }
+        }
+    }
+
+    EditUndoStep step;
+    step.map = nullptr;
+    step.tile_ops = TileOps::apply(maps, ops);
+    if(step.tile_ops.isEmpty())
+    {
+        return 0;
+    }
+
+    pushUndoStep(step);
+    foreach(const TileOpsMapDelta& delta, step.tile_ops)
+    {
+        notifyChanged(delta.map, AssetChangeType::TILES);
+    }
+    return step.tile_ops.size();
+}
+
+int EditContext::applyTileOp(const TileOp& op)
+{
+    return applyTileOps(QList<TileOp>() << op);
+}
+
 void EditContext::setMap(Map* new_map)
 {
     map = new_map;
@@ -204,11 +415,13 @@ Tileset* EditContext::getTileset(int bg_index) const
     return map->getTileset(bg_index);
 }
 
-void EditContext::setTileset(int bg_index, Tileset* tileset) const
+void EditContext::setTileset(int bg_index, Tileset* tileset)
 {
-    if(map != nullptr)
+    if(map != nullptr && map->getTileset(bg_index) != tileset)
     {
         map->setTileset(bg_index, tileset);
+        asset_graph.updateAsset(map, game);
+        notifyChanged(map, AssetChangeType::PROPERTIES);
     }
 }
 
@@ -237,6 +450,8 @@ void EditContext::getTilesetNames(QStringList& names) const
 bool EditContext::newSpriteSheet()
 {
     SpriteSheet* spritesheet = game->addAsset<SpriteSheet>();
+    asset_graph.updateAsset(spritesheet, game);
+    notifyChanged(spritesheet, AssetChangeType::ADDED);
     setSpriteSheet(spritesheet);
     return getSpriteSheet() != nullptr;
 }
@@ -284,10 +499,14 @@ bool EditContext::newSpriteSheetFromImage(QString image_filename)
         {
             QFileInfo fileInfo(image_filename);
             spritesheet->setName(fileInfo.baseName());
+            notifyChanged(spritesheet, AssetChangeType::ADDED);
         }
 
         setSpriteSheet(spritesheet);
         game->rebuildPalettes();
+        asset_graph.rebuild(game);
+        notifyChanged(spritesheet, AssetChangeType::PIXELS);
+        notifyChanged(game->getSpritePalette(), AssetChangeType::PALETTE);
 
         return true;
     }
@@ -297,6 +516,8 @@ bool EditContext::newSpriteSheetFromImage(QString image_filename)
 
 bool EditContext::removeSpriteSheet()
 {
+    notifyChanged(spritesheet, AssetChangeType::REMOVED);
+    asset_graph.removeAsset(spritesheet);
     game->removeAsset<SpriteSheet>(spritesheet);
 
     SpriteSheet* spritesheet = nullptr;
@@ -338,12 +559,16 @@ void EditContext::getSpriteSheetNames(QStringList& names) const
 bool EditContext::newSpriteAnim()
 {
     SpriteAnim* spriteanim = game->addAsset<SpriteAnim>();
+    asset_graph.updateAsset(spriteanim, game);
+    notifyChanged(spriteanim, AssetChangeType::ADDED);
     setSpriteAnim(spriteanim);
     return getSpriteAnim() != nullptr;
 }
 
 bool EditContext::removeSpriteAnim()
 {
+    notifyChanged(spriteanim, AssetChangeType::REMOVED);
+    asset_graph.removeAsset(spriteanim);
     game->removeAsset<SpriteAnim>(spriteanim);
 
     SpriteAnim* spriteanim = nullptr;
@@ -390,17 +615,130 @@ void EditContext::setSpriteSheetSize(int size_index)
         if(size_index >= 0 && size_index < sprite_size_flags.size())
         {
             spritesheet->setSpriteSize(sprite_size_flags[size_index]);
+            notifyChanged(spritesheet, AssetChangeType::FIELDS);
+        }
+    }
+}
+
+
+void EditContext::pushMapUndo(Map* stroke_map)
+{
+    stroke_map->pushUndo();
+
+    EditUndoStep step;
+    step.map = stroke_map;
+    pushUndoStep(step);
+}
+
+void EditContext::pushUndoStep(const EditUndoStep& step)
+{
+    undo_steps.append(step);
+    if(undo_steps.size() > EDIT_UNDO_LIMIT)
+        undo_steps.removeFirst();
+
+    redo_steps.clear();
+}
+
+void EditContext::forgetMap(Map* removed_map)
+{
+    QList<EditUndoStep>* histories[] = {&undo_steps, &redo_steps};
+    for(QList<EditUndoStep>* steps : histories)
+    {
+        for(int i = steps->size() - 1; i >= 0; --i)
+        {
+            EditUndoStep& step = (*steps)[i];
+            for(int delta = step.tile_ops.size() - 1; delta >= 0; --delta)
+            {
+                if(step.tile_ops[delta].map == removed_map)
+                    step.tile_ops.removeAt(delta);
+            }
+            if(step.map == removed_map || (step.map == nullptr && step.tile_ops.isEmpty()))
+                steps->removeAt(i);
         }
     }
 }
 
+static bool stepTouchesMap(const EditUndoStep& step, Map* touched_map)
+{
+    if(step.map)
+        return step.map == touched_map;
+    foreach(const TileOpsMapDelta& delta, step.tile_ops)
+    {
+        if(delta.map == touched_map)
+            return true;
+    }
+    return false;
+}
+
+int EditContext::findUndoStep(const QList<EditUndoStep>& steps) const
+{
+    if(map == nullptr)
+        return -1;
+
+    // The newest step on the current map. Newer steps on other maps wait until their map is opened again
+    for(int i = steps.size() - 1; i >= 0; --i)
+    {
+        if(!stepTouchesMap(steps[i], map))
+            continue;
+
+        // A bulk edit also changes other maps, it has to wait for their newer steps. Map strokes restore
+        // whole snapshots, so undoing around them would bring the bulk edit back
+        if(steps[i].map == nullptr)
+        {
+            for(int newer = i + 1; newer < steps.size(); ++newer)
+            {
+                foreach(const TileOpsMapDelta& delta, steps[i].tile_ops)
+                {
+                    if(stepTouchesMap(steps[newer], delta.map))
+                        return -1;
+                }
+            }
+        }
+        return i;
+    }
+    return -1;
+}
 
 void EditContext::undo()
 {
-    //TODO:!
+    const int index = findUndoStep(undo_steps);
+    if(index < 0)
+    {
+        return;
+    }
+
+    const EditUndoStep step = undo_steps.takeAt(index);
+    redo_steps.append(step);
+    if(step.map)
+    {
+        step.map->undo();
+        notifyChanged(step.map, AssetChangeType::TILES);
+        return;
+    }
+    foreach(Map* changed_map, TileOps::undo(step.tile_ops))
+    {
+        notifyChanged(changed_map, AssetChangeType::TILES);
+    }
 }
 
 void EditContext::redo()
 {
+    const int index = findUndoStep(redo_steps);
+    if(index < 0)
+    {
+        return;
+    }
 
+    const EditUndoStep step = redo_steps.takeAt(index);
+    undo_steps.append(step);
+    if(step.map)
+    {
+        step.map->redo();
+        notifyChanged(step.map, AssetChangeType::TILES);
+        return;
+    }
+    foreach(Map* changed_map, TileOps::redo(step.tile_ops))
+    {
+        notifyChanged(changed_map, AssetChangeType::TILES);
+    }
 }
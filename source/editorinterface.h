@@ -3,9 +3,26 @@
 
 #include "defines.h"
 #include <gba/game.h>
+#include <gba/assetgraph.h>
+#include <gba/editjournal.h>
+#include <gba/mapthumbnails.h>
+#include <gba/batchimporter.h>
+#include <gba/tileops.h>
 #include <QObject>
 
+// Number of edits that can be undone across all maps
+#define EDIT_UNDO_LIMIT MAP_UNDO_LIMIT
+
 class MainWindow;
+
+// One step of the edit history. Either a stroke on map, its cells are kept in the map's own undo stack,
+// or a bulk tile edit over any number of maps
+struct EditUndoStep
+{
+    Map* map;
+    QList<TileOpsMapDelta> tile_ops;
+};
+
 class EditorInterface
 {
 public:
@@ -34,6 +51,22 @@ private:
     class Tileset* tileset;
     class Map* map;
 
+    // which assets reference which, rebuilt on reset
+    AssetGraph asset_graph;
+    // edits since the last save, for crash recovery
+    EditJournal journal;
+    // downscaled maps, kept up to date through assetChanged
+    MapThumbnailCache map_thumbnails;
+
+    QList<EditUndoStep> undo_steps;
+    QList<EditUndoStep> redo_steps;
+
+    void journalChange(const AssetChange& change);
+    void pushUndoStep(const EditUndoStep& step);
+    // Drops the history of a removed map
+    void forgetMap(Map* removed_map);
+    int findUndoStep(const QList<EditUndoStep>& steps) const;
+
 public:
     EditContext();
     virtual ~EditContext();
@@ -42,6 +75,13 @@ public:
     Game* getGame();
     void setGame(Game* new_game);
 
+    const AssetGraph& getAssetGraph() const;
+    EditJournal& getJournal();
+    MapThumbnailCache& getMapThumbnails();
+    // Emits assetChanged for the asset and every asset depending on it
+    void notifyChanged(Asset* asset, AssetChangeType type, const QRect& rect = QRect());
+    void renameAsset(Asset* asset, const QString& name);
+
     bool newMap(QString name);
     bool removeMap();
     void setMap(Map* new_map);
@@ -56,7 +96,7 @@ public:
     Tileset* findTileset(const QString& name);
 
     Tileset* getTileset(int bg_index) const;
-    void setTileset(int bg_index, Tileset* tileset) const;
+    void setTileset(int bg_index, Tileset* tileset);
     QString getTilesetName(int bg_index) const;
     void getTilesetNames(QStringList& names) const;
 
@@ -77,9 +117,22 @@ public:
 
     void setSpriteSheetSize(int size);
 
-    // TODO: add redo/undo buffers here
+    // Adds the images decoded by importer, with one palette rebuild. Returns the number of assets imported
+    int importBatch(BatchImporter& importer);
+
+    // Bulk tile edits over the maps using op.tileset, or every map. One undo step for all the maps, and
+    // one change per map. Returns the number of maps changed
+    int applyTileOps(const QList<TileOp>& ops);
+    int applyTileOp(const TileOp& op);
+
+    // Call before a stroke on map, saves its cells as one undo step
+    void pushMapUndo(Map* map);
+    // Undo or redo the newest step on the current map. A bulk edit waits for newer steps on its other maps
     void undo();
     void redo();
+
+signals:
+    void assetChanged(AssetChange change);
 };
 
 #endif // EDITORINTERFACE_H
@@ -2,6 +2,7 @@
 #include "mainwindow.h"
 
 #include <config.h>
+#include <filecache.h>
 #include <ui/utils.h>
 #include <ui/misc/newnamedialog.h>
 
@@ -22,6 +23,8 @@ CodeEditor::CodeEditor(QWidget *parent)
 {
     ui->setupUi(this);
     code_view = nullptr;
+    generated_view = nullptr;
+    symbol_indexer = nullptr;
     source_files_view = nullptr;
     watcher = nullptr;
     source_file = nullptr;
@@ -40,6 +43,8 @@ void CodeEditor::setup(MainWindow* window)
 
     main_window = window;
     code_view = ui->code_view;
+    generated_view = ui->generated_view;
+    generated_view->hide();
     font = QFont(code_view->fontInfo().family(), code_view->fontInfo().pixelSize());
 
     // setup filesystem model
@@ -61,6 +66,11 @@ void CodeEditor::setup(MainWindow* window)
     QObject::connect(source_files_view, SIGNAL(doubleClicked(QModelIndex)), this, SLOT(on_sourceFileLoad(QModelIndex)));
     QObject::connect(code_view, SIGNAL(textChanged()), this, SLOT(on_sourceFileTextChange()));
     QObject::connect(this, SIGNAL(changeText(QString)), code_view, SLOT(setText(QString)));
+    QObject::connect(code_view, SIGNAL(definitionRequested(QString)), this, SLOT(on_gotoDefinition(QString)));
+
+    // setup symbol index
+    symbol_indexer = new SymbolIndexer(this);
+    QObject::connect(symbol_indexer, SIGNAL(updated()), this, SLOT(on_symbolsIndexed()));
 
     // setup filesystem watcher
     watcher = new QFileSystemWatcher();
@@ -84,6 +94,13 @@ void CodeEditor::reset()
         code_view->setPlainText("");
     }
 
+    if(generated_view)
+    {
+        generated_view->close();
+        generated_view->hide();
+        code_view->show();
+    }
+
     if(source_files_view)
     {
         source_files_view->setModel(filesystem_model);
@@ -108,6 +125,7 @@ void CodeEditor::reload()
     }
 
     game->reloadSourceFiles();
+    symbol_indexer->reindex(game);
 
     QString code_path = game->getAbsoluteCodePath();
     filesystem_model->setRootPath(code_path);
@@ -165,6 +183,7 @@ void CodeEditor::zoomIn()
     font.setPointSize(font.pointSize()+1);
     source_files_view->setFont(font);
     code_view->setFont(font);
+    generated_view->setFont(font);
 }
 
 void CodeEditor::zoomOut()
@@ -172,6 +191,7 @@ void CodeEditor::zoomOut()
     font.setPointSize(font.pointSize()-1);
     source_files_view->setFont(font);
     code_view->setFont(font);
+    generated_view->setFont(font);
 }
 
 void CodeEditor::makeUniqueFilePath(QString& file_path)
@@ -229,17 +249,39 @@ void CodeEditor::changeSourceFile(const QString &file_path)
         if(watcher)
         {
             watcher->addPath(absolute_file_path);
-        }
 
-        emit changeText(source_file->getContent());
+            // Rewritten on save, keeps the asset ids in the symbol index current
+            const QString assets_header = game->getAbsoluteGeneratedPath() + GBA_ASSETS_HEADER;
+            if(QFileInfo::exists(assets_header))
+            {
+                watcher->addPath(assets_header);
+            }
+        }
 
-        if(code_view && code_view->verticalScrollBar())
+        if(Game::isGeneratedFile(absolute_file_path))
         {
-            QScrollBar* vertical_scroll = code_view->verticalScrollBar();
-            if(file_path_to_line_scroll.contains(absolute_file_path))
+            // Generated assets are never edited, view them without loading them into the text document
+            source_file = nullptr;
+            code_view->hide();
+            generated_view->open(absolute_file_path);
+            generated_view->show();
+        }
+        else
+        {
+            generated_view->close();
+            generated_view->hide();
+            code_view->show();
+
+            emit changeText(source_file->getContent());
+
+            if(code_view && code_view->verticalScrollBar())
             {
-                int scroll = file_path_to_line_scroll[absolute_file_path];
-                vertical_scroll->setValue(scroll);
+                QScrollBar* vertical_scroll = code_view->verticalScrollBar();
+                if(file_path_to_line_scroll.contains(absolute_file_path))
+                {
+                    int scroll = file_path_to_line_scroll[absolute_file_path];
+                    vertical_scroll->setValue(scroll);
+                }
             }
         }
     }
@@ -400,7 +442,9 @@ void CodeEditor::on_sourceFileTextChange()
 {
     if(source_file)
     {
-        source_file->setContent(code_view->toPlainText());
+        const QString content = code_view->toPlainText();
+        edit_context->getJournal().appendSourceEdit(source_file->getFilePath(), source_file->getContent(), content);
+        source_file->setContent(content);
     }
 }
 
@@ -456,8 +500,16 @@ void CodeEditor::on_sourceFileOpenContextMenu(const QPoint &pos)
 
 void CodeEditor::on_fileChange(QString path)
 {
+    FileCache::get().invalidate(path);
+    symbol_indexer->updateFile(path);
+
     QFileInfo info(path);
-    if(info.exists() && source_file->getFilePath() == info.absoluteFilePath())
+    if(info.fileName() == GBA_ASSETS_HEADER && info.absoluteFilePath() != loaded_path)
+    {
+        return;
+    }
+
+    if(info.exists() && info.absoluteFilePath() == loaded_path)
     {
         changeSourceFile(path);
     }
@@ -471,3 +523,32 @@ void CodeEditor::on_directoryChange(QString /*path*/)
 {
     reload();
 }
+
+void CodeEditor::on_symbolsIndexed()
+{
+    const SymbolTable& table = symbol_indexer->getTable();
+    code_view->setUserTypes(table.type_names);
+    code_view->setCompletions(table.names);
+}
+
+void CodeEditor::on_gotoDefinition(QString name)
+{
+    const CSymbol* symbol = symbol_indexer->getTable().find(name);
+    if(symbol == nullptr)
+    {
+        return;
+    }
+
+    if(symbol->file_path != loaded_path)
+    {
+        changeSourceFile(symbol->file_path);
+    }
+    if(generated_view->isHidden())
+    {
+        code_view->gotoPosition(symbol->line, symbol->column);
+    }
+    else
+    {
+        generated_view->gotoLine(symbol->line);
+    }
+}
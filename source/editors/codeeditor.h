@@ -4,6 +4,8 @@
 #include <gba/game.h>
 #include <editorinterface.h>
 #include <ui/gba/codeview.h>
+#include <ui/gba/generatedview.h>
+#include <compiler/symbolindex.h>
 
 #include <QTextBrowser>
 #include <QTreeView>
@@ -21,6 +23,8 @@ private:
     QFileSystemModel* filesystem_model;
     QTreeView* source_files_view;
     CodeView* code_view;
+    GeneratedFileView* generated_view;   // replaces code_view for generated files
+    SymbolIndexer* symbol_indexer;
     SourceFile* source_file; // current source_file being edited
     QString selected_path;
     QString loaded_path;
@@ -71,6 +75,9 @@ public slots:
     void on_fileChange(QString dir);
     void on_directoryChange(QString dir);
 
+    void on_symbolsIndexed();
+    void on_gotoDefinition(QString name);
+
 };
 
 
@@ -27,6 +27,8 @@ MapEditor::MapEditor(QWidget *parent)
     skip_sync = 0;
     grid_color = QColor(255,0,0);
     editname_dialog = nullptr;
+    stroke_undo_pending = false;
+    names_dirty = true;
 }
 
 MapEditor::~MapEditor()
@@ -45,14 +47,15 @@ void MapEditor::setup(MainWindow* window)
     // set map ui
     map_model = new MapModel(this);
     ui->map_view->setModel(map_model);
-    QObject::connect(ui->map_view, SIGNAL(clicked(int,int)), this, SLOT(on_mapTileClick(int,int)));
+    QObject::connect(ui->map_view, SIGNAL(strokeStarted()), this, SLOT(on_mapStrokeStarted()));
+    QObject::connect(ui->map_view, SIGNAL(stroked(QVector<QPoint>)), this, SLOT(on_mapStroke(QVector<QPoint>)));
 
     map_names_model = new QStringListModel(this);
     ui->map_names->setModel(map_names_model);
     QObject::connect(ui->map_names, SIGNAL(currentTextChanged(QString)), this, SLOT(on_mapSelectionChange(QString)));
 
 
-    map_modes_model = new QStringListModel(this);
+    map_modes_model = new QStringListModel(Map::getMapModeNames(), this);
     ui->map_modes->setModel(map_modes_model);
     QObject::connect(ui->map_modes, SIGNAL(currentTextChanged(QString)), this, SLOT(on_mapModeChange(QString)));
 
@@ -92,6 +95,8 @@ void MapEditor::setup(MainWindow* window)
     QObject::connect(ui->bg1_button, SIGNAL(clicked(bool)), this, SLOT(on_clickBackground1(bool)));
     QObject::connect(ui->bg2_button, SIGNAL(clicked(bool)), this, SLOT(on_clickBackground2(bool)));
     QObject::connect(ui->bg3_button, SIGNAL(clicked(bool)), this, SLOT(on_clickBackground3(bool)));
+
+    QObject::connect(edit_context, SIGNAL(assetChanged(AssetChange)), this, SLOT(on_assetChanged(AssetChange)));
 }
 
 void MapEditor::reset()
@@ -106,6 +111,7 @@ void MapEditor::reset()
     }
 
     skip_sync = 0;
+    names_dirty = true;
     edit_context->reset();
 
     tileset_model->setTileset(nullptr);
@@ -189,20 +195,27 @@ void MapEditor::syncLabels()
     }
 
     // Sync map mode combo
-    QStringList map_modes = Map::getMapModeNames();
-    map_modes_model->setStringList(map_modes);
     ui->map_modes->setCurrentText(Map::getMapModeName(mode));
 
-    // Sync background combos
-    QStringList tileset_names;
-    edit_context->getTilesetNames(tileset_names);
+    // Name lists only change when an asset is added, removed or renamed
+    if(names_dirty)
+    {
+        QStringList tileset_names;
+        edit_context->getTilesetNames(tileset_names);
+        tileset_names_model->setStringList(tileset_names);
+
+        QStringList map_names;
+        edit_context->getMapNames(map_names);
+        map_names_model->setStringList(map_names);
+
+        names_dirty = false;
+    }
 
     // Sync tileset names combos
     int bg_index = getSelectedBackground();
     QString current_tileset_name = edit_context->getTilesetName(bg_index);
     QString background_size_label = getBackgroundSizeName(bg_index);
 
-    tileset_names_model->setStringList(tileset_names);
     ui->tileset_names->setCurrentText(current_tileset_name);
 
     // Sync background size combos
@@ -228,9 +241,6 @@ void MapEditor::syncLabels()
     ui->background_sizes->setCurrentText(background_size_label);
 
     // Sync map combos
-    QStringList map_names;
-    edit_context->getMapNames(map_names);
-    map_names_model->setStringList(map_names);
     ui->map_names->setCurrentText(map->getName());
 
     // Sync tile size
@@ -284,27 +294,76 @@ void MapEditor::refreshMapView()
     ui->map_view->redraw();
 }
 
-void MapEditor::on_mapTileClick(int tilex, int tiley)
+void MapEditor::on_mapStrokeStarted()
+{
+    stroke_undo_pending = true;
+}
+
+void MapEditor::on_mapStroke(QVector<QPoint> cells)
 {
-    handleMapTileClick(tilex, tiley);
+    Map* map = edit_context->getMap();
+    if(map == nullptr)
+        return;
+
+    // The whole stroke is undone at once
+    if(stroke_undo_pending)
+    {
+        edit_context->pushMapUndo(map);
+        stroke_undo_pending = false;
+    }
 
     int selection_size = getSelectionSize();
-    for(int dy = 0; dy < selection_size; ++dy)
+    const int rect_size = selection_size * GBA_TILE_SIZE;
+
+    QRect dirty_rect;
+    foreach(const QPoint& cell, cells)
     {
-        for(int dx = 0; dx < selection_size; ++dx)
+        handleMapTileClick(cell.x(), cell.y());
+
+        for(int dy = 0; dy < selection_size; ++dy)
         {
-            map_model->markTileDirty(tilex * selection_size + dx, tiley * selection_size + dy);
+            for(int dx = 0; dx < selection_size; ++dx)
+            {
+                map_model->markTileDirty(cell.x() * selection_size + dx, cell.y() * selection_size + dy);
+            }
         }
+        dirty_rect |= QRect(cell.x() * rect_size, cell.y() * rect_size, rect_size, rect_size);
     }
 
-    ui->map_view->invalidate();
+    edit_context->notifyChanged(map, AssetChangeType::TILES, dirty_rect);
     main_window->markDirty();
 }
 
+void MapEditor::on_assetChanged(AssetChange change)
+{
+    if(change.type == AssetChangeType::ADDED || change.type == AssetChangeType::REMOVED || change.type == AssetChangeType::RENAMED)
+    {
+        names_dirty = true;
+        return;
+    }
+
+    // Only redraw the views showing the changed asset
+    Map* map = edit_context->getMap();
+    if(map && change.asset == map)
+    {
+        if(change.type == AssetChangeType::TILES && !change.rect.isEmpty())
+        {
+            ui->map_view->invalidateRect(change.rect);
+        }
+        else
+        {
+            ui->map_view->invalidate();
+        }
+    }
+    else if(map && change.asset == getSelectedTileset())
+    {
+        ui->tileset_view->invalidate();
+    }
+}
+
 void MapEditor::on_tilesetTileClick(int tilex, int tiley)
 {
     handleTilesetTileClick(tilex, tiley);
-    ui->tileset_view->invalidateOverlay();
     refreshTilesetView();
 }
 
@@ -348,7 +407,7 @@ void MapEditor::on_mapEditName(bool /*enabled*/)
     if(editname_dialog->accepted())
     {
         QString name = editname_dialog->getName();
-        map->setName(name);
+        edit_context->renameAsset(map, name);
         selectMap(map);
 
         syncLabels();
@@ -397,11 +456,18 @@ void MapEditor::on_mapModeChange(QString name)
     if(skip_sync) return;
 
     //TODO: Gracefully handle null maps
-    if(Map* map = edit_context->getMap())
+    Map* map = edit_context->getMap();
+    if(map)
     {
         map->setMode(Map::getMapMode(name));
     }
     syncUI();
+
+    // After syncUI, which resizes the backgrounds the new mode does not support
+    if(map)
+    {
+        edit_context->notifyChanged(map, AssetChangeType::PROPERTIES);
+    }
     main_window->markDirty();
 }
 
@@ -452,7 +518,6 @@ void MapEditor::on_backgroundResize(QString value)
     if(size_flag != -1)
         resizeSelectedBackground(size_flag);
 
-    ui->map_view->invalidate();
     syncUI();
 }
 
@@ -461,10 +526,12 @@ void MapEditor::on_backgroundPriorityChange(int priority)
     if(Map* map = edit_context->getMap())
     {
         int bg_index = getSelectedBackground();
-        map->setPriority(bg_index, priority);
+        if(map->getPriority(bg_index) != priority)
+        {
+            map->setPriority(bg_index, priority);
+            edit_context->notifyChanged(map, AssetChangeType::FIELDS);
+        }
     }
-
-    ui->map_view->invalidate();
     // redraw
     syncUI();
 }
@@ -503,8 +570,6 @@ void MapEditor::on_tilesetSelectionChange(QString name)
     Tileset* tileset = edit_context->findTileset(name);
     setSelectedTileset(tileset);
 
-    ui->map_view->invalidate();
-
     syncUI();
     main_window->markDirty();
 }
@@ -525,8 +590,7 @@ void MapEditor::on_tilesetEditName(bool /*enabled*/)
     if(editname_dialog->accepted())
     {
         QString name = editname_dialog->getName();
-        tileset->setName(name);
-        setSelectedTileset(tileset);
+        edit_context->renameAsset(tileset, name);
 
         syncLabels();
         main_window->markDirty();
@@ -846,9 +910,11 @@ int MapEditor::getSelectedBackground() const
 
 void MapEditor::resizeSelectedBackground(int size_flag)
 {
-    if(Map* map = edit_context->getMap())
+    Map* map = edit_context->getMap();
+    if(map && map->getBackgroundSize(selected_bg_index) != size_flag)
     {
         map->resizeBackground(selected_bg_index, size_flag);
+        edit_context->notifyChanged(map, AssetChangeType::PROPERTIES);
     }
 }
 
@@ -881,10 +947,7 @@ Tileset* MapEditor::getSelectedTileset() const
 
 void MapEditor::setSelectedTileset(Tileset* tileset)
 {
-    if(Map* map = edit_context->getMap())
-    {
-        map->setTileset(selected_bg_index, tileset);
-    }
+    edit_context->setTileset(selected_bg_index, tileset);
 }
 
 bool MapEditor::removeSelectedTileset()
@@ -41,6 +41,9 @@ private:
 
     QRadioButton* background_buttons[GBA_BG_COUNT];
 
+    bool stroke_undo_pending; // the current stroke has not saved its undo step yet
+    bool names_dirty;         // an asset was added, removed or renamed since the name combos were filled
+
 private:
     // Begin Selection
     struct TilesetSelection
@@ -132,7 +135,9 @@ public slots:
     void on_clickBackground3(bool /**/);
 
     // Asset callbacks
-    void on_mapTileClick(int tilex, int tiley);
+    void on_assetChanged(AssetChange change);
+    void on_mapStrokeStarted();
+    void on_mapStroke(QVector<QPoint> cells);
     void on_tilesetTileClick(int tilex, int tiley);
 
     // Widget callbacks
@@ -17,6 +17,7 @@ SpriteEditor::SpriteEditor(QWidget *parent)
     frame_time_msec = 1000;
     skip_sync = true;
     preview_enabled = true;
+    names_dirty = true;
 
     ui->setupUi(this);
 
@@ -89,11 +90,13 @@ void SpriteEditor::setup(MainWindow* window)
     QObject::connect(ui->anim_hflip_checkbox, SIGNAL(toggled(bool)), this, SLOT(on_animationHFlipChange(bool)));
     QObject::connect(ui->anim_vflip_checkbox, SIGNAL(toggled(bool)), this, SLOT(on_animationVFlipChange(bool)));
 
+    QObject::connect(edit_context, SIGNAL(assetChanged(AssetChange)), this, SLOT(on_assetChanged(AssetChange)));
 }
 
 void SpriteEditor::reset()
 {
     skip_sync = false;
+    names_dirty = true;
     sprite_model->setSpriteSheet(nullptr);
     spritesheet_model->setSpriteSheet(nullptr);
 }
@@ -123,11 +126,21 @@ void SpriteEditor::syncLabels()
     SpriteSheet* spritesheet = edit_context->getSpriteSheet();
     SpriteAnim* spriteanim = edit_context->getSpriteAnim();
 
-    // Sync Sprite sheet combo
-    QStringList spritesheet_names;
-    edit_context->getSpriteSheetNames(spritesheet_names);
-    spritesheet_names_model->setStringList(spritesheet_names);
+    // Name lists only change when an asset is added, removed or renamed
+    if(names_dirty)
+    {
+        QStringList spritesheet_names;
+        edit_context->getSpriteSheetNames(spritesheet_names);
+        spritesheet_names_model->setStringList(spritesheet_names);
+
+        QStringList spriteanim_names;
+        edit_context->getSpriteAnimNames(spriteanim_names);
+        spriteanim_names_model->setStringList(spriteanim_names);
 
+        names_dirty = false;
+    }
+
+    // Sync Sprite sheet combo
     if(spritesheet)
     {
         spritesheet_names_combo->setCurrentText(spritesheet->getName());
@@ -138,10 +151,6 @@ void SpriteEditor::syncLabels()
     }
 
     // Sync Anim combo
-    QStringList spriteanim_names;
-    edit_context->getSpriteAnimNames(spriteanim_names);
-    spriteanim_names_model->setStringList(spriteanim_names);
-
     if(spriteanim)
     {
         spriteanim_names_combo->setCurrentText(spriteanim->getName());
@@ -184,6 +193,23 @@ void SpriteEditor::syncLabels()
     ui->anim_vflip_checkbox->setChecked(vflip);
 }
 
+void SpriteEditor::on_assetChanged(AssetChange change)
+{
+    if(change.type == AssetChangeType::ADDED || change.type == AssetChangeType::REMOVED || change.type == AssetChangeType::RENAMED)
+    {
+        names_dirty = true;
+        return;
+    }
+
+    // Both views draw the current spritesheet
+    SpriteSheet* spritesheet = edit_context->getSpriteSheet();
+    if(spritesheet && change.asset == spritesheet)
+    {
+        sprite_view->invalidate();
+        spritesheet_view->invalidate();
+    }
+}
+
 void SpriteEditor::syncViews()
 {
     sprite_view->invalidate();
@@ -291,7 +317,7 @@ void SpriteEditor::on_spriteSheetEditName(bool /*enabled*/)
     if(editname_dialog->accepted())
     {
         QString name = editname_dialog->getName();
-        spritesheet->setName(name);
+        edit_context->renameAsset(spritesheet, name);
         edit_context->setSpriteSheet(spritesheet);
 
         syncLabels();
@@ -382,7 +408,7 @@ void SpriteEditor::on_spriteAnimEditName(bool /*enabled*/)
     if(editname_dialog->accepted())
     {
         QString name = editname_dialog->getName();
-        spriteanim->setName(name);
+        edit_context->renameAsset(spriteanim, name);
         edit_context->setSpriteAnim(spriteanim);
 
         syncLabels();
@@ -441,15 +467,17 @@ void SpriteEditor::on_animationFramesChanged(QString anim_frames_text)
 
 void SpriteEditor::on_animationFramesCommit()
 {
-   syncUI();
+    edit_context->notifyChanged(edit_context->getSpriteAnim(), AssetChangeType::PROPERTIES);
+    syncUI();
 }
 
 void SpriteEditor::on_animationFrameSpeedChange(int value)
 {
     SpriteAnim* spriteanim = edit_context->getSpriteAnim();
-    if(spriteanim)
+    if(spriteanim && spriteanim->getFrameDuration() != value)
     {
         spriteanim->setFrameDuration(value);
+        edit_context->notifyChanged(spriteanim, AssetChangeType::FIELDS);
     }
 
     syncUI();
@@ -458,9 +486,10 @@ void SpriteEditor::on_animationFrameSpeedChange(int value)
 void SpriteEditor::on_animationHFlipChange(bool value)
 {
     SpriteAnim* spriteanim = edit_context->getSpriteAnim();
-    if(spriteanim)
+    if(spriteanim && spriteanim->getHFlip() != value)
     {
         spriteanim->setHFlip(value);
+        edit_context->notifyChanged(spriteanim, AssetChangeType::FIELDS);
     }
 
     syncUI();
@@ -470,9 +499,10 @@ void SpriteEditor::on_animationHFlipChange(bool value)
 void SpriteEditor::on_animationVFlipChange(bool value)
 {
     SpriteAnim* spriteanim = edit_context->getSpriteAnim();
-    if(spriteanim)
+    if(spriteanim && spriteanim->getVFlip() != value)
     {
         spriteanim->setVFlip(value);
+        edit_context->notifyChanged(spriteanim, AssetChangeType::FIELDS);
     }
 
     syncUI();
@@ -24,6 +24,7 @@ private:
     bool preview_enabled;
 
     bool skip_sync;
+    bool names_dirty; // an asset was added, removed or renamed since the name combos were filled
 
     SpriteModel* sprite_model;
     SpriteView* sprite_view;
@@ -60,6 +61,7 @@ private:
 
 protected slots:
     void on_toggleGrid();
+    void on_assetChanged(AssetChange change);
 
     void on_spriteSheetAdd(bool enabled);
     void on_spriteSheetRemove(bool enabled);
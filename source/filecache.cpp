@@ -0,0 +1,245 @@
+#include "filecache.h"
+#include "msglog.h"
+
+#include <QCryptographicHash>
+#include <QDateTime>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QMutexLocker>
+
+static QString cacheKey(const QString& file_path)
+{
+    return QDir::cleanPath(QFileInfo(file_path).absoluteFilePath());
+}
+
+static bool statFile(const QString& file_path, qint64& out_modified_msec, qint64& out_size)
+{
+    QFileInfo info(file_path);
+    if(!info.isFile())
+    {
+        return false;
+    }
+    out_modified_msec = info.lastModified().toMSecsSinceEpoch();
+    out_size = info.size();
+    return true;
+}
+
+static QByteArray hashData(const QByteArray& data)
+{
+    return QCryptographicHash::hash(data, QCryptographicHash::Sha1);
+}
+
+FileCache& FileCache::get()
+{
+    static FileCache file_cache;
+    return file_cache;
+}
+
+FileCache::FileCache()
+    : cached_bytes(0)
+    , use_counter(0)
+{
+}
+
+bool FileCache::read(const QString& file_path, QByteArray& out_data)
+{
+    QMutexLocker lock(&mutex);
+    return readLocked(cacheKey(file_path), out_data);
+}
+
+QByteArray FileCache::hash(const QString& file_path)
+{
+    QMutexLocker lock(&mutex);
+    const QString key = cacheKey(file_path);
+
+    qint64 modified_msec, size;
+    if(statFile(key, modified_msec, size))
+    {
+        FileCacheEntry* entry = findValid(key, modified_msec, size);
+        if(entry && entry->hash.size())
+        {
+            return entry->hash;
+        }
+    }
+
+    QByteArray data;
+    if(!readLocked(key, data))
+    {
+        return QByteArray();
+    }
+    FileCacheEntry& entry = entries[key];
+    entry.hash = hashData(data);
+    return entry.hash;
+}
+
+bool FileCache::write(const QString& file_path, const QByteArray& data)
+{
+    QMutexLocker lock(&mutex);
+    const QString key = cacheKey(file_path);
+
+    qint64 modified_msec, size;
+    if(statFile(key, modified_msec, size) && size == data.size())
+    {
+        FileCacheEntry* entry = findValid(key, modified_msec, size);
+        if(entry && entry->has_data)
+        {
+            if(entry->data == data)
+            {
+                entry->last_used = ++use_counter;
+                return true;
+            }
+        }
+        else if(entry && entry->hash.size())
+        {
+            if(entry->hash == hashData(data))
+            {
+                entry->last_used = ++use_counter;
+                return true;
+            }
+        }
+        else
+        {
+            QByteArray current;
+            if(readLocked(key, current) && current == data)
+            {
+                return true;
+            }
+        }
+    }
+
+    QFile file(key);
+    if(!file.open(QIODevice::WriteOnly | QIODevice::Truncate) || file.write(data) != data.size())
+    {
+        remove(key);
+        return false;
+    }
+    file.close();
+
+    if(statFile(key, modified_msec, size))
+    {
+        store(key, modified_msec, size, data);
+    }
+    else
+    {
+        remove(key);
+    }
+    return true;
+}
+
+void FileCache::invalidate(const QString& file_path)
+{
+    QMutexLocker lock(&mutex);
+    remove(cacheKey(file_path));
+}
+
+void FileCache::clear()
+{
+    QMutexLocker lock(&mutex);
+    entries.clear();
+    cached_bytes = 0;
+}
+
+FileCacheEntry* FileCache::findValid(const QString& key, qint64 modified_msec, qint64 size)
+{
+    QHash<QString, FileCacheEntry>::iterator it = entries.find(key);
+    if(it != entries.end() && it->modified_msec == modified_msec && it->size == size
+    && it->checked_msec - it->modified_msec >= FILE_CACHE_MTIME_WINDOW_MSEC)
+    {
+        return &it.value();
+    }
+    return nullptr;
+}
+
+bool FileCache::readLocked(const QString& key, QByteArray& out_data)
+{
+    qint64 modified_msec, size;
+    if(!statFile(key, modified_msec, size))
+    {
+        remove(key);
+        return false;
+    }
+
+    FileCacheEntry* entry = findValid(key, modified_msec, size);
+    if(entry && entry->has_data)
+    {
+        entry->last_used = ++use_counter;
+        out_data = entry->data;
+        return true;
+    }
+
+    QFile file(key);
+    if(!file.open(QIODevice::ReadOnly))
+    {
+        msgError("FileCache") << "Failed to open " << key << "\n";
+        remove(key);
+        return false;
+    }
+    out_data = file.readAll();
+    if(file.error() != QFileDevice::NoError)
+    {
+        msgError("FileCache") << "Failed to read " << key << "\n";
+        out_data = QByteArray();
+        remove(key);
+        return false;
+    }
+    store(key, modified_msec, size, out_data);
+    return true;
+}
+
+void FileCache::store(const QString& key, qint64 modified_msec, qint64 size, const QByteArray& data)
+{
+    remove(key);
+
+    FileCacheEntry entry;
+    entry.modified_msec = modified_msec;
+    entry.size = size;
+    entry.checked_msec = QDateTime::currentMSecsSinceEpoch();
+    entry.data = data;
+    entry.has_data = true;
+    entry.last_used = ++use_counter;
+    entries.insert(key, entry);
+
+    cached_bytes += data.size();
+    evict();
+}
+
+void FileCache::remove(const QString& key)
+{
+    QHash<QString, FileCacheEntry>::iterator it = entries.find(key);
+    if(it != entries.end())
+    {
+        if(it->has_data)
+        {
+            cached_bytes -= it->data.size();
+        }
+        entries.erase(it);
+    }
+}
+
+void FileCache::evict()
+{
+    while(cached_bytes > FILE_CACHE_MAX_BYTES)
+    {
+        QHash<QString, FileCacheEntry>::iterator oldest = entries.end();
+        for(QHash<QString, FileCacheEntry>::iterator it = entries.begin(); it != entries.end(); ++it)
+        {
+            if(it->has_data && (oldest == entries.end() || it->last_used < oldest->last_used))
+            {
+                oldest = it;
+            }
+        }
+        if(oldest == entries.end())
+        {
+            return;
+        }
+
+        if(oldest->hash.isEmpty())
+        {
+            oldest->hash = hashData(oldest->data);
+        }
+        cached_bytes -= oldest->data.size();
+        oldest->data = QByteArray();
+        oldest->has_data = false;
+    }
+}
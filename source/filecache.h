@@ -0,0 +1,62 @@
+#ifndef FILECACHE_H
+#define FILECACHE_H
+
+#include <QByteArray>
+#include <QHash>
+#include <QMutex>
+#include <QString>
+
+// Contents above this are dropped least recently used first. Their hash is kept for change checks
+#define FILE_CACHE_MAX_BYTES (32 * 1024 * 1024)
+// Coarsest modified time resolution of the file systems in use (FAT). A file checked within this of its
+// modified time can still change without its modified time changing, so it is read and compared again
+#define FILE_CACHE_MTIME_WINDOW_MSEC 2000
+
+struct FileCacheEntry
+{
+    qint64 modified_msec;
+    qint64 size;
+    qint64 checked_msec;    // when the contents were last read or written
+    QByteArray data;
+    bool has_data;
+    QByteArray hash;    // sha1 of the contents, computed on demand
+    quint64 last_used;
+};
+
+// Project file contents shared by the source files, the game loader and the asset export.
+// An entry is valid while the file keeps its modified time and size, and was checked long enough after it was
+// modified that a same size edit would have changed the modified time. So a file is read at most about once per version.
+// Thread safe, the ROM compiler exports from its own thread
+class FileCache
+{
+public:
+    static FileCache& get();
+
+    // False if the file does not exist or can not be read. Read errors are reported to the log
+    bool read(const QString& file_path, QByteArray& out_data);
+    // Empty if the file can not be read
+    QByteArray hash(const QString& file_path);
+
+    // Only writes when the contents differ, compared against the cached contents or hash when valid,
+    // or else against the contents read from disk
+    bool write(const QString& file_path, const QByteArray& data);
+
+    void invalidate(const QString& file_path);
+    void clear();
+
+private:
+    QMutex mutex;
+    QHash<QString, FileCacheEntry> entries;
+    qint64 cached_bytes;
+    quint64 use_counter;
+
+    FileCache();
+
+    FileCacheEntry* findValid(const QString& key, qint64 modified_msec, qint64 size);
+    bool readLocked(const QString& key, QByteArray& out_data);
+    void store(const QString& key, qint64 modified_msec, qint64 size, const QByteArray& data);
+    void remove(const QString& key);
+    void evict();
+};
+
+#endif // FILECACHE_H
@@ -2,6 +2,7 @@
 #define ASSET_H
 
 #include <QMap>
+#include <QDataStream>
 #include <QList>
 #include <QString>
 #include <QTextStream>
@@ -19,6 +20,10 @@ public:
     virtual void writeStructData(QList<QString>& /*out_field_data*/) {}
     virtual void readStructData(QList<QString>& /*in_field_data*/) {}
 
+    // Same fields as the struct data, for the edit journal
+    virtual void writeStructBinary(QDataStream& /*out*/) {}
+    virtual bool readStructBinary(QDataStream& /*in*/) { return true; }
+
     virtual void writeDecls(QTextStream& /*out*/) {}
     virtual bool readDecls(QTextStream& /*in*/) { return true; }
 
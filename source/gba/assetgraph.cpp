@@ -0,0 +1,161 @@
+#include "assetgraph.h"
+#include "game.h"
+
+AssetChange::AssetChange()
+    : type(AssetChangeType::PROPERTIES)
+    , asset(nullptr)
+    , source(nullptr)
+{
+}
+
+AssetChange::AssetChange(AssetChangeType type, Asset* asset, const QRect& rect)
+    : type(type)
+    , asset(asset)
+    , source(asset)
+    , rect(rect)
+{
+}
+
+// Sprite animations store frame indices only, they do not name a spritesheet yet
+static QSet<Asset*> findDependencies(Asset* asset, Game* game)
+{
+    QSet<Asset*> found;
+    if(Map* map = dynamic_cast<Map*>(asset))
+    {
+        for(int bg_index = 0; bg_index < GBA_BG_COUNT; ++bg_index)
+        {
+            if(Tileset* tileset = map->getTileset(bg_index))
+            {
+                found.insert(tileset);
+            }
+        }
+    }
+    else if(TiledImage* image = dynamic_cast<TiledImage*>(asset))
+    {
+        if(game && image->usesSharedPalette())
+        {
+            if(Palette* palette = game->findAsset<Palette>(image->getSharedPalette()))
+            {
+                found.insert(palette);
+            }
+        }
+    }
+    return found;
+}
+
+void AssetGraph::clear()
+{
+    dependencies.clear();
+    dependents.clear();
+}
+
+void AssetGraph::rebuild(Game* game)
+{
+    clear();
+    if(game == nullptr)
+    {
+        return;
+    }
+
+    foreach(const QList<Asset*>& assets, game->asset_table)
+    {
+        foreach(Asset* asset, assets)
+        {
+            updateAsset(asset, game);
+        }
+    }
+}
+
+void AssetGraph::updateAsset(Asset* asset, Game* game)
+{
+    if(asset == nullptr)
+    {
+        return;
+    }
+
+    foreach(Asset* dependency, dependencies.value(asset))
+    {
+        dependents[dependency].remove(asset);
+    }
+
+    const QSet<Asset*> found = findDependencies(asset, game);
+    dependencies[asset] = found;
+    foreach(Asset* dependency, found)
+    {
+        dependents[dependency].insert(asset);
+    }
+}
+
+void AssetGraph::removeAsset(Asset* asset)
+{
+    foreach(Asset* dependency, dependencies.value(asset))
+    {
+        dependents[dependency].remove(asset);
+    }
+    foreach(Asset* dependent, dependents.value(asset))
+    {
+        dependencies[dependent].remove(asset);
+    }
+    dependencies.remove(asset);
+    dependents.remove(asset);
+}
+
+QList<Asset*> AssetGraph::getDependencies(Asset* asset) const
+{
+    return dependencies.value(asset).toList();
+}
+
+QList<Asset*> AssetGraph::getDependents(Asset* asset) const
+{
+    return dependents.value(asset).toList();
+}
+
+QList<Asset*> AssetGraph::collectDependents(Asset* asset) const
+{
+    QList<Asset*> found;
+    QSet<Asset*> visited;
+    visited.insert(asset);
+
+    QList<Asset*> queue;
+    queue.append(asset);
+    for(int i = 0; i < queue.size(); ++i)
+    {
+        foreach(Asset* dependent, dependents.value(queue[i]))
+        {
+            if(!visited.contains(dependent))
+            {
+                visited.insert(dependent);
+                found.append(dependent);
+                queue.append(dependent);
+            }
+        }
+    }
+    return found;
+}
+
+QList<AssetChange> AssetGraph::propagate(const AssetChange& change) const
+{
+    QList<AssetChange> changes;
+    changes.append(change);
+
+    // A new asset has no dependents yet
+    if(change.type == AssetChangeType::ADDED)
+    {
+        return changes;
+    }
+
+    foreach(Asset* dependent, collectDependents(change.asset))
+    {
+        AssetChange dependent_change = change;
+        dependent_change.asset = dependent;
+        // The rect is in the edited asset's space, a dependent redraws whatever uses it
+        dependent_change.rect = QRect();
+        // Only the edited asset is removed or renamed, its dependents just show different content
+        if(change.type == AssetChangeType::REMOVED || change.type == AssetChangeType::RENAMED)
+        {
+            dependent_change.type = AssetChangeType::PROPERTIES;
+        }
+        changes.append(dependent_change);
+    }
+    return changes;
+}
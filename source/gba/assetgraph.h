@@ -0,0 +1,66 @@
+#ifndef ASSETGRAPH_H
+#define ASSETGRAPH_H
+
+#include "asset.h"
+
+#include <QHash>
+#include <QList>
+#include <QMetaType>
+#include <QRect>
+#include <QSet>
+#include <QString>
+
+class Game;
+
+enum class AssetChangeType
+{
+    ADDED,
+    REMOVED,    // sent before the asset is deleted
+    RENAMED,
+    PIXELS,     // image pixels, rect in image pixels
+    PALETTE,
+    TILES,      // map tiles, rect in map pixels
+    PROPERTIES, // size, mode, frames and other fields
+    FIELDS      // only values of the struct fields, like a priority or a flip
+};
+
+struct AssetChange
+{
+    AssetChangeType type;
+    Asset* asset;       // asset to update
+    Asset* source;      // asset that was edited. Differs from asset when the change reached it through a dependency
+    QRect rect;         // empty if the whole asset changed
+    QString old_name;   // RENAMED only
+
+    AssetChange();
+    AssetChange(AssetChangeType type, Asset* asset, const QRect& rect = QRect());
+};
+Q_DECLARE_METATYPE(AssetChange)
+
+// Which assets reference which: map -> tileset -> shared palette, spritesheet -> shared palette.
+// Reverse edges let an edit reach only the assets that depend on it
+class AssetGraph
+{
+private:
+    QHash<Asset*, QSet<Asset*>> dependencies;   // asset -> assets it references
+    QHash<Asset*, QSet<Asset*>> dependents;     // asset -> assets referencing it
+
+public:
+    void clear();
+    void rebuild(Game* game);
+
+    // Recomputes the references of one asset after it was added or edited
+    void updateAsset(Asset* asset, Game* game);
+    void removeAsset(Asset* asset);
+
+    QList<Asset*> getDependencies(Asset* asset) const;
+    QList<Asset*> getDependents(Asset* asset) const;
+    // Direct and indirect dependents, each once, nearest first
+    QList<Asset*> collectDependents(Asset* asset) const;
+
+    // The edited asset's change followed by one change for each of its dependents. Dependents of a removed
+    // or renamed asset get PROPERTIES, they only need to update
+    QList<AssetChange> propagate(const AssetChange& change) const;
+};
+
+#endif // ASSETGRAPH_H
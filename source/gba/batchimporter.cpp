@@ -0,0 +1,191 @@
+#include "batchimporter.h"
+#include "game.h"
+#include <msglog.h>
+#include <trace.h>
+
+#include <QFileInfo>
+#include <QImage>
+#include <QRunnable>
+#include <QThreadPool>
+
+BatchImportItem::BatchImportItem()
+    : type(BatchImportType::TILESET)
+    , decoded(false)
+    , width(0)
+    , height(0)
+{
+}
+
+// Decodes one image into its item, which no other job touches
+class BatchImportJob : public QRunnable
+{
+public:
+    BatchImporter* importer;
+    BatchImportItem* item;
+
+    void run() override
+    {
+        if(importer->cancelled.load())
+        {
+            return;
+        }
+
+        TRACE_SCOPE("import", "BatchImportJob::run");
+        QImage image;
+        if(!image.load(item->file_path))
+        {
+            item->error = "could not be read";
+        }
+        else
+        {
+            TiledImage indexed;
+            if(indexed.loadFromImage(image))
+            {
+                item->width = indexed.getWidth();
+                item->height = indexed.getHeight();
+                item->pixels = indexed.getPixels();
+                item->palette = indexed.getPalette();
+                item->decoded = true;
+            }
+            else
+            {
+                item->error = "is empty";
+            }
+        }
+        importer->done_count.ref();
+    }
+};
+
+BatchImporter::BatchImporter()
+{
+}
+
+void BatchImporter::addFile(const QString& file_path, BatchImportType type)
+{
+    BatchImportItem item;
+    item.file_path = file_path;
+    item.type = type;
+    items.append(item);
+}
+
+void BatchImporter::clear()
+{
+    items.clear();
+}
+
+const QList<BatchImportItem>& BatchImporter::getItems() const
+{
+    return items;
+}
+
+bool BatchImporter::decode(ProgressCallback progress)
+{
+    TRACE_SCOPE("import", "BatchImporter::decode");
+    cancelled.store(0);
+    done_count.store(0);
+
+    QThreadPool pool;
+    for(int i = 0; i < items.size(); ++i)
+    {
+        BatchImportItem& item = items[i];
+        item.decoded = false;
+        item.error.clear();
+
+        BatchImportJob* job = new BatchImportJob();
+        job->importer = this;
+        job->item = &item;
+        pool.start(job);
+    }
+
+    while(!pool.waitForDone(BATCH_IMPORT_PROGRESS_MSEC))
+    {
+        if(progress && !progress(done_count.load(), items.size()))
+        {
+            // Queued jobs are dropped, running ones finish their image
+            cancelled.store(1);
+            pool.clear();
+            pool.waitForDone();
+            for(int i = 0; i < items.size(); ++i)
+            {
+                items[i].decoded = false;
+                items[i].pixels.clear();
+                items[i].palette.clear();
+            }
+            return false;
+        }
+    }
+
+    if(progress)
+    {
+        progress(items.size(), items.size());
+    }
+    return true;
+}
+
+void BatchImporter::apply(Game* game, QList<Asset*>& out_added, QList<Asset*>& out_updated)
+{
+    TRACE_SCOPE("import", "BatchImporter::apply");
+    for(int i = 0; i < items.size(); ++i)
+    {
+        BatchImportItem& item = items[i];
+        if(!item.decoded)
+        {
+            if(!item.error.isEmpty())
+            {
+                msgWarn("Import") << "Skipped " << item.file_path << ", it " << item.error << "\n";
+            }
+            continue;
+        }
+
+        if(item.width * item.height > GBA_TILESET_MAX_SIZE)
+        {
+            msgWarn("Import") << item.file_path << " is larger than " << GBA_TILESET_WIDTH << "x" << GBA_TILESET_HEIGHT
+                              << ", the limit of " << GBA_TILE_MAX << " 8x8 tiles\n";
+        }
+
+        const QString name = QFileInfo(item.file_path).baseName();
+        TiledImage* image = nullptr;
+        bool added = false;
+        if(item.type == BatchImportType::TILESET)
+        {
+            image = game->findAsset<Tileset>(name);
+            if(image == nullptr)
+            {
+                image = game->addAsset<Tileset>();
+                added = true;
+            }
+        }
+        else
+        {
+            image = game->findAsset<SpriteSheet>(name);
+            if(image == nullptr)
+            {
+                image = game->addAsset<SpriteSheet>();
+                added = true;
+            }
+        }
+
+        if(added)
+        {
+            image->setName(name);
+            out_added.append(image);
+        }
+        else
+        {
+            out_updated.append(image);
+        }
+        image->setIndexedImage(item.width, item.height, item.pixels, item.palette);
+
+        // The asset holds them now
+        item.pixels.clear();
+        item.palette.clear();
+        item.decoded = false;
+    }
+
+    if(out_added.size() || out_updated.size())
+    {
+        game->rebuildPalettes();
+        game->markDirty();
+        msgLog("Import") << "Imported " << out_added.size() << " new and " << out_updated.size() << " existing images\n";
+    }
+}
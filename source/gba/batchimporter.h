@@ -0,0 +1,68 @@
+#ifndef BATCHIMPORTER_H
+#define BATCHIMPORTER_H
+
+#include <QAtomicInt>
+#include <QList>
+#include <QRgb>
+#include <QString>
+#include <QVector>
+#include <functional>
+
+// How often the progress callback is called while the images decode
+#define BATCH_IMPORT_PROGRESS_MSEC 50
+
+class Game;
+class Asset;
+class TiledImage;
+
+enum class BatchImportType
+{
+    TILESET,
+    SPRITESHEET
+};
+
+// One image file and its indexed pixels once decoded
+struct BatchImportItem
+{
+    QString file_path;
+    BatchImportType type;
+
+    bool decoded;
+    QString error;
+    int width, height;
+    QVector<unsigned char> pixels;
+    QVector<QRgb> palette;
+
+    BatchImportItem();
+};
+
+// Imports many images as tilesets or spritesheets. The images are decoded and indexed on a thread pool,
+// then added to the game with one palette rebuild for the whole batch, instead of one per image.
+// An image named like an existing asset of its type replaces that asset's pixels
+class BatchImporter
+{
+public:
+    // Called on the importing thread with the images decoded so far. Return false to cancel
+    typedef std::function<bool(int done, int total)> ProgressCallback;
+
+    BatchImporter();
+
+    void addFile(const QString& file_path, BatchImportType type);
+    void clear();
+    const QList<BatchImportItem>& getItems() const;
+
+    // Blocks until every image is decoded. Returns false if cancelled, nothing is decoded then
+    bool decode(ProgressCallback progress = nullptr);
+
+    // Adds or updates the decoded assets and rebuilds the palettes. Main thread only
+    void apply(Game* game, QList<Asset*>& out_added, QList<Asset*>& out_updated);
+
+private:
+    QList<BatchImportItem> items;
+    QAtomicInt cancelled;
+    QAtomicInt done_count;
+
+    friend class BatchImportJob;
+};
+
+#endif // BATCHIMPORTER_H
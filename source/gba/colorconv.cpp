@@ -0,0 +1,328 @@
+#include "colorconv.h"
+#include "gba.h"
+
+#include <QAtomicInt>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define COLORCONV_SSE2 1
+#include <emmintrin.h>
+#else
+#define COLORCONV_SSE2 0
+#endif
+
+// AVX2 is built with a function target, so only where the compiler supports that and runtime cpu checks
+#if COLORCONV_SSE2 && (defined(__GNUC__) || defined(__clang__))
+#define COLORCONV_AVX2 1
+#include <immintrin.h>
+#define COLORCONV_TARGET_AVX2 __attribute__((target("avx2")))
+#else
+#define COLORCONV_AVX2 0
+#endif
+
+// 5 bit channel to 8 bit, (v * 255) / 31 as GBA2RGBA computes it
+static const unsigned char color_expand_table[32] =
+{
+    0,   8,   16,  24,  32,  41,  49,  57,
+    65,  74,  82,  90,  98,  106, 115, 123,
+    131, 139, 148, 156, 164, 172, 180, 189,
+    197, 205, 213, 222, 230, 238, 246, 255
+};
+
+// The vector kernels expand with (v * 1053) >> 7, equal to the table for every 5 bit v
+#define COLOR_EXPAND_MUL 1053
+#define COLOR_EXPAND_SHIFT 7
+
+QRgb GBA2RGBA(unsigned short gba_color)
+{
+    if(gba_color == GBA_COLORKEY_15BIT)
+        return GBA_COLORKEY_RGB;
+
+    int r = (gba_color & 0x1f);
+    int g = ((gba_color >> 5) & 0x1f);
+    int b = ((gba_color >> 10) & 0x1f);
+    //remap from 15 to 16 bit
+    r = ((float)r)/0x1f * 0xff;
+    g = ((float)g)/0x1f * 0xff;
+    b = ((float)b)/0x1f * 0xff;
+    return (0xffu << 24) | ((r & 0xffu) << 16) | ((g & 0xffu) << 8) | (b & 0xffu);
+}
+
+unsigned short RGBA2GBA(QRgb rgba)
+{
+    int a = ((rgba >> 24) & 0xff);
+    if(a == 0)
+        return GBA_COLORKEY_15BIT;
+
+    int r = ((rgba >> 16) & 0xff);
+    int g = ((rgba >> 8) & 0xff);
+    int b = (rgba & 0xff);
+    return (((r >> 3) & 0x1f) | (((g >> 3) & 0x1f) << 5) | (((b >> 3) & 0x1f) << 10));
+}
+
+static void convertGBAToRGBAScalar(const unsigned short* in_colors, QRgb* out_colors, int begin, int count, bool use_colorkey)
+{
+    for(int i = begin; i < count; ++i)
+    {
+        const unsigned short color = in_colors[i];
+        if(use_colorkey && color == GBA_COLORKEY_15BIT)
+        {
+            out_colors[i] = GBA_COLORKEY_RGB;
+            continue;
+        }
+        out_colors[i] = 0xff000000u
+                      | (QRgb(color_expand_table[color & 0x1f]) << 16)
+                      | (QRgb(color_expand_table[(color >> 5) & 0x1f]) << 8)
+                      | QRgb(color_expand_table[(color >> 10) & 0x1f]);
+    }
+}
+
+static void convertRGBAToGBAScalar(const QRgb* in_colors, unsigned short* out_colors, int begin, int count, bool use_colorkey)
+{
+    for(int i = begin; i < count; ++i)
+    {
+        const QRgb color = in_colors[i];
+        if(use_colorkey && (color >> 24) == 0)
+        {
+            out_colors[i] = GBA_COLORKEY_15BIT;
+            continue;
+        }
+        out_colors[i] = ((color >> 19) & 0x1f) | (((color >> 11) & 0x1f) << 5) | (((color >> 3) & 0x1f) << 10);
+    }
+}
+
+#if COLORCONV_SSE2
+static void convertGBAToRGBASSE2(const unsigned short* in_colors, QRgb* out_colors, int count, bool use_colorkey)
+{
+    const __m128i mask = _mm_set1_epi16(0x1f);
+    const __m128i expand = _mm_set1_epi16(COLOR_EXPAND_MUL);
+    const __m128i alpha = _mm_set1_epi16(short(0xff00));
+    const __m128i colorkey_15bit = _mm_set1_epi16(GBA_COLORKEY_15BIT);
+    const __m128i colorkey_rgb = _mm_set1_epi32(int(GBA_COLORKEY_RGB));
+
+    int i = 0;
+    for(; i + 8 <= count; i += 8)
+    {
+        const __m128i color = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in_colors + i));
+        const __m128i r = _mm_srli_epi16(_mm_mullo_epi16(_mm_and_si128(color, mask), expand), COLOR_EXPAND_SHIFT);
+        const __m128i g = _mm_srli_epi16(_mm_mullo_epi16(_mm_and_si128(_mm_srli_epi16(color, 5), mask), expand), COLOR_EXPAND_SHIFT);
+        const __m128i b = _mm_srli_epi16(_mm_mullo_epi16(_mm_and_si128(_mm_srli_epi16(color, 10), mask), expand), COLOR_EXPAND_SHIFT);
+
+        // Low halves hold g and b, high halves alpha and r
+        const __m128i gb = _mm_or_si128(_mm_slli_epi16(g, 8), b);
+        const __m128i ar = _mm_or_si128(alpha, r);
+        __m128i lo = _mm_unpacklo_epi16(gb, ar);
+        __m128i hi = _mm_unpackhi_epi16(gb, ar);
+
+        if(use_colorkey)
+        {
+            const __m128i is_key = _mm_cmpeq_epi16(color, colorkey_15bit);
+            const __m128i is_key_lo = _mm_unpacklo_epi16(is_key, is_key);
+            const __m128i is_key_hi = _mm_unpackhi_epi16(is_key, is_key);
+            lo = _mm_or_si128(_mm_andnot_si128(is_key_lo, lo), _mm_and_si128(is_key_lo, colorkey_rgb));
+            hi = _mm_or_si128(_mm_andnot_si128(is_key_hi, hi), _mm_and_si128(is_key_hi, colorkey_rgb));
+        }
+
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out_colors + i), lo);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out_colors + i + 4), hi);
+    }
+    convertGBAToRGBAScalar(in_colors, out_colors, i, count, use_colorkey);
+}
+
+// 4 colors to 15 bit values in 32 bit lanes
+static inline __m128i toGBASSE2(__m128i color, bool use_colorkey)
+{
+    const __m128i mask = _mm_set1_epi32(0x1f);
+    const __m128i r = _mm_and_si128(_mm_srli_epi32(color, 19), mask);
+    const __m128i g = _mm_and_si128(_mm_srli_epi32(color, 11), mask);
+    const __m128i b = _mm_and_si128(_mm_srli_epi32(color, 3), mask);
+    __m128i gba = _mm_or_si128(r, _mm_or_si128(_mm_slli_epi32(g, 5), _mm_slli_epi32(b, 10)));
+    if(use_colorkey)
+    {
+        const __m128i is_key = _mm_cmpeq_epi32(_mm_srli_epi32(color, 24), _mm_setzero_si128());
+        gba = _mm_or_si128(_mm_andnot_si128(is_key, gba), _mm_and_si128(is_key, _mm_set1_epi32(GBA_COLORKEY_15BIT)));
+    }
+    return gba;
+}
+
+static void convertRGBAToGBASSE2(const QRgb* in_colors, unsigned short* out_colors, int count, bool use_colorkey)
+{
+    int i = 0;
+    for(; i + 8 <= count; i += 8)
+    {
+        const __m128i lo = toGBASSE2(_mm_loadu_si128(reinterpret_cast<const __m128i*>(in_colors + i)), use_colorkey);
+        const __m128i hi = toGBASSE2(_mm_loadu_si128(reinterpret_cast<const __m128i*>(in_colors + i + 4)), use_colorkey);
+        // 15 bit values, the signed saturation never applies
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out_colors + i), _mm_packs_epi32(lo, hi));
+    }
+    convertRGBAToGBAScalar(in_colors, out_colors, i, count, use_colorkey);
+}
+#endif
+
+#if COLORCONV_AVX2
+COLORCONV_TARGET_AVX2
+static void convertGBAToRGBAAVX2(const unsigned short* in_colors, QRgb* out_colors, int count, bool use_colorkey)
+{
+    const __m256i mask = _mm256_set1_epi16(0x1f);
+    const __m256i expand = _mm256_set1_epi16(COLOR_EXPAND_MUL);
+    const __m256i alpha = _mm256_set1_epi16(short(0xff00));
+    const __m256i colorkey_15bit = _mm256_set1_epi16(GBA_COLORKEY_15BIT);
+    const __m256i colorkey_rgb = _mm256_set1_epi32(int(GBA_COLORKEY_RGB));
+
+    int i = 0;
+    for(; i + 16 <= count; i += 16)
+    {
+        const __m256i color = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(in_colors + i));
+        const __m256i r = _mm256_srli_epi16(_mm256_mullo_epi16(_mm256_and_si256(color, mask), expand), COLOR_EXPAND_SHIFT);
+        const __m256i g = _mm256_srli_epi16(_mm256_mullo_epi16(_mm256_and_si256(_mm256_srli_epi16(color, 5), mask), expand), COLOR_EXPAND_SHIFT);
+        const __m256i b = _mm256_srli_epi16(_mm256_mullo_epi16(_mm256_and_si256(_mm256_srli_epi16(color, 10), mask), expand), COLOR_EXPAND_SHIFT);
+
+        const __m256i gb = _mm256_or_si256(_mm256_slli_epi16(g, 8), b);
+        const __m256i ar = _mm256_or_si256(alpha, r);
+        // Unpacks work within 128 bit lanes, lo holds colors 0-3 and 8-11, hi 4-7 and 12-15
+        __m256i lo = _mm256_unpacklo_epi16(gb, ar);
+        __m256i hi = _mm256_unpackhi_epi16(gb, ar);
+
+        if(use_colorkey)
+        {
+            const __m256i is_key = _mm256_cmpeq_epi16(color, colorkey_15bit);
+            const __m256i is_key_lo = _mm256_unpacklo_epi16(is_key, is_key);
+            const __m256i is_key_hi = _mm256_unpackhi_epi16(is_key, is_key);
+            lo = _mm256_blendv_epi8(lo, colorkey_rgb, is_key_lo);
+            hi = _mm256_blendv_epi8(hi, colorkey_rgb, is_key_hi);
+        }
+
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(out_colors + i), _mm256_permute2x128_si256(lo, hi, 0x20));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(out_colors + i + 8), _mm256_permute2x128_si256(lo, hi, 0x31));
+    }
+    convertGBAToRGBAScalar(in_colors, out_colors, i, count, use_colorkey);
+}
+
+COLORCONV_TARGET_AVX2
+static void convertRGBAToGBAAVX2(const QRgb* in_colors, unsigned short* out_colors, int count, bool use_colorkey)
+{
+    const __m256i mask = _mm256_set1_epi32(0x1f);
+    const __m256i colorkey_15bit = _mm256_set1_epi32(GBA_COLORKEY_15BIT);
+
+    int i = 0;
+    for(; i + 16 <= count; i += 16)
+    {
+        __m256i halves[2];
+        for(int half = 0; half < 2; ++half)
+        {
+            const __m256i color = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(in_colors + i + half * 8));
+            const __m256i r = _mm256_and_si256(_mm256_srli_epi32(color, 19), mask);
+            const __m256i g = _mm256_and_si256(_mm256_srli_epi32(color, 11), mask);
+            const __m256i b = _mm256_and_si256(_mm256_srli_epi32(color, 3), mask);
+            __m256i gba = _mm256_or_si256(r, _mm256_or_si256(_mm256_slli_epi32(g, 5), _mm256_slli_epi32(b, 10)));
+            if(use_colorkey)
+            {
+                const __m256i is_key = _mm256_cmpeq_epi32(_mm256_srli_epi32(color, 24), _mm256_setzero_si256());
+                gba = _mm256_blendv_epi8(gba, colorkey_15bit, is_key);
+            }
+            halves[half] = gba;
+        }
+        // The pack interleaves the lanes, the permute puts the 4 blocks of 4 back in order
+        const __m256i packed = _mm256_packs_epi32(halves[0], halves[1]);
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(out_colors + i), _mm256_permute4x64_epi64(packed, 0xD8));
+    }
+    convertRGBAToGBAScalar(in_colors, out_colors, i, count, use_colorkey);
+}
+#endif
+
+bool isColorConvKernelSupported(ColorConvKernel kernel)
+{
+    switch(kernel)
+    {
+    case ColorConvKernel::SCALAR:
+        return true;
+    case ColorConvKernel::SSE2:
+        return COLORCONV_SSE2;
+    case ColorConvKernel::AVX2:
+#if COLORCONV_AVX2
+        return __builtin_cpu_supports("avx2");
+#else
+        return false;
+#endif
+    }
+    return false;
+}
+
+static ColorConvKernel detectColorConvKernel()
+{
+    if(isColorConvKernelSupported(ColorConvKernel::AVX2))
+        return ColorConvKernel::AVX2;
+    if(isColorConvKernelSupported(ColorConvKernel::SSE2))
+        return ColorConvKernel::SSE2;
+    return ColorConvKernel::SCALAR;
+}
+
+static QAtomicInt color_conv_kernel(static_cast<int>(detectColorConvKernel()));
+
+bool setColorConvKernel(ColorConvKernel kernel)
+{
+    if(!isColorConvKernelSupported(kernel))
+    {
+        return false;
+    }
+    color_conv_kernel.store(int(kernel));
+    return true;
+}
+
+ColorConvKernel getColorConvKernel()
+{
+    return ColorConvKernel(color_conv_kernel.load());
+}
+
+const char* getColorConvKernelName(ColorConvKernel kernel)
+{
+    switch(kernel)
+    {
+    case ColorConvKernel::SCALAR:
+        return "scalar";
+    case ColorConvKernel::SSE2:
+        return "sse2";
+    case ColorConvKernel::AVX2:
+        return "avx2";
+    }
+    return "";
+}
+
+void convertGBAToRGBA(const unsigned short* in_colors, QRgb* out_colors, int count, bool use_colorkey)
+{
+    switch(getColorConvKernel())
+    {
+#if COLORCONV_AVX2
+    case ColorConvKernel::AVX2:
+        convertGBAToRGBAAVX2(in_colors, out_colors, count, use_colorkey);
+        return;
+#endif
+#if COLORCONV_SSE2
+    case ColorConvKernel::SSE2:
+        convertGBAToRGBASSE2(in_colors, out_colors, count, use_colorkey);
+        return;
+#endif
+    default:
+        convertGBAToRGBAScalar(in_colors, out_colors, 0, count, use_colorkey);
+        return;
+    }
+}
+
+void convertRGBAToGBA(const QRgb* in_colors, unsigned short* out_colors, int count, bool use_colorkey)
+{
+    switch(getColorConvKernel())
+    {
+#if COLORCONV_AVX2
+    case ColorConvKernel::AVX2:
+        convertRGBAToGBAAVX2(in_colors, out_colors, count, use_colorkey);
+        return;
+#endif
+#if COLORCONV_SSE2
+    case ColorConvKernel::SSE2:
+        convertRGBAToGBASSE2(in_colors, out_colors, count, use_colorkey);
+        return;
+#endif
+    default:
+        convertRGBAToGBAScalar(in_colors, out_colors, 0, count, use_colorkey);
+        return;
+    }
+}
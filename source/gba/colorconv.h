@@ -0,0 +1,30 @@
+#ifndef COLORCONV_H
+#define COLORCONV_H
+
+#include <QRgb>
+
+// Implementations of the batch conversions. Picked at startup for the CPU, AVX2 then SSE2 then SCALAR
+enum class ColorConvKernel
+{
+    SCALAR,
+    SSE2,
+    AVX2
+};
+
+// 15 bit GBA color to 32 bit RGB format
+QRgb GBA2RGBA(unsigned short gba_color);
+// 32 bit RGB format to 15 bit GBA color
+unsigned short RGBA2GBA(QRgb rgba);
+
+// Same results as GBA2RGBA and RGBA2GBA over count colors. With use_colorkey GBA_COLORKEY_15BIT and
+// transparent colors map to each other, otherwise every color converts as an opaque one
+void convertGBAToRGBA(const unsigned short* in_colors, QRgb* out_colors, int count, bool use_colorkey = true);
+void convertRGBAToGBA(const QRgb* in_colors, unsigned short* out_colors, int count, bool use_colorkey = true);
+
+bool isColorConvKernelSupported(ColorConvKernel kernel);
+// For benchmarks and checks. Returns false and keeps the current kernel if this CPU can not run it
+bool setColorConvKernel(ColorConvKernel kernel);
+ColorConvKernel getColorConvKernel();
+const char* getColorConvKernelName(ColorConvKernel kernel);
+
+#endif // COLORCONV_H
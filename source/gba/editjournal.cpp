@@ -0,0 +1,670 @@
+#include "editjournal.h"
+#include "game.h"
+#include <msglog.h>
+#include <trace.h>
+
+#include <QDataStream>
+#include <QFile>
+#include <QFileInfo>
+#include <QMutex>
+#include <QThread>
+#include <QWaitCondition>
+
+#ifdef Q_OS_WIN
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+
+#define EDIT_JOURNAL_HEADER_SIZE (8 + 4)       // magic, version
+#define EDIT_JOURNAL_RECORD_HEADER_SIZE (4 + 2) // size, checksum
+// A record larger than this is treated as a torn write
+#define EDIT_JOURNAL_MAX_RECORD_SIZE (256 * 1024 * 1024)
+
+#define TILE_HFLIP 0x01
+#define TILE_VFLIP 0x02
+
+static void syncFile(QFile& file)
+{
+    file.flush();
+#ifdef Q_OS_WIN
+    _commit(file.handle());
+#else
+    fsync(file.handle());
+#endif
+}
+
+// Owns the file once open returns. Appends only touch the pending buffer under the mutex
+class EditJournalWriter : public QThread
+{
+public:
+    QFile file;
+    QMutex mutex;
+    QWaitCondition wake;
+    QWaitCondition written;
+
+    QByteArray pending;
+    bool truncate_pending;
+    bool flush_pending;
+    bool stopping;
+    quint64 append_count;   // appends and truncates requested
+    quint64 write_count;    // appends and truncates on disk
+
+    EditJournalWriter()
+        : truncate_pending(false)
+        , flush_pending(false)
+        , stopping(false)
+        , append_count(0)
+        , write_count(0)
+    {
+    }
+
+protected:
+    void run() override
+    {
+        mutex.lock();
+        while(true)
+        {
+            while(pending.isEmpty() && !truncate_pending && !stopping)
+            {
+                wake.wait(&mutex);
+            }
+
+            // Let a stroke's appends gather into one write
+            if(!stopping && !flush_pending)
+            {
+                wake.wait(&mutex, EDIT_JOURNAL_BATCH_MSEC);
+            }
+
+            QByteArray batch;
+            batch.swap(pending);
+            const bool truncate = truncate_pending;
+            const quint64 batch_count = append_count;
+            truncate_pending = false;
+            flush_pending = false;
+            mutex.unlock();
+
+            if(truncate || batch.size())
+            {
+                TRACE_SCOPE("journal", "EditJournal::write");
+                if(truncate)
+                {
+                    file.resize(EDIT_JOURNAL_HEADER_SIZE);
+                }
+                file.seek(file.size());
+                if(batch.size() && file.write(batch) != batch.size())
+                {
+                    msgError("Journal") << "Failed to write " << file.fileName() << "\n";
+                }
+                syncFile(file);
+            }
+
+            mutex.lock();
+            write_count = batch_count;
+            written.wakeAll();
+            if(stopping && pending.isEmpty() && !truncate_pending)
+            {
+                break;
+            }
+        }
+        mutex.unlock();
+    }
+};
+
+static QByteArray encodeHeader()
+{
+    QByteArray header;
+    QDataStream out(&header, QIODevice::WriteOnly);
+    out.writeRawData(EDIT_JOURNAL_MAGIC, 8);
+    out << quint32(EDIT_JOURNAL_VERSION);
+    return header;
+}
+
+// Reads the records up to the first torn or corrupt one, returns the offset after the last valid record
+static qint64 readRecords(const QByteArray& data, QList<QByteArray>& out_records)
+{
+    if(data.size() < EDIT_JOURNAL_HEADER_SIZE || !data.startsWith(encodeHeader()))
+    {
+        return 0;
+    }
+
+    qint64 offset = EDIT_JOURNAL_HEADER_SIZE;
+    QDataStream in(data);
+    in.skipRawData(EDIT_JOURNAL_HEADER_SIZE);
+    while(data.size() - offset >= EDIT_JOURNAL_RECORD_HEADER_SIZE)
+    {
+        quint32 size = 0;
+        quint16 checksum = 0;
+        in >> size >> checksum;
+        if(size == 0 || size > EDIT_JOURNAL_MAX_RECORD_SIZE || data.size() - offset - EDIT_JOURNAL_RECORD_HEADER_SIZE < size)
+        {
+            break;
+        }
+
+        const QByteArray record = data.mid(int(offset + EDIT_JOURNAL_RECORD_HEADER_SIZE), int(size));
+        if(qChecksum(record.constData(), uint(record.size())) != checksum)
+        {
+            break;
+        }
+        in.skipRawData(int(size));
+        out_records.append(record);
+        offset += EDIT_JOURNAL_RECORD_HEADER_SIZE + size;
+    }
+    return offset;
+}
+
+static Asset* findAsset(Game* game, const QString& type_name, const QString& name)
+{
+    foreach(Asset* asset, game->asset_table.value(type_name))
+    {
+        if(asset->getName() == name)
+        {
+            return asset;
+        }
+    }
+    return nullptr;
+}
+
+static Asset* addAsset(Game* game, const QString& type_name)
+{
+    if(type_name == Map().getTypeName())
+        return game->addAsset<Map>();
+    if(type_name == Tileset().getTypeName())
+        return game->addAsset<Tileset>();
+    if(type_name == SpriteSheet().getTypeName())
+        return game->addAsset<SpriteSheet>();
+    if(type_name == SpriteAnim().getTypeName())
+        return game->addAsset<SpriteAnim>();
+    if(type_name == Palette().getTypeName())
+        return game->addAsset<Palette>();
+    return nullptr;
+}
+
+EditJournal::EditJournal()
+    : writer(nullptr)
+{
+}
+
+EditJournal::~EditJournal()
+{
+    close();
+}
+
+bool EditJournal::open(const QString& new_file_path)
+{
+    close();
+    file_path = new_file_path;
+
+    QByteArray data;
+    QFile previous(file_path);
+    if(previous.open(QIODevice::ReadOnly))
+    {
+        data = previous.readAll();
+        previous.close();
+    }
+    const qint64 valid_size = readRecords(data, recovered);
+
+    writer = new EditJournalWriter();
+    writer->file.setFileName(file_path);
+    if(!writer->file.open(QIODevice::ReadWrite))
+    {
+        msgWarn("Journal") << "Failed to open " << file_path << ", edits are not journaled\n";
+        delete writer;
+        writer = nullptr;
+        return false;
+    }
+
+    // Drop a torn tail so new records follow the last valid one
+    if(valid_size == 0)
+    {
+        writer->file.resize(0);
+        writer->file.write(encodeHeader());
+    }
+    else
+    {
+        writer->file.resize(valid_size);
+    }
+    syncFile(writer->file);
+
+    writer->start(QThread::LowPriority);
+    return true;
+}
+
+void EditJournal::close()
+{
+    recovered.clear();
+    if(writer == nullptr)
+    {
+        return;
+    }
+
+    writer->mutex.lock();
+    writer->stopping = true;
+    writer->wake.wakeAll();
+    writer->mutex.unlock();
+    writer->wait();
+
+    writer->file.close();
+    QFile::remove(file_path);
+    delete writer;
+    writer = nullptr;
+}
+
+bool EditJournal::isOpen() const
+{
+    return writer != nullptr;
+}
+
+QString EditJournal::getFilePath() const
+{
+    return file_path;
+}
+
+int EditJournal::getRecoveredCount() const
+{
+    return recovered.size();
+}
+
+int EditJournal::replay(Game* game)
+{
+    TRACE_SCOPE("journal", "EditJournal::replay");
+    int applied = 0;
+    foreach(const QByteArray& record, recovered)
+    {
+        if(applyRecord(game, record))
+        {
+            ++applied;
+        }
+    }
+    recovered.clear();
+
+    // Relink the references by name, as after a load
+    foreach(const QList<Asset*>& assets, game->asset_table)
+    {
+        foreach(Asset* asset, assets)
+        {
+            asset->gatherAssets(game);
+        }
+    }
+    game->markDirty();
+    return applied;
+}
+
+void EditJournal::markSaved()
+{
+    recovered.clear();
+    if(writer == nullptr)
+    {
+        return;
+    }
+
+    QMutexLocker lock(&writer->mutex);
+    writer->pending.clear();
+    writer->truncate_pending = true;
+    ++writer->append_count;
+    writer->wake.wakeAll();
+}
+
+void EditJournal::flush()
+{
+    if(writer == nullptr)
+    {
+        return;
+    }
+
+    QMutexLocker lock(&writer->mutex);
+    const quint64 target = writer->append_count;
+    writer->flush_pending = true;
+    writer->wake.wakeAll();
+    while(writer->write_count < target)
+    {
+        writer->written.wait(&writer->mutex);
+    }
+}
+
+void EditJournal::append(EditJournalOp op, const QByteArray& payload)
+{
+    if(writer == nullptr)
+    {
+        return;
+    }
+
+    QByteArray record;
+    record.reserve(payload.size() + 1);
+    record.append(char(op));
+    record.append(payload);
+
+    QByteArray bytes;
+    bytes.reserve(EDIT_JOURNAL_RECORD_HEADER_SIZE + record.size());
+    QDataStream out(&bytes, QIODevice::WriteOnly);
+    out << quint32(record.size()) << quint16(qChecksum(record.constData(), uint(record.size())));
+    out.writeRawData(record.constData(), record.size());
+
+    QMutexLocker lock(&writer->mutex);
+    const bool was_empty = writer->pending.isEmpty();
+    writer->pending.append(bytes);
+    ++writer->append_count;
+    // The writer is already gathering a batch otherwise
+    if(was_empty)
+    {
+        writer->wake.wakeAll();
+    }
+}
+
+void EditJournal::appendTiles(Map* map, const QRect& rect)
+{
+    if(writer == nullptr || map == nullptr || rect.isEmpty())
+    {
+        return;
+    }
+
+    QByteArray payload;
+    QDataStream out(&payload, QIODevice::WriteOnly);
+    out << map->getName();
+
+    for(int bg_index = 0; bg_index < GBA_BG_COUNT; ++bg_index)
+    {
+        Background* background = map->getBackground(bg_index);
+        if(background == nullptr || background->tiles.isEmpty())
+        {
+            continue;
+        }
+
+        const int bg_width = Map::getBackgroundSizeFlagWidth(background->size_flag);
+        if(bg_width <= 0)
+        {
+            continue;
+        }
+        const int bg_height = background->tiles.size() / bg_width;
+        const QRect tile_rect = QRect(QPoint(rect.left() / GBA_TILE_SIZE, rect.top() / GBA_TILE_SIZE),
+                                      QPoint(rect.right() / GBA_TILE_SIZE, rect.bottom() / GBA_TILE_SIZE))
+                                .intersected(QRect(0, 0, bg_width, bg_height));
+        if(tile_rect.isEmpty())
+        {
+            continue;
+        }
+
+        out << qint32(bg_index) << tile_rect;
+        for(int y = tile_rect.top(); y <= tile_rect.bottom(); ++y)
+        {
+            for(int x = tile_rect.left(); x <= tile_rect.right(); ++x)
+            {
+                const int index = y * bg_width + x;
+                quint8 flags = 0;
+                if(background->hflips[index])
+                    flags |= TILE_HFLIP;
+                if(background->vflips[index])
+                    flags |= TILE_VFLIP;
+                out << qint32(background->tiles[index]) << flags;
+            }
+        }
+    }
+    append(EditJournalOp::TILES, payload);
+}
+
+void EditJournal::appendAsset(Asset* asset)
+{
+    if(writer == nullptr || asset == nullptr)
+    {
+        return;
+    }
+
+    QString text;
+    QTextStream text_out(&text);
+    asset->serialize(text_out);
+    text_out.flush();
+
+    QByteArray payload;
+    QDataStream out(&payload, QIODevice::WriteOnly);
+    out << asset->getTypeName() << asset->getName() << text;
+    append(EditJournalOp::ASSET, payload);
+}
+
+void EditJournal::appendRemove(Asset* asset)
+{
+    if(writer == nullptr || asset == nullptr)
+    {
+        return;
+    }
+
+    QByteArray payload;
+    QDataStream out(&payload, QIODevice::WriteOnly);
+    out << asset->getTypeName() << asset->getName();
+    append(EditJournalOp::REMOVE, payload);
+}
+
+void EditJournal::appendRename(Asset* asset, const QString& old_name)
+{
+    if(writer == nullptr || asset == nullptr)
+    {
+        return;
+    }
+
+    QByteArray payload;
+    QDataStream out(&payload, QIODevice::WriteOnly);
+    out << asset->getTypeName() << old_name << asset->getName();
+    append(EditJournalOp::RENAME, payload);
+}
+
+void EditJournal::appendFields(Asset* asset)
+{
+    if(writer == nullptr || asset == nullptr)
+    {
+        return;
+    }
+
+    QByteArray fields;
+    QDataStream fields_out(&fields, QIODevice::WriteOnly);
+    asset->writeStructBinary(fields_out);
+
+    QByteArray payload;
+    QDataStream out(&payload, QIODevice::WriteOnly);
+    out << asset->getTypeName() << asset->getName() << fields;
+    append(EditJournalOp::FIELDS, payload);
+}
+
+void EditJournal::appendSourceEdit(const QString& source_file_path, const QString& old_text, const QString& new_text)
+{
+    if(writer == nullptr)
+    {
+        return;
+    }
+
+    // Only the changed span between the common prefix and suffix is stored
+    const int common_size = qMin(old_text.size(), new_text.size());
+    int prefix = 0;
+    while(prefix < common_size && old_text[prefix] == new_text[prefix])
+    {
+        ++prefix;
+    }
+    int suffix = 0;
+    while(suffix < common_size - prefix && old_text[old_text.size() - 1 - suffix] == new_text[new_text.size() - 1 - suffix])
+    {
+        ++suffix;
+    }
+
+    const int removed = old_text.size() - prefix - suffix;
+    const QString inserted = new_text.mid(prefix, new_text.size() - prefix - suffix);
+    if(removed == 0 && inserted.isEmpty())
+    {
+        return;
+    }
+
+    QByteArray payload;
+    QDataStream out(&payload, QIODevice::WriteOnly);
+    out << source_file_path << qint32(prefix) << qint32(removed) << inserted;
+    append(EditJournalOp::SOURCE, payload);
+}
+
+bool EditJournal::applyRecord(Game* game, const QByteArray& record)
+{
+    if(record.isEmpty())
+    {
+        return false;
+    }
+
+    const EditJournalOp op = EditJournalOp(quint8(record[0]));
+    QDataStream in(record);
+    in.skipRawData(1);
+
+    switch(op)
+    {
+    case EditJournalOp::TILES:
+    {
+        QString map_name;
+        in >> map_name;
+        Map* map = game->findAsset<Map>(map_name);
+        if(map == nullptr)
+        {
+            return false;
+        }
+
+        while(!in.atEnd() && in.status() == QDataStream::Ok)
+        {
+            qint32 bg_index;
+            QRect tile_rect;
+            in >> bg_index >> tile_rect;
+            Background* background = map->getBackground(bg_index);
+            if(background == nullptr)
+            {
+                return false;
+            }
+
+            // Written for another background size, or corrupt. Out of range cells would wrap into other rows
+            const int bg_width = Map::getBackgroundSizeFlagWidth(background->size_flag);
+            if(bg_width <= 0 || !QRect(0, 0, bg_width, background->tiles.size() / bg_width).contains(tile_rect))
+            {
+                return false;
+            }
+            for(int y = tile_rect.top(); y <= tile_rect.bottom(); ++y)
+            {
+                for(int x = tile_rect.left(); x <= tile_rect.right(); ++x)
+                {
+                    qint32 tile;
+                    quint8 flags;
+                    in >> tile >> flags;
+                    map->setTile(bg_index, y * bg_width + x, tile, flags & TILE_HFLIP, flags & TILE_VFLIP);
+                }
+            }
+        }
+        return in.status() == QDataStream::Ok;
+    }
+    case EditJournalOp::ASSET:
+    {
+        QString type_name, name, text;
+        in >> type_name >> name >> text;
+        if(in.status() != QDataStream::Ok)
+        {
+            return false;
+        }
+
+        Asset* asset = findAsset(game, type_name, name);
+        const bool added = asset == nullptr;
+        if(added)
+        {
+            asset = addAsset(game, type_name);
+        }
+        if(asset == nullptr)
+        {
+            return false;
+        }
+
+        // Only an asset added for this record is removed again, an existing one is the user's
+        QTextStream text_in(&text);
+        if(!asset->deserialize(text_in))
+        {
+            if(added)
+            {
+                game->removeAsset<Asset>(asset);
+            }
+            return false;
+        }
+        return true;
+    }
+    case EditJournalOp::REMOVE:
+    {
+        QString type_name, name;
+        in >> type_name >> name;
+        Asset* asset = findAsset(game, type_name, name);
+        if(asset == nullptr)
+        {
+            return false;
+        }
+
+        if(Tileset* tileset = dynamic_cast<Tileset*>(asset))
+        {
+            foreach(Map* map, game->getAssets<Map>())
+            {
+                map->removeTileset(tileset);
+            }
+        }
+        game->removeAsset<Asset>(asset);
+        return true;
+    }
+    case EditJournalOp::RENAME:
+    {
+        QString type_name, old_name, new_name;
+        in >> type_name >> old_name >> new_name;
+        Asset* asset = findAsset(game, type_name, old_name);
+        if(asset == nullptr)
+        {
+            return false;
+        }
+
+        asset->setName(new_name);
+        foreach(const QList<Asset*>& assets, game->asset_table)
+        {
+            foreach(Asset* dependent, assets)
+            {
+                if(Map* map = dynamic_cast<Map*>(dependent))
+                {
+                    map->syncBackgrounds();
+                }
+                else if(TiledImage* image = dynamic_cast<TiledImage*>(dependent))
+                {
+                    if(image->usesSharedPalette() && image->getSharedPalette() == old_name)
+                    {
+                        image->setSharedPalette(new_name);
+                    }
+                }
+            }
+        }
+        return true;
+    }
+    case EditJournalOp::SOURCE:
+    {
+        QString source_file_path, inserted;
+        qint32 position, removed;
+        in >> source_file_path >> position >> removed >> inserted;
+        SourceFile* source_file = game->findSourceFile(source_file_path);
+        if(source_file == nullptr || in.status() != QDataStream::Ok)
+        {
+            return false;
+        }
+
+        QString content = source_file->getContent();
+        if(position < 0 || removed < 0 || position + removed > content.size())
+        {
+            return false;
+        }
+        content.replace(position, removed, inserted);
+        source_file->setContent(content);
+        return true;
+    }
+    case EditJournalOp::FIELDS:
+    {
+        QString type_name, name;
+        QByteArray fields;
+        in >> type_name >> name >> fields;
+        Asset* asset = findAsset(game, type_name, name);
+        if(asset == nullptr || in.status() != QDataStream::Ok)
+        {
+            return false;
+        }
+
+        QDataStream fields_in(fields);
+        return asset->readStructBinary(fields_in);
+    }
+    }
+    return false;
+}
@@ -0,0 +1,75 @@
+#ifndef EDITJOURNAL_H
+#define EDITJOURNAL_H
+
+#include <QByteArray>
+#include <QList>
+#include <QRect>
+#include <QString>
+
+// Appended to the project file name, rpg.edgba -> rpg.edgba.journal
+#define EDIT_JOURNAL_EXT ".journal"
+#define EDIT_JOURNAL_MAGIC "EDGBAJNL"
+#define EDIT_JOURNAL_VERSION 1
+
+// Appends are gathered for this long before one write and fsync
+#define EDIT_JOURNAL_BATCH_MSEC 50
+
+class Game;
+class Map;
+class Asset;
+class EditJournalWriter;
+
+enum class EditJournalOp : quint8
+{
+    TILES = 1,      // map tiles in a rect
+    ASSET = 2,      // whole serialized asset, replaces or adds it
+    REMOVE = 3,
+    RENAME = 4,
+    SOURCE = 5,     // source file text replaced at a position
+    FIELDS = 6      // binary struct fields of an asset
+};
+
+// Append only log of the edits made since the last save. Records are encoded on the calling thread
+// and written in batches by a background thread, so an edit costs a copy instead of a project save.
+// Saving truncates the journal and closing the editor removes it. A journal left with records means
+// the editor did not shut down and its edits can be replayed on top of the saved project
+class EditJournal
+{
+public:
+    EditJournal();
+    ~EditJournal();
+
+    // Reads the records left by a previous session, then appends after them
+    bool open(const QString& file_path);
+    // Removes the file, every edit it held has been saved or discarded
+    void close();
+    bool isOpen() const;
+    QString getFilePath() const;
+
+    int getRecoveredCount() const;
+    // Applies the recovered records to the loaded game, returns how many applied
+    int replay(Game* game);
+
+    // The game was saved, drop every record appended so far
+    void markSaved();
+    // Blocks until the appended records are on disk
+    void flush();
+
+    // rect in map pixels
+    void appendTiles(Map* map, const QRect& rect);
+    void appendAsset(Asset* asset);
+    void appendRemove(Asset* asset);
+    void appendRename(Asset* asset, const QString& old_name);
+    void appendFields(Asset* asset);
+    void appendSourceEdit(const QString& file_path, const QString& old_text, const QString& new_text);
+
+private:
+    QString file_path;
+    EditJournalWriter* writer;
+    QList<QByteArray> recovered;    // record payloads, op byte first
+
+    void append(EditJournalOp op, const QByteArray& payload);
+    bool applyRecord(Game* game, const QByteArray& record);
+};
+
+#endif // EDITJOURNAL_H
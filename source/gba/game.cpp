@@ -3,13 +3,17 @@
 #include <msglog.h>
 #include <compiler/cgen.h>
 #include <common.h>
+#include <filecache.h>
+#include <trace.h>
 
+#include <QBuffer>
 #include <QDebug>
 #include <QDir>
 #include <QDirIterator>
+#include <QHash>
 #include <QSettings>
 
-#define HEADER_TAG  QString("/*** Generated by EdGBA ***/")
+#define HEADER_TAG  QString(GBA_GENERATED_HEADER_TAG)
 #define MESSAGE_TAG QString("/*** ! Do not modify !  ***/")
 
 #define TILESET_TAG QString("/*** Tileset ***/")
@@ -17,6 +21,12 @@
 
 // TODO: Add undo redo buffer. Push/Pop assets off stack with a action (add, remove, etc..)
 
+Game::Game()
+    : is_dirty(false)
+    , revision(0)
+{
+}
+
 Game::~Game()
 {
     reset();
@@ -35,6 +45,7 @@ void Game::newGame(QString project_path)
 void Game::reset()
 {
     is_dirty = false;
+    ++revision;
     project_file= "";
     name = GBA_DEFAULT_GAME_NAME;
 
@@ -67,6 +78,12 @@ bool Game::isDirty() const
 void Game::markDirty()
 {
     is_dirty = true;
+    ++revision;
+}
+
+quint64 Game::getRevision() const
+{
+    return revision;
 }
 
 QString Game::getName() const
@@ -107,10 +124,12 @@ QSettings* Game::getSettings()
 
 void Game::reloadSourceFiles()
 {
+    // Files still on disk keep their SourceFile, only added and removed files change
+    QHash<QString, SourceFile*> previous_files;
     foreach(SourceFile* source_file, source_files)
     {
         source_file->save();
-        delete source_file;
+        previous_files.insert(source_file->getFilePath(), source_file);
     }
     source_files.clear();
 
@@ -120,7 +139,20 @@ void Game::reloadSourceFiles()
     QDirIterator it(dir, filters, QDir::Files, QDirIterator::Subdirectories);
     while (it.hasNext())
     {
-        addSourceFile(it.next());
+        const QString file_path = QFileInfo(it.next()).absoluteFilePath();
+        if(SourceFile* source_file = previous_files.take(file_path))
+        {
+            source_files.push_back(source_file);
+        }
+        else
+        {
+            addSourceFile(file_path);
+        }
+    }
+
+    foreach(SourceFile* source_file, previous_files)
+    {
+        delete source_file;
     }
 }
 
@@ -155,6 +187,7 @@ void Game::saveAs(const QString& in_project_file)
 
 void Game::save()
 {
+    TRACE_SCOPE("game", "Game::save");
     is_dirty = false;
     QSettings* settings = getSettings();
     if(settings == nullptr)
@@ -163,8 +196,8 @@ void Game::save()
     }
     settings->setValue("name", name);
 
-    // TODO: write to temp file. THen on complete,  remove existing maps and tilesets then copy over
-    QDir(getAbsoluteGeneratedPath()).removeRecursively();
+    // Unchanged files are not rewritten, stale files are removed once all assets are saved
+    saved_files.clear();
     QDir(getAbsoluteGeneratedPath()).mkpath(".");
 
     foreach(SourceFile* source_file, source_files)
@@ -197,6 +230,16 @@ void Game::save()
 
     // Create the Assets.h API
     saveAssetsHeader();
+
+    QDirIterator file_it(getAbsoluteGeneratedPath(), QDir::Files, QDirIterator::Subdirectories);
+    while(file_it.hasNext())
+    {
+        const QString file_path = QDir::cleanPath(file_it.next());
+        if(!saved_files.contains(file_path))
+        {
+            QFile::remove(file_path);
+        }
+    }
 }
 
 void Game::saveAssetsHeader()
@@ -248,6 +291,7 @@ void Game::rebuildPalettes()
 
 bool Game::load(const QString& in_project_file)
 {
+    TRACE_SCOPE("game", "Game::load");
     reset();
     project_file = in_project_file;
 
@@ -380,22 +424,30 @@ Palette* Game::getSpritePalette()
     return palette;
 }
 
-QTextStream* Game::openInputStream(const QString& file_path)
+bool Game::isGeneratedFile(const QString& file_path)
 {
-    QFile* file = new QFile(file_path);
-    if(file == nullptr)
+    QFile file(file_path);
+    if(!file.open(QIODevice::ReadOnly))
     {
-        return nullptr;
+        return false;
     }
-    file->open(QIODevice::ReadOnly);
+    return file.readLine(sizeof(GBA_GENERATED_HEADER_TAG) + 2).trimmed() == GBA_GENERATED_HEADER_TAG;
+}
 
-    QTextStream* stream = new QTextStream(file);
-    if(stream == nullptr)
+QTextStream* Game::openInputStream(const QString& file_path)
+{
+    // Read through the cache, so the export after loading compares against memory instead of reading again
+    QByteArray data;
+    if(!FileCache::get().read(file_path, data))
     {
-        file->close();
-        delete file;
         return nullptr;
     }
+
+    QBuffer* buffer = new QBuffer();
+    buffer->setData(data);
+    buffer->open(QIODevice::ReadOnly);
+
+    QTextStream* stream = new QTextStream(buffer);
     QString line = stream->readLine();
     if (line != HEADER_TAG)
     {
@@ -407,20 +459,12 @@ QTextStream* Game::openInputStream(const QString& file_path)
 
 QTextStream* Game::openOutputStream(const QString& file_path)
 {
-    QFile* file = new QFile(file_path);
-    if(file == nullptr)
-    {
-        return nullptr;
-    }
-    file->open(QIODevice::WriteOnly);
+    // Written to memory, closeStream only touches the file if the contents changed
+    QBuffer* buffer = new QBuffer();
+    buffer->setProperty("file_path", QDir::cleanPath(QFileInfo(file_path).absoluteFilePath()));
+    buffer->open(QIODevice::WriteOnly);
 
-    QTextStream* stream = new QTextStream(file);
-    if(stream == nullptr)
-    {
-        file->close();
-        delete file;
-        return nullptr;
-    }
+    QTextStream* stream = new QTextStream(buffer);
     *stream << HEADER_TAG << endl;
     return stream;
 }
@@ -429,6 +473,18 @@ void Game::closeStream(QTextStream* stream)
 {
     if(stream)
     {
+        QBuffer* buffer = qobject_cast<QBuffer*>(stream->device());
+        if(buffer && buffer->isWritable())
+        {
+            stream->flush();
+            const QString file_path = buffer->property("file_path").toString();
+            if(!Common::writeFileIfChanged(file_path, buffer->data()))
+            {
+                msgError("Game") << "Failed to write " << file_path << "\n";
+            }
+            saved_files.insert(file_path);
+        }
+
         if(stream->device())
         {
             stream->device()->close();
@@ -11,14 +11,18 @@
 #include "palette.h"
 
 #include <QList>
+#include <QSet>
 #include <QSettings>
 
 class Game
 {
 public:
+    Game();
     ~Game();
 
     bool is_dirty;
+    // Incremented on every edit. Used to check if a built ROM is up to date
+    quint64 revision;
     QString name;
     QString project_file;
 
@@ -26,6 +30,10 @@ public:
     // Maps from asset type name to instances
     QMap<QString, QList<Asset*>> asset_table;
 
+private:
+    // Files written by the current save, anything else in the generated dir is stale
+    QSet<QString> saved_files;
+
 public:
     // create default game
     void newGame(QString project_path);
@@ -33,6 +41,7 @@ public:
     bool isValid() const;
     bool isDirty() const;
     void markDirty();
+    quint64 getRevision() const;
 
     void saveAs(const QString& project_dir);
     void save();
@@ -54,6 +63,8 @@ public:
     QString getAbsoluteCodePath() const;
     QString getAbsoluteGeneratedPath() const;
 
+    // Starts with the header written by openOutputStream
+    static bool isGeneratedFile(const QString& file_path);
     QTextStream* openInputStream(const QString& file_path);
     QTextStream* openOutputStream(const QString& file_path);
     void closeStream(QTextStream* stream);
@@ -61,6 +61,14 @@
 #define GBA_SPRITESHEET_WIDTH  128
 #define GBA_SPRITESHEET_HEIGHT 128
 
+// Memory map
+#define GBA_EWRAM_ADDRESS 0x02000000
+#define GBA_EWRAM_SIZE    0x00040000
+#define GBA_IWRAM_ADDRESS 0x03000000
+#define GBA_IWRAM_SIZE    0x00008000
+#define GBA_ROM_ADDRESS   0x08000000
+#define GBA_ROM_SIZE      0x02000000
+
 // "blank color"
 #define GBA_COLORKEY_RGB 0x00FF00FF
 #define GBA_COLORKEY_15BIT 0x7C1F
@@ -75,6 +83,8 @@
 #define GBA_TILES_SUFFIX "_tiles"
 
 #define GBA_ASSETS_HEADER     "assets.h"
+// First line of every file written by the asset export
+#define GBA_GENERATED_HEADER_TAG "/*** Generated by EdGBA ***/"
 
 #define GBA_CODE_PATH     "code/"
 #define GBA_GENERATED_PATH   "code/generated/"
@@ -6,6 +6,8 @@
 #include "palette.h"
 #include "game.h"
 #include <compiler/cgen.h>
+#include <compiler/cschema.h>
+#include <trace.h>
 
 #include <QPainter>
 #include <QFileInfo>
@@ -315,71 +317,48 @@ QString Background::getTypeName() const
     return GBA_LAYER_TYPE;
 }
 
-void Background::getStructFields(QList<QPair<CGen::Type, QString>>& out_fields) const
-{
-    const QString prefix = getBackgroundTypePrefix(bg_index) + "_";
-    const QString tileset_type = Tileset().getTypeName();
-
-    out_fields.push_back(qMakePair(CGen::Type::CONST_CHAR,               prefix + QString("priority : 2")));
-    out_fields.push_back(qMakePair(CGen::Type::CONST_CHAR,               prefix + QString("size_flag : 2")));
-    out_fields.push_back(qMakePair(CGen::Type::CONST_SHORT,              prefix + QString("scroll_x")));
-    out_fields.push_back(qMakePair(CGen::Type::CONST_SHORT,              prefix + QString("scroll_y")));
-    out_fields.push_back(qMakePair(CGen::Type::CONST_PTR_UNSIGNED_CHAR, prefix + QString("tiles")));
-    out_fields.push_back(qMakePair(CGen::Type::CONST_STRUCT,             tileset_type + "* " + prefix + "tileset"));
-}
-
-void Background::writeStructData(QList<QString>& out_field_data)
+// Map Size is shifted down if the map bg is affine
+static int getGBASizeFlag(const Background& background)
 {
-    int gba_size_flag = size_flag;
-    // Map Size is shifted down if the map bg is affine
-    if(map && Map::getBackgroundAffine(map->getMode(), bg_index))
+    if(background.map && Map::getBackgroundAffine(background.map->getMode(), background.bg_index))
     {
-        gba_size_flag = gba_size_flag - GBA_MAP_SIZE_16x16_AFFINE;
+        return background.size_flag - GBA_MAP_SIZE_16x16_AFFINE;
     }
-
-    out_field_data.append(QString::number(priority));
-    out_field_data.append(QString::number(gba_size_flag));
-    out_field_data.append(QString::number(scroll_x));
-    out_field_data.append(QString::number(scroll_y));
-    out_field_data.append(getTilesId());
-    out_field_data.append(getTilesetId());
+    return background.size_flag;
 }
 
-void Background::readStructData(QList<QString>& in_field_data)
+static void setTilesetName(Background& background, const QString& tileset_name)
 {
-    // Note: this must match the field order
-    if(in_field_data.size() == 0)
-        return;
-
-    priority = in_field_data.front().toInt();
-    in_field_data.pop_front();
-    if(in_field_data.size() == 0)
-        return;
+    background.tileset_name = tileset_name;
+}
 
-    size_flag = in_field_data.front().toInt();
-    in_field_data.pop_front();
-    if(in_field_data.size() == 0)
-        return;
+// Tiles are loaded with the tiles array, the tileset is linked by name in gatherAssets
+static const CSchemaField<Background> background_fields[] =
+{
+    CSchema<Background>::intField(CGen::Type::CONST_CHAR,  "priority",   CSCHEMA_MEMBER_GETTER(Background, int, priority), CSCHEMA_MEMBER_SETTER(Background, int, priority), 2),
+    CSchema<Background>::intField(CGen::Type::CONST_CHAR,  "size_flag",  &getGBASizeFlag, CSCHEMA_MEMBER_SETTER(Background, int, size_flag), 2),
+    CSchema<Background>::intField(CGen::Type::CONST_SHORT, "scroll_x",   CSCHEMA_MEMBER_GETTER(Background, int, scroll_x), CSCHEMA_MEMBER_SETTER(Background, int, scroll_x)),
+    CSchema<Background>::intField(CGen::Type::CONST_SHORT, "scroll_y",   CSCHEMA_MEMBER_GETTER(Background, int, scroll_y), CSCHEMA_MEMBER_SETTER(Background, int, scroll_y)),
+    CSchema<Background>::idField(CGen::Type::CONST_PTR_UNSIGNED_CHAR, "tiles", CSCHEMA_ID_GETTER(Background, getTilesId)),
+    CSchema<Background>::idField(CGen::Type::CONST_STRUCT, "tileset",    CSCHEMA_ID_GETTER(Background, getTilesetId), &setTilesetName, GBA_TILESET_TYPE),
+};
+static const CSchema<Background> background_schema(background_fields);
 
-    scroll_x = in_field_data.front().toInt();
-    in_field_data.pop_front();
-    if(in_field_data.size() == 0)
-        return;
+void Background::getStructFields(QList<QPair<CGen::Type, QString>>& out_fields) const
+{
+    background_schema.getStructFields(*this, out_fields, getBackgroundTypePrefix(bg_index) + "_");
+}
 
-    scroll_y = in_field_data.front().toInt();
-    in_field_data.pop_front();
-    if(in_field_data.size() == 0)
-        return;
+void Background::writeStructData(QList<QString>& out_field_data)
+{
+    background_schema.writeStructData(*this, out_field_data);
+}
 
-    // setTiles(in_field_data.front()); // skip tiles. this is loaded in data
-    in_field_data.pop_front();
-    if(in_field_data.size() == 0)
+void Background::readStructData(QList<QString>& in_field_data)
+{
+    if(!background_schema.readStructData(*this, in_field_data))
         return;
 
-    tileset_name = in_field_data.front();
-    in_field_data.pop_front();
-
-
     // Map Size is shifted down if the map bg is affine
     if(map && Map::getBackgroundAffine(map->getMode(), bg_index))
     {
@@ -395,6 +374,32 @@ void Background::readStructData(QList<QString>& in_field_data)
     hflips.fill(0, width * height);
 }
 
+void Background::writeStructBinary(QDataStream& out)
+{
+    background_schema.writeBinary(*this, out);
+}
+
+bool Background::readStructBinary(QDataStream& in)
+{
+    const int prev_size_flag = size_flag;
+    if(!background_schema.readBinary(*this, in))
+        return false;
+
+    if(map && Map::getBackgroundAffine(map->getMode(), bg_index))
+    {
+        size_flag = GBA_MAP_SIZE_16x16_AFFINE + size_flag;
+    }
+
+    // Unlike a load, the tiles are already there. Keep them through a size change
+    const int new_size_flag = size_flag;
+    size_flag = prev_size_flag;
+    if(new_size_flag != prev_size_flag)
+    {
+        resize(new_size_flag);
+    }
+    return true;
+}
+
 void Background::gatherAssets(Game* game)
 {
     tileset_name.remove("&");
@@ -827,9 +832,16 @@ QString Map::getDefaultName() const
     return GBA_DEFAULT_MAP_NAME;
 }
 
+// Followed by the fields of each background
+static const CSchemaField<Map> map_fields[] =
+{
+    CSchema<Map>::intField(CGen::Type::CONST_CHAR, "mode", CSCHEMA_GETTER(Map, int, getMode), CSCHEMA_SETTER(Map, int, setMode), 2),
+};
+static const CSchema<Map> map_schema(map_fields);
+
 void Map::getStructFields(QList<QPair<CGen::Type, QString>>& out_fields) const
 {
-    out_fields.push_back(qMakePair(CGen::Type::CONST_CHAR,     QString("mode : 2")));
+    map_schema.getStructFields(*this, out_fields);
     for(int bg_index= 0; bg_index < GBA_BG_COUNT; ++bg_index)
     {
         const Background& background = backgrounds[bg_index];
@@ -839,8 +851,7 @@ void Map::getStructFields(QList<QPair<CGen::Type, QString>>& out_fields) const
 
 void Map::writeStructData(QList<QString>& out_field_data)
 {
-    out_field_data.append(QString::number(getMode()));
-
+    map_schema.writeStructData(*this, out_field_data);
     for(int bg_index= 0; bg_index < GBA_BG_COUNT; ++bg_index)
     {
         Background& background = backgrounds[bg_index];
@@ -850,12 +861,7 @@ void Map::writeStructData(QList<QString>& out_field_data)
 
 void Map::readStructData(QList<QString>& in_field_data)
 {
-    if(in_field_data.size() == 0)
-        return;
-
-    setMode(in_field_data.front().toInt());
-    in_field_data.pop_front();
-    if(in_field_data.size() == 0)
+    if(!map_schema.readStructData(*this, in_field_data))
         return;
 
     for(int bg_index= 0; bg_index < GBA_BG_COUNT; ++bg_index)
@@ -865,6 +871,28 @@ void Map::readStructData(QList<QString>& in_field_data)
     }
 }
 
+void Map::writeStructBinary(QDataStream& out)
+{
+    map_schema.writeBinary(*this, out);
+    for(int bg_index= 0; bg_index < GBA_BG_COUNT; ++bg_index)
+    {
+        backgrounds[bg_index].writeStructBinary(out);
+    }
+}
+
+bool Map::readStructBinary(QDataStream& in)
+{
+    if(!map_schema.readBinary(*this, in))
+        return false;
+
+    for(int bg_index= 0; bg_index < GBA_BG_COUNT; ++bg_index)
+    {
+        if(!backgrounds[bg_index].readStructBinary(in))
+            return false;
+    }
+    return true;
+}
+
 void Map::writeDecls(QTextStream& out)
 {
     for(int bg_index= 0; bg_index < GBA_BG_COUNT; ++bg_index)
@@ -950,28 +978,152 @@ void Map::setTile(int bg_index, int index, int tile_index, bool hflip, bool vfli
 
 void Map::render(QImage& out_image) const
 {
-    int image_width = getPixelWidth();
-    int image_height = getPixelHeight();
-    if(out_image.width() != image_width || out_image.height() != image_height)
-    {
-        out_image = QImage(image_width, image_height, QImage::Format_Indexed8);
-        out_image.fill(Qt::transparent);
-    }
+    TRACE_SCOPE("render", "Map::render");
+    getRenderSnapshot().render(out_image);
+}
 
-    Palette* tileset_palette = game->getTilesetPalette();
-    out_image.setColorTable(*tileset_palette);
+MapRenderSnapshot Map::getRenderSnapshot() const
+{
+    MapRenderSnapshot snapshot;
+    snapshot.pixel_width = getPixelWidth();
+    snapshot.pixel_height = getPixelHeight();
+    snapshot.color_table = *game->getTilesetPalette();
 
     for(int priority = GBA_PRIORITY_COUNT-1; priority >= 0; --priority)
     {
         for(int bg_index = 0; bg_index < GBA_BG_COUNT; ++bg_index)
         {
             const Background& background = backgrounds[bg_index];
-            if(background.priority == priority)
+            if(background.priority != priority || background.tileset == nullptr)
             {
-                background.render(out_image);
+                continue;
             }
+
+            MapRenderLayer layer;
+            layer.width = getBackgroundSizeFlagWidth(background.size_flag);
+            layer.height = getBackgroundSizeFlagHeight(background.size_flag);
+            layer.tiles = background.tiles;
+            layer.hflips = background.hflips;
+            layer.vflips = background.vflips;
+            layer.tileset_width = background.tileset->getWidth();
+            layer.tileset_pixels = background.tileset->getPixels();
+            layer.tileset_palette = background.tileset->getPalette();
+            snapshot.layers.append(layer);
         }
     }
+    return snapshot;
+}
+
+MapRenderSnapshot::MapRenderSnapshot() :
+    pixel_width(0),
+    pixel_height(0)
+{
+}
+
+bool MapRenderSnapshot::render(QImage& out_image, std::function<bool()> is_cancelled) const
+{
+    TRACE_SCOPE("render", "MapRenderSnapshot::render");
+    if(out_image.width() != pixel_width || out_image.height() != pixel_height)
+    {
+        out_image = QImage(pixel_width, pixel_height, QImage::Format_Indexed8);
+        out_image.fill(Qt::transparent);
+    }
+    out_image.setColorTable(color_table);
+    return renderPixels(out_image, QRect(0, 0, pixel_width, pixel_height), is_cancelled);
+}
+
+QRect MapRenderSnapshot::renderRect(QImage& out_image, const QRect& rect) const
+{
+    TRACE_SCOPE("render", "MapRenderSnapshot::renderRect");
+    const QRect clipped = rect.intersected(QRect(0, 0, pixel_width, pixel_height));
+    out_image = QImage(clipped.size(), QImage::Format_Indexed8);
+    out_image.setColorTable(color_table);
+    out_image.fill(0);
+    if(!clipped.isEmpty())
+    {
+        renderPixels(out_image, clipped, nullptr);
+    }
+    return clipped;
+}
+
+bool MapRenderSnapshot::renderPixels(QImage& out_image, const QRect& rect, std::function<bool()> is_cancelled) const
+{
+    // Same result as Background::render through Tileset::renderTile, without the per pixel bounds checks
+    foreach(const MapRenderLayer& layer, layers)
+    {
+        if(layer.tileset_width == 0)
+        {
+            continue;
+        }
+        const int tileset_height = layer.tileset_pixels.size() / layer.tileset_width;
+
+        // Only the tiles overlapping rect
+        const int first_x = rect.left() / GBA_TILE_SIZE;
+        const int first_y = rect.top() / GBA_TILE_SIZE;
+        const int last_x = qMin(layer.width - 1, rect.right() / GBA_TILE_SIZE);
+        const int last_y = qMin(layer.height - 1, rect.bottom() / GBA_TILE_SIZE);
+
+        for (int y = first_y; y <= last_y; y++)
+        {
+            if(is_cancelled && is_cancelled())
+            {
+                return false;
+            }
+
+            for (int x = first_x; x <= last_x; x++)
+            {
+                const int index = y * layer.width + x;
+                if(index >= layer.tiles.size())
+                {
+                    break;
+                }
+
+                // Not a tile of the tileset, drawn as transparent like any other out of range tile
+                const int tile_index = layer.tiles[index];
+                if(tile_index < 0)
+                {
+                    continue;
+                }
+                const bool hflip = layer.hflips[index];
+                const bool vflip = layer.vflips[index];
+                const int tilex = (tile_index * GBA_TILE_SIZE) % layer.tileset_width;
+                const int tiley = ((tile_index * GBA_TILE_SIZE) / layer.tileset_width) * GBA_TILE_SIZE;
+
+                for (int j = 0; j < GBA_TILE_SIZE; j++)
+                {
+                    const int v = vflip ? GBA_TILE_SIZE - 1 - j : j;
+                    const int out_y = y * GBA_TILE_SIZE + v;
+                    if(out_y < rect.top() || out_y > rect.bottom())
+                    {
+                        continue;
+                    }
+
+                    uchar* out_line = out_image.scanLine(out_y - rect.top());
+                    for (int i = 0; i < GBA_TILE_SIZE; i++)
+                    {
+                        const int u = hflip ? GBA_TILE_SIZE - 1 - i : i;
+                        const int out_x = x * GBA_TILE_SIZE + u;
+
+                        // Out of range pixels read as color 0, which is transparent
+                        int color_index = 0;
+                        if(tilex + i < layer.tileset_width && tiley + j < tileset_height)
+                        {
+                            color_index = layer.tileset_pixels[(tiley + j) * layer.tileset_width + tilex + i];
+                        }
+                        if(color_index <= 0 || color_index >= layer.tileset_palette.size() || qAlpha(layer.tileset_palette[color_index]) == 0)
+                        {
+                            continue;
+                        }
+                        if(out_x >= rect.left() && out_x <= rect.right())
+                        {
+                            out_line[out_x - rect.left()] = color_index;
+                        }
+                    }
+                }
+            }
+        }
+    }
+    return true;
 }
 
 void Map::renderTile(QImage& out_image, int x, int y, int tile_width, int tile_height) const
@@ -1016,6 +1168,44 @@ void Map::renderTile(QImage& out_image, int x, int y, int tile_width, int tile_h
     }
 }
 
+QVector<MapUndoLayer> Map::getUndoLayers() const
+{
+    QVector<MapUndoLayer> layers;
+    for(int bg_index = 0; bg_index < GBA_BG_COUNT; ++bg_index)
+    {
+        const Background& background = backgrounds[bg_index];
+        MapUndoLayer layer;
+        layer.size_flag = background.size_flag;
+        layer.tiles = background.tiles;
+        layer.hflips = background.hflips;
+        layer.vflips = background.vflips;
+        layers.append(layer);
+    }
+    return layers;
+}
+
+void Map::setUndoLayers(const QVector<MapUndoLayer>& layers)
+{
+    for(int bg_index = 0; bg_index < GBA_BG_COUNT; ++bg_index)
+    {
+        Background& background = backgrounds[bg_index];
+        const MapUndoLayer& layer = layers[bg_index];
+        background.size_flag = layer.size_flag;
+        background.tiles = layer.tiles;
+        background.hflips = layer.hflips;
+        background.vflips = layer.vflips;
+    }
+}
+
+void Map::pushUndo()
+{
+    undo_stack.push_back(getUndoLayers());
+    if(undo_stack.size() > MAP_UNDO_LIMIT)
+        undo_stack.pop_front();
+
+    redo_stack.clear();
+}
+
 void Map::undo()
 {
     if (undo_stack.empty())
@@ -1023,17 +1213,9 @@ void Map::undo()
         return;
     }
 
-    QVector<Background> restore = undo_stack.back();
+    redo_stack.push_back(getUndoLayers());
+    setUndoLayers(undo_stack.back());
     undo_stack.pop_back();
-
-    QVector<Background> current;
-    for(int bg_index = 0; bg_index < GBA_BG_COUNT; ++bg_index)
-        current.append(backgrounds[bg_index]);
-
-    for(int bg_index = 0; bg_index < GBA_BG_COUNT; ++bg_index)
-        backgrounds[bg_index] = restore[bg_index];
-
-    redo_stack.push_back(current);
 }
 
 void Map::redo()
@@ -1043,15 +1225,7 @@ void Map::redo()
         return;
     }
 
-    QVector<Background> restore = redo_stack.back();
+    undo_stack.push_back(getUndoLayers());
+    setUndoLayers(redo_stack.back());
     redo_stack.pop_back();
-
-    QVector<Background> current;
-    for(int bg_index = 0; bg_index < GBA_BG_COUNT; ++bg_index)
-        current.append(backgrounds[bg_index]);
-
-    for(int bg_index = 0; bg_index < GBA_BG_COUNT; ++bg_index)
-        backgrounds[bg_index] = restore[bg_index];
-
-    undo_stack.push_back(current);
 }
@@ -4,10 +4,12 @@
 #include "gba.h"
 #include "tileset.h"
 #include <QStack>
+#include <QMetaType>
 #include <functional>
 
+// Number of strokes or edits that can be undone per map
+#define MAP_UNDO_LIMIT 100
 
-//TODO: cache the Map image for Overworld rendering ?
 
 class Map;
 class Background : public CStructInterface
@@ -45,19 +47,68 @@ public:
     void getStructFields(QList<QPair<CGen::Type, QString>>& out_fields) const override;
     void writeStructData(QList<QString>& out_field_data) override;
     void readStructData(QList<QString>& in_field_data) override;
+    void writeStructBinary(QDataStream& out) override;
+    bool readStructBinary(QDataStream& in) override;
     void writeDecls(QTextStream& out) override;
     bool readDecls(QTextStream& in) override;
     void writeData(QTextStream& out) override;
     bool readData(QTextStream& in) override;
 };
 
+// One background of a MapRenderSnapshot, with a copy of its tileset's pixels
+struct MapRenderLayer
+{
+    int width, height;   // in tiles
+    QVector<int> tiles;
+    QVector<bool> hflips;
+    QVector<bool> vflips;
+
+    int tileset_width;
+    QVector<unsigned char> tileset_pixels;
+    QVector<QRgb> tileset_palette;
+};
+
+// Copy of everything Map::render reads. The containers are implicitly shared so taking one is cheap,
+// and the map and its tilesets can be edited while another thread renders the snapshot
+class MapRenderSnapshot
+{
+public:
+    int pixel_width, pixel_height;
+    QVector<QRgb> color_table;
+    QList<MapRenderLayer> layers;   // back to front
+
+    MapRenderSnapshot();
+
+    // Returns false if is_cancelled returned true before the image was finished
+    bool render(QImage& out_image, std::function<bool()> is_cancelled = nullptr) const;
+    // Renders the part of the map in rect, map pixels, to an image of its size. Returns rect clipped to the map
+    QRect renderRect(QImage& out_image, const QRect& rect) const;
+
+private:
+    bool renderPixels(QImage& out_image, const QRect& rect, std::function<bool()> is_cancelled) const;
+};
+Q_DECLARE_METATYPE(MapRenderSnapshot)
+
+// The cells of one background as an undo step keeps them. The tileset is not kept, it can be
+// replaced or removed before the step is undone
+struct MapUndoLayer
+{
+    int size_flag;
+    QVector<int> tiles;
+    QVector<bool> hflips;
+    QVector<bool> vflips;
+};
+
 class Map : public Asset
 {
 private:
     Background backgrounds[GBA_BG_COUNT];
 
-    QList<QVector<Background>> undo_stack;
-    QList<QVector<Background>> redo_stack;
+    QList<QVector<MapUndoLayer>> undo_stack;
+    QList<QVector<MapUndoLayer>> redo_stack;
+
+    QVector<MapUndoLayer> getUndoLayers() const;
+    void setUndoLayers(const QVector<MapUndoLayer>& layers);
 
 public:
     Map();
@@ -112,7 +163,10 @@ public:
 
     void render(QImage& out_image) const;
     void renderTile(QImage& out_image, int x, int y, int tile_width = GBA_TILE_SIZE, int tile_height = GBA_TILE_SIZE) const;
+    MapRenderSnapshot getRenderSnapshot() const;
 
+    // Saves the cells of the backgrounds as one undo step, call before an edit
+    void pushUndo();
     void undo();
     void redo();
 
@@ -124,6 +178,8 @@ public:
     void getStructFields(QList<QPair<CGen::Type, QString>>& out_fields) const override;
     void writeStructData(QList<QString>& out_field_data) override;
     void readStructData(QList<QString>& in_field_data) override;
+    void writeStructBinary(QDataStream& out) override;
+    bool readStructBinary(QDataStream& in) override;
     void writeDecls(QTextStream& out) override;
     bool readDecls(QTextStream& in) override;
     void writeData(QTextStream& out) override;
@@ -0,0 +1,403 @@
+#include "mapthumbnails.h"
+#include <defines.h>
+#include <trace.h>
+
+#include <QCryptographicHash>
+#include <QDir>
+#include <QFile>
+#include <QRunnable>
+#include <QSaveFile>
+#include <QStandardPaths>
+
+// Part of the content hash, bump when the stored images change
+#define MAP_THUMBNAIL_VERSION 1
+
+template<typename Type>
+static void hashVector(QCryptographicHash& hash, const QVector<Type>& values)
+{
+    const int size = values.size();
+    hash.addData(reinterpret_cast<const char*>(&size), sizeof(size));
+    hash.addData(reinterpret_cast<const char*>(values.constData()), values.size() * int(sizeof(Type)));
+}
+
+// Everything the map renders from, so equal maps share their thumbnail on disk
+static QByteArray hashSnapshot(const MapRenderSnapshot& snapshot)
+{
+    QCryptographicHash hash(QCryptographicHash::Sha1);
+    const int header[] = { MAP_THUMBNAIL_VERSION, snapshot.pixel_width, snapshot.pixel_height, snapshot.layers.size() };
+    hash.addData(reinterpret_cast<const char*>(header), sizeof(header));
+    hashVector(hash, snapshot.color_table);
+    foreach(const MapRenderLayer& layer, snapshot.layers)
+    {
+        const int layer_header[] = { layer.width, layer.height, layer.tileset_width };
+        hash.addData(reinterpret_cast<const char*>(layer_header), sizeof(layer_header));
+        hashVector(hash, layer.tiles);
+        hashVector(hash, layer.hflips);
+        hashVector(hash, layer.vflips);
+        hashVector(hash, layer.tileset_pixels);
+        hashVector(hash, layer.tileset_palette);
+    }
+    return hash.result().toHex();
+}
+
+static QSize getLevelSize(int pixel_width, int pixel_height, int level)
+{
+    return QSize(qMax(1, pixel_width >> (level + 1)), qMax(1, pixel_height >> (level + 1)));
+}
+
+// Box filters 2x2 source pixels into each pixel of dest_rect. Source pixel 2 * dest - source_origin
+static void downsample(const QImage& source, const QPoint& source_origin, QImage& dest, const QRect& dest_rect)
+{
+    const int last_x = source.width() - 1;
+    const int last_y = source.height() - 1;
+    for(int y = dest_rect.top(); y <= dest_rect.bottom(); ++y)
+    {
+        const int sy0 = qBound(0, y * 2 - source_origin.y(), last_y);
+        const int sy1 = qMin(sy0 + 1, last_y);
+        const QRgb* line0 = reinterpret_cast<const QRgb*>(source.constScanLine(sy0));
+        const QRgb* line1 = reinterpret_cast<const QRgb*>(source.constScanLine(sy1));
+        QRgb* out_line = reinterpret_cast<QRgb*>(dest.scanLine(y));
+        for(int x = dest_rect.left(); x <= dest_rect.right(); ++x)
+        {
+            const int sx0 = qBound(0, x * 2 - source_origin.x(), last_x);
+            const int sx1 = qMin(sx0 + 1, last_x);
+            const QRgb a = line0[sx0], b = line0[sx1], c = line1[sx0], d = line1[sx1];
+            out_line[x] = qRgba((qRed(a) + qRed(b) + qRed(c) + qRed(d) + 2) >> 2,
+                                (qGreen(a) + qGreen(b) + qGreen(c) + qGreen(d) + 2) >> 2,
+                                (qBlue(a) + qBlue(b) + qBlue(c) + qBlue(d) + 2) >> 2,
+                                (qAlpha(a) + qAlpha(b) + qAlpha(c) + qAlpha(d) + 2) >> 2);
+        }
+    }
+}
+
+// Fills the levels after level 0 in region, given in level 0 pixels
+static void downsampleLevels(QList<QImage>& levels, QRect region)
+{
+    for(int level = 1; level < levels.size(); ++level)
+    {
+        QImage& dest = levels[level];
+        region = QRect(QPoint(region.left() / 2, region.top() / 2), QPoint(region.right() / 2, region.bottom() / 2))
+                 .intersected(dest.rect());
+        if(region.isEmpty())
+        {
+            return;
+        }
+        downsample(levels[level - 1], QPoint(0, 0), dest, region);
+    }
+}
+
+static QList<QImage> buildLevels(const QImage& level0, int level_count)
+{
+    QList<QImage> levels;
+    levels.append(level0);
+    for(int level = 1; level < level_count; ++level)
+    {
+        const QSize size(qMax(1, levels.back().width() / 2), qMax(1, levels.back().height() / 2));
+        levels.append(QImage(size, QImage::Format_ARGB32_Premultiplied));
+    }
+    downsampleLevels(levels, level0.rect());
+    return levels;
+}
+
+class MapThumbnailJob : public QRunnable
+{
+public:
+    MapThumbnailCache* cache;   // outlives the job, it waits for its pool
+    MapThumbnailResult result;
+    MapRenderSnapshot snapshot;
+    QString cache_dir;
+    bool full;
+    bool store;
+
+    void run() override
+    {
+        TRACE_SCOPE("thumbnail", "MapThumbnailJob::run");
+        const int level_count = MapThumbnailCache::getLevelCount(snapshot.pixel_width, snapshot.pixel_height);
+        const QSize level0_size = getLevelSize(snapshot.pixel_width, snapshot.pixel_height, 0);
+
+        // The map was resized since the levels were made
+        if(!full && (result.levels.size() != level_count || result.levels.front().size() != level0_size))
+        {
+            full = true;
+        }
+
+        QString file_path;
+        if(!cache_dir.isEmpty() && (full || store))
+        {
+            file_path = cache_dir + "/" + hashSnapshot(snapshot) + MAP_THUMBNAIL_EXT;
+        }
+
+        if(full)
+        {
+            result.rect = QRect();
+
+            QImage level0;
+            if(!file_path.isEmpty() && QFile::exists(file_path) && level0.load(file_path) && level0.size() == level0_size)
+            {
+                level0 = level0.convertToFormat(QImage::Format_ARGB32_Premultiplied);
+                store = false;
+            }
+            else
+            {
+                QImage image;
+                snapshot.render(image);
+                image = image.convertToFormat(QImage::Format_ARGB32_Premultiplied);
+                level0 = QImage(level0_size, QImage::Format_ARGB32_Premultiplied);
+                downsample(image, QPoint(0, 0), level0, level0.rect());
+                store = true;
+            }
+            result.levels = buildLevels(level0, level_count);
+        }
+        else if(!result.rect.isEmpty())
+        {
+            // Aligned to the last level so its pixels are made from whole blocks
+            const int align = 1 << level_count;
+            const QRect aligned(QPoint((result.rect.left() / align) * align, (result.rect.top() / align) * align),
+                                QPoint((result.rect.right() / align + 1) * align - 1, (result.rect.bottom() / align + 1) * align - 1));
+
+            QImage image;
+            const QRect rendered = snapshot.renderRect(image, aligned);
+            if(!rendered.isEmpty())
+            {
+                image = image.convertToFormat(QImage::Format_ARGB32_Premultiplied);
+                const QRect region = QRect(QPoint(rendered.left() / 2, rendered.top() / 2), QPoint(rendered.right() / 2, rendered.bottom() / 2))
+                                     .intersected(result.levels.front().rect());
+                downsample(image, rendered.topLeft(), result.levels.front(), region);
+                downsampleLevels(result.levels, region);
+            }
+            result.rect = rendered;
+        }
+
+        result.stored = false;
+        if(store && !file_path.isEmpty())
+        {
+            QSaveFile file(file_path);
+            result.stored = file.open(QIODevice::WriteOnly) && result.levels.front().save(&file, "PNG") && file.commit();
+        }
+        else if(!file_path.isEmpty())
+        {
+            result.stored = full;
+        }
+
+        QMetaObject::invokeMethod(cache, "on_jobFinished", Qt::QueuedConnection, Q_ARG(MapThumbnailResult, result));
+    }
+};
+
+MapThumbnailCache::MapThumbnailCache(QObject* parent)
+    : QObject(parent)
+    , next_job_id(0)
+{
+    qRegisterMetaType<MapThumbnailResult>("MapThumbnailResult");
+    setCacheDir(QStandardPaths::writableLocation(QStandardPaths::GenericCacheLocation) + "/" EDGBA_APP_NAME "/" MAP_THUMBNAIL_CACHE_DIR);
+}
+
+MapThumbnailCache::~MapThumbnailCache()
+{
+    pool.waitForDone();
+}
+
+void MapThumbnailCache::setCacheDir(const QString& dir)
+{
+    cache_dir = dir;
+    if(!cache_dir.isEmpty() && !QDir().mkpath(cache_dir))
+    {
+        cache_dir.clear();
+    }
+}
+
+QString MapThumbnailCache::getCacheDir() const
+{
+    return cache_dir;
+}
+
+int MapThumbnailCache::getLevelCount(int pixel_width, int pixel_height)
+{
+    int level_count = 1;
+    while(level_count < MAP_THUMBNAIL_MAX_LEVELS && qMin(pixel_width, pixel_height) >> (level_count + 1) >= MAP_THUMBNAIL_MIN_SIZE)
+    {
+        ++level_count;
+    }
+    return level_count;
+}
+
+int MapThumbnailCache::getLevelForScale(qreal scale)
+{
+    int level = 0;
+    while(level < MAP_THUMBNAIL_MAX_LEVELS - 1 && scale <= 0.5 / (1 << (level + 1)))
+    {
+        ++level;
+    }
+    return level;
+}
+
+QImage MapThumbnailCache::getThumbnail(Map* map, int level)
+{
+    if(map == nullptr)
+    {
+        return QImage();
+    }
+
+    auto it = entries.find(map);
+    if(it == entries.end())
+    {
+        Entry entry;
+        entry.job_id = 0;
+        entry.full_dirty = true;
+        entry.stored = false;
+        entry.store_pending = false;
+        it = entries.insert(map, entry);
+        startJob(map, *it, false);
+        return QImage();
+    }
+
+    const Entry& entry = *it;
+    if(entry.levels.isEmpty())
+    {
+        return QImage();
+    }
+    return entry.levels[qBound(0, level, entry.levels.size() - 1)];
+}
+
+int MapThumbnailCache::getLevelCount(Map* map) const
+{
+    auto it = entries.constFind(map);
+    return it == entries.constEnd() ? 0 : it->levels.size();
+}
+
+void MapThumbnailCache::startJob(Map* map, Entry& entry, bool store)
+{
+    MapThumbnailJob* job = new MapThumbnailJob();
+    job->cache = this;
+    job->snapshot = map->getRenderSnapshot();
+    job->cache_dir = cache_dir;
+    job->full = entry.full_dirty || entry.levels.isEmpty();
+    job->store = store;
+    job->result.map = map;
+    job->result.job_id = ++next_job_id;
+    job->result.levels = entry.levels;
+    job->result.rect = job->full ? QRect() : entry.dirty_rect;
+    job->result.stored = false;
+
+    entry.job_id = job->result.job_id;
+    entry.full_dirty = false;
+    entry.dirty_rect = QRect();
+    entry.store_pending = false;
+    pool.start(job);
+}
+
+void MapThumbnailCache::invalidate(Map* map, const QRect& rect)
+{
+    // Not shown yet, generated when first asked for
+    auto it = entries.find(map);
+    if(it == entries.end())
+    {
+        return;
+    }
+
+    Entry& entry = *it;
+    entry.stored = false;
+    if(rect.isEmpty())
+    {
+        entry.full_dirty = true;
+    }
+    else
+    {
+        entry.dirty_rect |= rect;
+    }
+
+    if(entry.job_id == 0)
+    {
+        startJob(map, entry, false);
+    }
+}
+
+void MapThumbnailCache::remove(Map* map)
+{
+    // A running job's result no longer finds its entry
+    entries.remove(map);
+}
+
+void MapThumbnailCache::clear()
+{
+    entries.clear();
+}
+
+void MapThumbnailCache::store()
+{
+    if(cache_dir.isEmpty())
+    {
+        return;
+    }
+
+    for(auto it = entries.begin(); it != entries.end(); ++it)
+    {
+        Entry& entry = *it;
+        if(entry.stored || entry.levels.isEmpty())
+        {
+            continue;
+        }
+
+        if(entry.job_id == 0)
+        {
+            startJob(it.key(), entry, true);
+        }
+        else
+        {
+            entry.store_pending = true;
+        }
+    }
+}
+
+void MapThumbnailCache::waitForDone()
+{
+    pool.waitForDone();
+}
+
+void MapThumbnailCache::on_assetChanged(AssetChange change)
+{
+    Map* map = dynamic_cast<Map*>(change.asset);
+    if(map == nullptr)
+    {
+        return;
+    }
+
+    switch(change.type)
+    {
+    case AssetChangeType::ADDED:
+    case AssetChangeType::RENAMED:
+        break;
+    case AssetChangeType::REMOVED:
+        remove(map);
+        break;
+    case AssetChangeType::TILES:
+        invalidate(map, change.rect);
+        break;
+    default:
+        // Tileset and palette edits reach the map through its dependencies
+        invalidate(map);
+        break;
+    }
+}
+
+void MapThumbnailCache::on_jobFinished(MapThumbnailResult result)
+{
+    auto it = entries.find(result.map);
+    if(it == entries.end() || it->job_id != result.job_id)
+    {
+        return;
+    }
+
+    Entry& entry = *it;
+    entry.job_id = 0;
+    entry.levels = result.levels;
+    entry.stored = result.stored;
+
+    // Edits made while the job ran
+    if(entry.full_dirty || !entry.dirty_rect.isEmpty() || (entry.store_pending && !entry.stored))
+    {
+        startJob(result.map, entry, entry.store_pending);
+    }
+    entry.store_pending = false;
+
+    emit thumbnailUpdated(result.map, result.rect);
+}
@@ -0,0 +1,93 @@
+#ifndef MAPTHUMBNAILS_H
+#define MAPTHUMBNAILS_H
+
+#include "map.h"
+#include "assetgraph.h"
+
+#include <QHash>
+#include <QImage>
+#include <QList>
+#include <QObject>
+#include <QRect>
+#include <QThreadPool>
+
+// Level 0 is half the map size, each level half of the one before
+#define MAP_THUMBNAIL_MAX_LEVELS 6
+// Smallest side of the last level, in pixels
+#define MAP_THUMBNAIL_MIN_SIZE 4
+// Under the generic cache location. Files are named by map content hash, so they are shared by projects
+#define MAP_THUMBNAIL_CACHE_DIR "map_thumbnails"
+#define MAP_THUMBNAIL_EXT ".png"
+
+// Result of a thumbnail job, delivered on the thread of the cache
+struct MapThumbnailResult
+{
+    Map* map;
+    quint64 job_id;
+    QList<QImage> levels;
+    bool stored;    // level 0 is on disk under the current content hash
+    QRect rect;     // map pixels updated, empty if all of it
+};
+Q_DECLARE_METATYPE(MapThumbnailResult)
+
+// Downscaled pyramids of the maps for views showing many at once, like a world view.
+// Generated by pool threads from render snapshots and loaded from the disk cache when the map content was seen before.
+// Tile edits update only the levels under their rect. One job runs per map at a time, edits made meanwhile
+// are merged into the next job
+class MapThumbnailCache : public QObject
+{
+    Q_OBJECT
+private:
+    struct Entry
+    {
+        QList<QImage> levels;   // ARGB32 premultiplied
+        quint64 job_id;         // running job, 0 if none
+        bool full_dirty;
+        QRect dirty_rect;       // map pixels waiting for the next job
+        bool stored;            // level 0 is in the disk cache
+        bool store_pending;     // store once the running job is done
+    };
+
+    QHash<Map*, Entry> entries;
+    QThreadPool pool;
+    QString cache_dir;
+    quint64 next_job_id;
+
+    void startJob(Map* map, Entry& entry, bool store);
+
+public:
+    MapThumbnailCache(QObject* parent = nullptr);
+    ~MapThumbnailCache();
+
+    // Empty to keep thumbnails in memory only
+    void setCacheDir(const QString& dir);
+    QString getCacheDir() const;
+
+    static int getLevelCount(int pixel_width, int pixel_height);
+    // Level with the closest scale at or above scale, scale 0.5 is level 0
+    static int getLevelForScale(qreal scale);
+
+    // Null until generated, the first call starts it. thumbnailUpdated is emitted once ready
+    QImage getThumbnail(Map* map, int level);
+    int getLevelCount(Map* map) const;
+
+    // rect in map pixels, empty if the whole map changed
+    void invalidate(Map* map, const QRect& rect = QRect());
+    void remove(Map* map);
+    void clear();
+
+    // Stores the thumbnails edited since they were generated
+    void store();
+    void waitForDone();
+
+signals:
+    void thumbnailUpdated(Map* map, QRect rect);
+
+public slots:
+    void on_assetChanged(AssetChange change);
+
+private slots:
+    void on_jobFinished(MapThumbnailResult result);
+};
+
+#endif // MAPTHUMBNAILS_H
@@ -1,59 +1,20 @@
 #include "palette.h"
+#include "colorconv.h"
 #include "game.h"
 #include "gba.h"
+#include <compiler/cschema.h>
 
-// 15 bit GBA color to 32 bit RGB format
-int GBA2RGBA(unsigned short gba_color)
+QVector<QRgb> Palette::translateFromGBAPalette(const QVector<unsigned short>& in_palette)
 {
-    if(gba_color == GBA_COLORKEY_15BIT)
-        return GBA_COLORKEY_RGB;
-
-    int r = (gba_color & 0x1f);
-    int g = ((gba_color >> 5) & 0x1f);
-    int b = ((gba_color >> 10) & 0x1f);
-    //remap from 15 to 16 bit
-    r = ((float)r)/0x1f * 0xff;
-    g = ((float)g)/0x1f * 0xff;
-    b = ((float)b)/0x1f * 0xff;
-    return (0xffu << 24) | ((r & 0xffu) << 16) | ((g & 0xffu) << 8) | (b & 0xffu);
-}
-
-// 32 bit RGB format to 15 bit GBA color
-unsigned short RGBA2GBA(int rgba)
-{
-    int a = ((rgba >> 24) & 0xff);
-    if(a == 0)
-        return GBA_COLORKEY_15BIT;
-
-    int r = ((rgba >> 16) & 0xff);
-    int g = ((rgba >> 8) & 0xff);
-    int b = (rgba & 0xff);
-    return (((r >> 3) & 0x1f) | (((g >> 3) & 0x1f) << 5) | (((b >> 3) & 0x1f) << 10));
-}
-
-QVector<QRgb> Palette::translateFromGBAPalette(const QVector<int>& in_palette)
-{
-    QVector<QRgb> out_palette;
-
-    for(int color_index = 0; color_index < in_palette.size(); ++color_index )
-    {
-        int color_15bit = in_palette[color_index];
-        QRgb rgb = GBA2RGBA(color_15bit);
-
-        out_palette.append(rgb);
-    }
+    QVector<QRgb> out_palette(in_palette.size());
+    convertGBAToRGBA(in_palette.constData(), out_palette.data(), in_palette.size());
     return out_palette;
 }
 
-QVector<int> Palette::translateToGBAPalette(const QVector<QRgb>& in_palette)
+QVector<unsigned short> Palette::translateToGBAPalette(const QVector<QRgb>& in_palette)
 {
-    QVector<int> out_palette;
-    for(int color_index = 0; color_index < in_palette.size(); ++color_index )
-    {
-        QRgb color = in_palette[color_index];
-        int color_15bit  = RGBA2GBA(color);
-        out_palette.append(color_15bit);
-    }
+    QVector<unsigned short> out_palette(in_palette.size());
+    convertRGBAToGBA(in_palette.constData(), out_palette.data(), in_palette.size());
     return out_palette;
 }
 
@@ -83,35 +44,43 @@ QString Palette::getTypeName() const
     return GBA_PALETTE_TYPE;
 }
 
+static int getPaletteSize(const Palette& palette)
+{
+    return palette.size();
+}
+
+// Read back from the colors array
+static const CSchemaField<Palette> palette_fields[] =
+{
+    CSchema<Palette>::intField(CGen::Type::UNSIGNED_SHORT, "size",             &getPaletteSize),
+    CSchema<Palette>::idField(CGen::Type::CONST_PTR_UNSIGNED_SHORT, "colors",  CSCHEMA_ID_GETTER(Palette, getPaletteDataId)),
+};
+static const CSchema<Palette> palette_schema(palette_fields);
+
 void Palette::getStructFields(QList<QPair<CGen::Type, QString>>& out_fields) const
 {
-    out_fields.push_back(qMakePair(CGen::Type::UNSIGNED_SHORT, QString("size")));
-    out_fields.push_back(qMakePair(CGen::Type::CONST_PTR_UNSIGNED_SHORT, QString("colors")));
+    palette_schema.getStructFields(*this, out_fields);
 }
 
 void Palette::writeStructData(QList<QString>& out_field_data)
 {
-    // Note: this must match the field order
-    out_field_data.append(QString::number(size()));
-    out_field_data.append(getPaletteDataId());
+    palette_schema.writeStructData(*this, out_field_data);
 }
 
 void Palette::readStructData(QList<QString>& in_field_data)
 {
-    if(in_field_data.size() == 0)
-        return;
-
-    //setPaletteSize(in_field_data.front().toInt());
-    in_field_data.pop_front();
-    if(in_field_data.size() == 0)
-        return;
+    palette_schema.readStructData(*this, in_field_data);
+}
 
-    //setPaletteId(in_field_data.front().toInt());
-    in_field_data.pop_front();
-    if(in_field_data.size() == 0)
-        return;
+void Palette::writeStructBinary(QDataStream& out)
+{
+    palette_schema.writeBinary(*this, out);
 }
 
+bool Palette::readStructBinary(QDataStream& in)
+{
+    return palette_schema.readBinary(*this, in);
+}
 
 void Palette::writeDecls(QTextStream& out)
 {
@@ -130,7 +99,7 @@ void Palette::writeData(QTextStream& out)
 {
     CGen::ArrayWriter array_writer(out);
 
-    QVector<int> palette_data = translateToGBAPalette(*this);
+    QVector<unsigned short> palette_data = translateToGBAPalette(*this);
     array_writer.writeAllValues(CGen::CONST_UNSIGNED_SHORT, getPaletteDataId(), palette_data);
 }
 
@@ -138,7 +107,7 @@ bool Palette::readData(QTextStream& in)
 {
     CGen::ArrayReader array_reader(in);
 
-    QVector<int> palette_data;
+    QVector<unsigned short> palette_data;
     QString id;
     if(!array_reader.readAllValues(CGen::CONST_UNSIGNED_SHORT, id, palette_data))
     {
@@ -11,8 +11,8 @@ class Palette : public Asset, public QVector<QRgb>
 public:
     virtual ~Palette() = default;
 
-    static QVector<QRgb> translateFromGBAPalette(const QVector<int>& in_palette);
-    static QVector<int> translateToGBAPalette(const QVector<QRgb>& in_palette);
+    static QVector<QRgb> translateFromGBAPalette(const QVector<unsigned short>& in_palette);
+    static QVector<unsigned short> translateToGBAPalette(const QVector<QRgb>& in_palette);
 
     QString getPaletteDataId() const;
 
@@ -24,6 +24,8 @@ public:
     void getStructFields(QList<QPair<CGen::Type, QString>>& out_fields) const override;
     void writeStructData(QList<QString>& out_field_data) override;
     void readStructData(QList<QString>& in_field_data) override;
+    void writeStructBinary(QDataStream& out) override;
+    bool readStructBinary(QDataStream& in) override;
     void writeDecls(QTextStream& out) override;
     bool readDecls(QTextStream& in) override;
     void writeData(QTextStream& out) override;
@@ -1,4 +1,5 @@
 #include "sourcefile.h"
+#include <filecache.h>
 
 #include <QFile>
 #include <QTextStream>
@@ -24,6 +25,7 @@ void SourceFile::save()
             text.flush();
             f.close();
         }
+        FileCache::get().invalidate(getFilePath());
     }
 }
 
@@ -76,20 +78,25 @@ void SourceFile::setContent(const QString& new_content)
 
 QString& SourceFile::getContent()
 {
-    if(is_dirty)
-    {
-        return content;
-    }
-    else
+    if(!is_dirty)
     {
-        content = "";
-        QFile f(file_path);
-        if(f.open(QIODevice::ReadOnly | QIODevice::Text))
+        QByteArray data;
+        if(!FileCache::get().read(getFilePath(), data))
         {
-            QTextStream text(&f);
+            // The cache reports the error. The content stays empty until the file can be read
+            loaded_data = QByteArray();
+            content.clear();
+            return content;
+        }
+
+        // Only decoded again when the cache read a new version of the file.
+        // Decoded with the locale codec save() writes with, not as UTF-8
+        if(data.constData() != loaded_data.constData() || data.size() != loaded_data.size())
+        {
+            loaded_data = data;
+            QTextStream text(data, QIODevice::ReadOnly);
             content = text.readAll();
-            text.flush();
-            f.close();
+            content.replace("\r\n", "\n");
         }
     }
     return content;
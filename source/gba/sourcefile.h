@@ -23,6 +23,7 @@ public:
 
 private:
     QString content;
+    QByteArray loaded_data;    // file contents content was decoded from, shared with the FileCache
     QString file_path;
     bool is_dirty;
 };
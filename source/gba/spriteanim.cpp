@@ -2,6 +2,7 @@
 
 #include "gba.h"
 #include <compiler/cgen.h>
+#include <compiler/cschema.h>
 
 //QString SpriteFrame::getTypeName()
 //{
@@ -37,44 +38,40 @@ QString SpriteAnim::getDefaultName() const
     return GBA_DEFAULT_SPRITEANIM_NAME;
 }
 
+// Frame count and frames are loaded with the frames array
+static const CSchemaField<SpriteAnim> spriteanim_fields[] =
+{
+    CSchema<SpriteAnim>::intField(CGen::Type::UNSIGNED_SHORT, "hflip",          CSCHEMA_GETTER(SpriteAnim, bool, getHFlip), CSCHEMA_SETTER(SpriteAnim, bool, setHFlip)),
+    CSchema<SpriteAnim>::intField(CGen::Type::UNSIGNED_SHORT, "vflip",          CSCHEMA_GETTER(SpriteAnim, bool, getVFlip), CSCHEMA_SETTER(SpriteAnim, bool, setVFlip)),
+    CSchema<SpriteAnim>::intField(CGen::Type::UNSIGNED_SHORT, "frame_duration", CSCHEMA_GETTER(SpriteAnim, int, getFrameDuration), CSCHEMA_SETTER(SpriteAnim, int, setFrameDuration)),
+    CSchema<SpriteAnim>::intField(CGen::Type::UNSIGNED_CHAR,  "frame_count",    CSCHEMA_GETTER(SpriteAnim, int, getFrameCount)),
+    CSchema<SpriteAnim>::idField(CGen::Type::CONST_PTR_UNSIGNED_CHAR, "frames", CSCHEMA_ID_GETTER(SpriteAnim, getFramesId)),
+};
+static const CSchema<SpriteAnim> spriteanim_schema(spriteanim_fields);
+
 void SpriteAnim::getStructFields(QList<QPair<CGen::Type, QString>>& out_fields) const
 {
-    out_fields.push_back(qMakePair(CGen::Type::UNSIGNED_SHORT, QString("hflip")));
-    out_fields.push_back(qMakePair(CGen::Type::UNSIGNED_SHORT, QString("vflip")));
-    out_fields.push_back(qMakePair(CGen::Type::UNSIGNED_SHORT, QString("frame_duration")));
-    out_fields.push_back(qMakePair(CGen::Type::UNSIGNED_CHAR, QString("frame_count")));
-    out_fields.push_back(qMakePair(CGen::Type::CONST_PTR_UNSIGNED_CHAR, QString("frames")));
-    //out_fields.push_back(qMakePair(CGen::Type::CONST_STRUCT, SpriteFrame().getTypeName() + " frames[]"));
+    spriteanim_schema.getStructFields(*this, out_fields);
 }
 
 void SpriteAnim::writeStructData(QList<QString>& out_field_data)
 {
-    out_field_data.append(QString::number(getHFlip()));
-    out_field_data.append(QString::number(getVFlip()));
-    out_field_data.append(QString::number(getFrameDuration()));
-    out_field_data.append(QString::number(getFrameCount()));
-    out_field_data.append(getFramesId());
+    spriteanim_schema.writeStructData(*this, out_field_data);
 }
 
 void SpriteAnim::readStructData(QList<QString>& in_field_data)
 {
-    // Note: this must match the field order
-    setHFlip(in_field_data[0].toInt() != 0);
-    in_field_data.pop_front();
-    if(in_field_data.size() == 0)
-        return;
-
-    setVFlip(in_field_data[0].toInt() != 0);
-    in_field_data.pop_front();
-    if(in_field_data.size() == 0)
-        return;
+    spriteanim_schema.readStructData(*this, in_field_data);
+}
 
-    setFrameDuration(in_field_data[0].toInt());
-    in_field_data.pop_front();
-    if(in_field_data.size() == 0)
-        return;
+void SpriteAnim::writeStructBinary(QDataStream& out)
+{
+    spriteanim_schema.writeBinary(*this, out);
+}
 
-    // in_field_data[0] skip frames, these are loaded in data
+bool SpriteAnim::readStructBinary(QDataStream& in)
+{
+    return spriteanim_schema.readBinary(*this, in);
 }
 
 void SpriteAnim::writeDecls(QTextStream& out)
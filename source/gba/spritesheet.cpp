@@ -1,5 +1,6 @@
 #include "spritesheet.h"
 #include "gba.h"
+#include <compiler/cschema.h>
 
 static int sprite_sizes[GBA_SPRITE_SIZE_COUNT][2] = {
     {8, 8 },
@@ -86,29 +87,40 @@ QString SpriteSheet::getTypeName() const
     return GBA_SPRITESHEET_TYPE;
 }
 
+// Follows the TiledImage fields
+static const CSchemaField<SpriteSheet> spritesheet_fields[] =
+{
+    CSchema<SpriteSheet>::intField(CGen::Type::UNSIGNED_SHORT, "sprite_size", CSCHEMA_GETTER(SpriteSheet, int, getSpriteSize), CSCHEMA_SETTER(SpriteSheet, int, setSpriteSize)),
+};
+static const CSchema<SpriteSheet> spritesheet_schema(spritesheet_fields);
+
 void SpriteSheet::getStructFields(QList<QPair<CGen::Type, QString>>& out_fields) const
 {
     TiledImage::getStructFields(out_fields);
-    out_fields.push_back(qMakePair(CGen::Type::UNSIGNED_SHORT, QString("sprite_size")));
+    spritesheet_schema.getStructFields(*this, out_fields);
 }
 
 void SpriteSheet::writeStructData(QList<QString>& out_field_data)
 {
-    // Note: this must match the field order
     TiledImage::writeStructData(out_field_data);
-    out_field_data.append(QString::number(getSpriteSize()));
+    spritesheet_schema.writeStructData(*this, out_field_data);
 }
 
 void SpriteSheet::readStructData(QList<QString>& in_field_data)
 {
     TiledImage::readStructData(in_field_data);
-    if(in_field_data.size() == 0)
-        return;
+    spritesheet_schema.readStructData(*this, in_field_data);
+}
 
-    setSpriteSize(in_field_data.front().toInt());
-    in_field_data.pop_front();
-    if(in_field_data.size() == 0)
-        return;
+void SpriteSheet::writeStructBinary(QDataStream& out)
+{
+    TiledImage::writeStructBinary(out);
+    spritesheet_schema.writeBinary(*this, out);
+}
+
+bool SpriteSheet::readStructBinary(QDataStream& in)
+{
+    return TiledImage::readStructBinary(in) && spritesheet_schema.readBinary(*this, in);
 }
 
 void SpriteSheet::getTileXY(int tile_index, int& tilex, int& tiley) const
@@ -17,6 +17,8 @@ public:
     void getStructFields(QList<QPair<CGen::Type, QString>>& out_fields) const override;
     void writeStructData(QList<QString>& out_field_data) override;
     void readStructData(QList<QString>& in_field_data) override;
+    void writeStructBinary(QDataStream& out) override;
+    bool readStructBinary(QDataStream& in) override;
 
     static QStringList getSpriteSizeNames();
     static QString getSpriteSizeName(int size_flag);
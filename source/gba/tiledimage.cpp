@@ -4,6 +4,8 @@
 #include "palette.h"
 #include <msglog.h>
 #include <compiler/cgen.h>
+#include <compiler/cschema.h>
+#include <trace.h>
 #include <functional>
 
 // Iterates the image by each 8x8 tiles from left to right, top to bottom
@@ -116,8 +118,14 @@ QVector<unsigned char> translateToGBAImage(const QVector<unsigned char>& pixels,
     return out_pixels;
 }
 
+TiledImage::TiledImage()
+    : revision(0)
+{
+}
+
 void TiledImage::reset()
 {
+    ++revision;
     setWidth(0);
     setHeight(0);
     setTileWidth(GBA_TILE_SIZE);
@@ -142,59 +150,44 @@ QString TiledImage::getTypeName() const
     return GBA_IMAGE_TYPE;
 }
 
+static bool hasOwnPalette(const TiledImage& image)
+{
+    return !image.usesSharedPalette();
+}
+
+// The pixels and palette arrays are loaded separately
+static const CSchemaField<TiledImage> tiledimage_fields[] =
+{
+    CSchema<TiledImage>::intField(CGen::Type::UNSIGNED_SHORT, "width",              CSCHEMA_GETTER(TiledImage, int, getWidth), CSCHEMA_SETTER(TiledImage, int, setWidth)),
+    CSchema<TiledImage>::intField(CGen::Type::UNSIGNED_SHORT, "height",             CSCHEMA_GETTER(TiledImage, int, getHeight), CSCHEMA_SETTER(TiledImage, int, setHeight)),
+    CSchema<TiledImage>::idField(CGen::Type::CONST_PTR_UNSIGNED_CHAR, "pixels",     CSCHEMA_ID_GETTER(TiledImage, getPixelsId)),
+    CSchema<TiledImage>::idField(CGen::Type::CONST_PTR_UNSIGNED_SHORT, "palette",   CSCHEMA_ID_GETTER(TiledImage, getPaletteId), nullptr, nullptr, &hasOwnPalette),
+};
+static const CSchema<TiledImage> tiledimage_schema(tiledimage_fields);
+
 void TiledImage::getStructFields(QList<QPair<CGen::Type, QString>>& out_fields) const
 {
-    out_fields.push_back(qMakePair(CGen::Type::UNSIGNED_SHORT, QString("width")));
-    out_fields.push_back(qMakePair(CGen::Type::UNSIGNED_SHORT, QString("height")));
-    out_fields.push_back(qMakePair(CGen::Type::CONST_PTR_UNSIGNED_CHAR, QString("pixels")));
-    if(!usesSharedPalette())
-    {
-        out_fields.push_back(qMakePair(CGen::Type::CONST_PTR_UNSIGNED_SHORT, QString("palette")));
-    }
+    tiledimage_schema.getStructFields(*this, out_fields);
 }
 
 void TiledImage::writeStructData(QList<QString>& out_field_data)
 {
-    // Note: this must match the field order
-    out_field_data.append(QString::number(getWidth()));
-    out_field_data.append(QString::number(getHeight()));
-    out_field_data.append(getPixelsId());
-    if(!usesSharedPalette())
-    {
-        out_field_data.append(getPaletteId());
-    }
+    tiledimage_schema.writeStructData(*this, out_field_data);
 }
 
 void TiledImage::readStructData(QList<QString>& in_field_data)
 {
-    // Note: this must match the field order
-    if(in_field_data.size() == 0)
-        return;
-
-    setWidth(in_field_data.front().toInt());
-    in_field_data.pop_front();
-    if(in_field_data.size() == 0)
-        return;
-
-    setHeight(in_field_data.front().toInt());
-    in_field_data.pop_front();
-    if(in_field_data.size() == 0)
-        return;
-
-    // Image and color data is skipped. These arrays are loaded manually in the source file
+    tiledimage_schema.readStructData(*this, in_field_data);
+}
 
-    //setTilesId(field_data.at(2));
-    in_field_data.pop_front();
-    if(in_field_data.size() == 0)
-        return;
+void TiledImage::writeStructBinary(QDataStream& out)
+{
+    tiledimage_schema.writeBinary(*this, out);
+}
 
-    if(!usesSharedPalette())
-    {
-        //setPaletteId(field_data.at(3));
-        in_field_data.pop_front();
-        if(in_field_data.size() == 0)
-            return;
-    }
+bool TiledImage::readStructBinary(QDataStream& in)
+{
+    return tiledimage_schema.readBinary(*this, in);
 }
 
 void TiledImage::writeDecls(QTextStream& out)
@@ -236,7 +229,7 @@ void TiledImage::writeData(QTextStream& out)
 
     if(!usesSharedPalette())
     {
-       QVector<int> palette_data = Palette::translateToGBAPalette(palette);
+       QVector<unsigned short> palette_data = Palette::translateToGBAPalette(palette);
        array_writer.writeAllValues(CGen::CONST_UNSIGNED_SHORT, getPaletteId(), palette_data);
     }
 }
@@ -256,6 +249,7 @@ bool TiledImage::readData(QTextStream& in)
     const int height = getHeight();
     const int tile_width = getTileWidth();
     const int tile_height = getTileHeight();
+    ++revision;
     pixels = translateFromGBAImage(pixel_data, tile_width, tile_height, width, height);
     if(pixels.size() != width * height)
     {
@@ -264,7 +258,7 @@ bool TiledImage::readData(QTextStream& in)
 
     if(!usesSharedPalette())
     {
-        QVector<int> palette_data;
+        QVector<unsigned short> palette_data;
         if(!array_reader.readAllValues(CGen::CONST_UNSIGNED_SHORT, id, palette_data))
         {
             return false;
@@ -288,6 +282,7 @@ void TiledImage::gatherAssets(Game* game)
 
 bool TiledImage::loadFromImage(const QImage& image)
 {
+    ++revision;
     setWidth(0);
     setHeight(0);
     palette.clear();
@@ -319,6 +314,15 @@ bool TiledImage::loadFromImage(const QImage& image)
     return true;
 }
 
+void TiledImage::setIndexedImage(int width, int height, const QVector<unsigned char>& new_pixels, const QVector<QRgb>& new_palette)
+{
+    ++revision;
+    setWidth(width);
+    setHeight(height);
+    pixels = new_pixels;
+    palette = new_palette;
+}
+
 void TiledImage::render(QImage& out_image)
 {
     int width = getWidth();
@@ -407,6 +411,7 @@ void TiledImage::setColor(int x, int y, QRgb color)
 
     int color_index = addOrFindColor(color);
     pixels[y * width +  x] = color_index;
+    ++revision;
 }
 
 void TiledImage::setPaletteColor(int color_index, QRgb color)
@@ -414,11 +419,13 @@ void TiledImage::setPaletteColor(int color_index, QRgb color)
     if(color_index < palette.size())
     {
         palette[color_index] = color;
+        ++revision;
     }
 }
 
 void TiledImage::syncPalettes(QList<TiledImage*> images, Palette* out_shared_palette)
 {
+    TRACE_SCOPE("palette", "TiledImage::syncPalettes");
     images.removeAll(nullptr);
 
     QVector<QMap<int, int>> color_index_maps;
@@ -471,12 +478,14 @@ void TiledImage::syncPalettes(QList<TiledImage*> images, Palette* out_shared_pal
         {
             image->pixels[j] = color_index_map[image->pixels[j]];
         }
+        ++image->revision;
     }
 }
 
 void TiledImage::setPalette(const QVector<QRgb>& palette)
 {
     this->palette = palette;
+    ++revision;
 }
 
 const QVector<QRgb>& TiledImage::getPalette() const
@@ -484,6 +493,16 @@ const QVector<QRgb>& TiledImage::getPalette() const
     return palette;
 }
 
+const QVector<unsigned char>& TiledImage::getPixels() const
+{
+    return pixels;
+}
+
+quint64 TiledImage::getRevision() const
+{
+    return revision;
+}
+
 int TiledImage::getWidth() const
 {
     return metadata["width"].toInt();
@@ -519,11 +538,13 @@ bool TiledImage::usesSharedPalette() const
 void TiledImage::setWidth(int width)
 {
     metadata.insert("width", QString::number(width));
+    ++revision;
 }
 
 void TiledImage::setHeight(int height)
 {
     metadata.insert("height", QString::number(height));
+    ++revision;
 }
 
 void TiledImage::setTileWidth(int tile_width)
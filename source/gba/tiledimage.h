@@ -10,6 +10,10 @@
 
 #include "palette.h"
 
+// Reorders row major pixels to the GBA layout of 8x8 tiles grouped in tile_width x tile_height blocks, and back
+QVector<unsigned char> translateToGBAImage(const QVector<unsigned char>& pixels, int tile_width, int tile_height, int width, int height);
+QVector<unsigned char> translateFromGBAImage(const QVector<unsigned char>& pixels, int tile_width, int tile_height, int width, int height);
+
 class TiledImage : public Asset
 {
 protected:
@@ -17,7 +21,11 @@ protected:
     QVector<unsigned char> pixels;
     QVector<QRgb> palette;
 
+    // Incremented when the pixels, palette or size change. Lets views keep rendered copies
+    quint64 revision;
+
 public:
+    TiledImage();
     virtual ~TiledImage() = default;
 
     virtual void reset() override;
@@ -28,6 +36,8 @@ public:
     virtual void getStructFields(QList<QPair<CGen::Type, QString>>& out_fields) const override;
     virtual void writeStructData(QList<QString>& out_field_data) override;
     virtual void readStructData(QList<QString>& in_field_data) override;
+    virtual void writeStructBinary(QDataStream& out) override;
+    virtual bool readStructBinary(QDataStream& in) override;
     virtual void writeDecls(QTextStream& out) override;
     virtual bool readDecls(QTextStream& in) override;
     virtual void writeData(QTextStream& out) override;
@@ -37,6 +47,8 @@ public:
     void render(QImage& out_image);
     void renderRegion(const QRect& rect, QImage& image);
     bool loadFromImage(const QImage& image);
+    // Pixels already indexed into palette, like the result of loadFromImage on another image
+    void setIndexedImage(int width, int height, const QVector<unsigned char>& pixels, const QVector<QRgb>& palette);
 
     int addOrFindColor(QRgb color);
     int getColorIndex(int x, int y);
@@ -49,6 +61,8 @@ public:
     static void syncPalettes(QList<TiledImage*> images, Palette* out_shared_palette);
     void setPalette(const QVector<QRgb>& palette);
     const QVector<QRgb>& getPalette() const;
+    const QVector<unsigned char>& getPixels() const;
+    quint64 getRevision() const;
 
     int getWidth() const;
     int getHeight() const;
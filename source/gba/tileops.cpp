@@ -0,0 +1,396 @@
+#include "tileops.h"
+#include "map.h"
+#include <trace.h>
+
+#include <QRunnable>
+#include <QThreadPool>
+
+TileOp::TileOp()
+    : type(TileOpType::REMAP)
+    , bg_index(TILE_OPS_ALL_BACKGROUNDS)
+    , tileset(nullptr)
+    , tile(0)
+    , hflip(false)
+    , vflip(false)
+{
+}
+
+TileOp TileOp::replace(int from_tile, int to_tile, Tileset* tileset)
+{
+    QVector<int> remap;
+    if(from_tile >= 0)
+    {
+        remap.fill(-1, from_tile + 1);
+        remap[from_tile] = to_tile;
+    }
+    return remapTiles(remap, tileset);
+}
+
+TileOp TileOp::remapTiles(const QVector<int>& remap, Tileset* tileset)
+{
+    TileOp op;
+    op.type = TileOpType::REMAP;
+    op.tileset = tileset;
+    op.remap = remap;
+    return op;
+}
+
+TileOp TileOp::fill(int bg_index, const QRect& rect, int tile, bool hflip, bool vflip)
+{
+    TileOp op;
+    op.type = TileOpType::FILL;
+    op.bg_index = bg_index;
+    op.rect = rect;
+    op.tile = tile;
+    op.hflip = hflip;
+    op.vflip = vflip;
+    return op;
+}
+
+TileOp TileOp::copy(int bg_index, const QRect& rect, const QPoint& dest)
+{
+    TileOp op;
+    op.type = TileOpType::COPY;
+    op.bg_index = bg_index;
+    op.rect = rect;
+    op.dest = dest;
+    return op;
+}
+
+TileOp TileOp::move(int bg_index, const QRect& rect, const QPoint& dest)
+{
+    TileOp op = copy(bg_index, rect, dest);
+    op.type = TileOpType::MOVE;
+    return op;
+}
+
+TileOp TileOp::flip(int bg_index, const QRect& rect, bool horizontal)
+{
+    TileOp op;
+    op.type = horizontal ? TileOpType::FLIP_H : TileOpType::FLIP_V;
+    op.bg_index = bg_index;
+    op.rect = rect;
+    return op;
+}
+
+// Reads through the const accessors first, so a background that ends up unchanged stays shared
+static bool setCell(Background& background, int index, const TileCell& cell)
+{
+    if(background.tiles.at(index) == cell.tile && background.hflips.at(index) == cell.hflip && background.vflips.at(index) == cell.vflip)
+    {
+        return false;
+    }
+    background.tiles[index] = cell.tile;
+    background.hflips[index] = cell.hflip;
+    background.vflips[index] = cell.vflip;
+    return true;
+}
+
+static QVector<TileCell> readCells(const Background& background, int width, const QRect& rect)
+{
+    QVector<TileCell> cells;
+    cells.reserve(rect.width() * rect.height());
+    for(int y = rect.top(); y <= rect.bottom(); ++y)
+    {
+        for(int x = rect.left(); x <= rect.right(); ++x)
+        {
+            const int index = y * width + x;
+            TileCell cell = { background.tiles.at(index), background.hflips.at(index), background.vflips.at(index) };
+            cells.append(cell);
+        }
+    }
+    return cells;
+}
+
+static bool remapBackground(Background& background, const QVector<int>& remap)
+{
+    const int remap_size = remap.size();
+    const int* table = remap.constData();
+    const int* tiles = background.tiles.constData();
+    const int count = background.tiles.size();
+
+    int first = 0;
+    while(first < count)
+    {
+        const int tile = tiles[first];
+        if(unsigned(tile) < unsigned(remap_size) && table[tile] >= 0 && table[tile] != tile)
+        {
+            break;
+        }
+        ++first;
+    }
+    if(first == count)
+    {
+        return false;
+    }
+
+    int* out = background.tiles.data();
+    for(int index = first; index < count; ++index)
+    {
+        const int tile = out[index];
+        if(unsigned(tile) < unsigned(remap_size) && table[tile] >= 0)
+        {
+            out[index] = table[tile];
+        }
+    }
+    return true;
+}
+
+static bool applyToBackground(Background& background, const TileOp& op)
+{
+    const int width = Map::getBackgroundSizeFlagWidth(background.size_flag);
+    if(width <= 0 || background.tiles.isEmpty())
+    {
+        return false;
+    }
+    const int height = background.tiles.size() / width;
+    const QRect bounds(0, 0, width, height);
+    const QRect rect = op.rect.isEmpty() ? bounds : op.rect.intersected(bounds);
+    if(rect.isEmpty())
+    {
+        return false;
+    }
+
+    // Affine tiles can not be flipped
+    const bool affine = Map::getBackgroundSizeFlagAffine(background.size_flag);
+    bool changed = false;
+    switch(op.type)
+    {
+    case TileOpType::REMAP:
+        return remapBackground(background, op.remap);
+    case TileOpType::FILL:
+    {
+        if(op.tile < 0)
+        {
+            return false;
+        }
+        const TileCell cell = { op.tile, op.hflip && !affine, op.vflip && !affine };
+        for(int y = rect.top(); y <= rect.bottom(); ++y)
+        {
+            for(int x = rect.left(); x <= rect.right(); ++x)
+            {
+                changed |= setCell(background, y * width + x, cell);
+            }
+        }
+        return changed;
+    }
+    case TileOpType::COPY:
+    case TileOpType::MOVE:
+    {
+        // Read before writing, source and dest may overlap
+        const QVector<TileCell> cells = readCells(background, width, rect);
+        const QRect dest_rect = QRect(op.dest, rect.size()).intersected(bounds);
+        if(op.type == TileOpType::MOVE)
+        {
+            const TileCell empty = { 0, false, false };
+            for(int y = rect.top(); y <= rect.bottom(); ++y)
+            {
+                for(int x = rect.left(); x <= rect.right(); ++x)
+                {
+                    if(!dest_rect.contains(x, y))
+                    {
+                        changed |= setCell(background, y * width + x, empty);
+                    }
+                }
+            }
+        }
+        for(int y = dest_rect.top(); y <= dest_rect.bottom(); ++y)
+        {
+            for(int x = dest_rect.left(); x <= dest_rect.right(); ++x)
+            {
+                const int source = (y - op.dest.y()) * rect.width() + (x - op.dest.x());
+                changed |= setCell(background, y * width + x, cells[source]);
+            }
+        }
+        return changed;
+    }
+    case TileOpType::FLIP_H:
+    case TileOpType::FLIP_V:
+    {
+        if(affine)
+        {
+            return false;
+        }
+        const bool horizontal = op.type == TileOpType::FLIP_H;
+        const QVector<TileCell> cells = readCells(background, width, rect);
+        for(int y = rect.top(); y <= rect.bottom(); ++y)
+        {
+            for(int x = rect.left(); x <= rect.right(); ++x)
+            {
+                const int source_x = horizontal ? rect.right() - (x - rect.left()) : x;
+                const int source_y = horizontal ? y : rect.bottom() - (y - rect.top());
+                TileCell cell = cells[(source_y - rect.top()) * rect.width() + (source_x - rect.left())];
+                if(horizontal)
+                    cell.hflip = !cell.hflip;
+                else
+                    cell.vflip = !cell.vflip;
+                changed |= setCell(background, y * width + x, cell);
+            }
+        }
+        return changed;
+    }
+    }
+    return false;
+}
+
+// Edits copies of one map's backgrounds, touches nothing shared with the other jobs
+class TileOpsJob : public QRunnable
+{
+public:
+    const QList<TileOp>& ops;
+    int mode;
+    QVector<Background> backgrounds;
+    bool changed;
+
+    TileOpsJob(Map* map, const QList<TileOp>& ops)
+        : ops(ops)
+        , mode(map->getMode())
+        , changed(false)
+    {
+        setAutoDelete(false);
+        for(int bg_index = 0; bg_index < GBA_BG_COUNT; ++bg_index)
+        {
+            backgrounds.append(*map->getBackground(bg_index));
+        }
+    }
+
+    void run() override
+    {
+        foreach(const TileOp& op, ops)
+        {
+            for(int bg_index = 0; bg_index < GBA_BG_COUNT; ++bg_index)
+            {
+                Background& background = backgrounds[bg_index];
+                if(op.bg_index != TILE_OPS_ALL_BACKGROUNDS && op.bg_index != bg_index)
+                    continue;
+                if(op.tileset && op.tileset != background.tileset)
+                    continue;
+                if(!Map::getBackgroundEnabled(mode, bg_index))
+                    continue;
+
+                changed |= applyToBackground(background, op);
+            }
+        }
+    }
+};
+
+QList<TileOpsMapDelta> TileOps::apply(const QList<Map*>& maps, const TileOp& op)
+{
+    return apply(maps, QList<TileOp>() << op);
+}
+
+// Cells that differ between the map's background and the edited copy
+static void diffBackground(const Background& before, const Background& after, int bg_index, QVector<TileCellChange>& out_cells)
+{
+    // Untouched backgrounds still share their tiles with the map
+    if(before.tiles.constData() == after.tiles.constData()
+    && before.hflips.constData() == after.hflips.constData()
+    && before.vflips.constData() == after.vflips.constData())
+    {
+        return;
+    }
+
+    const int count = qMin(before.tiles.size(), after.tiles.size());
+    for(int index = 0; index < count; ++index)
+    {
+        const TileCell before_cell = { before.tiles.at(index), before.hflips.at(index), before.vflips.at(index) };
+        const TileCell after_cell = { after.tiles.at(index), after.hflips.at(index), after.vflips.at(index) };
+        if(before_cell.tile != after_cell.tile || before_cell.hflip != after_cell.hflip || before_cell.vflip != after_cell.vflip)
+        {
+            TileCellChange change;
+            change.bg_index = bg_index;
+            change.index = index;
+            change.before = before_cell;
+            change.after = after_cell;
+            out_cells.append(change);
+        }
+    }
+}
+
+QList<TileOpsMapDelta> TileOps::apply(const QList<Map*>& maps, const QList<TileOp>& ops)
+{
+    TRACE_SCOPE("tileops", "TileOps::apply");
+
+    QList<TileOpsJob*> jobs;
+    foreach(Map* map, maps)
+    {
+        jobs.append(new TileOpsJob(map, ops));
+    }
+
+    if(jobs.size() == 1)
+    {
+        jobs.front()->run();
+    }
+    else if(jobs.size() > 1)
+    {
+        QThreadPool pool;
+        foreach(TileOpsJob* job, jobs)
+        {
+            pool.start(job);
+        }
+        pool.waitForDone();
+    }
+
+    QList<TileOpsMapDelta> deltas;
+    for(int i = 0; i < jobs.size(); ++i)
+    {
+        TileOpsJob* job = jobs[i];
+        if(job->changed)
+        {
+            TileOpsMapDelta delta;
+            delta.map = maps[i];
+            for(int bg_index = 0; bg_index < GBA_BG_COUNT; ++bg_index)
+            {
+                Background* background = delta.map->getBackground(bg_index);
+                diffBackground(*background, job->backgrounds[bg_index], bg_index, delta.cells);
+                *background = job->backgrounds[bg_index];
+            }
+            if(delta.cells.size())
+            {
+                deltas.append(delta);
+            }
+        }
+        delete job;
+    }
+    return deltas;
+}
+
+static QList<Map*> restoreCells(const QList<TileOpsMapDelta>& deltas, bool undo)
+{
+    QList<Map*> changed_maps;
+    foreach(const TileOpsMapDelta& delta, deltas)
+    {
+        bool changed = false;
+        foreach(const TileCellChange& change, delta.cells)
+        {
+            Background& background = *delta.map->getBackground(change.bg_index);
+            if(change.index >= background.tiles.size())
+            {
+                continue;
+            }
+            const TileCell& expected = undo ? change.after : change.before;
+            if(background.tiles.at(change.index) != expected.tile
+            || background.hflips.at(change.index) != expected.hflip
+            || background.vflips.at(change.index) != expected.vflip)
+            {
+                continue;
+            }
+            changed |= setCell(background, change.index, undo ? change.before : change.after);
+        }
+        if(changed)
+        {
+            changed_maps.append(delta.map);
+        }
+    }
+    return changed_maps;
+}
+
+QList<Map*> TileOps::undo(const QList<TileOpsMapDelta>& deltas)
+{
+    return restoreCells(deltas, true);
+}
+
+QList<Map*> TileOps::redo(const QList<TileOpsMapDelta>& deltas)
+{
+    return restoreCells(deltas, false);
+}
@@ -0,0 +1,85 @@
+#ifndef TILEOPS_H
+#define TILEOPS_H
+
+#include <QList>
+#include <QPoint>
+#include <QRect>
+#include <QVector>
+
+// Applies to every background of the map
+#define TILE_OPS_ALL_BACKGROUNDS -1
+
+class Map;
+class Tileset;
+
+enum class TileOpType
+{
+    REMAP,      // tile -> remap[tile], every cell of the background
+    FILL,       // rect set to tile, hflip, vflip
+    COPY,       // rect copied to dest
+    MOVE,       // rect copied to dest, the uncovered cells are cleared
+    FLIP_H,     // rect mirrored left to right, hflips toggled
+    FLIP_V      // rect mirrored top to bottom, vflips toggled
+};
+
+// One edit of many cells. Rects and points are in tiles and clipped to each background
+struct TileOp
+{
+    TileOpType type;
+    int bg_index;           // or TILE_OPS_ALL_BACKGROUNDS
+    Tileset* tileset;       // only backgrounds using this tileset, nullptr for any
+    QRect rect;             // empty for the whole background
+    QPoint dest;            // COPY and MOVE
+    QVector<int> remap;     // REMAP, indexed by tile. Negative or out of range keeps the tile
+    int tile;               // FILL, negative tiles are rejected
+    bool hflip, vflip;      // FILL
+
+    TileOp();
+
+    static TileOp replace(int from_tile, int to_tile, Tileset* tileset = nullptr);
+    static TileOp remapTiles(const QVector<int>& remap, Tileset* tileset = nullptr);
+    static TileOp fill(int bg_index, const QRect& rect, int tile, bool hflip = false, bool vflip = false);
+    static TileOp copy(int bg_index, const QRect& rect, const QPoint& dest);
+    static TileOp move(int bg_index, const QRect& rect, const QPoint& dest);
+    static TileOp flip(int bg_index, const QRect& rect, bool horizontal);
+};
+
+struct TileCell
+{
+    int tile;
+    bool hflip, vflip;
+};
+
+// One cell changed by TileOps::apply, index into the background's tiles
+struct TileCellChange
+{
+    int bg_index;
+    int index;
+    TileCell before, after;
+};
+
+// The cells one apply changed in a map, what undoing it restores
+struct TileOpsMapDelta
+{
+    Map* map;
+    QVector<TileCellChange> cells;
+};
+
+// Bulk tile edits over many maps. Each map is edited on a copy of its backgrounds by a pool
+// thread, then the changed maps are committed on the calling thread. The copies share their
+// tiles with the maps until written. No map undo step is pushed, the returned deltas hold
+// only the changed cells and are undone together with undo()
+class TileOps
+{
+public:
+    // Returns the cells changed in each map that changed
+    static QList<TileOpsMapDelta> apply(const QList<Map*>& maps, const TileOp& op);
+    static QList<TileOpsMapDelta> apply(const QList<Map*>& maps, const QList<TileOp>& ops);
+
+    // Put the cells back to before or after the apply. A cell edited again since then is left as it is.
+    // Return the maps that changed
+    static QList<Map*> undo(const QList<TileOpsMapDelta>& deltas);
+    static QList<Map*> redo(const QList<TileOpsMapDelta>& deltas);
+};
+
+#endif // TILEOPS_H
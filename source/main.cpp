@@ -4,9 +4,14 @@
 #include <stdio.h>
 #include "mainwindow.h"
 #include "ui_mainwindow.h"
+#include "cli.h"
 
 int main(int argc, char** argv)
 {
+    /* build from the command line without creating any widgets */
+    if(CommandLine::isHeadless(argc, argv))
+        return CommandLine::run(argc, argv);
+
     QApplication app(argc, argv);
 
     /* load the main window ui from the one QT generates from the ui file */ 
@@ -3,9 +3,12 @@
 #include "common.h"
 #include "defines.h"
 #include "msglog.h"
+#include "trace.h"
 
 #include <ui/utils.h>
 #include <ui/misc/configmenu.h>
+#include <ui/misc/romsizedialog.h>
+#include <compiler/buildfilegen.h>
 
 #include <stdio.h>
 #include <QMouseEvent>
@@ -13,6 +16,16 @@
 #include <QFileDialog>
 #include <QTextStream>
 #include <QMessageBox>
+#include <QStatusBar>
+#include <QScrollBar>
+#include <QTextCursor>
+#include <QDir>
+#include <QInputDialog>
+#include <QProgressDialog>
+
+// Status bar trace readout, the most expensive zones of the last interval
+#define TRACE_STATS_MSEC 1000
+#define TRACE_STATS_ZONES 3
 
 MainWindow::MainWindow(QApplication* parent_app)
     : ui(new Ui_MainWindow())
@@ -21,18 +34,24 @@ MainWindow::MainWindow(QApplication* parent_app)
     setWindowTitle(EDGBA_TITLE);
     setMouseTracking(true);
 
-    ui->setupUi(this);
-    setup();
-
     project_dirname_valid = false;
     emuprocess = nullptr;
     rom_compiler = nullptr;
+    rom_auto_builder = new RomAutoBuilder(this);
+
+    ui->setupUi(this);
+    setup();
 
     edit_context.setGame(new Game());
+    rom_auto_builder->setGame(edit_context.getGame());
 }
 
 MainWindow::~MainWindow()
 {
+    // Stop background builds before the game goes away
+    delete rom_auto_builder;
+    rom_auto_builder = nullptr;
+
     delete ui;
     delete edit_context.getGame();
     if(emuprocess)
@@ -72,7 +91,8 @@ void MainWindow::setup()
 
     // Setup Message Log
     message_log_view = new QTextBrowser(this);
-    QObject::connect(&MsgLog::get(), SIGNAL(logPosted(QString)), message_log_view, SLOT(insertHtml(QString)));
+    message_log_view->document()->setUndoRedoEnabled(false);
+    QObject::connect(&MsgLog::get(), SIGNAL(logPosted(QString)), this, SLOT(on_messageLogged(QString)));
 
     clear_message_log_button = new QPushButton(this);
     clear_message_log_button->setStyleSheet("QPushButton {border: none;}");
@@ -100,7 +120,25 @@ void MainWindow::setup()
     QObject::connect(ui->action_set_gba_emulator,   SIGNAL(triggered()),        this, SLOT(on_setGBAEmulator()));
     QObject::connect(ui->action_set_devkitarm_path, SIGNAL(triggered()),        this, SLOT(on_setDevKitProPath()));
     QObject::connect(ui->action_toggle_dark_mode,   SIGNAL(triggered(bool)),    this, SLOT(on_setDarkMode(bool)));
+    QObject::connect(ui->action_auto_build,         SIGNAL(triggered(bool)),    this, SLOT(on_setAutoBuild(bool)));
     QObject::connect(ui->action_build_settings,     SIGNAL(triggered()),        this, SLOT(on_openBuildSettings()));
+    QObject::connect(ui->action_rom_size_report,    SIGNAL(triggered()),        this, SLOT(on_openRomSizeReport()));
+    QObject::connect(ui->action_export_build_files, SIGNAL(triggered()),        this, SLOT(on_exportBuildFiles()));
+    QObject::connect(ui->action_batch_import,       SIGNAL(triggered()),        this, SLOT(on_batchImport()));
+    QObject::connect(ui->action_show_trace_costs,   SIGNAL(triggered(bool)),    this, SLOT(on_showTraceCosts(bool)));
+    QObject::connect(ui->action_dump_trace,         SIGNAL(triggered()),        this, SLOT(on_dumpTrace()));
+
+    // Trace readout, only shown on request
+    trace_stats_label = new QLabel(this);
+    trace_stats_label->hide();
+    statusBar()->addPermanentWidget(trace_stats_label);
+    trace_stats_timer = new QTimer(this);
+    trace_stats_timer->setInterval(TRACE_STATS_MSEC);
+    QObject::connect(trace_stats_timer, SIGNAL(timeout()), this, SLOT(on_traceStatsTimeout()));
+#if !EDGBA_TRACE
+    ui->action_show_trace_costs->setEnabled(false);
+    ui->action_dump_trace->setEnabled(false);
+#endif
 
     // Setup the styles. Set all of the icons
     Utils::setupAction(ui->action_new_game      , ":/edgba/icons/new.png");
@@ -122,6 +160,12 @@ void MainWindow::setup()
         Config::set(CONFIG_KEY_DARK_MODE, QString::number(1));
     if(Config::get(CONFIG_KEY_DARK_MODE).toInt() == 1)
         ui->action_toggle_dark_mode->trigger();
+
+    QObject::connect(rom_auto_builder, SIGNAL(launchReady(QString)), this, SLOT(on_romAutoBuildReady(QString)));
+    QObject::connect(rom_auto_builder, SIGNAL(launchFailed()), this, SLOT(on_romAutoBuildFailed()));
+    QObject::connect(rom_auto_builder, SIGNAL(analyzed(RomSizeReport)), this, SLOT(on_romAnalyzed(RomSizeReport)));
+    if(Config::get(CONFIG_KEY_AUTO_BUILD).toInt() == 1)
+        ui->action_auto_build->trigger();
 }
 
 void MainWindow::closeEvent(QCloseEvent* event)
@@ -132,6 +176,8 @@ void MainWindow::closeEvent(QCloseEvent* event)
         return;
     }
 
+    // Edits were saved or discarded, nothing to recover
+    edit_context.getJournal().close();
     event->accept();
 }
 
@@ -178,7 +224,16 @@ void MainWindow::newGame(QString project_path)
 void MainWindow::openGame(QString project_file)
 {
     Game* game = edit_context.getGame();
+    rom_auto_builder->setGame(game);
     project_dirname_valid = game->load(project_file);
+    if(project_dirname_valid)
+    {
+        openJournal();
+    }
+    else
+    {
+        edit_context.getJournal().close();
+    }
     syncActionEnabledState();
     for(int i = 0; i < editors.size(); ++i)
     {
@@ -190,6 +245,7 @@ void MainWindow::openGame(QString project_file)
     }
 
     game->save();
+    edit_context.getJournal().markSaved();
     saveSession();
 
     msgLog("Game") << "Opened Game " << game->getAbsoluteProjectFile() << "\n";
@@ -201,7 +257,10 @@ void MainWindow::saveGame(QString project_path)
     if(project_path.size() == 0)
     {
         game->save();
+        edit_context.getJournal().markSaved();
+        edit_context.getMapThumbnails().store();
         saveSession();
+        rom_auto_builder->requestBuild();
         return;
     }
 
@@ -214,13 +273,42 @@ void MainWindow::saveGame(QString project_path)
         QString file_path =  project_path + game->getName() + "." EDGBA_FILE_EXT;
         game->saveAs(file_path);
         project_dirname_valid = true;
+
+        // The journal follows the project file, anything left at the new location is stale
+        edit_context.getJournal().open(game->getAbsoluteProjectFile() + EDIT_JOURNAL_EXT);
+        edit_context.getJournal().markSaved();
     }
 
     saveSession();
+    rom_auto_builder->requestBuild();
 
     msgLog("Game") << "Saved Game " << game->getAbsoluteProjectFile() << "\n";
 }
 
+void MainWindow::openJournal()
+{
+    Game* game = edit_context.getGame();
+    EditJournal& journal = edit_context.getJournal();
+    if(!journal.open(game->getAbsoluteProjectFile() + EDIT_JOURNAL_EXT) || journal.getRecoveredCount() == 0)
+    {
+        return;
+    }
+
+    // Records are only left behind when the editor did not shut down
+    QMessageBox msgBox;
+    msgBox.setWindowTitle(EDGBA_TITLE);
+    msgBox.setText("Unsaved changes found");
+    const int recovered_count = journal.getRecoveredCount();
+    msgBox.setInformativeText("The editor did not shut down after the last save. Do you wish to recover the " + QString::number(recovered_count) + " unsaved edits?");
+    msgBox.setStandardButtons(QMessageBox::Yes | QMessageBox::No);
+    msgBox.setDefaultButton(QMessageBox::Yes);
+    if(msgBox.exec() == QMessageBox::Yes)
+    {
+        const int applied = journal.replay(game);
+        msgLog("Journal") << "Recovered " << applied << " of " << recovered_count << " edits\n";
+    }
+}
+
 void MainWindow::saveSession()
 {
     Game* game = edit_context.getGame();
@@ -260,6 +348,7 @@ void MainWindow::syncActionEnabledState()
     ui->action_undo->setEnabled(enabled);
     ui->action_show_grid->setEnabled(enabled);
     ui->action_run->setEnabled(enabled);
+    ui->action_export_build_files->setEnabled(enabled);
     ui->action_zoom_in->setEnabled(enabled);
     ui->action_zoom_out->setEnabled(enabled);
     //ui->tabview_editor->setEnabled(enabled);
@@ -309,7 +398,10 @@ void MainWindow::on_saveAs()
 void MainWindow::on_quit()
 {
     if (checkSave())
+    {
+        edit_context.getJournal().close();
         app->exit();
+    }
 }
 
 void MainWindow::on_undo()
@@ -348,17 +440,30 @@ void MainWindow::on_run()
         emuprocess->waitForFinished();
     }
 
+    // Launches right away if the background build is fresh
+    if(rom_auto_builder->isEnabled())
+    {
+        rom_auto_builder->run();
+        return;
+    }
+
     delete rom_compiler;
     rom_compiler = nullptr;
 
     rom_compiler = new RomCompiler();
     QObject::connect(rom_compiler, SIGNAL(finished(bool,QString)), this, SLOT(on_romCompileFinished(bool,QString)));
+    QObject::connect(rom_compiler, SIGNAL(analyzed(RomSizeReport)), this, SLOT(on_romAnalyzed(RomSizeReport)));
 
+    // Assets are exported by the compiler as the first traced build step
     Game* game = edit_context.getGame();
-    game->save();
     rom_compiler->build(game);
 }
 
+void MainWindow::on_romAnalyzed(RomSizeReport report)
+{
+    rom_size_report = report;
+}
+
 void MainWindow::on_romCompileFinished(bool success, QString rom_file)
 {
     delete rom_compiler;
@@ -370,6 +475,21 @@ void MainWindow::on_romCompileFinished(bool success, QString rom_file)
         return;
     }
 
+    launchRom(rom_file);
+}
+
+void MainWindow::on_romAutoBuildReady(QString rom_file)
+{
+    launchRom(rom_file);
+}
+
+void MainWindow::on_romAutoBuildFailed()
+{
+    Utils::popupWarning("Failed to build ROM! Check message log for details.");
+}
+
+void MainWindow::launchRom(const QString& rom_file)
+{
     QString emu_path = Config::get(CONFIG_KEY_GBA_EMU_PATH);
     if(!Common::fileExists(emu_path))
     {
@@ -394,6 +514,22 @@ void MainWindow::on_emuFinished(int exit_code, QProcess::ExitStatus exit_status)
         msgLog("ROM") << "Emulator exited code " << exit_code << "\n";
 }
 
+void MainWindow::on_messageLogged(QString html)
+{
+    // Append the whole batch in one edit at the end, and keep following the log only if it was scrolled to the bottom
+    QScrollBar* scroll_bar = message_log_view->verticalScrollBar();
+    const bool at_bottom = scroll_bar->value() == scroll_bar->maximum();
+
+    QTextCursor cursor(message_log_view->document());
+    cursor.movePosition(QTextCursor::End);
+    cursor.insertHtml(html);
+
+    if(at_bottom)
+    {
+        scroll_bar->setValue(scroll_bar->maximum());
+    }
+}
+
 void MainWindow::on_messageClear(bool)
 {
     message_log_view->clear();
@@ -441,8 +577,152 @@ void MainWindow::on_setDarkMode(bool is_dark_mode)
     Config::save();
 }
 
+void MainWindow::on_setAutoBuild(bool is_auto_build)
+{
+    rom_auto_builder->setEnabled(is_auto_build);
+    rom_auto_builder->requestBuild();
+
+    Config::set(CONFIG_KEY_AUTO_BUILD, QString::number(is_auto_build ? 1 : 0));
+    Config::save();
+}
+
 void MainWindow::on_openBuildSettings()
 {
     ConfigMenu* config_menu = new ConfigMenu();
     config_menu->show();
 }
+
+void MainWindow::on_openRomSizeReport()
+{
+    if(rom_size_report.isEmpty())
+    {
+        Utils::popupWarning("No ROM size report yet. Build the ROM first.");
+        return;
+    }
+
+    RomSizeDialog* rom_size_dialog = new RomSizeDialog();
+    rom_size_dialog->on_report(rom_size_report);
+    rom_size_dialog->show();
+}
+
+void MainWindow::on_showTraceCosts(bool show)
+{
+    trace_stats_label->setVisible(show);
+    if(show)
+    {
+        on_traceStatsTimeout();
+        trace_stats_timer->start();
+    }
+    else
+    {
+        trace_stats_timer->stop();
+    }
+}
+
+void MainWindow::on_traceStatsTimeout()
+{
+    QStringList zones;
+    const QList<TraceZoneStats> stats = Trace::zoneStats(TRACE_STATS_MSEC);
+    for(int i = 0; i < stats.size() && i < TRACE_STATS_ZONES; ++i)
+    {
+        const TraceZoneStats& zone = stats[i];
+        zones << QString("%1 %2x %3/%4 ms").arg(zone.name).arg(zone.count)
+                     .arg(zone.total_usec / 1000.0 / zone.count, 0, 'f', 1)
+                     .arg(zone.max_usec / 1000.0, 0, 'f', 1);
+    }
+    trace_stats_label->setText(zones.isEmpty() ? QString("Idle") : zones.join("   "));
+}
+
+void MainWindow::on_dumpTrace()
+{
+    // Take the events now, the dialog would push the interesting part out of the window
+    const QString temp_file = QDir::temp().filePath("edgba_trace.json");
+    if(!Trace::writeChromeTrace(temp_file))
+    {
+        Utils::popupWarning("Failed to write the trace.");
+        return;
+    }
+
+    const QString trace_file = QFileDialog::getSaveFileName(this, "Save Trace", "edgba_trace.json", "Chrome Trace (*.json)");
+    if(trace_file.isEmpty())
+    {
+        QFile::remove(temp_file);
+        return;
+    }
+
+    QFile::remove(trace_file);
+    if(!QFile::rename(temp_file, trace_file) && !QFile::copy(temp_file, trace_file))
+    {
+        Utils::popupWarning("Failed to write " + trace_file);
+        return;
+    }
+    QFile::remove(temp_file);
+    msgLog("Trace") << "Wrote the last " << TRACE_DUMP_SECONDS << " seconds to " << trace_file << "\n";
+}
+
+void MainWindow::on_batchImport()
+{
+    const QStringList image_files = QFileDialog::getOpenFileNames(this, tr("Batch Import Images"), "", tr("Images (*.png *.bmp)"));
+    if(image_files.isEmpty())
+        return;
+
+    QStringList types;
+    types << "Tilesets" << "SpriteSheets";
+    bool ok = false;
+    const QString type = QInputDialog::getItem(this, tr("Batch Import Images"), tr("Import as"), types, 0, false, &ok);
+    if(!ok)
+        return;
+
+    BatchImporter importer;
+    foreach(const QString& image_file, image_files)
+    {
+        importer.addFile(image_file, type == types[0] ? BatchImportType::TILESET : BatchImportType::SPRITESHEET);
+    }
+
+    QProgressDialog progress_dialog(tr("Decoding images..."), tr("Cancel"), 0, image_files.size(), this);
+    progress_dialog.setWindowModality(Qt::WindowModal);
+    progress_dialog.setMinimumDuration(0);
+    const bool decoded = importer.decode([&](int done, int total)
+    {
+        progress_dialog.setMaximum(total);
+        progress_dialog.setValue(done);
+        app->processEvents();
+        return !progress_dialog.wasCanceled();
+    });
+    progress_dialog.close();
+
+    if(!decoded)
+    {
+        msgLog("Import") << "Cancelled the import of " << image_files.size() << " images\n";
+        return;
+    }
+
+    if(edit_context.importBatch(importer) > 0)
+    {
+        markDirty();
+        if(EditorInterface* editor = activeEditor())
+            editor->reload();
+    }
+}
+
+void MainWindow::on_exportBuildFiles()
+{
+    // Export the assets as well so the build files can be used right away
+    Game* game = edit_context.getGame();
+    RomCompileArgs args;
+    RomCompiler::prepare(game, args);
+
+    QStringList build_files;
+    QString export_error;
+    if(!BuildFileGenerator::exportBuildFiles(args, build_files, export_error))
+    {
+        msgError("ROM") << export_error << "\n";
+        Utils::popupWarning("Failed to export build files! Check message log for details.");
+        return;
+    }
+
+    foreach(const QString& build_file, build_files)
+    {
+        msgLog("ROM") << "Exported " << build_file << "\n";
+    }
+}
@@ -7,11 +7,14 @@
 #include <gba/game.h>
 #include <ui/utils.h>
 #include <compiler/romcompiler.h>
+#include <compiler/romautobuilder.h>
 
 #include <QString>
 #include <QProcess>
 #include <QPushButton>
 #include <QTabWidget>
+#include <QLabel>
+#include <QTimer>
 
 class MainWindow : public QMainWindow
 {
@@ -35,13 +38,20 @@ private:
     void newGame(QString project_path);
     void openGame(QString project_file);
     void saveGame(QString project_file);
+    void openJournal();
 
     EditorInterface* activeEditor() const;
+    void launchRom(const QString& rom_file);
     void syncActionEnabledState();
 
     RomCompiler* rom_compiler;
+    RomAutoBuilder* rom_auto_builder;
+    RomSizeReport rom_size_report;
     QProcess* emuprocess;
 
+    QTimer* trace_stats_timer;
+    QLabel* trace_stats_label;
+
 public:
     MainWindow(QApplication* app);
     ~MainWindow();
@@ -70,15 +80,26 @@ public slots:
     void on_run();
 
     // Menu
+    void on_messageLogged(QString html);
     void on_messageClear(bool);
     void on_setGBAEmulator();
     void on_setDevKitProPath();
     void on_setDarkMode( bool is_dark_mode);
+    void on_setAutoBuild(bool is_auto_build);
     void on_openBuildSettings();
+    void on_openRomSizeReport();
+    void on_exportBuildFiles();
+    void on_batchImport();
+    void on_showTraceCosts(bool show);
+    void on_dumpTrace();
+    void on_traceStatsTimeout();
 
     // rom callbacks
 
+    void on_romAnalyzed(RomSizeReport report);
     void on_romCompileFinished(bool success, QString rom_file);
+    void on_romAutoBuildReady(QString rom_file);
+    void on_romAutoBuildFailed();
     void on_emuFinished(int exitCode, QProcess::ExitStatus exitStatus);};
 
 #endif
@@ -1,49 +1,266 @@
 #include "msglog.h"
 
+#include <QCoreApplication>
+#include <QDateTime>
+#include <QThread>
+#include <QTimer>
 
-MsgLog& msgLog(const QString& tag)
+#include <utility>
+
+MsgLogStream::MsgLogStream(const QString& tag, MsgCategory category)
+    : active(true)
 {
-    MsgLog::get().tag = tag;
-    MsgLog::get().category = MsgCategory::LOG;
-    return MsgLog::get();
+    record.tag = tag;
+    record.category = category;
+    record.timestamp_msec = QDateTime::currentMSecsSinceEpoch();
 }
 
-MsgLog& msgWarn(const QString& tag)
+MsgLogStream::MsgLogStream(MsgLogStream&& other)
+    : record(std::move(other.record))
+    , active(other.active)
 {
-    MsgLog::get().tag = tag;
-    MsgLog::get().category = MsgCategory::WARN;
-    return MsgLog::get();
+    other.active = false;
 }
 
-MsgLog& msgError(const QString& tag)
+MsgLogStream::~MsgLogStream()
 {
-    MsgLog::get().tag = tag;
-    MsgLog::get().category = MsgCategory::ERROR;
-    return MsgLog::get();
+    if(active && record.text.size())
+    {
+        MsgLog::get().post(record);
+    }
 }
 
-MsgLog& MsgLog::get()
+MsgLogStream msgLog(const QString& tag)
 {
-    static MsgLog logger;
-    return logger;
+    return MsgLogStream(tag, MsgCategory::LOG);
+}
+
+MsgLogStream msgWarn(const QString& tag)
+{
+    return MsgLogStream(tag, MsgCategory::WARN);
+}
+
+MsgLogStream msgError(const QString& tag)
+{
+    return MsgLogStream(tag, MsgCategory::ERROR);
 }
 
-void MsgLog::postMsg(const QString& msg)
+static QString toHtml(const MsgRecord& record)
 {
-    QString html = "<l style=\"margin-right:30px\">[" + tag + "]</l>";
-    switch(category)
+    QString html = record.text;
+    switch(record.category)
     {
     case MsgCategory::LOG:
-        html = msg;
         break;
     case MsgCategory::WARN:
-        html = "<span style='color: yellow'>" + msg + "</span>";
+        html = "<span style='color: yellow'>" + html + "</span>";
         break;
     case MsgCategory::ERROR:
-        html = "<span style='color: red'>" + msg + "</span>";
+        html = "<span style='color: red'>" + html + "</span>";
         break;
     }
     html.replace("\n", "<br>");
-    emit logPosted(html);
+    return html;
+}
+
+MsgLog& MsgLog::get()
+{
+    static MsgLog logger;
+    return logger;
+}
+
+MsgLog::MsgLog()
+    : enqueue_pos(0)
+    , dequeue_pos(0)
+    , queued_chars(0)
+    , dropped(0)
+    , dropped_total(0)
+    , draining(0)
+    , flush_pending(0)
+    , flush_interval(MSGLOG_FLUSH_MSEC)
+{
+    for(quint32 i = 0; i < MSGLOG_RING_SIZE; ++i)
+    {
+        ring[i].sequence.store(i);
+    }
+
+    flush_timer = new QTimer(this);
+    flush_timer->setSingleShot(true);
+    connect(flush_timer, SIGNAL(timeout()), this, SLOT(flush()));
+
+    // The first message may come from a worker. Flushes are always scheduled on the application thread
+    if(QCoreApplication::instance())
+    {
+        moveToThread(QCoreApplication::instance()->thread());
+    }
+}
+
+void MsgLog::post(MsgRecord& record)
+{
+    if(record.text.size() > MSGLOG_MAX_RECORD_CHARS)
+    {
+        record.text.truncate(MSGLOG_MAX_RECORD_CHARS);
+        record.text += "...\n";
+    }
+
+    // Reserved before the push, the consumer releases it when the record is popped
+    const int chars = record.text.size() + record.tag.size();
+    const bool within_budget = queued_chars.fetchAndAddRelaxed(chars) + chars <= MSGLOG_MAX_QUEUED_CHARS;
+    if(!within_budget || !push(record))
+    {
+        queued_chars.fetchAndAddRelaxed(-chars);
+        dropped.fetchAndAddRelaxed(1);
+        dropped_total.fetchAndAddRelaxed(1);
+    }
+
+    if(flush_interval.loadAcquire() == 0)
+    {
+        flush();
+    }
+    else if(flush_pending.testAndSetOrdered(0, 1))
+    {
+        QMetaObject::invokeMethod(this, "on_scheduleFlush", Qt::QueuedConnection);
+    }
+}
+
+void MsgLog::setFlushInterval(int msec)
+{
+    flush_interval.storeRelease(qMax(0, msec));
+    if(msec == 0)
+    {
+        flush();
+    }
+}
+
+quint64 MsgLog::getDroppedCount() const
+{
+    return dropped_total.loadAcquire();
+}
+
+void MsgLog::on_scheduleFlush()
+{
+    if(flush_timer->isActive())
+    {
+        return;
+    }
+
+    const qint64 since_flush = last_flush.isValid() ? last_flush.elapsed() : flush_interval.loadAcquire();
+    flush_timer->start(int(qMax<qint64>(0, flush_interval.loadAcquire() - since_flush)));
 }
 
+void MsgLog::flush()
+{
+    for(;;)
+    {
+        if(!draining.testAndSetAcquire(0, 1))
+        {
+            return;
+        }
+        flush_pending.storeRelease(0);
+        drain();
+        draining.storeRelease(0);
+
+        // Left over from a full ring or pushed while another thread was draining
+        if(!hasPending())
+        {
+            return;
+        }
+        if(flush_interval.loadAcquire() != 0)
+        {
+            if(flush_pending.testAndSetOrdered(0, 1))
+            {
+                QMetaObject::invokeMethod(this, "on_scheduleFlush", Qt::QueuedConnection);
+            }
+            return;
+        }
+    }
+}
+
+// Bounded multi producer queue. Each slot sequence tells whose turn it is,
+// pos when free for the producer of pos and pos + 1 when filled for the consumer
+bool MsgLog::push(MsgRecord& record)
+{
+    quint32 pos = enqueue_pos.load();
+    MsgLogSlot* slot;
+    for(;;)
+    {
+        slot = &ring[pos % MSGLOG_RING_SIZE];
+        const qint32 diff = qint32(slot->sequence.loadAcquire() - pos);
+        if(diff == 0)
+        {
+            if(enqueue_pos.testAndSetRelaxed(pos, pos + 1))
+            {
+                break;
+            }
+            pos = enqueue_pos.load();
+        }
+        else if(diff < 0)
+        {
+            return false;
+        }
+        else
+        {
+            pos = enqueue_pos.load();
+        }
+    }
+
+    slot->record = record;
+    slot->sequence.storeRelease(pos + 1);
+    return true;
+}
+
+bool MsgLog::pop(MsgRecord& out_record)
+{
+    const quint32 pos = dequeue_pos.load();
+    MsgLogSlot* slot = &ring[pos % MSGLOG_RING_SIZE];
+    if(slot->sequence.loadAcquire() != pos + 1)
+    {
+        return false;
+    }
+
+    out_record = slot->record;
+    slot->record = MsgRecord();
+    dequeue_pos.storeRelease(pos + 1);
+    slot->sequence.storeRelease(pos + MSGLOG_RING_SIZE);
+    queued_chars.fetchAndAddRelaxed(-(out_record.text.size() + out_record.tag.size()));
+    return true;
+}
+
+bool MsgLog::hasPending() const
+{
+    const quint32 pos = dequeue_pos.loadAcquire();
+    return ring[pos % MSGLOG_RING_SIZE].sequence.loadAcquire() == pos + 1;
+}
+
+void MsgLog::drain()
+{
+    last_flush.start();
+
+    QString text;
+    QString html;
+    MsgRecord record;
+    // Bounded so a flooding producer can not keep the consumer here forever
+    for(int i = 0; i < MSGLOG_RING_SIZE && pop(record); ++i)
+    {
+        text += record.text;
+        html += toHtml(record);
+    }
+
+    const int dropped_now = dropped.fetchAndStoreRelaxed(0);
+    if(dropped_now)
+    {
+        MsgRecord notice;
+        notice.tag = "Log";
+        notice.category = MsgCategory::WARN;
+        notice.timestamp_msec = QDateTime::currentMSecsSinceEpoch();
+        notice.text = QString("Dropped %1 messages\n").arg(dropped_now);
+        text += notice.text;
+        html += toHtml(notice);
+    }
+
+    if(text.size())
+    {
+        emit textPosted(text);
+        emit logPosted(html);
+    }
+}
@@ -3,55 +3,125 @@
 
 #include <QObject>
 #include <QString>
-#include <QMutex>
+#include <QAtomicInt>
+#include <QElapsedTimer>
 #include <QTextStream>
 
-// Primary API. Usage msgLog() << "Message";
-class MsgLog;
-MsgLog& msgLog(const QString& tag);
-MsgLog& msgWarn(const QString& tag);
-MsgLog& msgError(const QString& tag);
+// Records kept until the next flush. Producers drop and count records while the ring is full
+#define MSGLOG_RING_SIZE        1024
+// Text queued until the next flush, about 2 MB of QString. Producers drop and count records past it,
+// so the memory is bounded by this rather than by the ring size times the record size
+#define MSGLOG_MAX_QUEUED_CHARS (1024 * 1024)
+// Longer record text is cut, one runaway tool output should not take the whole budget
+#define MSGLOG_MAX_RECORD_CHARS (64 * 1024)
+// Minimum time between two flushes, batches the log view updates to about 30 per second
+#define MSGLOG_FLUSH_MSEC       33
+
+class QTimer;
 
 enum class MsgCategory
 {
     LOG, WARN, ERROR
 };
 
+struct MsgRecord
+{
+    QString tag;
+    MsgCategory category;
+    qint64 timestamp_msec;
+    QString text;
+};
+
+// Collects one log statement. The record is posted when the statement ends
+class MsgLogStream
+{
+public:
+    MsgLogStream(const QString& tag, MsgCategory category);
+    MsgLogStream(MsgLogStream&& other);
+    ~MsgLogStream();
+
+    MsgLogStream& operator<<(const QString& arg)    { record.text += arg; return *this; }
+    MsgLogStream& operator<<(const char* arg)       { record.text += QString::fromUtf8(arg); return *this; }
+    MsgLogStream& operator<<(QChar arg)             { record.text += arg; return *this; }
+    MsgLogStream& operator<<(char arg)              { record.text += QChar::fromLatin1(arg); return *this; }
+    MsgLogStream& operator<<(int arg)               { record.text += QString::number(arg); return *this; }
+    MsgLogStream& operator<<(unsigned int arg)      { record.text += QString::number(arg); return *this; }
+    MsgLogStream& operator<<(qint64 arg)            { record.text += QString::number(arg); return *this; }
+    MsgLogStream& operator<<(quint64 arg)           { record.text += QString::number(arg); return *this; }
+
+    template<typename Type>
+    MsgLogStream& operator<<(const Type& arg)
+    {
+        QTextStream stream(&record.text);
+        stream << arg;
+        return *this;
+    }
+
+private:
+    MsgRecord record;
+    bool active;
+
+    MsgLogStream(const MsgLogStream&) = delete;
+    MsgLogStream& operator=(const MsgLogStream&) = delete;
+};
+
+// Primary API. Usage msgLog() << "Message";
+MsgLogStream msgLog(const QString& tag);
+MsgLogStream msgWarn(const QString& tag);
+MsgLogStream msgError(const QString& tag);
+
+struct MsgLogSlot
+{
+    QAtomicInteger<quint32> sequence;
+    MsgRecord record;
+};
+
+// Any thread may post. Records go through a bounded lock-free ring and are handed to the listeners in batches,
+// from the thread of the application
 class MsgLog : public QObject
 {
     Q_OBJECT
 public:
     static MsgLog& get();
 
-private:
-    QMutex mutex;
-    QString tag;
-    MsgCategory category;
+    void post(MsgRecord& record);
+
+    // 0 flushes on the posting thread right away. Used by the command line which has no event loop during a build
+    void setFlushInterval(int msec);
+    quint64 getDroppedCount() const;
 
-    void postMsg(const QString& msg);
+public slots:
+    // Safe from any thread, only one thread drains at a time
+    void flush();
+
+private slots:
+    void on_scheduleFlush();
 
 private:
-    friend MsgLog& msgLog(const QString& tag);
-    friend MsgLog& msgWarn(const QString& tag);
-    friend MsgLog& msgError(const QString& tag);
+    MsgLogSlot ring[MSGLOG_RING_SIZE];
+    QAtomicInteger<quint32> enqueue_pos;
+    QAtomicInteger<quint32> dequeue_pos;
+    QAtomicInt queued_chars;
+    QAtomicInt dropped;
+    QAtomicInteger<quint64> dropped_total;
+    QAtomicInt draining;
+    QAtomicInt flush_pending;
+    QAtomicInt flush_interval;
+    QTimer* flush_timer;
+    QElapsedTimer last_flush;
 
-    template<typename Type>
-    friend MsgLog& operator<<(MsgLog& logger, const Type& arg);
+    MsgLog();
+
+    bool push(MsgRecord& record);
+    bool pop(MsgRecord& out_record);
+    bool hasPending() const;
+    void drain();
 
 signals:
+    // One batch of records
     void logPosted(QString msg);
+    // Same batch without html markup. Used by the command line
+    void textPosted(QString msg);
 };
 
-template<typename Type>
-MsgLog& operator<<(MsgLog& logger, const Type& arg)
-{
-    QString msg;
-    QTextStream stream(&msg);
-    stream << arg;
-    logger.mutex.lock();
-    logger.postMsg(msg);
-    logger.mutex.unlock();
-    return logger;
-}
-
 #endif // MSGLOG_H
@@ -0,0 +1,246 @@
+#include "trace.h"
+
+#include <QCoreApplication>
+#include <QDir>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QFileInfo>
+#include <QHash>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QMap>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QThread>
+#include <QVector>
+#include <algorithm>
+
+// Written by its thread only. The mutex is uncontended except while a dump copies the events
+struct TraceBuffer
+{
+    QMutex mutex;
+    QVector<TraceEvent> events;
+    int next;
+    bool in_use;
+};
+
+struct TraceRegistry
+{
+    QMutex mutex;
+    QList<TraceBuffer*> buffers;    // never freed, a buffer is handed to the next new thread when its thread ends
+    QMap<int, QString> thread_names;
+    int next_thread_id;
+    QElapsedTimer clock;
+
+    TraceRegistry()
+        : next_thread_id(1)
+    {
+        clock.start();
+    }
+};
+
+static TraceRegistry& registry()
+{
+    static TraceRegistry trace_registry;
+    return trace_registry;
+}
+
+static QString currentThreadName()
+{
+    QThread* thread = QThread::currentThread();
+    if(QCoreApplication::instance() && thread == QCoreApplication::instance()->thread())
+    {
+        return "Main";
+    }
+    return thread->objectName();
+}
+
+struct TraceThreadHandle
+{
+    TraceBuffer* buffer;
+    int thread_id;
+
+    TraceThreadHandle()
+        : buffer(nullptr)
+        , thread_id(0)
+    {
+    }
+
+    ~TraceThreadHandle()
+    {
+        if(buffer)
+        {
+            QMutexLocker lock(&registry().mutex);
+            buffer->in_use = false;
+        }
+    }
+
+    void acquire()
+    {
+        TraceRegistry& reg = registry();
+        QMutexLocker lock(&reg.mutex);
+        foreach(TraceBuffer* candidate, reg.buffers)
+        {
+            if(!candidate->in_use)
+            {
+                buffer = candidate;
+                break;
+            }
+        }
+        if(buffer == nullptr)
+        {
+            buffer = new TraceBuffer();
+            buffer->events.resize(TRACE_BUFFER_EVENTS);
+            buffer->next = 0;
+            reg.buffers.append(buffer);
+        }
+        buffer->in_use = true;
+
+        thread_id = reg.next_thread_id++;
+        QString name = currentThreadName();
+        reg.thread_names[thread_id] = name.isEmpty() ? QString("Thread %1").arg(thread_id) : name;
+    }
+};
+
+static thread_local TraceThreadHandle thread_handle;
+
+namespace Trace
+{
+    qint64 nowUsec()
+    {
+        return registry().clock.nsecsElapsed() / 1000;
+    }
+
+    void record(const char* category, const char* name, qint64 start_usec, qint64 duration_usec)
+    {
+        if(thread_handle.buffer == nullptr)
+        {
+            thread_handle.acquire();
+        }
+
+        TraceBuffer* buffer = thread_handle.buffer;
+        QMutexLocker lock(&buffer->mutex);
+        TraceEvent& event = buffer->events[buffer->next];
+        event.category = category;
+        event.name = name;
+        event.start_usec = start_usec;
+        event.duration_usec = duration_usec;
+        event.thread_id = thread_handle.thread_id;
+        buffer->next = (buffer->next + 1) % TRACE_BUFFER_EVENTS;
+    }
+
+    QList<TraceEvent> collect(qint64 window_msec)
+    {
+        TraceRegistry& reg = registry();
+        QList<TraceBuffer*> buffers;
+        {
+            QMutexLocker lock(&reg.mutex);
+            buffers = reg.buffers;
+        }
+
+        const qint64 since_usec = nowUsec() - window_msec * 1000;
+        QList<TraceEvent> events;
+        foreach(TraceBuffer* buffer, buffers)
+        {
+            QMutexLocker lock(&buffer->mutex);
+            foreach(const TraceEvent& event, buffer->events)
+            {
+                if(event.name && event.start_usec + event.duration_usec >= since_usec)
+                {
+                    events.append(event);
+                }
+            }
+        }
+
+        std::sort(events.begin(), events.end(), [](const TraceEvent& a, const TraceEvent& b)
+        {
+            return a.start_usec < b.start_usec;
+        });
+        return events;
+    }
+
+    QList<TraceZoneStats> zoneStats(qint64 window_msec)
+    {
+        // Keyed by text, the same literal may have a different address in each translation unit
+        QHash<QString, TraceZoneStats> zones;
+        foreach(const TraceEvent& event, collect(window_msec))
+        {
+            const QString name = QString::fromLatin1(event.name);
+            TraceZoneStats& zone = zones[name];
+            if(zone.name.isEmpty())
+            {
+                zone.name = name;
+                zone.count = 0;
+                zone.total_usec = 0;
+                zone.max_usec = 0;
+            }
+            zone.count++;
+            zone.total_usec += event.duration_usec;
+            zone.max_usec = qMax(zone.max_usec, event.duration_usec);
+        }
+
+        QList<TraceZoneStats> stats = zones.values();
+        std::sort(stats.begin(), stats.end(), [](const TraceZoneStats& a, const TraceZoneStats& b)
+        {
+            return a.total_usec > b.total_usec;
+        });
+        return stats;
+    }
+
+    bool writeChromeTrace(const QString& file_path, qint64 window_msec)
+    {
+        const QList<TraceEvent> events = collect(window_msec);
+
+        QMap<int, QString> thread_names;
+        {
+            QMutexLocker lock(&registry().mutex);
+            thread_names = registry().thread_names;
+        }
+
+        QJsonArray trace_events;
+        QMap<int, bool> named_threads;
+        foreach(const TraceEvent& event, events)
+        {
+            if(!named_threads.contains(event.thread_id))
+            {
+                named_threads[event.thread_id] = true;
+
+                QJsonObject args;
+                args["name"] = thread_names.value(event.thread_id);
+
+                QJsonObject thread_event;
+                thread_event["name"] = "thread_name";
+                thread_event["ph"] = "M";
+                thread_event["pid"] = 1;
+                thread_event["tid"] = event.thread_id;
+                thread_event["args"] = args;
+                trace_events.append(thread_event);
+            }
+
+            QJsonObject trace_event;
+            trace_event["name"] = QString::fromLatin1(event.name);
+            trace_event["cat"] = QString::fromLatin1(event.category);
+            trace_event["ph"] = "X";
+            trace_event["ts"] = event.start_usec;
+            trace_event["dur"] = event.duration_usec;
+            trace_event["pid"] = 1;
+            trace_event["tid"] = event.thread_id;
+            trace_events.append(trace_event);
+        }
+
+        QJsonObject root;
+        root["traceEvents"] = trace_events;
+        root["displayTimeUnit"] = "ms";
+
+        QDir().mkpath(QFileInfo(file_path).absolutePath());
+        QFile file(file_path);
+        if(!file.open(QIODevice::WriteOnly | QIODevice::Truncate))
+        {
+            return false;
+        }
+        file.write(QJsonDocument(root).toJson(QJsonDocument::Compact));
+        file.close();
+        return true;
+    }
+}
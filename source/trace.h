@@ -0,0 +1,76 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include "defines.h"
+
+#include <QList>
+#include <QString>
+
+// Events kept per thread. The oldest are overwritten, about the last few seconds of a busy editor
+#define TRACE_BUFFER_EVENTS 16384
+// Span of the trace written by the dump menu action
+#define TRACE_DUMP_SECONDS  10
+
+// Usage TRACE_SCOPE("render", "Map::render"); times the rest of the enclosing block.
+// Category and name must be string literals, only the pointers are stored
+#if EDGBA_TRACE
+#define TRACE_CONCAT_IMPL(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT_IMPL(a, b)
+#define TRACE_SCOPE(category, name) TraceScope TRACE_CONCAT(trace_scope_, __LINE__)(category, name)
+#else
+#define TRACE_SCOPE(category, name)
+#endif
+
+struct TraceEvent
+{
+    const char* category;
+    const char* name;
+    qint64 start_usec;      // since the first traced event of the process
+    qint64 duration_usec;
+    int thread_id;
+};
+
+struct TraceZoneStats
+{
+    QString name;
+    int count;
+    qint64 total_usec;
+    qint64 max_usec;
+};
+
+namespace Trace
+{
+    qint64 nowUsec();
+    void record(const char* category, const char* name, qint64 start_usec, qint64 duration_usec);
+
+    // Events that ended within the last window_msec, of every thread
+    QList<TraceEvent> collect(qint64 window_msec);
+    // Per zone totals of the last window_msec, most expensive first
+    QList<TraceZoneStats> zoneStats(qint64 window_msec);
+
+    // Chrome trace-event JSON (chrome://tracing, Perfetto)
+    bool writeChromeTrace(const QString& file_path, qint64 window_msec = TRACE_DUMP_SECONDS * 1000);
+}
+
+class TraceScope
+{
+private:
+    const char* category;
+    const char* name;
+    qint64 start_usec;
+
+public:
+    TraceScope(const char* category, const char* name)
+        : category(category)
+        , name(name)
+        , start_usec(Trace::nowUsec())
+    {
+    }
+
+    ~TraceScope()
+    {
+        Trace::record(category, name, start_usec, Trace::nowUsec() - start_usec);
+    }
+};
+
+#endif // TRACE_H
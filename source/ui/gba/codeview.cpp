@@ -3,51 +3,58 @@
 #include <QTextBlock>
 #include <QTextStream>
 #include <QFontMetricsF>
+#include <QScrollBar>
+#include <QKeyEvent>
+#include <QMouseEvent>
+#include <QAbstractItemView>
 
 // TODO: make customizable
 struct SyntaxConfig
 {
-    SyntaxConfig(QColor color = QColor(), QString pattern="", bool is_bold = false)
+    SyntaxConfig(QColor color = QColor(), bool is_bold = false)
         : color(color)
-        , pattern(pattern)
         , is_bold(is_bold)
     {}
     QColor color;
-    QString pattern;
-    bool is_bold = false;
+    bool is_bold;
 };
 
-// TODO: build a user keywords pattern for any typedefs in the game code
 const int tab_width = 4;
-static const char* keywords_pattern =
-    "(#define|#include|#ifdef|#ifndef|#if|#else|#elif|#end)|\\b(auto|break|case|char|const|continue|default|do|double|else|enum|extern|float|for|goto|if|inline|int|long|register|return|short|signed|sizeof|static|struct|switch|typedef|union|unsigned|void|volatile|while)\\b"
-;
-
-static QMap<QString, SyntaxConfig>& getSyntaxConfig()
-{
-    // NOTE: prefix denote priority. 0 is lowest priority
-    static QMap<QString, SyntaxConfig> syntax_config;
-    if(syntax_config.size() == 0)
-    {
-        syntax_config["6_comment"]       = SyntaxConfig( QColor(0x6A, 0x99, 0x49), "//[^\n]*");
-        syntax_config["5_string"]        = SyntaxConfig( QColor(0xD9, 0x82, 0x00), "\".*\"");
-        syntax_config["4_keywords"]      = SyntaxConfig( QColor(0x35, 0x8C, 0xD6), keywords_pattern );
-        syntax_config["3_include"]       = SyntaxConfig( QColor(0xD9, 0x82, 0x00), "#include ?(\"|<).+(\"|>)");
-        syntax_config["3_define"]        = SyntaxConfig( QColor(0x84, 0xC3, 0xAD), "#define ?(.+\\\\n)*(.+\\n)");
-        syntax_config["2_number"]        = SyntaxConfig( QColor(0xA7, 0xCE, 0xA8), "(?=.)((0x|0b)?([0-9]*)(\\.([0-9]+)?(f|i)?)?)");
-        syntax_config["2_function"]      = SyntaxConfig( QColor(0xDC, 0xDC, 0x9D), "\\b[A-Za-z0-9_]+(?=\\()");
-        syntax_config["1_identifier"]    = SyntaxConfig( QColor(0x84, 0xC3, 0xAD), "\\w[\\w\\d_]*");
-        syntax_config["0_left_bracket"]  = SyntaxConfig( QColor(0xA4, 0x63, 0xD6), "{"  );
-        syntax_config["0_right_bracket"] = SyntaxConfig( QColor(0xA4, 0x63, 0xD6), "}"  );
-        syntax_config["0_left_brace"]    = SyntaxConfig( QColor(0xA4, 0x63, 0xD6), "\\[");
-        syntax_config["0_right_brace"]   = SyntaxConfig( QColor(0xA4, 0x63, 0xD6), "\\]");
-        syntax_config["0_left_paren"]    = SyntaxConfig( QColor(0xF1, 0xD7, 0x10), "\\(");
-        syntax_config["0_right_paren"]   = SyntaxConfig( QColor(0xF1, 0xD7, 0x10), "\\)");
+
+static const SyntaxConfig& getSyntaxConfig(CTokenType type)
+{
+    static SyntaxConfig syntax_config[CTOKEN_PUNCTUATION + 1];
+    static bool initialized = false;
+    if(!initialized)
+    {
+        syntax_config[CTOKEN_COMMENT]      = SyntaxConfig( QColor(0x6A, 0x99, 0x49) );
+        syntax_config[CTOKEN_STRING]       = SyntaxConfig( QColor(0xD9, 0x82, 0x00) );
+        syntax_config[CTOKEN_NUMBER]       = SyntaxConfig( QColor(0xA7, 0xCE, 0xA8) );
+        syntax_config[CTOKEN_KEYWORD]      = SyntaxConfig( QColor(0x35, 0x8C, 0xD6) );
+        syntax_config[CTOKEN_DIRECTIVE]    = SyntaxConfig( QColor(0x35, 0x8C, 0xD6) );
+        syntax_config[CTOKEN_INCLUDE_PATH] = SyntaxConfig( QColor(0xD9, 0x82, 0x00) );
+        syntax_config[CTOKEN_IDENTIFIER]   = SyntaxConfig( QColor(0x84, 0xC3, 0xAD) );
+        syntax_config[CTOKEN_FUNCTION]     = SyntaxConfig( QColor(0xDC, 0xDC, 0x9D) );
+        syntax_config[CTOKEN_BRACE]        = SyntaxConfig( QColor(0xA4, 0x63, 0xD6) );
+        syntax_config[CTOKEN_PAREN]        = SyntaxConfig( QColor(0xF1, 0xD7, 0x10) );
+        initialized = true;
     }
+    return syntax_config[type];
+}
+
+static const SyntaxConfig& getUserTypeSyntaxConfig()
+{
+    static SyntaxConfig syntax_config( QColor(0x4E, 0xC9, 0xB0) );
     return syntax_config;
 }
 
-// TODO: build a list of known struct definitions. Create a global lookup
+// Set on every block by the highlighter
+class CodeBlockData : public QTextBlockUserData
+{
+public:
+    CodeBlockData(bool highlighted) : highlighted(highlighted) {}
+    bool highlighted;
+};
 
 CodeViewGutter::CodeViewGutter(CodeView *code_view)
     : QWidget(code_view), code_view(code_view)
@@ -74,60 +81,75 @@ CodeHighlighter::CodeHighlighter(CodeView* code_view, QTextDocument *parent)
 
 void CodeHighlighter::reset()
 {
-    highlight_rules.clear();
-    const QList<QString>& syntax_keys = getSyntaxConfig().keys();
-    foreach(const QString& id, syntax_keys)
+    for(int type = 0; type <= CTOKEN_PUNCTUATION; ++type)
     {
-        SyntaxConfig config = getSyntaxConfig()[id];
-        HighlightingRule rule;
+        const SyntaxConfig& config = getSyntaxConfig(CTokenType(type));
         QTextCharFormat format;
-        format.setFontWeight(config.is_bold ? QFont::Bold : QFont::Normal);
-        format.setForeground(config.color);
-        rule.pattern = QRegularExpression(config.pattern);
-        rule.format = format;
-        highlight_rules.append(rule);
+        if(config.color.isValid())
+        {
+            format.setFontWeight(config.is_bold ? QFont::Bold : QFont::Normal);
+            format.setForeground(config.color);
+        }
+        token_formats[type] = format;
     }
-    multiline_comment_format.setForeground(getSyntaxConfig()["6_comment"].color);
-    comment_start_expression = QRegularExpression(QStringLiteral("/\\*"));
-    comment_end_expression = QRegularExpression(QStringLiteral("\\*/"));
+
+    const SyntaxConfig& user_type_config = getUserTypeSyntaxConfig();
+    user_type_format.setFontWeight(user_type_config.is_bold ? QFont::Bold : QFont::Normal);
+    user_type_format.setForeground(user_type_config.color);
 }
 
-void CodeHighlighter::highlightBlock(const QString &text)
+void CodeHighlighter::setUserTypes(const QSet<QString>& new_user_types)
 {
-    foreach(const HighlightingRule &rule, highlight_rules)
+    if(user_types != new_user_types)
     {
-        QRegularExpressionMatchIterator it = rule.pattern.globalMatch(text);
-        while (it.hasNext())
-        {
-            QRegularExpressionMatch match = it.next();
-            setFormat(match.capturedStart(), match.capturedLength(), rule.format);
-        }
+        user_types = new_user_types;
+        rehighlight();
     }
+}
 
-    // multi-line comment
-    setCurrentBlockState(0);
+QColor CodeHighlighter::getTokenColor(CTokenType type)
+{
+    return getSyntaxConfig(type).color;
+}
 
-    int start_index = 0;
-    if (previousBlockState() != 1)
-        start_index = text.indexOf(comment_start_expression);
+bool CodeHighlighter::isHighlighted(const QTextBlock& block)
+{
+    CodeBlockData* data = static_cast<CodeBlockData*>(block.userData());
+    return data && data->highlighted;
+}
 
-    while (start_index >= 0)
+void CodeHighlighter::highlightBlock(const QString &text)
+{
+    // The lexer state is always updated so the following blocks start in the right state
+    tokens.clear();
+    setCurrentBlockState(CLexer::tokenize(text.constData(), text.size(), previousBlockState(), tokens));
+
+    // Formatting is left for when the block is scrolled into view
+    const bool highlighted = code_view->isBlockNearViewport(currentBlock().blockNumber());
+    CodeBlockData* data = static_cast<CodeBlockData*>(currentBlockUserData());
+    if(data)
     {
-        QRegularExpressionMatch match = comment_end_expression.match(text, start_index);
-        int end_index = match.capturedStart();
-        int comment_len = 0;
-        if (end_index == -1)
+        data->highlighted = highlighted;
+    }
+    else
+    {
+        setCurrentBlockUserData(new CodeBlockData(highlighted));
+    }
+    if(!highlighted)
+    {
+        return;
+    }
+
+    foreach(const CToken& token, tokens)
+    {
+        if(token.type == CTOKEN_IDENTIFIER && user_types.contains(QString::fromRawData(text.constData() + token.start, token.length)))
         {
-            setCurrentBlockState(1);
-            comment_len = text.length() - start_index;
+            setFormat(token.start, token.length, user_type_format);
         }
-        else
+        else if(token.type != CTOKEN_PUNCTUATION)
         {
-            comment_len = end_index - start_index
-                            + match.capturedLength();
+            setFormat(token.start, token.length, token_formats[token.type]);
         }
-        setFormat(start_index, comment_len, multiline_comment_format);
-        start_index = text.indexOf(comment_start_expression, start_index + comment_len);
     }
 }
 
@@ -137,10 +159,25 @@ CodeView::CodeView(QWidget *parent)
     : QPlainTextEdit(parent)
     , gutter(new CodeViewGutter(this))
     , highlighter(new CodeHighlighter(this, document()))
+    , completer(new QCompleter(this))
+    , completion_model(new QStringListModel(this))
 {
     connect(this, &CodeView::blockCountChanged, this, &CodeView::updateGutterWidth);
     connect(this, &CodeView::updateRequest, this, &CodeView::updateGutter);
 
+    highlight_timer.setSingleShot(true);
+    highlight_timer.setInterval(0);
+    connect(&highlight_timer, &QTimer::timeout, this, &CodeView::highlightVisibleBlocks);
+    connect(verticalScrollBar(), &QScrollBar::valueChanged, &highlight_timer, static_cast<void (QTimer::*)()>(&QTimer::start));
+
+    completer->setWidget(this);
+    completer->setModel(completion_model);
+    completer->setCompletionMode(QCompleter::PopupCompletion);
+    completer->setModelSorting(QCompleter::CaseSensitivelySortedModel);
+    completer->setCaseSensitivity(Qt::CaseSensitive);
+    connect(completer, SIGNAL(activated(QString)), this, SLOT(insertCompletion(QString)));
+    setCompletions(QStringList());
+
     setupFont();
     updateGutterWidth(0);
 }
@@ -155,6 +192,7 @@ void CodeView::setText(const QString& text)
     textCursor().setPosition(0);
     updateGutterWidth(0);
     setPlainText(text);
+    highlight_timer.start();
 }
 
 int CodeView::gutterWidth()
@@ -174,6 +212,141 @@ int CodeView::gutterWidth()
     return qMax(5, digits) * char_width;
 }
 
+bool CodeView::isBlockNearViewport(int block_number)
+{
+    const int first_visible = firstVisibleBlock().blockNumber();
+    const int visible_lines = viewport()->height() / qMax(1, fontMetrics().height()) + 1;
+    return block_number >= first_visible - CODE_HIGHLIGHT_MARGIN_LINES
+        && block_number <= first_visible + visible_lines + CODE_HIGHLIGHT_MARGIN_LINES;
+}
+
+void CodeView::highlightVisibleBlocks()
+{
+    const int first_visible = firstVisibleBlock().blockNumber();
+    QTextBlock block = document()->findBlockByNumber(qMax(0, first_visible - CODE_HIGHLIGHT_MARGIN_LINES));
+    while(block.isValid() && isBlockNearViewport(block.blockNumber()))
+    {
+        if(!CodeHighlighter::isHighlighted(block))
+        {
+            highlighter->rehighlightBlock(block);
+        }
+        block = block.next();
+    }
+}
+
+void CodeView::setUserTypes(const QSet<QString>& user_types)
+{
+    highlighter->setUserTypes(user_types);
+}
+
+void CodeView::setCompletions(const QStringList& words)
+{
+    QStringList list = words + CLexer::getKeywords();
+    list.sort();
+    list.removeDuplicates();
+    completion_model->setStringList(list);
+}
+
+void CodeView::gotoPosition(int line, int column)
+{
+    QTextBlock block = document()->findBlockByNumber(line);
+    if(!block.isValid())
+    {
+        return;
+    }
+    QTextCursor cursor(block);
+    cursor.movePosition(QTextCursor::Right, QTextCursor::MoveAnchor, qMin(column, block.length() - 1));
+    setTextCursor(cursor);
+    centerCursor();
+}
+
+QString CodeView::wordUnderCursor() const
+{
+    QTextCursor cursor = textCursor();
+    cursor.select(QTextCursor::WordUnderCursor);
+    return cursor.selectedText();
+}
+
+// Identifier characters left of the cursor
+QString CodeView::completionPrefix() const
+{
+    const QTextCursor cursor = textCursor();
+    const QString text = cursor.block().text();
+    const int end = cursor.positionInBlock();
+    int start = end;
+    while(start > 0 && (text[start - 1].isLetterOrNumber() || text[start - 1] == '_'))
+    {
+        --start;
+    }
+    return text.mid(start, end - start);
+}
+
+void CodeView::insertCompletion(const QString& completion)
+{
+    QTextCursor cursor = textCursor();
+    cursor.insertText(completion.mid(completer->completionPrefix().size()));
+    setTextCursor(cursor);
+}
+
+void CodeView::keyPressEvent(QKeyEvent *event)
+{
+    // Let the popup take the keys that pick a completion
+    if(completer->popup()->isVisible())
+    {
+        switch(event->key())
+        {
+        case Qt::Key_Enter:
+        case Qt::Key_Return:
+        case Qt::Key_Escape:
+        case Qt::Key_Tab:
+        case Qt::Key_Backtab:
+            event->ignore();
+            return;
+        default:
+            break;
+        }
+    }
+
+    if(event->key() == Qt::Key_F12)
+    {
+        emit definitionRequested(wordUnderCursor());
+        return;
+    }
+
+    const bool shortcut = event->key() == Qt::Key_Space && (event->modifiers() & Qt::ControlModifier);
+    if(!shortcut)
+    {
+        QPlainTextEdit::keyPressEvent(event);
+    }
+
+    const QString prefix = completionPrefix();
+    const QString typed = event->text();
+    const bool typed_word = typed.size() && (typed.at(typed.size() - 1).isLetterOrNumber() || typed.at(typed.size() - 1) == '_');
+    if(!shortcut && (!typed_word || prefix.size() < CODE_COMPLETION_MIN_PREFIX))
+    {
+        completer->popup()->hide();
+        return;
+    }
+
+    if(prefix != completer->completionPrefix())
+    {
+        completer->setCompletionPrefix(prefix);
+        completer->popup()->setCurrentIndex(completer->completionModel()->index(0, 0));
+    }
+    QRect rect = cursorRect();
+    rect.setWidth(completer->popup()->sizeHintForColumn(0) + completer->popup()->verticalScrollBar()->sizeHint().width());
+    completer->complete(rect);
+}
+
+void CodeView::mouseReleaseEvent(QMouseEvent *event)
+{
+    QPlainTextEdit::mouseReleaseEvent(event);
+    if(event->button() == Qt::LeftButton && (event->modifiers() & Qt::ControlModifier) && !textCursor().hasSelection())
+    {
+        emit definitionRequested(wordUnderCursor());
+    }
+}
+
 void CodeView::updateGutterWidth(int /* newBlockCount */)
 {
     setViewportMargins(gutterWidth() + gutter_margin, 0, 0, 0);
@@ -201,6 +374,7 @@ void CodeView::resizeEvent(QResizeEvent *e)
 
     QRect cr = contentsRect();
     gutter->setGeometry(QRect(cr.left(), cr.top(), gutterWidth(), cr.height()));
+    highlight_timer.start();
 }
 
 void CodeView::setupFont()
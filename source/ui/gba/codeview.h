@@ -2,10 +2,20 @@
 #define CODEVIEW_H
 
 #include <QThread>
+#include <QTimer>
 #include <QPlainTextEdit>
 #include <QSyntaxHighlighter>
 #include <QTextCharFormat>
-#include <QRegularExpression>
+#include <QTextBlock>
+#include <QCompleter>
+#include <QStringListModel>
+#include <QSet>
+#include <compiler/clexer.h>
+
+// Blocks this many lines above and below the viewport are highlighted ahead of scrolling
+#define CODE_HIGHLIGHT_MARGIN_LINES 50
+// Typed characters before completions are shown. Ctrl+Space shows them right away
+#define CODE_COMPLETION_MIN_PREFIX 3
 
 class CodeView;
 
@@ -29,20 +39,23 @@ class CodeHighlighter : public QSyntaxHighlighter
 public:
     CodeHighlighter(CodeView* code_view, QTextDocument *parent = nullptr);
     void reset();
+    // Identifiers highlighted as types, such as the typedefs of the game code
+    void setUserTypes(const QSet<QString>& user_types);
+
+    // Invalid for tokens drawn in the text color
+    static QColor getTokenColor(CTokenType type);
+
+    // False when the block was skipped for being outside of the viewport
+    static bool isHighlighted(const QTextBlock& block);
 
 protected:
     void highlightBlock(const QString &text) override;
 
 private:
-    struct HighlightingRule
-    {
-        QRegularExpression pattern;
-        QTextCharFormat format;
-    };
-    QList<HighlightingRule> highlight_rules;
-    QRegularExpression comment_start_expression;
-    QRegularExpression comment_end_expression;
-    QTextCharFormat multiline_comment_format;
+    QTextCharFormat token_formats[CTOKEN_PUNCTUATION + 1];
+    QTextCharFormat user_type_format;
+    QSet<QString> user_types;
+    QVector<CToken> tokens;
     CodeView* code_view;
 };
 
@@ -55,6 +68,9 @@ private:
     CodeViewGutter * gutter;
     const int gutter_margin = 10;
     CodeHighlighter* highlighter;
+    QTimer highlight_timer;
+    QCompleter* completer;
+    QStringListModel* completion_model;
 
 public:
     CodeView(QWidget *parent = nullptr);
@@ -63,14 +79,32 @@ public:
     void setupFont();
     void gutterPaintEvent(QPaintEvent *event);
     int gutterWidth();
+    bool isBlockNearViewport(int block_number);
+
+    void setUserTypes(const QSet<QString>& user_types);
+    // Words offered by the completer, in addition to the C keywords
+    void setCompletions(const QStringList& words);
+    void gotoPosition(int line, int column);
 
 protected:
     void resizeEvent(QResizeEvent *event) override;
+    void keyPressEvent(QKeyEvent *event) override;
+    void mouseReleaseEvent(QMouseEvent *event) override;
+
+private:
+    QString wordUnderCursor() const;
+    QString completionPrefix() const;
+
+signals:
+    // F12 or Ctrl+Click on a word
+    void definitionRequested(QString name);
 
 private slots:
     void setText(const QString& text);
     void updateGutterWidth(int newBlockCount);
     void updateGutter(const QRect &rect, int dy);
+    void highlightVisibleBlocks();
+    void insertCompletion(const QString& completion);
 };
 
 #endif // CODEVIEW_H
@@ -0,0 +1,324 @@
+#include "generatedview.h"
+#include "codeview.h"
+#include <compiler/clexer.h>
+#include <ui/utils.h>
+
+#include <QFile>
+#include <QFileInfo>
+#include <QKeyEvent>
+#include <QPainter>
+#include <QScrollBar>
+#include <string.h>
+
+#define GENERATED_VIEW_TAB_WIDTH    4
+#define GENERATED_VIEW_GUTTER_DIGITS 5
+#define GENERATED_VIEW_GUTTER_MARGIN 10
+
+static QString expandTabs(const QString& text)
+{
+    if(!text.contains('\t'))
+    {
+        return text;
+    }
+
+    QString expanded;
+    expanded.reserve(text.size() + GENERATED_VIEW_TAB_WIDTH * 4);
+    foreach(const QChar c, text)
+    {
+        if(c == '\t')
+        {
+            expanded += QString(GENERATED_VIEW_TAB_WIDTH - expanded.size() % GENERATED_VIEW_TAB_WIDTH, ' ');
+        }
+        else
+        {
+            expanded += c;
+        }
+    }
+    return expanded;
+}
+
+GeneratedFileView::GeneratedFileView(QWidget* parent)
+    : QAbstractScrollArea(parent)
+    , max_line_length(0)
+{
+    QFont font("Monospace");
+    font.setStyleHint(QFont::TypeWriter);
+    setFont(font);
+    setFocusPolicy(Qt::StrongFocus);
+    connect(&watcher, SIGNAL(fileChanged(QString)), this, SLOT(on_fileChanged(QString)));
+}
+
+GeneratedFileView::~GeneratedFileView()
+{
+    close();
+}
+
+bool GeneratedFileView::open(const QString& new_file_path)
+{
+    close();
+    file_path = new_file_path;
+    if(!readFile())
+    {
+        close();
+        return false;
+    }
+    watcher.addPath(file_path);
+
+    verticalScrollBar()->setValue(0);
+    horizontalScrollBar()->setValue(0);
+    viewport()->update();
+    return true;
+}
+
+void GeneratedFileView::close()
+{
+    if(watcher.files().size())
+    {
+        watcher.removePaths(watcher.files());
+    }
+    file_path.clear();
+    data.clear();
+    line_offsets.clear();
+    line_states.clear();
+    max_line_length = 0;
+    updateScrollBars();
+    viewport()->update();
+}
+
+QString GeneratedFileView::getFilePath() const
+{
+    return QFileInfo(file_path).absoluteFilePath();
+}
+
+bool GeneratedFileView::readFile()
+{
+    QFile file(file_path);
+    if(!file.open(QIODevice::ReadOnly))
+    {
+        return false;
+    }
+    data = file.readAll();
+    buildLineIndex();
+    updateScrollBars();
+    return true;
+}
+
+void GeneratedFileView::on_fileChanged(const QString& path)
+{
+    if(path != file_path)
+    {
+        return;
+    }
+
+    // Saves run on this thread, so the rewrite is finished by the time the change is handled.
+    // Keep the scroll position, the export usually changes a few values
+    const int scroll_x = horizontalScrollBar()->value();
+    const int scroll_y = verticalScrollBar()->value();
+    if(!readFile())
+    {
+        data.clear();
+        buildLineIndex();
+        updateScrollBars();
+    }
+    // Replaced instead of rewritten, watch the new file
+    if(!watcher.files().contains(file_path) && QFileInfo(file_path).exists())
+    {
+        watcher.addPath(file_path);
+    }
+    horizontalScrollBar()->setValue(scroll_x);
+    verticalScrollBar()->setValue(scroll_y);
+    viewport()->update();
+}
+
+void GeneratedFileView::buildLineIndex()
+{
+    line_offsets.clear();
+    line_states.clear();
+    max_line_length = 0;
+
+    const qint64 data_size = data.size();
+    line_offsets.reserve(int(data_size / 32) + 2);
+
+    const char* begin = data.constData();
+    qint64 start = 0;
+    while(start < data_size)
+    {
+        const char* newline = static_cast<const char*>(memchr(begin + start, '\n', size_t(data_size - start)));
+        const qint64 end = newline ? newline - begin : data_size;
+        line_offsets.append(start);
+
+        // Tabs are counted at full width, close enough for the scroll range
+        int length = 0;
+        for(qint64 i = start; i < end; ++i)
+        {
+            length += begin[i] == '\t' ? GENERATED_VIEW_TAB_WIDTH : 1;
+        }
+        max_line_length = qMax(max_line_length, length);
+
+        start = end + 1;
+    }
+    line_offsets.append(data_size);
+    line_states.append(CLEX_STATE_NORMAL);
+}
+
+int GeneratedFileView::getLineState(int line)
+{
+    // Lexed from the last known line, so a /* */ comment opened above the view is still highlighted as one
+    QVector<CToken> tokens;
+    while(line_states.size() <= line && line_states.size() <= lineCount())
+    {
+        const int known_line = line_states.size() - 1;
+        const QString text = lineText(known_line);
+        tokens.clear();
+        line_states.append((unsigned char)CLexer::tokenize(text.constData(), text.size(), line_states[known_line], tokens));
+    }
+    return line_states[qMin(line, line_states.size() - 1)];
+}
+
+int GeneratedFileView::lineCount() const
+{
+    return qMax(0, line_offsets.size() - 1);
+}
+
+QString GeneratedFileView::lineText(int line) const
+{
+    if(line < 0 || line >= lineCount())
+    {
+        return QString();
+    }
+
+    const qint64 start = line_offsets[line];
+    qint64 end = line_offsets[line + 1];
+    while(end > start && (data[int(end - 1)] == '\n' || data[int(end - 1)] == '\r'))
+    {
+        --end;
+    }
+    return QString::fromUtf8(data.constData() + start, int(end - start));
+}
+
+void GeneratedFileView::gotoLine(int line)
+{
+    verticalScrollBar()->setValue(line - verticalScrollBar()->pageStep() / 2);
+}
+
+int GeneratedFileView::gutterWidth() const
+{
+    int digits = 1;
+    for(int lines = lineCount(); lines != 0; lines /= 10)
+    {
+        ++digits;
+    }
+    return qMax(GENERATED_VIEW_GUTTER_DIGITS, digits) * Utils::textWidth(fontMetrics(), "9") + GENERATED_VIEW_GUTTER_MARGIN;
+}
+
+void GeneratedFileView::updateScrollBars()
+{
+    const int line_height = qMax(1, fontMetrics().height());
+    const int visible_lines = viewport()->height() / line_height;
+    verticalScrollBar()->setRange(0, qMax(0, lineCount() - visible_lines));
+    verticalScrollBar()->setPageStep(qMax(1, visible_lines));
+    verticalScrollBar()->setSingleStep(1);
+
+    const int char_width = qMax(1, Utils::textWidth(fontMetrics(), "9"));
+    const int content_width = gutterWidth() + max_line_length * char_width;
+    horizontalScrollBar()->setRange(0, qMax(0, content_width - viewport()->width()));
+    horizontalScrollBar()->setPageStep(viewport()->width());
+    horizontalScrollBar()->setSingleStep(char_width);
+}
+
+void GeneratedFileView::paintEvent(QPaintEvent* /*event*/)
+{
+    QPainter painter(viewport());
+    painter.setFont(font());
+
+    const QColor text_color = palette().text().color();
+    const QFontMetrics metrics = fontMetrics();
+    const int line_height = qMax(1, metrics.height());
+    const int gutter_width = gutterWidth();
+    const int scroll_x = horizontalScrollBar()->value();
+    const int first_line = verticalScrollBar()->value();
+    const int last_line = qMin(lineCount(), first_line + viewport()->height() / line_height + 1);
+
+    QVector<CToken> tokens;
+    int state = getLineState(first_line);
+    painter.setClipRect(gutter_width, 0, viewport()->width() - gutter_width, viewport()->height());
+    for(int line = first_line, y = 0; line < last_line; ++line, y += line_height)
+    {
+        const QString text = expandTabs(lineText(line));
+        tokens.clear();
+        const int next_state = CLexer::tokenize(text.constData(), text.size(), state, tokens);
+        if(line + 1 == line_states.size())
+        {
+            line_states.append((unsigned char)next_state);
+        }
+        state = next_state;
+
+        // The lexer only skips whitespace, so the gaps between tokens just advance x
+        const int baseline = y + metrics.ascent();
+        int x = gutter_width - scroll_x;
+        int pos = 0;
+        foreach(const CToken& token, tokens)
+        {
+            if(token.start > pos)
+            {
+                x += Utils::textWidth(metrics, text.mid(pos, token.start - pos));
+            }
+            const QString token_text = text.mid(token.start, token.length);
+            const QColor color = CodeHighlighter::getTokenColor(token.type);
+            painter.setPen(color.isValid() ? color : text_color);
+            painter.drawText(x, baseline, token_text);
+            x += Utils::textWidth(metrics, token_text);
+            pos = token.start + token.length;
+
+            if(x > viewport()->width())
+            {
+                break;
+            }
+        }
+    }
+
+    painter.setClipping(false);
+    painter.setPen(text_color);
+    for(int line = first_line, y = 0; line < last_line; ++line, y += line_height)
+    {
+        painter.drawText(0, y, gutter_width - GENERATED_VIEW_GUTTER_MARGIN, line_height, Qt::AlignRight, QString::number(line + 1));
+    }
+}
+
+void GeneratedFileView::resizeEvent(QResizeEvent* event)
+{
+    QAbstractScrollArea::resizeEvent(event);
+    updateScrollBars();
+}
+
+void GeneratedFileView::keyPressEvent(QKeyEvent* event)
+{
+    switch(event->key())
+    {
+    case Qt::Key_Up:       verticalScrollBar()->triggerAction(QAbstractSlider::SliderSingleStepSub); break;
+    case Qt::Key_Down:     verticalScrollBar()->triggerAction(QAbstractSlider::SliderSingleStepAdd); break;
+    case Qt::Key_PageUp:   verticalScrollBar()->triggerAction(QAbstractSlider::SliderPageStepSub); break;
+    case Qt::Key_PageDown: verticalScrollBar()->triggerAction(QAbstractSlider::SliderPageStepAdd); break;
+    case Qt::Key_Home:     verticalScrollBar()->triggerAction(QAbstractSlider::SliderToMinimum); break;
+    case Qt::Key_End:      verticalScrollBar()->triggerAction(QAbstractSlider::SliderToMaximum); break;
+    case Qt::Key_Left:     horizontalScrollBar()->triggerAction(QAbstractSlider::SliderSingleStepSub); break;
+    case Qt::Key_Right:    horizontalScrollBar()->triggerAction(QAbstractSlider::SliderSingleStepAdd); break;
+    default:
+        QAbstractScrollArea::keyPressEvent(event);
+        break;
+    }
+}
+
+void GeneratedFileView::scrollContentsBy(int /*dx*/, int /*dy*/)
+{
+    viewport()->update();
+}
+
+void GeneratedFileView::changeEvent(QEvent* event)
+{
+    QAbstractScrollArea::changeEvent(event);
+    if(event->type() == QEvent::FontChange)
+    {
+        updateScrollBars();
+    }
+}
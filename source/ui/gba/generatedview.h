@@ -0,0 +1,55 @@
+#ifndef GENERATEDVIEW_H
+#define GENERATEDVIEW_H
+
+#include <QAbstractScrollArea>
+#include <QByteArray>
+#include <QFileSystemWatcher>
+#include <QVector>
+
+// Read-only view of a generated asset source. Only the visible lines are decoded and drawn, so multi megabyte
+// tileset and map sources open without loading them into a text document. The file is read into a private
+// buffer instead of mapped, since the export truncates and rewrites it in place, and read again when it changes
+class GeneratedFileView : public QAbstractScrollArea
+{
+    Q_OBJECT
+
+private:
+    QString file_path;
+    QByteArray data;
+    QFileSystemWatcher watcher;
+    QVector<qint64> line_offsets;   // start of each line, plus the end of the data
+    QVector<unsigned char> line_states; // lexer state at the start of each line, extended as lines are shown
+    int max_line_length;            // in characters with tabs expanded
+
+public:
+    GeneratedFileView(QWidget* parent = nullptr);
+    ~GeneratedFileView();
+
+    bool open(const QString& file_path);
+    void close();
+    QString getFilePath() const;
+
+    int lineCount() const;
+    QString lineText(int line) const;
+    // Scrolls the line into the middle of the view
+    void gotoLine(int line);
+
+protected:
+    void paintEvent(QPaintEvent* event) override;
+    void resizeEvent(QResizeEvent* event) override;
+    void keyPressEvent(QKeyEvent* event) override;
+    void scrollContentsBy(int dx, int dy) override;
+    void changeEvent(QEvent* event) override;
+
+private slots:
+    void on_fileChanged(const QString& path);
+
+private:
+    bool readFile();
+    void buildLineIndex();
+    int getLineState(int line);
+    void updateScrollBars();
+    int gutterWidth() const;
+};
+
+#endif // GENERATEDVIEW_H
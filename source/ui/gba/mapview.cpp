@@ -6,17 +6,77 @@
 #include <QMouseEvent>
 #include <QMessageBox>
 
+MapRenderWorker::MapRenderWorker()
+{
+    latest_request = 0;
+}
+
+void MapRenderWorker::setLatestRequest(int request_id)
+{
+    latest_request.storeRelease(request_id);
+}
+
+bool MapRenderWorker::isStale(int request_id) const
+{
+    return latest_request.loadAcquire() != request_id;
+}
+
+void MapRenderWorker::render(int request_id, MapRenderSnapshot snapshot)
+{
+    if(isStale(request_id))
+    {
+        return;
+    }
+
+    QImage image;
+    if(snapshot.render(image, [this, request_id]() { return isStale(request_id); }))
+    {
+        emit rendered(request_id, image);
+    }
+}
+
 MapModel::MapModel(QObject* parent)
     : TiledImageModel(parent)
     , map(nullptr)
     , tileset(nullptr)
-    , view(nullptr)
+    , cached_map(nullptr)
+    , render_worker(nullptr)
+    , render_request(0)
+    , render_pending(false)
+    , render_ready(false)
+    , render_invalidated(false)
 {
+    static bool register_type = true;
+    if(register_type)
+    {
+        qRegisterMetaType<MapRenderSnapshot>("MapRenderSnapshot");
+        register_type = false;
+    }
+
+    render_worker = new MapRenderWorker();
+    render_worker->moveToThread(&render_thread);
+    connect(this, SIGNAL(renderRequested(int,MapRenderSnapshot)), render_worker, SLOT(render(int,MapRenderSnapshot)));
+    connect(render_worker, SIGNAL(rendered(int,QImage)), this, SLOT(on_rendered(int,QImage)));
+    connect(&render_thread, SIGNAL(finished()), render_worker, SLOT(deleteLater()));
+    render_thread.start();
+}
+
+MapModel::~MapModel()
+{
+    cancelRender();
+    render_thread.quit();
+    render_thread.wait();
 }
+
 void MapModel::setMap(Map* new_map)
 {
     if(map != new_map)
     {
+        // Results and edits of the previous map no longer apply
+        cancelRender();
+        tile_changes.clear();
+        tile_changes_rect = QRect();
+
         map = new_map;
         //if(map)
         //{
@@ -53,6 +113,7 @@ void MapModel::markTileDirty(int tile_x, int tile_y)
     change.tile_x = tile_x;
     change.tile_y = tile_y;
     tile_changes.push_back(change);
+    tile_changes_rect |= QRect(tile_x * GBA_TILE_SIZE, tile_y * GBA_TILE_SIZE, GBA_TILE_SIZE, GBA_TILE_SIZE);
 }
 
 void MapModel::render(QImage& out_image)
@@ -60,36 +121,136 @@ void MapModel::render(QImage& out_image)
     // render map to image, then draw to view
     if(map)
     {
-        if(tile_changes.size())
+        if(render_ready)
         {
-            while(tile_changes.size())
+            render_ready = false;
+            render_invalidated = false;
+            cached_image = rendered_image;
+            cached_map = map;
+            rendered_image = QImage();
+
+            // Edits made after the snapshot was taken
+            foreach(const TileChange& change, tile_changes)
             {
-                TileChange change = tile_changes.back();
-                tile_changes.pop_back();
                 map->renderTile(cached_image, change.tile_x, change.tile_y);
             }
+            tile_changes.clear();
+            tile_changes_rect = QRect();
+            out_image = cached_image;
+        }
+        else if(tile_changes.size() && cached_map == map && !render_invalidated)
+        {
+            foreach(const TileChange& change, tile_changes)
+            {
+                map->renderTile(cached_image, change.tile_x, change.tile_y);
+            }
+            // Kept for the pending render, its snapshot does not have them yet
+            if(!render_pending)
+            {
+                tile_changes.clear();
+                tile_changes_rect = QRect();
+            }
             out_image = cached_image;
         }
         else
         {
-            map->render(out_image);
-            cached_image = out_image;
+            // Redraws for zoom or overlays while the render runs keep waiting for it
+            if(!render_pending || render_invalidated)
+            {
+                requestRender();
+            }
+
+            // Previous frame of this map, or a blank view, until the result arrives
+            out_image = cached_map == map ? cached_image : QImage();
+        }
+    }
+}
+
+void MapModel::invalidate()
+{
+    render_invalidated = true;
+}
+
+void MapModel::invalidateRect(const QRect& rect)
+{
+    // Redrawn over the cached or the pending image like painted tiles, no new render needed.
+    // Strokes mark their tiles before notifying, their rect is already covered
+    if(map == nullptr || tile_changes_rect.contains(rect))
+    {
+        return;
+    }
+    if((rect.width() / GBA_TILE_SIZE + 1) * (rect.height() / GBA_TILE_SIZE + 1) > MAP_MAX_TILE_CHANGES)
+    {
+        render_invalidated = true;
+        return;
+    }
+    for(int tile_y = rect.top() / GBA_TILE_SIZE; tile_y <= rect.bottom() / GBA_TILE_SIZE; ++tile_y)
+    {
+        for(int tile_x = rect.left() / GBA_TILE_SIZE; tile_x <= rect.right() / GBA_TILE_SIZE; ++tile_x)
+        {
+            markTileDirty(tile_x, tile_y);
         }
     }
 }
 
+void MapModel::on_rendered(int request_id, QImage image)
+{
+    if(request_id != render_request || !render_pending)
+    {
+        return;
+    }
+
+    // The map changed since the snapshot was taken, the result is already stale
+    if(render_invalidated)
+    {
+        requestRender();
+        return;
+    }
+
+    render_pending = false;
+    render_ready = true;
+    rendered_image = image;
+    if(view)
+    {
+        view->invalidate();
+        view->redraw();
+    }
+}
+
+void MapModel::requestRender()
+{
+    ++render_request;
+    render_pending = true;
+    render_ready = false;
+    render_invalidated = false;
+    render_worker->setLatestRequest(render_request);
+    emit renderRequested(render_request, map->getRenderSnapshot());
+}
+
+void MapModel::cancelRender()
+{
+    ++render_request;
+    render_pending = false;
+    render_ready = false;
+    render_invalidated = false;
+    rendered_image = QImage();
+    render_worker->setLatestRequest(render_request);
+}
+
 MapView::MapView(QWidget* parent)
     : TiledImageView(parent)
     , model( nullptr)
     , dragging(false)
 {
-
-    //setThreaded(true);
     QGraphicsScene* scene = new QGraphicsScene(parent);
     scene->setBackgroundBrush(Qt::transparent);
 
     setScene(scene);
     setAlignment(Qt::AlignLeft | Qt::AlignTop);
+
+    stroke_timer.setSingleShot(true);
+    stroke_timer.setInterval(MAP_STROKE_FLUSH_MSEC);
+    connect(&stroke_timer, SIGNAL(timeout()), this, SLOT(on_flushStroke()));
 }
 
 void MapView::mouseMoveEvent(QMouseEvent* event)
@@ -100,38 +261,91 @@ void MapView::mouseMoveEvent(QMouseEvent* event)
         return;
     }
 
-    static int px = 0, py = 0;
     int x,y;
     TiledImageView::getCellXY(event, x,y);
 
-    if(px != x || py != y)
+    // Fill in the cells skipped between two mouse samples, so fast drags leave no gaps
+    const QPoint cell(x, y);
+    if(cell == last_cell)
     {
-        placeTileAt(x, y);
-        px = x; py = y;
+        return;
     }
+
+    int dx = qAbs(cell.x() - last_cell.x());
+    int dy = -qAbs(cell.y() - last_cell.y());
+    const int step_x = last_cell.x() < cell.x() ? 1 : -1;
+    const int step_y = last_cell.y() < cell.y() ? 1 : -1;
+    int error = dx + dy;
+
+    QPoint point = last_cell;
+    while(point != cell)
+    {
+        const int error2 = 2 * error;
+        if(error2 >= dy)
+        {
+            error += dy;
+            point.rx() += step_x;
+        }
+        if(error2 <= dx)
+        {
+            error += dx;
+            point.ry() += step_y;
+        }
+        paintCell(point);
+    }
+    last_cell = cell;
 }
 
-void MapView::placeTileAt(int x, int y)
+void MapView::paintCell(const QPoint& cell)
 {
-    emit clicked(x,y);
+    stroke_cells.append(cell);
+    if(!stroke_timer.isActive())
+    {
+        stroke_timer.start();
+    }
+}
+
+void MapView::on_flushStroke()
+{
+    stroke_timer.stop();
+    if(stroke_cells.isEmpty())
+    {
+        return;
+    }
+
+    QVector<QPoint> cells;
+    cells.swap(stroke_cells);
+    emit stroked(cells);
     redraw();
 }
 
 void MapView::mouseReleaseEvent(QMouseEvent* event)
 {
-    if (event->button() == Qt::LeftButton)
+    if (event->button() == Qt::LeftButton && dragging)
     {
         dragging = false;
+        on_flushStroke();
+        emit strokeFinished();
     }
 }
 
 void MapView::mousePressEvent(QMouseEvent* event)
 {
+    int x,y;
+    TiledImageView::getCellXY(event, x,y);
+    last_cell = QPoint(x, y);
+
+    // Other buttons place a single tile
+    emit strokeStarted();
+    paintCell(last_cell);
+    on_flushStroke();
+
     if (event->button() == Qt::LeftButton)
     {
         dragging = true;
     }
-    int x,y;
-    TiledImageView::getCellXY(event, x,y);
-    placeTileAt(x, y);
+    else
+    {
+        emit strokeFinished();
+    }
 }
@@ -4,6 +4,36 @@
 #include <gba/map.h>
 #include <ui/gba/tiledimageview.h>
 
+#include <QAtomicInt>
+#include <QThread>
+#include <QTimer>
+
+// Cells painted while dragging are applied to the map at most once per display refresh
+#define MAP_STROKE_FLUSH_MSEC 16
+// Larger invalidated areas are rendered again off the GUI thread instead of tile by tile
+#define MAP_MAX_TILE_CHANGES 1024
+
+// Renders map snapshots off the GUI thread. Requests older than the latest one are skipped or abandoned
+class MapRenderWorker : public QObject
+{
+    Q_OBJECT
+private:
+    QAtomicInt latest_request;
+
+public:
+    MapRenderWorker();
+
+    // Thread safe. Any request before request_id is stale
+    void setLatestRequest(int request_id);
+    bool isStale(int request_id) const;
+
+public slots:
+    void render(int request_id, MapRenderSnapshot snapshot);
+
+signals:
+    void rendered(int request_id, QImage image);
+};
+
 class MapModel : public TiledImageModel
 {
     Q_OBJECT
@@ -12,24 +42,47 @@ private:
     Map* map;
     Tileset* tileset; //cached previous tileset
     QImage cached_image;
+    Map* cached_map;    // map shown in cached_image
 
     friend class MapView;
-    class MapView* view;
 
     struct TileChange
     {
         int tile_x, tile_y;
     };
     QVector<TileChange> tile_changes;
+    QRect tile_changes_rect;    // bounds of tile_changes in pixels
+
+    // Full renders run on render_thread. The view shows the previous frame until the result arrives
+    QThread render_thread;
+    MapRenderWorker* render_worker;
+    int render_request;
+    bool render_pending;
+    bool render_ready;
+    bool render_invalidated;    // the view dropped its image since the pending request
+    QImage rendered_image;
 
 public:
     MapModel(QObject* parent);
+    ~MapModel();
     void setMap(Map* map);
     Map* getMap() const;
 
     void markTileDirty(int tile_x, int tile_y);
 
-    void render(QImage& out_image);
+    void render(QImage& out_image) override;
+    void invalidate() override;
+    void invalidateRect(const QRect& rect) override;
+
+signals:
+    void renderRequested(int request_id, MapRenderSnapshot snapshot);
+
+private slots:
+    void on_rendered(int request_id, QImage image);
+
+private:
+    void requestRender();
+    void cancelRender();
 };
 
 class MapView : public TiledImageView
@@ -40,8 +93,11 @@ private:
     MapModel* model;
 
     bool dragging;
+    QPoint last_cell;
+    QVector<QPoint> stroke_cells;   // painted since the last flush
+    QTimer stroke_timer;
 
-    void placeTileAt(int x, int y);
+    void paintCell(const QPoint& cell);
 public:
     MapView(QWidget* parent);
 
@@ -50,8 +106,13 @@ public:
     void mouseMoveEvent(QMouseEvent* event);
 
 signals:
-    void clicked(int image_x, int image_y);
+    // A stroke is one press to release. Its cells arrive in batches through stroked
+    void strokeStarted();
+    void stroked(QVector<QPoint> cells);
+    void strokeFinished();
 
+private slots:
+    void on_flushStroke();
 };
 
 #endif
@@ -11,6 +11,11 @@ SpriteModel::SpriteModel(QObject* parent)
     : TiledImageModel(parent)
 {
     frame = -1;
+    spriteanim = nullptr;
+    cached_spritesheet = nullptr;
+    cached_revision = 0;
+    cached_sprite_width = 0;
+    cached_sprite_height = 0;
     connect(&timer, SIGNAL(timeout()), this, SLOT(on_nextFrame()));
 }
 
@@ -77,7 +82,7 @@ void SpriteModel::render(QImage& out_image)
             const int default_frame = spriteanim->getFrame(0);
             const bool hflip = spriteanim->getHFlip();
             const bool vflip = spriteanim->getVFlip();
-            spritesheet->renderFrame(out_image, default_frame, hflip, vflip);
+            out_image = getFrameImage(spritesheet, default_frame, hflip, vflip);
         }
 
         view->clear();
@@ -89,10 +94,35 @@ void SpriteModel::render(QImage& out_image)
         int current_frame_index = spriteanim->getFrame(frame);
         const bool hflip = spriteanim->getHFlip();
         const bool vflip = spriteanim->getVFlip();
-        spritesheet->renderFrame(out_image, current_frame_index, hflip, vflip);
+        out_image = getFrameImage(spritesheet, current_frame_index, hflip, vflip);
     }
 }
 
+QImage SpriteModel::getFrameImage(SpriteSheet* spritesheet, int frame_index, bool hflip, bool vflip)
+{
+    if(spritesheet != cached_spritesheet
+    || spritesheet->getRevision() != cached_revision
+    || spritesheet->getSpriteWidth() != cached_sprite_width
+    || spritesheet->getSpriteHeight() != cached_sprite_height)
+    {
+        frame_cache.clear();
+        cached_spritesheet = spritesheet;
+        cached_revision = spritesheet->getRevision();
+        cached_sprite_width = spritesheet->getSpriteWidth();
+        cached_sprite_height = spritesheet->getSpriteHeight();
+    }
+
+    const int key = (frame_index << 2) | (hflip ? 2 : 0) | (vflip ? 1 : 0);
+    QHash<int, QImage>::iterator it = frame_cache.find(key);
+    if(it == frame_cache.end())
+    {
+        QImage frame_image;
+        spritesheet->renderFrame(frame_image, frame_index, hflip, vflip);
+        it = frame_cache.insert(key, frame_image);
+    }
+    return it.value();
+}
+
 void SpriteModel::on_nextFrame()
 {
     // not visible
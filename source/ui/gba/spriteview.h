@@ -2,6 +2,7 @@
 #define SPRITEVIEW_H
 
 #include <QVector>
+#include <QHash>
 #include <QTimer>
 #include <gba/spriteanim.h>
 #include <gba/spritesheet.h>
@@ -16,6 +17,15 @@ private:
     SpriteAnim* spriteanim;
     QTimer timer;
 
+    // Rendered frames keyed by frame index and flips. Playback only swaps the shared images,
+    // so the view finds their pixmaps already uploaded. Dropped when the spritesheet changes
+    QHash<int, QImage> frame_cache;
+    SpriteSheet* cached_spritesheet;
+    quint64 cached_revision;
+    int cached_sprite_width, cached_sprite_height;
+
+    QImage getFrameImage(SpriteSheet* spritesheet, int frame_index, bool hflip, bool vflip);
+
 public:
     SpriteModel(QObject* parent);
 
@@ -1,113 +1,156 @@
 #include "tiledimageview.h"
+#include <trace.h>
+#include <ui/utils.h>
 #include <QMouseEvent>
 #include <QScrollBar>
-#include <QGraphicsPixmapItem>
 #include <QPainter>
+#include <QPixmapCache>
 
 #define GRID_LINE_WIDTH 1
 
-static void renderGrid(QImage& image, int grid_size_x, int grid_size_y, QColor grid_color)
+// Overlays are drawn in view pixels, so lines and labels stay sharp at any zoom. Only the exposed rect is drawn
+static void renderGrid(QPainter* painter, const QRectF& rect, qreal cell_width, qreal cell_height, qreal width, qreal height, QColor grid_color)
 {
-    if(grid_size_x < 0 || grid_size_y < 0)
+    if(cell_width <= 0 || cell_height <= 0)
         return;
 
-    QPainter painter( &image);
-    painter.setPen(QPen(grid_color, GRID_LINE_WIDTH));
+    painter->setPen(QPen(grid_color, GRID_LINE_WIDTH));
 
-    QVector<QLine> lines;
-    lines.reserve(image.width() / grid_size_x + image.height() / grid_size_y);
+    const qreal left = qMax<qreal>(rect.left(), 0);
+    const qreal top = qMax<qreal>(rect.top(), 0);
+    const qreal right = qMin(rect.right(), width);
+    const qreal bottom = qMin(rect.bottom(), height);
 
-    for (int y = 0; y < image.height(); y += grid_size_y)
+    QVector<QLineF> lines;
+    lines.reserve(int(rect.width() / cell_width) + int(rect.height() / cell_height) + 4);
+
+    for (int y = int(top / cell_height); y * cell_height <= bottom; y++)
     {
-        QLine line = QLine(0, y, image.width(), y);
-        lines.push_back(line);
+        lines.push_back(QLineF(left, y * cell_height, right, y * cell_height));
     }
 
-    for (int x = 0; x < image.width(); x += grid_size_x)
+    for (int x = int(left / cell_width); x * cell_width <= right; x++)
     {
-        QLine line = QLine(x, 0, x, image.height());
-        lines.push_back(line);
+        lines.push_back(QLineF(x * cell_width, top, x * cell_width, bottom));
     }
-    painter.drawLines(lines);
+    painter->drawLines(lines);
 }
 
-static void renderTileIndices(QImage& image, int grid_size_x, int grid_size_y, QColor text_fg_color, QColor text_bg_color)
-{
-    if(grid_size_x < 0 || grid_size_y < 0)
-        return;
+#define INDEX_FONT_NAME "Arial"
+#define INDEX_FONT_PIXEL_SIZE 9
 
-    QFont font = QFont("Arial");
-    font.setPixelSize(9);
-
-    QPainter painter( &image);
-    painter.setFont( font );
-    painter.setPen(text_fg_color);
+// The digits 0-9 rendered once into one image. Labels are blitted digit by digit instead of laid out as text
+struct TileIndexGlyphs
+{
+    QImage atlas;
+    int digit_x[10];
+    int digit_width[10];
+    int max_digit_width;
+    int height;
+};
 
-    int tiles_w =  image.width() / grid_size_x;
-    int tiles_h =  image.height() / grid_size_y;
-    int tile_count = tiles_w * tiles_h;
+static const TileIndexGlyphs& getTileIndexGlyphs(QColor text_fg_color)
+{
+    // Label size does not follow the zoom, so one atlas per color is enough
+    static QHash<QRgb, TileIndexGlyphs> glyph_cache;
+    QHash<QRgb, TileIndexGlyphs>::iterator it = glyph_cache.find(text_fg_color.rgba());
+    if(it != glyph_cache.end())
+    {
+        return it.value();
+    }
 
-    QRect rect = QFontMetrics(font).boundingRect(QString::number(tile_count-1));
+    QFont font = QFont(INDEX_FONT_NAME);
+    font.setPixelSize(INDEX_FONT_PIXEL_SIZE);
+    QFontMetrics metrics(font);
 
-    for (int tx = 0; tx < tiles_w; tx++)
+    TileIndexGlyphs glyphs;
+    glyphs.height = metrics.height();
+    glyphs.max_digit_width = 0;
+    int atlas_width = 0;
+    for(int digit = 0; digit < 10; ++digit)
     {
-        for (int ty = 0; ty < tiles_h; ty++)
-        {
-            int tile_index = ty * tiles_w + tx;
-            QString text = QString::number(tile_index);
+        glyphs.digit_x[digit] = atlas_width;
+        glyphs.digit_width[digit] = Utils::textWidth(metrics, QString(QChar('0' + digit)));
+        glyphs.max_digit_width = qMax(glyphs.max_digit_width, glyphs.digit_width[digit]);
+        atlas_width += glyphs.digit_width[digit];
+    }
 
-            int x = tx * grid_size_x;
-            int y = ty * grid_size_y;
-            rect.moveTo(x+1,y+1);
+    glyphs.atlas = QImage(atlas_width, glyphs.height, QImage::Format_ARGB32_Premultiplied);
+    glyphs.atlas.fill(Qt::transparent);
 
-            painter.fillRect(rect, text_bg_color);
-            painter.drawText(rect, Qt::AlignLeft, text );
-        }
+    QPainter painter(&glyphs.atlas);
+    painter.setFont(font);
+    painter.setPen(text_fg_color);
+    for(int digit = 0; digit < 10; ++digit)
+    {
+        painter.drawText(glyphs.digit_x[digit], metrics.ascent(), QString(QChar('0' + digit)));
     }
+    painter.end();
+
+    return glyph_cache.insert(text_fg_color.rgba(), glyphs).value();
 }
 
-static void renderCellHighlight(QImage& image, int grid_size_x, int grid_size_y, QColor highlight_color, int highlight_x, int highlight_y)
+static void renderTileIndices(QPainter* painter, const QRectF& rect, qreal cell_width, qreal cell_height, int tiles_w, int tiles_h, QColor text_fg_color, QColor text_bg_color)
 {
-    if(highlight_x != -1 && highlight_y != -1)
-    {
-        QPainter painter( &image);
-        painter.setPen(QPen(highlight_color, GRID_LINE_WIDTH));
-        painter.drawRect(highlight_x * grid_size_x, highlight_y * grid_size_y, grid_size_x, grid_size_y);
+    if(cell_width <= 0 || cell_height <= 0 || tiles_w <= 0 || tiles_h <= 0)
         return;
 
-        int x1 = highlight_x*grid_size_x;
-        int y1 = highlight_y*grid_size_y;
-        int x2 = x1 + grid_size_x;
-        int y2 = y1 + grid_size_y;
+    const TileIndexGlyphs& glyphs = getTileIndexGlyphs(text_fg_color);
 
-        if(x2 > image.width()-1)
-        {
-            --grid_size_x;
-        }
+    int tile_count = tiles_w * tiles_h;
 
-        if(y2 > image.height()-1)
-        {
-            --grid_size_y;
-        }
+    // Every label gets the background of the widest index
+    QRect text_rect(0, 0, QString::number(tile_count-1).size() * glyphs.max_digit_width, glyphs.height);
+
+    // Labels of tiles left or above the rect may still reach into it
+    const int tx_begin = qMax(0, int((rect.left() - text_rect.width()) / cell_width));
+    const int ty_begin = qMax(0, int((rect.top() - text_rect.height()) / cell_height));
+    const int tx_end = qMin(tiles_w, int(rect.right() / cell_width) + 1);
+    const int ty_end = qMin(tiles_h, int(rect.bottom() / cell_height) + 1);
 
-        for (int y = y1; y <= y2; y += grid_size_y)
+    char digits[16];
+    for (int tx = tx_begin; tx < tx_end; tx++)
+    {
+        for (int ty = ty_begin; ty < ty_end; ty++)
         {
-            for (int x = x1; x <= x2; x++)
+            int tile_index = ty * tiles_w + tx;
+
+            int x = int(tx * cell_width);
+            int y = int(ty * cell_height);
+            text_rect.moveTo(x+1,y+1);
+
+            painter->fillRect(text_rect, text_bg_color);
+
+            // Digits come out least significant first
+            int digit_count = 0;
+            do
             {
-                image.setPixel(x, y, highlight_color.rgba());
+                digits[digit_count++] = tile_index % 10;
+                tile_index /= 10;
             }
-        }
+            while(tile_index > 0);
 
-        for (int x = x1; x <= x2; x += grid_size_x)
-        {
-            for (int y = y1; y <= y2; y++)
+            int glyph_x = text_rect.x();
+            while(digit_count > 0)
             {
-                image.setPixel(x, y, highlight_color.rgba());
+                const int digit = digits[--digit_count];
+                painter->drawImage(glyph_x, text_rect.y(), glyphs.atlas, glyphs.digit_x[digit], 0, glyphs.digit_width[digit], glyphs.height);
+                glyph_x += glyphs.digit_width[digit];
             }
         }
     }
 }
 
+static void renderCellHighlight(QPainter* painter, qreal cell_width, qreal cell_height, QColor highlight_color, int highlight_x, int highlight_y)
+{
+    if(highlight_x != -1 && highlight_y != -1)
+    {
+        painter->setPen(QPen(highlight_color, GRID_LINE_WIDTH));
+        painter->setBrush(Qt::NoBrush);
+        painter->drawRect(QRectF(highlight_x * cell_width, highlight_y * cell_height, cell_width, cell_height));
+    }
+}
+
 TileImageViewDrawProperties::TileImageViewDrawProperties():
     zoom(2),
     grid_color(QColor(128, 32, 32, 128)),
@@ -118,6 +161,8 @@ TileImageViewDrawProperties::TileImageViewDrawProperties():
     indices_enabled(false),
     grid_size_x(8),
     grid_size_y(8),
+    cell_highlight_x(-1),
+    cell_highlight_y(-1),
     mouse_cell_highlight(true),
     mouse_cell_x(0),
     mouse_cell_y(0)
@@ -156,6 +201,14 @@ void TiledImageModel::render(QImage& out_image)
     }
 }
 
+void TiledImageModel::invalidate()
+{
+}
+
+void TiledImageModel::invalidateRect(const QRect&)
+{
+}
+
 TiledImageView::TiledImageView(QWidget* parent):
     QGraphicsView(parent),
     model(nullptr),
@@ -163,6 +216,8 @@ TiledImageView::TiledImageView(QWidget* parent):
 {    
     source_width = 0;
     source_height = 0;
+    chunk_columns = 0;
+    chunk_rows = 0;
 
     QGraphicsScene* scene = new QGraphicsScene(this);
     scene->setBackgroundBrush(Qt::transparent);
@@ -197,61 +252,69 @@ TiledImageModel* TiledImageView::getModel()
 
 void TiledImageView::clear()
 {
-    cached_pixmap = QPixmap(0, 0);
-    scene()->clear();
+    chunk_pixmaps.clear();
+    chunk_dirty.clear();
+    chunk_columns = 0;
+    chunk_rows = 0;
+    scene()->setSceneRect(QRectF(0, 0, 0, 0));
+    viewport()->update();
 }
 
 void TiledImageView::invalidate()
 {
     cached_image = QImage(0, 0, QImage::Format_ARGB32);
+    dirty_rect = QRect();
+    if(model)
+    {
+        model->invalidate();
+    }
+}
+
+void TiledImageView::invalidateRect(const QRect& rect)
+{
+    dirty_rect |= rect;
+    if(model)
+    {
+        model->invalidateRect(rect);
+    }
 }
 
 void TiledImageView::invalidateOverlay()
 {
-    cached_overlay = QImage(0, 0, QImage::Format_ARGB32);
+    overlay_chunks.clear();
+    viewport()->update();
 }
 
 void TiledImageView::redraw()
 {
+    TRACE_SCOPE("render", "TiledImageView::redraw");
     if(model == nullptr)
     {
         clear();
         return;
     }
 
-    cached_pixmap = QPixmap(0, 0);   // force realloc
-    if(cached_image.width() == 0 || cached_image.height() == 0)
+    // Zoom only changes the painter scale, the image is re-rendered when invalidated
+    const bool full_render = cached_image.width() == 0 || cached_image.height() == 0;
+    if(full_render || !dirty_rect.isEmpty())
     {
+        const QSize previous_size(source_width, source_height);
         render();
-    }
-
-    const int scaled_width = source_width * properties.zoom;
-    const int scaled_height = source_height * properties.zoom;
-    if(scaled_width != cached_image.width() && scaled_height != cached_image.height())
-    {
-        cached_image = cached_image.scaled(scaled_width, scaled_height, Qt::IgnoreAspectRatio, Qt::FastTransformation);
-        invalidateOverlay();
-    }
 
-    const int target_pixmap_width = cached_image.width() + GRID_LINE_WIDTH;
-    const int target_pixmap_height = cached_image.height() + GRID_LINE_WIDTH;
-    if(cached_pixmap.width() != target_pixmap_width || cached_pixmap.height() != target_pixmap_height)
-    {
-        cached_pixmap = QPixmap(target_pixmap_width, target_pixmap_height);
-        cached_pixmap.fill(Qt::transparent); // force alpha channel
+        if(full_render || cached_image.size() != previous_size)
+            resetChunks();
+        else
+            markChunksDirty(dirty_rect);
+        dirty_rect = QRect();
     }
 
-    draw(cached_image, GRID_LINE_WIDTH, GRID_LINE_WIDTH);
-
-    if(cached_overlay.width() != cached_image.width() && cached_overlay.height() != cached_image.width())
+    if(chunk_pixmaps.isEmpty())
     {
-        renderOverlay();
+        resetChunks();
     }
 
-    draw(cached_overlay);
-
-    scene()->clear();
-    scene()->addPixmap(cached_pixmap);
+    updateSceneRect();
+    viewport()->update();
 }
 
 void TiledImageView::zoomBy(int delta)
@@ -303,6 +366,10 @@ int TiledImageView::getGridSizeY()
 
 void TiledImageView::setGrid(QColor grid_color, int grid_size_x, int grid_size_y)
 {
+    if(properties.grid_color != grid_color || properties.grid_size_x != grid_size_x || properties.grid_size_y != grid_size_y)
+    {
+        invalidateOverlay();
+    }
     properties.grid_color = grid_color;
     properties.grid_size_x = grid_size_x;
     properties.grid_size_y = grid_size_y;
@@ -310,41 +377,56 @@ void TiledImageView::setGrid(QColor grid_color, int grid_size_x, int grid_size_y
 
 void TiledImageView::setGridEnabled(bool is_enabled)
 {
+    if(properties.grid_enabled != is_enabled)
+    {
+        invalidateOverlay();
+    }
     properties.grid_enabled = is_enabled;
 }
 
 void TiledImageView::setMouseHighlightEnabled(bool is_enabled)
 {
+    if(properties.mouse_cell_highlight != is_enabled)
+    {
+        updateCell(properties.mouse_cell_x, properties.mouse_cell_y);
+    }
     properties.mouse_cell_highlight = is_enabled;
 }
 
 void TiledImageView::toggleGrid()
 {
     properties.grid_enabled = !properties.grid_enabled;
+    invalidateOverlay();
 }
 
 void TiledImageView::setIndicesEnabled(bool is_enabled)
 {
+    if(properties.indices_enabled != is_enabled)
+    {
+        invalidateOverlay();
+    }
     properties.indices_enabled = is_enabled;
 }
 
 void TiledImageView::toggleIndices()
 {
     properties.indices_enabled = !properties.indices_enabled;
+    invalidateOverlay();
 }
 
 void TiledImageView::clearCellHighlight()
 {
+    updateCell(properties.cell_highlight_x, properties.cell_highlight_y);
     properties.cell_highlight_x = -1;
     properties.cell_highlight_y = -1;
-    invalidateOverlay();
 }
 
 void TiledImageView::setCellHighlight(int cellx, int celly)
 {
+    updateCell(properties.cell_highlight_x, properties.cell_highlight_y);
     properties.cell_highlight_x = cellx;
     properties.cell_highlight_y = celly;
-    invalidateOverlay();
+    updateCell(cellx, celly);
 }
 
 void TiledImageView::keyPressEvent(QKeyEvent *event)
@@ -389,20 +471,32 @@ void TiledImageView::wheelEvent(QWheelEvent *event)
 
 void TiledImageView::mouseMoveEvent( QMouseEvent *event )
 {
-    TiledImageView::getCellXY(event, properties.mouse_cell_x,properties.mouse_cell_y);
-    if(properties.mouse_cell_highlight)
+    int cellx, celly;
+    TiledImageView::getCellXY(event, cellx, celly);
+    if(cellx != properties.mouse_cell_x || celly != properties.mouse_cell_y)
     {
-        invalidateOverlay();
-        redraw();
+        // Only the previous and the new hover cell are repainted
+        if(properties.mouse_cell_highlight)
+        {
+            updateCell(properties.mouse_cell_x, properties.mouse_cell_y);
+            updateCell(cellx, celly);
+        }
+        properties.mouse_cell_x = cellx;
+        properties.mouse_cell_y = celly;
     }
     QWidget::mouseMoveEvent( event );
 }
 
-void TiledImageView::draw(const QImage& image, int x, int y)
+void TiledImageView::drawBackground(QPainter* painter, const QRectF& rect)
 {
-    QPainter painter(&cached_pixmap);
-    painter.setCompositionMode(QPainter::CompositionMode_SourceOver);
-    painter.drawImage(x, y, image);
+    QGraphicsView::drawBackground(painter, rect);
+    renderImage(painter, rect);
+}
+
+void TiledImageView::drawForeground(QPainter* painter, const QRectF& rect)
+{
+    QGraphicsView::drawForeground(painter, rect);
+    renderOverlay(painter, rect);
 }
 
 void TiledImageView::render()
@@ -413,29 +507,182 @@ void TiledImageView::render()
     source_height = cached_image.height();
 }
 
-void TiledImageView::renderOverlay()
+void TiledImageView::resetChunks()
+{
+    chunk_columns = (source_width + TILED_VIEW_CHUNK_SIZE - 1) / TILED_VIEW_CHUNK_SIZE;
+    chunk_rows = (source_height + TILED_VIEW_CHUNK_SIZE - 1) / TILED_VIEW_CHUNK_SIZE;
+    chunk_pixmaps = QVector<QPixmap>(chunk_columns * chunk_rows);
+    chunk_dirty = QVector<bool>(chunk_columns * chunk_rows, true);
+}
+
+void TiledImageView::markChunksDirty(const QRect& rect)
 {
-    const int width = cached_image.width() + GRID_LINE_WIDTH;
-    const int height = cached_image.height() + GRID_LINE_WIDTH;
+    const QRect source_rect = rect & QRect(0, 0, source_width, source_height);
+    if(source_rect.isEmpty())
+    {
+        return;
+    }
 
-    // draw overlay
-    cached_overlay = QImage(width, height, QImage::Format_ARGB32);
-    cached_overlay.fill(Qt::transparent);
+    for(int chunk_y = source_rect.top() / TILED_VIEW_CHUNK_SIZE; chunk_y <= source_rect.bottom() / TILED_VIEW_CHUNK_SIZE; ++chunk_y)
+    {
+        for(int chunk_x = source_rect.left() / TILED_VIEW_CHUNK_SIZE; chunk_x <= source_rect.right() / TILED_VIEW_CHUNK_SIZE; ++chunk_x)
+        {
+            chunk_dirty[chunk_y * chunk_columns + chunk_x] = true;
+        }
+    }
+}
 
-    int grid_size_x_scale = properties.grid_size_x * properties.zoom;
-    int grid_size_y_scale = properties.grid_size_y * properties.zoom;
+const QPixmap& TiledImageView::getChunkPixmap(int chunk_x, int chunk_y)
+{
+    const int index = chunk_y * chunk_columns + chunk_x;
+    if(chunk_dirty[index])
+    {
+        chunk_dirty[index] = false;
+
+        // Small images are uploaded once per cache key. Models that hand out the same shared
+        // image again, like the frames of a sprite animation, skip the upload
+        if(chunk_columns == 1 && chunk_rows == 1)
+        {
+            const QString pixmap_key = "tiledimageview_" + QString::number(cached_image.cacheKey());
+            if(!QPixmapCache::find(pixmap_key, &chunk_pixmaps[index]))
+            {
+                chunk_pixmaps[index] = QPixmap::fromImage(cached_image);
+                QPixmapCache::insert(pixmap_key, chunk_pixmaps[index]);
+            }
+            return chunk_pixmaps[index];
+        }
+
+        const QRect chunk_rect(chunk_x * TILED_VIEW_CHUNK_SIZE, chunk_y * TILED_VIEW_CHUNK_SIZE, TILED_VIEW_CHUNK_SIZE, TILED_VIEW_CHUNK_SIZE);
+        chunk_pixmaps[index] = QPixmap::fromImage(cached_image.copy(chunk_rect & cached_image.rect()));
+    }
+    return chunk_pixmaps[index];
+}
+
+const QPixmap& TiledImageView::getOverlayChunk(int chunk_x, int chunk_y)
+{
+    const quint64 key = (quint64(chunk_y) << 32) | quint32(chunk_x);
+    QHash<quint64, QPixmap>::iterator it = overlay_chunks.find(key);
+    if(it != overlay_chunks.end())
+    {
+        return it.value();
+    }
+
+    QPixmap pixmap(TILED_VIEW_OVERLAY_CHUNK_SIZE, TILED_VIEW_OVERLAY_CHUNK_SIZE);
+    pixmap.fill(Qt::transparent);
+
+    const QRectF chunk_rect(chunk_x * TILED_VIEW_OVERLAY_CHUNK_SIZE, chunk_y * TILED_VIEW_OVERLAY_CHUNK_SIZE,
+                            TILED_VIEW_OVERLAY_CHUNK_SIZE, TILED_VIEW_OVERLAY_CHUNK_SIZE);
+    const qreal width = source_width * properties.zoom + GRID_LINE_WIDTH;
+    const qreal height = source_height * properties.zoom + GRID_LINE_WIDTH;
+    const qreal grid_size_x_scale = properties.grid_size_x * properties.zoom;
+    const qreal grid_size_y_scale = properties.grid_size_y * properties.zoom;
+
+    QPainter painter(&pixmap);
+    painter.translate(-chunk_rect.topLeft());
 
     if (properties.grid_enabled)
-        renderGrid(cached_overlay, grid_size_x_scale, grid_size_y_scale, properties.grid_color);
+        renderGrid(&painter, chunk_rect, grid_size_x_scale, grid_size_y_scale, width, height, properties.grid_color);
 
-    if(properties.indices_enabled)
-        renderTileIndices(cached_overlay, grid_size_x_scale, grid_size_y_scale, properties.text_fg_color, properties.text_bg_color);
+    if(properties.indices_enabled && properties.grid_size_x > 0 && properties.grid_size_y > 0)
+        renderTileIndices(&painter, chunk_rect, grid_size_x_scale, grid_size_y_scale, source_width / properties.grid_size_x, source_height / properties.grid_size_y, properties.text_fg_color, properties.text_bg_color);
 
-    renderCellHighlight(cached_overlay, grid_size_x_scale, grid_size_y_scale, properties.highlight_color, properties.cell_highlight_x, properties.cell_highlight_y);
+    painter.end();
+    return overlay_chunks.insert(key, pixmap).value();
+}
 
-    if(properties.mouse_cell_highlight)
-        renderCellHighlight(cached_overlay, grid_size_x_scale, grid_size_y_scale, properties.highlight_color, properties.mouse_cell_x, properties.mouse_cell_y);
+void TiledImageView::updateSceneRect()
+{
+    // Leaves room for the grid line left and above the image
+    const qreal width = source_width * properties.zoom + GRID_LINE_WIDTH;
+    const qreal height = source_height * properties.zoom + GRID_LINE_WIDTH;
+    if(scene()->sceneRect() != QRectF(0, 0, width, height))
+    {
+        scene()->setSceneRect(0, 0, width, height);
+        invalidateOverlay();
+    }
+}
 
-    cached_overlay = cached_overlay.scaled(cached_overlay.width(), cached_overlay.height(), Qt::IgnoreAspectRatio, Qt::FastTransformation);
+void TiledImageView::updateCell(int cellx, int celly)
+{
+    if(cellx == -1 || celly == -1)
+    {
+        return;
+    }
+
+    const qreal grid_size_x_scale = properties.grid_size_x * properties.zoom;
+    const qreal grid_size_y_scale = properties.grid_size_y * properties.zoom;
+    const QRectF cell_rect = QRectF(cellx * grid_size_x_scale, celly * grid_size_y_scale, grid_size_x_scale, grid_size_y_scale)
+                                .adjusted(-GRID_LINE_WIDTH, -GRID_LINE_WIDTH, GRID_LINE_WIDTH + 1, GRID_LINE_WIDTH + 1);
+    viewport()->update(mapFromScene(cell_rect).boundingRect());
+}
+
+void TiledImageView::renderImage(QPainter* painter, const QRectF& rect)
+{
+    if(chunk_pixmaps.isEmpty())
+    {
+        return;
+    }
+
+    const qreal zoom = properties.zoom;
+    const QRect source_rect = QRectF((rect.left() - GRID_LINE_WIDTH) / zoom, (rect.top() - GRID_LINE_WIDTH) / zoom,
+                                     rect.width() / zoom, rect.height() / zoom).toAlignedRect()
+                            & QRect(0, 0, source_width, source_height);
+    if(source_rect.isEmpty())
+    {
+        return;
+    }
+
+    // Nearest neighbour scaling of only the chunks in view, the cost does not depend on the image size
+    painter->save();
+    painter->setRenderHint(QPainter::SmoothPixmapTransform, false);
+    painter->translate(GRID_LINE_WIDTH, GRID_LINE_WIDTH);
+    painter->scale(zoom, zoom);
+
+    for(int chunk_y = source_rect.top() / TILED_VIEW_CHUNK_SIZE; chunk_y <= source_rect.bottom() / TILED_VIEW_CHUNK_SIZE; ++chunk_y)
+    {
+        for(int chunk_x = source_rect.left() / TILED_VIEW_CHUNK_SIZE; chunk_x <= source_rect.right() / TILED_VIEW_CHUNK_SIZE; ++chunk_x)
+        {
+            painter->drawPixmap(chunk_x * TILED_VIEW_CHUNK_SIZE, chunk_y * TILED_VIEW_CHUNK_SIZE, getChunkPixmap(chunk_x, chunk_y));
+        }
+    }
+    painter->restore();
 }
 
+void TiledImageView::renderOverlay(QPainter* painter, const QRectF& rect)
+{
+    if(chunk_pixmaps.isEmpty())
+    {
+        return;
+    }
+
+    painter->save();
+
+    if(properties.grid_enabled || properties.indices_enabled)
+    {
+        const QRectF overlay_rect = rect & scene()->sceneRect();
+        if(!overlay_rect.isEmpty())
+        {
+            const int chunk_x_begin = int(overlay_rect.left()) / TILED_VIEW_OVERLAY_CHUNK_SIZE;
+            const int chunk_y_begin = int(overlay_rect.top()) / TILED_VIEW_OVERLAY_CHUNK_SIZE;
+            const int chunk_x_end = int(overlay_rect.right()) / TILED_VIEW_OVERLAY_CHUNK_SIZE;
+            const int chunk_y_end = int(overlay_rect.bottom()) / TILED_VIEW_OVERLAY_CHUNK_SIZE;
+            for(int chunk_y = chunk_y_begin; chunk_y <= chunk_y_end; ++chunk_y)
+            {
+                for(int chunk_x = chunk_x_begin; chunk_x <= chunk_x_end; ++chunk_x)
+                {
+                    painter->drawPixmap(chunk_x * TILED_VIEW_OVERLAY_CHUNK_SIZE, chunk_y * TILED_VIEW_OVERLAY_CHUNK_SIZE, getOverlayChunk(chunk_x, chunk_y));
+                }
+            }
+        }
+    }
+
+    qreal grid_size_x_scale = properties.grid_size_x * properties.zoom;
+    qreal grid_size_y_scale = properties.grid_size_y * properties.zoom;
+
+    renderCellHighlight(painter, grid_size_x_scale, grid_size_y_scale, properties.highlight_color, properties.cell_highlight_x, properties.cell_highlight_y);
+
+    if(properties.mouse_cell_highlight)
+        renderCellHighlight(painter, grid_size_x_scale, grid_size_y_scale, properties.highlight_color, properties.mouse_cell_x, properties.mouse_cell_y);
+
+    painter->restore();
+}
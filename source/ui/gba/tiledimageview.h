@@ -4,6 +4,7 @@
 #include <gba/tiledimage.h>
 
 #include <QGraphicsView>
+#include <QHash>
 #include <QThread>
 
 struct TileImageViewDrawProperties
@@ -39,18 +40,32 @@ public:
     TiledImage* getTiledImage() const;
 
     virtual void render(QImage& out_image);
+    // Called when the view drops its image, or an area of it in source pixels
+    virtual void invalidate();
+    virtual void invalidateRect(const QRect& rect);
 };
 
 
+// Side of the square pixmap chunks the source image is uploaded in, in source pixels
+#define TILED_VIEW_CHUNK_SIZE 256
+// Side of the cached grid and index overlay chunks, in view pixels
+#define TILED_VIEW_OVERLAY_CHUNK_SIZE 256
+
 class TiledImageView : public QGraphicsView
 {
     Q_OBJECT
 private:
     int source_width, source_height;
+
+    // The model render at 1:1. Drawn scaled through the painter, only the chunks in view
     QImage cached_image;
-    QImage cached_overlay;
+    QVector<QPixmap> chunk_pixmaps;
+    QVector<bool> chunk_dirty;
+    int chunk_columns, chunk_rows;
+    QRect dirty_rect;       // source area to re-render and re-upload on the next redraw
 
-    QPixmap cached_pixmap;
+    // Grid and tile indices, rebuilt on zoom or grid changes. Highlights are drawn over it on each paint
+    QHash<quint64, QPixmap> overlay_chunks;
 
     TiledImageModel* model;
 
@@ -67,13 +82,22 @@ public:
     void clear();
     void redraw();
     void invalidate();
+    // Only re-uploads the chunks overlapping rect, in source pixels
+    void invalidateRect(const QRect& rect);
+    // Rebuilds the grid and index layer
     void invalidateOverlay();
 
 private:
-    void draw(const QImage& image, int x=0, int y=0);
-
     void render();
-    void renderOverlay();
+    void resetChunks();
+    void markChunksDirty(const QRect& rect);
+    const QPixmap& getChunkPixmap(int chunk_x, int chunk_y);
+    const QPixmap& getOverlayChunk(int chunk_x, int chunk_y);
+    void updateSceneRect();
+    void updateCell(int cellx, int celly);
+
+    void renderImage(QPainter* painter, const QRectF& rect);
+    void renderOverlay(QPainter* painter, const QRectF& rect);
 public:
     void getXY(QMouseEvent* event, int& x, int& y);
     void getCellXY(QMouseEvent* event, int& cellx, int& celly);
@@ -100,6 +124,10 @@ public:
     virtual void wheelEvent(QWheelEvent *event) override;
     virtual void mouseMoveEvent( QMouseEvent *e ) override;
     // End QOpenGLWidget
+
+protected:
+    virtual void drawBackground(QPainter* painter, const QRectF& rect) override;
+    virtual void drawForeground(QPainter* painter, const QRectF& rect) override;
 };
 
 #endif // TILEDIMAGEVIEW_H
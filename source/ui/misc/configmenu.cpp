@@ -21,6 +21,8 @@ ConfigMenu::ConfigMenu(QWidget *parent) :
     build_options[BUILD_INCLUDES] = ui->includes;
     build_options[BUILD_ARCH]= ui->arch;
     build_options[BUILD_ROM] = ui->rom;
+    build_options[BUILD_TRACE] = ui->trace;
+    build_options[BUILD_NINJA] = ui->ninja;
     build_options[BUILD_STEP_COMPILE] = ui->compile_step ;
     build_options[BUILD_STEP_LINK] = ui->link_step;
     build_options[BUILD_STEP_OBJCOPY] = ui->objcopy_step;
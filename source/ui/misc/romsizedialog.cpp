@@ -0,0 +1,105 @@
+#include "romsizedialog.h"
+#include "defines.h"
+
+#include <QHeaderView>
+#include <QVBoxLayout>
+
+RomSizeDialog::RomSizeDialog(QWidget *parent) :
+    QWidget(parent)
+{
+    setWindowTitle(EDGBA_TITLE " ROM Size");
+    resize(640, 480);
+
+    region_table = createTable({ "Region", "Address", "Used", "Capacity", "Used %" });
+    section_table = createTable({ "Section", "Region", "Address", "Size" });
+    asset_table = createTable({ "Asset", "Type", "Region", "Size", "Symbols" });
+
+    tabs = new QTabWidget(this);
+    tabs->addTab(asset_table, "Assets");
+    tabs->addTab(section_table, "Sections");
+    tabs->addTab(region_table, "Regions");
+
+    QVBoxLayout* layout = new QVBoxLayout(this);
+    layout->addWidget(tabs);
+}
+
+void RomSizeDialog::closeEvent(QCloseEvent* /*event*/)
+{
+    deleteLater();
+}
+
+QTableWidget* RomSizeDialog::createTable(const QStringList& headers)
+{
+    QTableWidget* table = new QTableWidget(this);
+    table->setColumnCount(headers.size());
+    table->setHorizontalHeaderLabels(headers);
+    table->setEditTriggers(QAbstractItemView::NoEditTriggers);
+    table->setSelectionBehavior(QAbstractItemView::SelectRows);
+    table->horizontalHeader()->setStretchLastSection(true);
+    table->verticalHeader()->hide();
+    return table;
+}
+
+void RomSizeDialog::setItem(QTableWidget* table, int row, int column, const QVariant& value)
+{
+    // Store numbers as numbers so the columns sort by value
+    QTableWidgetItem* item = new QTableWidgetItem();
+    item->setData(Qt::DisplayRole, value);
+    table->setItem(row, column, item);
+}
+
+static QString formatAddress(quint32 address)
+{
+    return QString("0x%1").arg(address, 8, 16, QChar('0'));
+}
+
+void RomSizeDialog::on_report(RomSizeReport report)
+{
+    QTableWidget* tables[] = { region_table, section_table, asset_table };
+    for(QTableWidget* table : tables)
+    {
+        table->setSortingEnabled(false);
+        table->clearContents();
+    }
+
+    region_table->setRowCount(report.regions.size());
+    for(int row = 0; row < report.regions.size(); ++row)
+    {
+        const RomRegionUsage& region = report.regions[row];
+        const double percent = region.capacity ? 100.0 * region.used / region.capacity : 0.0;
+        setItem(region_table, row, 0, region.name);
+        setItem(region_table, row, 1, formatAddress(region.address));
+        setItem(region_table, row, 2, region.used);
+        setItem(region_table, row, 3, region.capacity);
+        setItem(region_table, row, 4, qRound(percent * 10.0) / 10.0);
+    }
+
+    section_table->setRowCount(report.sections.size());
+    for(int row = 0; row < report.sections.size(); ++row)
+    {
+        const RomSizeEntry& section = report.sections[row];
+        setItem(section_table, row, 0, section.name);
+        setItem(section_table, row, 1, section.region);
+        setItem(section_table, row, 2, formatAddress(section.address));
+        setItem(section_table, row, 3, section.size);
+    }
+
+    asset_table->setRowCount(report.assets.size());
+    for(int row = 0; row < report.assets.size(); ++row)
+    {
+        const RomSizeEntry& asset = report.assets[row];
+        setItem(asset_table, row, 0, asset.name);
+        setItem(asset_table, row, 1, asset.type);
+        setItem(asset_table, row, 2, asset.region);
+        setItem(asset_table, row, 3, asset.size);
+        setItem(asset_table, row, 4, asset.symbols.join(", "));
+    }
+
+    for(QTableWidget* table : tables)
+    {
+        table->setSortingEnabled(true);
+        table->resizeColumnsToContents();
+    }
+    asset_table->sortItems(3, Qt::DescendingOrder);
+    section_table->sortItems(3, Qt::DescendingOrder);
+}
@@ -0,0 +1,32 @@
+#ifndef ROMSIZEDIALOG_H
+#define ROMSIZEDIALOG_H
+
+#include <compiler/elfanalyzer.h>
+
+#include <QWidget>
+#include <QTabWidget>
+#include <QTableWidget>
+
+// Sortable per region, section and asset size tables of the last built ROM
+class RomSizeDialog : public QWidget
+{
+    Q_OBJECT
+
+    QTabWidget* tabs;
+    QTableWidget* region_table;
+    QTableWidget* section_table;
+    QTableWidget* asset_table;
+
+public:
+    explicit RomSizeDialog(QWidget *parent = nullptr);
+    void closeEvent(QCloseEvent* event) override;
+
+public slots:
+    void on_report(RomSizeReport report);
+
+private:
+    QTableWidget* createTable(const QStringList& headers);
+    void setItem(QTableWidget* table, int row, int column, const QVariant& value);
+};
+
+#endif // ROMSIZEDIALOG_H
@@ -2,6 +2,7 @@
 #include "defines.h"
 
 #include <QAction>
+#include <QFontMetrics>
 #include <QStyle>
 #include <QPushButton>
 #include <QMessageBox>
@@ -30,3 +31,12 @@ void Utils::popupWarning(const char* message)
     msgBox.setText(message);
     msgBox.exec();
 }
+
+int Utils::textWidth(const QFontMetrics& metrics, const QString& text)
+{
+#if QT_VERSION >= QT_VERSION_CHECK(5, 11, 0)
+    return metrics.horizontalAdvance(text);
+#else
+    return metrics.width(text);
+#endif
+}
@@ -5,6 +5,7 @@
 
 class QAction;
 class QPushButton;
+class QFontMetrics;
 
 class Utils
 {
@@ -12,6 +13,8 @@ public:
     static void setupAction(QAction* action, QString icon);
     static void setupIconButton(QPushButton* button, QString icon);
     static void popupWarning(const char* message);
+    // Advance of the text. QFontMetrics::width is deprecated from Qt 5.11, horizontalAdvance is missing before it
+    static int textWidth(const QFontMetrics& metrics, const QString& text);
 
 };
 